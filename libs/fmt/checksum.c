@@ -0,0 +1,297 @@
+#include <hl.h>
+#include <zlib.h>
+#include "checksum.h"
+#include "cpu.h"
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#	include <arm_acle.h>
+#endif
+
+int fmt_cpu_disabled = 0;
+
+int fmt_cpu_disable( int caps ) {
+	int all;
+	fmt_cpu_disabled = 0;
+	all = fmt_cpu_caps();
+	fmt_cpu_disabled = caps;
+	return all;
+}
+
+/* ------------------------------------------------- CRC32 --------------------------------------------------- */
+
+#ifdef FMT_X86
+/*
+	Folds 64 bytes at once with carry-less multiplications then reduces with Barrett,
+	constants are for the reflected 0xEDB88320 polynomial. Needs len >= 64 and a multiple
+	of 16, works on the non inverted crc.
+*/
+#define CRC_FOLD(x,k,data) { \
+		__m128i t = _mm_clmulepi64_si128(x, k, 0x00); \
+		x = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), t), data); \
+	}
+
+FMT_TARGET("pclmul,sse4.1")
+static unsigned int crc32_pclmul( unsigned int crc, const unsigned char *p, unsigned int len ) {
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_cvtsi32_si128((int)crc));
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(p + 16));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(p + 32));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(p + 48));
+	__m128i t;
+	p += 64;
+	len -= 64;
+	while( len >= 64 ) {
+		CRC_FOLD(x0, k1k2, _mm_loadu_si128((const __m128i*)p));
+		CRC_FOLD(x1, k1k2, _mm_loadu_si128((const __m128i*)(p + 16)));
+		CRC_FOLD(x2, k1k2, _mm_loadu_si128((const __m128i*)(p + 32)));
+		CRC_FOLD(x3, k1k2, _mm_loadu_si128((const __m128i*)(p + 48)));
+		p += 64;
+		len -= 64;
+	}
+	CRC_FOLD(x0, k3k4, x1);
+	CRC_FOLD(x0, k3k4, x2);
+	CRC_FOLD(x0, k3k4, x3);
+	while( len >= 16 ) {
+		CRC_FOLD(x0, k3k4, _mm_loadu_si128((const __m128i*)p));
+		p += 16;
+		len -= 16;
+	}
+	// 128 to 64 bits
+	x0 = _mm_xor_si128(_mm_clmulepi64_si128(x0, k3k4, 0x10), _mm_srli_si128(x0, 8));
+	// 64 to 32 bits
+	t = _mm_srli_si128(x0, 4);
+	x0 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00), t);
+	// Barrett reduction
+	t = x0;
+	x0 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x10), mask32);
+	x0 = _mm_xor_si128(_mm_clmulepi64_si128(x0, poly, 0x00), t);
+	return (unsigned int)_mm_extract_epi32(x0, 1);
+}
+#endif
+
+unsigned int crc32_fast( unsigned int crc, const unsigned char *data, unsigned int len ) {
+#	if defined(__ARM_FEATURE_CRC32)
+	crc = ~crc;
+	while( len >= 8 ) {
+		unsigned long long v;
+		memcpy(&v, data, 8);
+		crc = __crc32d(crc, v);
+		data += 8;
+		len -= 8;
+	}
+	while( len-- )
+		crc = __crc32b(crc, *data++);
+	return ~crc;
+#	else
+#	ifdef FMT_X86
+	if( len >= 64 && (fmt_cpu_caps() & CPU_PCLMUL) ) {
+		unsigned int n = len & ~15;
+		crc = ~crc32_pclmul(~crc, data, n);
+		data += n;
+		len -= n;
+	}
+#	endif
+	return (unsigned int)crc32(crc, data, len);
+#	endif
+}
+
+/* ------------------------------------------------- CRC32C --------------------------------------------------- */
+
+static unsigned int crc32c_table[256];
+static bool crc32c_init = false;
+
+static unsigned int crc32c_soft( unsigned int crc, const unsigned char *data, unsigned int len ) {
+	if( !crc32c_init ) {
+		unsigned int i, k;
+		for(i=0;i<256;i++) {
+			unsigned int c = i;
+			for(k=0;k<8;k++)
+				c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+			crc32c_table[i] = c;
+		}
+		crc32c_init = true;
+	}
+	while( len-- )
+		crc = crc32c_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef FMT_X86
+FMT_TARGET("sse4.2")
+static unsigned int crc32c_sse42( unsigned int crc, const unsigned char *data, unsigned int len ) {
+#	if defined(__x86_64__) || defined(_M_X64)
+	unsigned long long c = crc;
+	while( len >= 8 ) {
+		unsigned long long v;
+		memcpy(&v, data, 8);
+		c = _mm_crc32_u64(c, v);
+		data += 8;
+		len -= 8;
+	}
+	crc = (unsigned int)c;
+#	else
+	while( len >= 4 ) {
+		unsigned int v;
+		memcpy(&v, data, 4);
+		crc = _mm_crc32_u32(crc, v);
+		data += 4;
+		len -= 4;
+	}
+#	endif
+	while( len-- )
+		crc = _mm_crc32_u8(crc, *data++);
+	return crc;
+}
+#endif
+
+unsigned int crc32c( unsigned int crc, const unsigned char *data, unsigned int len ) {
+	crc = ~crc;
+#	if defined(__ARM_FEATURE_CRC32)
+	while( len >= 8 ) {
+		unsigned long long v;
+		memcpy(&v, data, 8);
+		crc = __crc32cd(crc, v);
+		data += 8;
+		len -= 8;
+	}
+	while( len-- )
+		crc = __crc32cb(crc, *data++);
+	return ~crc;
+#	else
+#	ifdef FMT_X86
+	if( fmt_cpu_caps() & CPU_SSE42 )
+		return ~crc32c_sse42(crc, data, len);
+#	endif
+	return ~crc32c_soft(crc, data, len);
+#	endif
+}
+
+/* ------------------------------------------------- XXH64 --------------------------------------------------- */
+
+#define XXH_P1 11400714785074694791ULL
+#define XXH_P2 14029467366897019727ULL
+#define XXH_P3 1609587929392839161ULL
+#define XXH_P4 9650029242287828579ULL
+#define XXH_P5 2870177450012600261ULL
+
+#define xxh_rotl(x,r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static unsigned long long xxh_read64( const unsigned char *p ) {
+#	ifdef HL_BIG_ENDIAN
+	unsigned long long v = 0;
+	int i;
+	for(i=7;i>=0;i--)
+		v = (v << 8) | p[i];
+	return v;
+#	else
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+#	endif
+}
+
+static unsigned int xxh_read32( const unsigned char *p ) {
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long xxh_round( unsigned long long acc, unsigned long long v ) {
+	acc += v * XXH_P2;
+	acc = xxh_rotl(acc, 31);
+	return acc * XXH_P1;
+}
+
+static unsigned long long xxh_merge( unsigned long long h, unsigned long long v ) {
+	h ^= xxh_round(0, v);
+	return h * XXH_P1 + XXH_P4;
+}
+
+static void xxh64_stripes( XXH64_CTX *c, const unsigned char *p, unsigned int n ) {
+	unsigned long long v0 = c->v[0], v1 = c->v[1], v2 = c->v[2], v3 = c->v[3];
+	while( n-- ) {
+		v0 = xxh_round(v0, xxh_read64(p));
+		v1 = xxh_round(v1, xxh_read64(p + 8));
+		v2 = xxh_round(v2, xxh_read64(p + 16));
+		v3 = xxh_round(v3, xxh_read64(p + 24));
+		p += 32;
+	}
+	c->v[0] = v0;
+	c->v[1] = v1;
+	c->v[2] = v2;
+	c->v[3] = v3;
+}
+
+void xxh64_init( XXH64_CTX *c, unsigned long long seed ) {
+	c->seed = seed;
+	c->v[0] = seed + XXH_P1 + XXH_P2;
+	c->v[1] = seed + XXH_P2;
+	c->v[2] = seed;
+	c->v[3] = seed - XXH_P1;
+	c->total = 0;
+	c->size = 0;
+}
+
+void xxh64_update( XXH64_CTX *c, const unsigned char *data, unsigned int len ) {
+	c->total += len;
+	if( c->size ) {
+		unsigned int k = 32 - c->size;
+		if( len < k ) {
+			memcpy(c->buffer + c->size, data, len);
+			c->size += len;
+			return;
+		}
+		memcpy(c->buffer + c->size, data, k);
+		xxh64_stripes(c, c->buffer, 1);
+		data += k;
+		len -= k;
+		c->size = 0;
+	}
+	if( len >= 32 ) {
+		xxh64_stripes(c, data, len >> 5);
+		data += len & ~31;
+		len &= 31;
+	}
+	memcpy(c->buffer, data, len);
+	c->size = len;
+}
+
+unsigned long long xxh64_final( XXH64_CTX *c ) {
+	unsigned long long h;
+	const unsigned char *p = c->buffer;
+	unsigned int len = c->size;
+	if( c->total >= 32 ) {
+		h = xxh_rotl(c->v[0], 1) + xxh_rotl(c->v[1], 7) + xxh_rotl(c->v[2], 12) + xxh_rotl(c->v[3], 18);
+		h = xxh_merge(h, c->v[0]);
+		h = xxh_merge(h, c->v[1]);
+		h = xxh_merge(h, c->v[2]);
+		h = xxh_merge(h, c->v[3]);
+	} else
+		h = c->seed + XXH_P5;
+	h += c->total;
+	while( len >= 8 ) {
+		h ^= xxh_round(0, xxh_read64(p));
+		h = xxh_rotl(h, 27) * XXH_P1 + XXH_P4;
+		p += 8;
+		len -= 8;
+	}
+	if( len >= 4 ) {
+		h ^= (unsigned long long)xxh_read32(p) * XXH_P1;
+		h = xxh_rotl(h, 23) * XXH_P2 + XXH_P3;
+		p += 4;
+		len -= 4;
+	}
+	while( len-- ) {
+		h ^= (*p++) * XXH_P5;
+		h = xxh_rotl(h, 11) * XXH_P1;
+	}
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return h;
+}
@@ -0,0 +1,23 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+typedef struct {
+	unsigned long long v[4];
+	unsigned long long total;
+	unsigned long long seed;
+	unsigned char buffer[32];
+	unsigned int size;
+} XXH64_CTX;
+
+// same convention as zlib crc32 : pass 0 to start, the previous result to continue
+unsigned int crc32_fast( unsigned int crc, const unsigned char *data, unsigned int len );
+unsigned int crc32c( unsigned int crc, const unsigned char *data, unsigned int len );
+
+// disables some accelerated code paths (CPU_* flags), returns the ones the cpu supports
+int fmt_cpu_disable( int caps );
+
+void xxh64_init( XXH64_CTX *c, unsigned long long seed );
+void xxh64_update( XXH64_CTX *c, const unsigned char *data, unsigned int len );
+unsigned long long xxh64_final( XXH64_CTX *c );
+
+#endif
@@ -0,0 +1,440 @@
+#define HL_NAME(n) fmt_##n
+#include <hl.h>
+#include <string.h>
+
+#ifdef HL_ZSTD
+#	include <zstd.h>
+#	include <zstd_errors.h>
+#endif
+#ifdef HL_LZ4
+#	include <lz4.h>
+#	include <lz4hc.h>
+#	include <lz4frame.h>
+#endif
+
+/*
+	Zstandard and LZ4 codecs, each optional (HL_ZSTD / HL_LZ4), use codec_supported to check.
+
+	Streams use the same model as fmt_zip : a handle created with *_compress_init or
+	*_decompress_init, codec_buffer consuming src and filling dst, codec_flush_mode
+	with the zip_flush_mode values (0 none, 1 sync, 2 full, 3 finish, 4 block) and
+	codec_buffer returning true once the frame is complete.
+	LZ4 streams are LZ4 frames, lz4_compress/lz4_decompress work on raw LZ4 blocks.
+
+	As with deflate_buffer, srclen and dstlen are the buffers sizes.
+*/
+
+#define CODEC_ZSTD		0
+#define CODEC_LZ4		1
+
+#define FLUSH_NONE		0
+#define FLUSH_SYNC		1
+#define FLUSH_FINISH	3
+
+#define LZ4_CHUNK		(64 << 10)
+
+typedef struct _fmt_codec fmt_codec;
+struct _fmt_codec {
+	void (*finalize)( fmt_codec * );
+	int codec;
+	bool compress;
+	int flush;
+	int level;
+	void *ctx;
+	// lz4 frame compression output not yet copied to dst
+	unsigned char *buf;
+	int bufsize;
+	int bufpos;
+	int buflen;
+	bool begun;
+	bool flushed;
+	bool ended;
+};
+
+#if !defined(HL_ZSTD) || !defined(HL_LZ4)
+static void codec_unsupported( const char *name ) {
+	hl_error("%s is not supported by this build of fmt", hl_to_utf16(name));
+}
+#endif
+
+static void codec_check_range( int srcpos, int srclen, int dstpos, int dstlen ) {
+	if( srcpos < 0 || dstpos < 0 || srclen < srcpos || dstlen < dstpos )
+		hl_error("Out of range");
+}
+
+static void codec_free( fmt_codec *c ) {
+	if( c->ctx ) {
+		switch( c->codec ) {
+#		ifdef HL_ZSTD
+		case CODEC_ZSTD:
+			if( c->compress ) ZSTD_freeCCtx((ZSTD_CCtx*)c->ctx); else ZSTD_freeDCtx((ZSTD_DCtx*)c->ctx);
+			break;
+#		endif
+#		ifdef HL_LZ4
+		case CODEC_LZ4:
+			if( c->compress ) LZ4F_freeCompressionContext((LZ4F_cctx*)c->ctx); else LZ4F_freeDecompressionContext((LZ4F_dctx*)c->ctx);
+			break;
+#		endif
+		}
+	}
+	free(c->buf);
+	c->buf = NULL;
+	c->ctx = NULL;
+	c->finalize = NULL;
+}
+
+#if defined(HL_ZSTD) || defined(HL_LZ4)
+static fmt_codec *codec_alloc( int codec, bool compress, int level, void *ctx ) {
+	fmt_codec *c = (fmt_codec*)hl_gc_alloc_finalizer(sizeof(fmt_codec));
+	memset(c, 0, sizeof(fmt_codec));
+	c->finalize = codec_free;
+	c->codec = codec;
+	c->compress = compress;
+	c->level = level;
+	c->flush = FLUSH_NONE;
+	c->ctx = ctx;
+	return c;
+}
+#endif
+
+HL_PRIM bool HL_NAME(codec_supported)( int codec ) {
+	switch( codec ) {
+#	ifdef HL_ZSTD
+	case CODEC_ZSTD: return true;
+#	endif
+#	ifdef HL_LZ4
+	case CODEC_LZ4: return true;
+#	endif
+	default: return false;
+	}
+}
+
+HL_PRIM void HL_NAME(codec_end)( fmt_codec *c ) {
+	codec_free(c);
+}
+
+HL_PRIM void HL_NAME(codec_flush_mode)( fmt_codec *c, int flush ) {
+	if( flush < 0 || flush > 4 )
+		hl_error("Invalid flush mode %d",flush);
+	// zstd and lz4 have no difference between sync, full and block flushes
+	c->flush = flush == FLUSH_FINISH || flush == FLUSH_NONE ? flush : FLUSH_SYNC;
+}
+
+/* ------------------------------------------------- ZSTD --------------------------------------------------- */
+
+#ifdef HL_ZSTD
+static void zstd_error( size_t r ) {
+	hl_error("ZSTD Error : %s", hl_to_utf16(ZSTD_getErrorName(r)));
+}
+
+static bool zstd_buffer( fmt_codec *c, vbyte *src, int slen, vbyte *dst, int dlen, int *read, int *write ) {
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	size_t r;
+	in.src = src;
+	in.size = slen;
+	in.pos = 0;
+	out.dst = dst;
+	out.size = dlen;
+	out.pos = 0;
+	hl_blocking(true);
+	if( c->compress )
+		r = ZSTD_compressStream2((ZSTD_CCtx*)c->ctx, &out, &in, c->flush == FLUSH_FINISH ? ZSTD_e_end : c->flush == FLUSH_SYNC ? ZSTD_e_flush : ZSTD_e_continue);
+	else
+		r = ZSTD_decompressStream((ZSTD_DCtx*)c->ctx, &out, &in);
+	hl_blocking(false);
+	if( ZSTD_isError(r) )
+		zstd_error(r);
+	*read = (int)in.pos;
+	*write = (int)out.pos;
+	// zero : compression frame ended and flushed, or decompression frame complete
+	return r == 0 && (!c->compress || c->flush == FLUSH_FINISH);
+}
+#endif
+
+HL_PRIM fmt_codec *HL_NAME(zstd_compress_init)( int level ) {
+#	ifdef HL_ZSTD
+	ZSTD_CCtx *ctx = ZSTD_createCCtx();
+	size_t r;
+	if( ctx == NULL )
+		hl_error("Out of memory");
+	r = ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, level);
+	if( ZSTD_isError(r) ) {
+		ZSTD_freeCCtx(ctx);
+		zstd_error(r);
+	}
+	return codec_alloc(CODEC_ZSTD, true, level, ctx);
+#	else
+	codec_unsupported("zstd");
+	return NULL;
+#	endif
+}
+
+HL_PRIM fmt_codec *HL_NAME(zstd_decompress_init)() {
+#	ifdef HL_ZSTD
+	ZSTD_DCtx *ctx = ZSTD_createDCtx();
+	if( ctx == NULL )
+		hl_error("Out of memory");
+	return codec_alloc(CODEC_ZSTD, false, 0, ctx);
+#	else
+	codec_unsupported("zstd");
+	return NULL;
+#	endif
+}
+
+// the dictionary is copied, it must be set before the first codec_buffer of the frame
+HL_PRIM void HL_NAME(zstd_set_dictionary)( fmt_codec *c, vbyte *dict, int pos, int len ) {
+#	ifdef HL_ZSTD
+	size_t r;
+	if( c->ctx == NULL || c->codec != CODEC_ZSTD )
+		hl_error("Invalid zstd handle");
+	r = c->compress ? ZSTD_CCtx_loadDictionary((ZSTD_CCtx*)c->ctx, dict + pos, len) : ZSTD_DCtx_loadDictionary((ZSTD_DCtx*)c->ctx, dict + pos, len);
+	if( ZSTD_isError(r) )
+		zstd_error(r);
+#	else
+	codec_unsupported("zstd");
+#	endif
+}
+
+HL_PRIM int HL_NAME(zstd_compress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen, int level ) {
+#	ifdef HL_ZSTD
+	size_t r;
+	codec_check_range(srcpos, srclen, dstpos, dstlen);
+	hl_blocking(true);
+	r = ZSTD_compress(dst + dstpos, dstlen - dstpos, src + srcpos, srclen - srcpos, level);
+	hl_blocking(false);
+	if( ZSTD_isError(r) ) {
+		if( ZSTD_getErrorCode(r) == ZSTD_error_dstSize_tooSmall )
+			return -1;
+		zstd_error(r);
+	}
+	return (int)r;
+#	else
+	codec_unsupported("zstd");
+	return -1;
+#	endif
+}
+
+HL_PRIM int HL_NAME(zstd_decompress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen ) {
+#	ifdef HL_ZSTD
+	size_t r;
+	codec_check_range(srcpos, srclen, dstpos, dstlen);
+	hl_blocking(true);
+	r = ZSTD_decompress(dst + dstpos, dstlen - dstpos, src + srcpos, srclen - srcpos);
+	hl_blocking(false);
+	if( ZSTD_isError(r) ) {
+		if( ZSTD_getErrorCode(r) == ZSTD_error_dstSize_tooSmall )
+			return -1;
+		zstd_error(r);
+	}
+	return (int)r;
+#	else
+	codec_unsupported("zstd");
+	return -1;
+#	endif
+}
+
+HL_PRIM int HL_NAME(zstd_compress_bound)( int size ) {
+#	ifdef HL_ZSTD
+	return (int)ZSTD_compressBound(size);
+#	else
+	codec_unsupported("zstd");
+	return 0;
+#	endif
+}
+
+/* ------------------------------------------------- LZ4 --------------------------------------------------- */
+
+#ifdef HL_LZ4
+static void lz4_error( size_t r ) {
+	hl_error("LZ4 Error : %s", hl_to_utf16(LZ4F_getErrorName(r)));
+}
+
+static void lz4_prefs( fmt_codec *c, LZ4F_preferences_t *prefs ) {
+	memset(prefs, 0, sizeof(LZ4F_preferences_t));
+	prefs->frameInfo.blockSizeID = LZ4F_max64KB;
+	prefs->frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	prefs->compressionLevel = c->level;
+}
+
+// compresses into buf as long as dst can receive its content, buf is flushed to dst first
+static bool lz4_compress_buffer( fmt_codec *c, vbyte *src, int slen, vbyte *dst, int dlen, int *read, int *write, size_t *err ) {
+	LZ4F_cctx *ctx = (LZ4F_cctx*)c->ctx;
+	LZ4F_preferences_t prefs;
+	int rpos = 0, wpos = 0;
+	size_t r;
+	lz4_prefs(c, &prefs);
+	while( true ) {
+		int n = c->buflen - c->bufpos;
+		if( n > dlen - wpos ) n = dlen - wpos;
+		memcpy(dst + wpos, c->buf + c->bufpos, n);
+		wpos += n;
+		c->bufpos += n;
+		if( c->bufpos < c->buflen )
+			break;
+		c->bufpos = c->buflen = 0;
+		if( !c->begun ) {
+			r = LZ4F_compressBegin(ctx, c->buf, c->bufsize, &prefs);
+			c->begun = true;
+		} else if( rpos < slen && !c->ended ) {
+			int k = slen - rpos;
+			if( k > LZ4_CHUNK ) k = LZ4_CHUNK;
+			r = LZ4F_compressUpdate(ctx, c->buf, c->bufsize, src + rpos, k, NULL);
+			rpos += k;
+			c->flushed = false;
+		} else if( c->flush == FLUSH_FINISH && !c->ended ) {
+			r = LZ4F_compressEnd(ctx, c->buf, c->bufsize, NULL);
+			c->ended = true;
+		} else if( c->flush == FLUSH_SYNC && !c->flushed && !c->ended ) {
+			r = LZ4F_flush(ctx, c->buf, c->bufsize, NULL);
+			c->flushed = true;
+		} else
+			break;
+		if( LZ4F_isError(r) ) {
+			*err = r;
+			break;
+		}
+		c->buflen = (int)r;
+	}
+	*read = rpos;
+	*write = wpos;
+	return c->ended && c->bufpos == c->buflen;
+}
+#endif
+
+HL_PRIM fmt_codec *HL_NAME(lz4_compress_init)( int level ) {
+#	ifdef HL_LZ4
+	LZ4F_cctx *ctx;
+	LZ4F_preferences_t prefs;
+	fmt_codec *c;
+	size_t r = LZ4F_createCompressionContext(&ctx, LZ4F_VERSION);
+	if( LZ4F_isError(r) )
+		lz4_error(r);
+	c = codec_alloc(CODEC_LZ4, true, level, ctx);
+	lz4_prefs(c, &prefs);
+	c->bufsize = (int)LZ4F_compressBound(LZ4_CHUNK, &prefs);
+	if( c->bufsize < LZ4F_HEADER_SIZE_MAX ) c->bufsize = LZ4F_HEADER_SIZE_MAX;
+	c->buf = (unsigned char*)malloc(c->bufsize);
+	if( c->buf == NULL ) {
+		codec_free(c);
+		hl_error("Out of memory");
+	}
+	return c;
+#	else
+	codec_unsupported("lz4");
+	return NULL;
+#	endif
+}
+
+HL_PRIM fmt_codec *HL_NAME(lz4_decompress_init)() {
+#	ifdef HL_LZ4
+	LZ4F_dctx *ctx;
+	size_t r = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+	if( LZ4F_isError(r) )
+		lz4_error(r);
+	return codec_alloc(CODEC_LZ4, false, 0, ctx);
+#	else
+	codec_unsupported("lz4");
+	return NULL;
+#	endif
+}
+
+// level <= 0 : fast compression with -level acceleration, level > 0 : high compression
+HL_PRIM int HL_NAME(lz4_compress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen, int level ) {
+#	ifdef HL_LZ4
+	int r;
+	codec_check_range(srcpos, srclen, dstpos, dstlen);
+	hl_blocking(true);
+	if( level > 0 )
+		r = LZ4_compress_HC((char*)src + srcpos, (char*)dst + dstpos, srclen - srcpos, dstlen - dstpos, level);
+	else
+		r = LZ4_compress_fast((char*)src + srcpos, (char*)dst + dstpos, srclen - srcpos, dstlen - dstpos, level < 0 ? -level : 1);
+	hl_blocking(false);
+	return r == 0 && srclen > srcpos ? -1 : r;
+#	else
+	codec_unsupported("lz4");
+	return -1;
+#	endif
+}
+
+// the decompressed size must be known : a too small dst is an error
+HL_PRIM int HL_NAME(lz4_decompress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen ) {
+#	ifdef HL_LZ4
+	int r;
+	codec_check_range(srcpos, srclen, dstpos, dstlen);
+	hl_blocking(true);
+	r = LZ4_decompress_safe((char*)src + srcpos, (char*)dst + dstpos, srclen - srcpos, dstlen - dstpos);
+	hl_blocking(false);
+	if( r < 0 )
+		hl_error("LZ4 Error : invalid data or output too small");
+	return r;
+#	else
+	codec_unsupported("lz4");
+	return -1;
+#	endif
+}
+
+HL_PRIM int HL_NAME(lz4_compress_bound)( int size ) {
+#	ifdef HL_LZ4
+	return LZ4_compressBound(size);
+#	else
+	codec_unsupported("lz4");
+	return 0;
+#	endif
+}
+
+/* ------------------------------------------------- STREAMS --------------------------------------------------- */
+
+HL_PRIM bool HL_NAME(codec_buffer)( fmt_codec *c, vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen, int *read, int *write ) {
+	codec_check_range(srcpos, srclen, dstpos, dstlen);
+	if( c->ctx == NULL )
+		hl_error("Codec stream is closed");
+	switch( c->codec ) {
+#	ifdef HL_ZSTD
+	case CODEC_ZSTD:
+		return zstd_buffer(c, src + srcpos, srclen - srcpos, dst + dstpos, dstlen - dstpos, read, write);
+#	endif
+#	ifdef HL_LZ4
+	case CODEC_LZ4:
+		if( c->compress ) {
+			size_t err = 0;
+			bool done;
+			hl_blocking(true);
+			done = lz4_compress_buffer(c, src + srcpos, srclen - srcpos, dst + dstpos, dstlen - dstpos, read, write, &err);
+			hl_blocking(false);
+			if( err )
+				lz4_error(err);
+			return done;
+		} else {
+			size_t slen = srclen - srcpos, dlen = dstlen - dstpos, r;
+			hl_blocking(true);
+			r = LZ4F_decompress((LZ4F_dctx*)c->ctx, dst + dstpos, &dlen, src + srcpos, &slen, NULL);
+			hl_blocking(false);
+			if( LZ4F_isError(r) )
+				lz4_error(r);
+			*read = (int)slen;
+			*write = (int)dlen;
+			return r == 0;
+		}
+#	endif
+	}
+	return false;
+}
+
+#define _CODEC _ABSTRACT(fmt_codec)
+
+DEFINE_PRIM(_BOOL, codec_supported, _I32);
+DEFINE_PRIM(_VOID, codec_end, _CODEC);
+DEFINE_PRIM(_VOID, codec_flush_mode, _CODEC _I32);
+DEFINE_PRIM(_BOOL, codec_buffer, _CODEC _BYTES _I32 _I32 _BYTES _I32 _I32 _REF(_I32) _REF(_I32));
+DEFINE_PRIM(_CODEC, zstd_compress_init, _I32);
+DEFINE_PRIM(_CODEC, zstd_decompress_init, _NO_ARG);
+DEFINE_PRIM(_VOID, zstd_set_dictionary, _CODEC _BYTES _I32 _I32);
+DEFINE_PRIM(_I32, zstd_compress, _BYTES _I32 _I32 _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_I32, zstd_decompress, _BYTES _I32 _I32 _BYTES _I32 _I32);
+DEFINE_PRIM(_I32, zstd_compress_bound, _I32);
+DEFINE_PRIM(_CODEC, lz4_compress_init, _I32);
+DEFINE_PRIM(_CODEC, lz4_decompress_init, _NO_ARG);
+DEFINE_PRIM(_I32, lz4_compress, _BYTES _I32 _I32 _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_I32, lz4_decompress, _BYTES _I32 _I32 _BYTES _I32 _I32);
+DEFINE_PRIM(_I32, lz4_compress_bound, _I32);
@@ -0,0 +1,56 @@
+#ifndef FMT_CPU_H
+#define FMT_CPU_H
+
+/*
+	Runtime detection of the x86 instructions used by the digests.
+	On ARM the CRC32 instructions are used when enabled at compile time (__ARM_FEATURE_CRC32).
+*/
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#	define FMT_X86
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	else
+#		include <cpuid.h>
+#	endif
+#	include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#	define FMT_TARGET(t) __attribute__((target(t)))
+#else
+#	define FMT_TARGET(t)
+#endif
+
+#define CPU_SSE42	1
+#define CPU_PCLMUL	2
+#define CPU_SHA		4
+
+// caps disabled with fmt_cpu_disable (checksum.c)
+extern int fmt_cpu_disabled;
+
+static int fmt_cpu_caps() {
+	static int caps = -1;
+	if( caps < 0 ) {
+		int c = 0;
+#		ifdef FMT_X86
+		unsigned int r1[4] = {0}, r7[4] = {0};
+#		ifdef _MSC_VER
+		__cpuid((int*)r1, 1);
+		__cpuidex((int*)r7, 7, 0);
+#		else
+		__cpuid(1, r1[0], r1[1], r1[2], r1[3]);
+		if( __get_cpuid_max(0, NULL) >= 7 )
+			__cpuid_count(7, 0, r7[0], r7[1], r7[2], r7[3]);
+#		endif
+		if( r1[2] & (1 << 20) ) c |= CPU_SSE42;
+		// PCLMUL and SHA code also use SSE4.1
+		if( (r1[2] & (1 << 1)) && (r1[2] & (1 << 19)) ) c |= CPU_PCLMUL;
+		if( (r7[1] & (1 << 29)) && (r1[2] & (1 << 19)) && (r1[2] & (1 << 9)) ) c |= CPU_SHA;
+#		endif
+		caps = c;
+	}
+	return caps & ~fmt_cpu_disabled;
+}
+
+#endif
@@ -1,5 +1,23 @@
 #define HL_NAME(n) fmt_##n
 #include <hl.h>
+#include <string.h>
+#include <math.h>
+
+/*
+	Block compressed (BCn / DXT) textures to and from 32 bits RGBA pixels.
+
+	format :
+		1 : BC1 (DXT1), 2 : BC2 (DXT3, decoding only), 3 : BC3 (DXT5)
+		4 : BC4 (red), 5 : BC5 (red and green), 7 : BC7
+		256 : split the block rows between several threads
+	Partial blocks on the right and bottom edges are clipped when decoding
+	and filled by repeating the edge pixels when encoding.
+*/
+
+#define DXT_THREADS		256
+#define MAX_THREADS		8
+#define MIN_DECODE_ROWS	16
+#define MIN_ENCODE_ROWS	2
 
 static const int BIT5[] = { 0, 8, 16, 25, 33, 41, 49, 58, 66, 74, 82, 90, 99, 107, 115, 123, 132, 140, 148, 156, 165, 173, 181, 189, 197, 206, 214, 222, 230, 239, 247, 255 };
 static const int BIT6[] = { 0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 45, 49, 53, 57, 61, 65, 69, 73, 77, 81, 85, 89, 93, 97, 101, 105, 109, 113, 117, 121, 125, 130, 134, 138, 142, 146, 150, 154, 158, 162, 166, 170, 174, 178, 182, 186, 190, 194, 198, 202, 206, 210, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255 };
@@ -58,112 +76,891 @@ static int dxtColor(int c0, int c1, int a, int t) {
 	return 0;
 }
 
-HL_PRIM bool HL_NAME(dxt_decode)( vbyte *data, int *out, int width, int height, int format ) {
-	int x,y,k;
-	int index = 0;
-	int write = 0;
-	int alpha[16];
+/* ------------------------------------------------- BC7 --------------------------------------------------- */
+
+typedef struct {
+	unsigned char ns;	// subsets
+	unsigned char pb;	// partition bits
+	unsigned char rb;	// rotation bits
+	unsigned char isb;	// index selection bits
+	unsigned char cb;	// color bits
+	unsigned char ab;	// alpha bits
+	unsigned char epb;	// pbit per endpoint
+	unsigned char spb;	// pbit per subset
+	unsigned char ib;	// index bits
+	unsigned char ib2;	// secondary index bits
+} bc7_mode;
+
+static const bc7_mode BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// bit k is the subset of texel k
+static const unsigned short BC7_P2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static const unsigned char BC7_P3[64][16] = {
+	{0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2}, {0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1}, {0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1}, {0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1},
+	{0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2}, {0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2}, {0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1}, {0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1},
+	{0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2}, {0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2},
+	{0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2}, {0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2}, {0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2}, {0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0},
+	{0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2}, {0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0}, {0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2}, {0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1},
+	{0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2}, {0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1}, {0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2}, {0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0},
+	{0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0}, {0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2}, {0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0}, {0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1},
+	{0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2}, {0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2}, {0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1}, {0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1},
+	{0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2}, {0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1}, {0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2}, {0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0},
+	{0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0}, {0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0}, {0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0}, {0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1},
+	{0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1}, {0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1}, {0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2},
+	{0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1}, {0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1}, {0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1}, {0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1},
+	{0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2}, {0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1}, {0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2}, {0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2},
+	{0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2}, {0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2}, {0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2},
+	{0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2}, {0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2}, {0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2}, {0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2},
+	{0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1}, {0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2}, {0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2}, {0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0},
+};
+
+// anchor texel of the second subset (two subsets) and of the second and third subsets (three subsets)
+static const unsigned char BC7_A2[64] = {
+	15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15, 2, 8, 2, 2, 8, 8,15, 2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15, 2, 8, 2, 2, 2,15,15, 6, 6, 2, 6, 8,15,15, 2, 2,15,15,15,15,15, 2, 2,15,
+};
+static const unsigned char BC7_A3A[64] = {
+	 3, 3,15,15, 8, 3,15,15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8,15, 3, 3, 6,10, 5, 8, 8, 6, 8, 5,15,15,
+	 8,15, 3, 5, 6,10, 8,15,15, 3,15, 5,15,15,15,15, 3,15, 5, 5, 5, 8, 5,10, 5,10, 8,13,15,12, 3, 3,
+};
+static const unsigned char BC7_A3B[64] = {
+	15, 8, 8, 3,15,15, 3, 8,15,15,15,15,15,15,15, 8,15, 8,15, 3,15, 8,15, 8, 3,15, 6,10,15,15,10, 8,
+	15, 3,15,10,10, 8, 9,10, 6,15, 8,15, 3, 6, 6, 8,15, 3,15,15,15,15,15,15,15,15,15,15, 3,15,15, 8,
+};
+
+static const int BC7_W2[4] = { 0, 21, 43, 64 };
+static const int BC7_W3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int BC7_W4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const int *bc7_weights( int bits ) {
+	return bits == 2 ? BC7_W2 : bits == 3 ? BC7_W3 : BC7_W4;
+}
+
+static int bc7_subset( int ns, int part, int k ) {
+	return ns == 1 ? 0 : ns == 2 ? (BC7_P2[part] >> k) & 1 : BC7_P3[part][k];
+}
+
+static int bc7_anchor( int ns, int part, int s ) {
+	return s == 0 ? 0 : ns == 2 ? BC7_A2[part] : s == 1 ? BC7_A3A[part] : BC7_A3B[part];
+}
+
+static int bc7_expand( int v, int bits ) {
+	v <<= 8 - bits;
+	return v | (v >> bits);
+}
+
+static int bc7_interp( int e0, int e1, int w ) {
+	return ((64 - w) * e0 + w * e1 + 32) >> 6;
+}
+
+typedef struct {
+	uint64 lo;
+	uint64 hi;
+	int pos;
+} bc7_bits;
+
+static int bc7_read( bc7_bits *b, int n ) {
+	uint64 v;
+	if( n == 0 ) return 0;
+	if( b->pos >= 64 )
+		v = b->hi >> (b->pos - 64);
+	else if( b->pos + n <= 64 )
+		v = b->lo >> b->pos;
+	else
+		v = (b->lo >> b->pos) | (b->hi << (64 - b->pos));
+	b->pos += n;
+	return (int)(v & ((1 << n) - 1));
+}
+
+static void bc7_write( bc7_bits *b, int v, int n ) {
+	if( b->pos < 64 ) {
+		b->lo |= (uint64)v << b->pos;
+		if( b->pos + n > 64 ) b->hi |= (uint64)v >> (64 - b->pos);
+	} else
+		b->hi |= (uint64)v << (b->pos - 64);
+	b->pos += n;
+}
+
+static uint64 dxt_read64( const unsigned char *b ) {
+	uint64 v = 0;
+	int k;
+	for(k=7;k>=0;k--)
+		v = (v << 8) | b[k];
+	return v;
+}
+
+static void dxt_write64( unsigned char *b, uint64 v ) {
+	int k;
+	for(k=0;k<8;k++) {
+		b[k] = (unsigned char)v;
+		v >>= 8;
+	}
+}
+
+static void bc7_block( const unsigned char *b, int *px ) {
+	const bc7_mode *m;
+	bc7_bits bits;
+	int ep[3][2][4];
+	int idx[16], idx2[16];
+	int mode, part, rot, isb, s, i, c, k, cprec, aprec;
+	const int *cw, *aw;
+	for(mode=0;mode<8;mode++)
+		if( b[0] & (1 << mode) ) break;
+	if( mode == 8 ) {
+		memset(px, 0, sizeof(int) * 16);
+		return;
+	}
+	m = &BC7_MODES[mode];
+	bits.lo = dxt_read64(b);
+	bits.hi = dxt_read64(b + 8);
+	bits.pos = mode + 1;
+	part = bc7_read(&bits, m->pb);
+	rot = bc7_read(&bits, m->rb);
+	isb = bc7_read(&bits, m->isb);
+	for(c=0;c<3;c++)
+		for(s=0;s<m->ns;s++)
+			for(i=0;i<2;i++)
+				ep[s][i][c] = bc7_read(&bits, m->cb);
+	for(s=0;s<m->ns;s++)
+		for(i=0;i<2;i++)
+			ep[s][i][3] = bc7_read(&bits, m->ab);
+	cprec = m->cb;
+	aprec = m->ab;
+	if( m->epb || m->spb ) {
+		for(s=0;s<m->ns;s++) {
+			int p = m->spb ? bc7_read(&bits, 1) : 0;
+			for(i=0;i<2;i++) {
+				if( m->epb ) p = bc7_read(&bits, 1);
+				for(c=0;c<4;c++)
+					ep[s][i][c] = (ep[s][i][c] << 1) | p;
+			}
+		}
+		cprec++;
+		aprec++;
+	}
+	for(s=0;s<m->ns;s++)
+		for(i=0;i<2;i++) {
+			for(c=0;c<3;c++)
+				ep[s][i][c] = bc7_expand(ep[s][i][c], cprec);
+			ep[s][i][3] = m->ab ? bc7_expand(ep[s][i][3], aprec) : 255;
+		}
+	for(k=0;k<16;k++) {
+		s = bc7_subset(m->ns, part, k);
+		idx[k] = bc7_read(&bits, m->ib - (k == bc7_anchor(m->ns, part, s) ? 1 : 0));
+	}
+	cw = aw = bc7_weights(m->ib);
+	if( m->ib2 ) {
+		for(k=0;k<16;k++)
+			idx2[k] = bc7_read(&bits, m->ib2 - (k == 0 ? 1 : 0));
+		if( isb ) cw = bc7_weights(m->ib2); else aw = bc7_weights(m->ib2);
+	}
+	for(k=0;k<16;k++) {
+		int ci = idx[k], ai = idx[k], col[4], t;
+		if( m->ib2 ) {
+			if( isb ) ci = idx2[k]; else ai = idx2[k];
+		}
+		s = bc7_subset(m->ns, part, k);
+		for(c=0;c<3;c++)
+			col[c] = bc7_interp(ep[s][0][c], ep[s][1][c], cw[ci]);
+		col[3] = bc7_interp(ep[s][0][3], ep[s][1][3], aw[ai]);
+		if( rot ) {
+			t = col[3];
+			col[3] = col[rot - 1];
+			col[rot - 1] = t;
+		}
+		px[k] = (int)MK_COLOR(col[0], col[1], col[2], (unsigned)col[3]);
+	}
+}
+
+/* ------------------------------------------------- DECODING --------------------------------------------------- */
+
+static void dxt_color_block( const unsigned char *b, const int *alpha, int *px ) {
+	int c0 = b[0] | (b[1] << 8);
+	int c1 = b[2] | (b[3] << 8);
+	unsigned int bits = b[4] | (b[5] << 8) | (b[6] << 16) | ((unsigned int)b[7] << 24);
+	int pal[4], k;
+	for(k=0;k<4;k++)
+		pal[k] = dxtColor(c0, c1, 0, k);
+	for(k=0;k<16;k++) {
+		int t = (bits >> (k << 1)) & 3;
+		px[k] = (t == 3 && c0 <= c1) ? 0 : pal[t] | (int)((unsigned)(alpha ? alpha[k] : 0xFF) << 24);
+	}
+}
+
+static void dxt_alpha_block( const unsigned char *b, int *alpha ) {
+	uint64 bits = dxt_read64(b) >> 16;
+	int pal[8], k;
+	for(k=0;k<8;k++)
+		pal[k] = dxtAlpha(b[0], b[1], k);
+	for(k=0;k<16;k++)
+		alpha[k] = pal[(bits >> (k * 3)) & 7];
+}
+
+static int dxt_block_size( int format ) {
 	switch( format ) {
-	case 1:
-		for(y=0;y<height>>2;y++) {
-			for(x=0;x<width>>2;x++) {
-				int c0 = data[index] | (data[index + 1] << 8); index += 2;
-				int c1 = data[index] | (data[index + 1] << 8); index += 2;
-				for(k=0;k<4;k++) {
-					unsigned char c = data[index++];
-					int t0 = c & 0x03;
-					int t1 = (c & 0x0C) >> 2;
-					int t2 = (c & 0x30) >> 4;
-					int t3 = (c & 0xC0) >> 6;
-					int w = write + k * width;
-					out[w++] = dxtColor(c0, c1, 0xFF, t0);
-					out[w++] = dxtColor(c0, c1, 0xFF, t1);
-					out[w++] = dxtColor(c0, c1, 0xFF, t2);
-					out[w++] = dxtColor(c0, c1, 0xFF, t3);
+	case 1: case 4: return 8;
+	case 2: case 3: case 5: case 7: return 16;
+	default: return 0;
+	}
+}
+
+typedef struct _dxt_ctx dxt_ctx;
+struct _dxt_ctx {
+	void (*band)( dxt_ctx *c, int from, int to );
+	unsigned char *data;
+	int *pixels;
+	int width;
+	int height;
+	int format;
+	int quality;
+	int bw;
+	int bh;
+	int rows[MAX_THREADS + 1];
+};
+
+static void dxt_decode_rows( dxt_ctx *c, int from, int to ) {
+	int size = dxt_block_size(c->format);
+	int px[16], alpha[16], alpha2[16];
+	int bx, by, k, y;
+	for(by=from;by<to;by++)
+		for(bx=0;bx<c->bw;bx++) {
+			unsigned char *b = c->data + (by * c->bw + bx) * size;
+			int w = c->width - bx * 4, h = c->height - by * 4;
+			switch( c->format ) {
+			case 1:
+				dxt_color_block(b, NULL, px);
+				break;
+			case 2:
+				for(k=0;k<8;k++) {
+					alpha[k * 2] = 17 * (b[k] >> 4);
+					alpha[k * 2 + 1] = 17 * (b[k] & 0x0F);
 				}
-				write += 4;
+				dxt_color_block(b + 8, alpha, px);
+				break;
+			case 3:
+				dxt_alpha_block(b, alpha);
+				dxt_color_block(b + 8, alpha, px);
+				break;
+			case 4:
+				dxt_alpha_block(b, alpha);
+				for(k=0;k<16;k++)
+					px[k] = (int)MK_COLOR(alpha[k], 0, 0, 0xFFu);
+				break;
+			case 5:
+				dxt_alpha_block(b, alpha);
+				dxt_alpha_block(b + 8, alpha2);
+				for(k=0;k<16;k++)
+					px[k] = (int)MK_COLOR(alpha[k], alpha2[k], 0, 0xFFu);
+				break;
+			case 7:
+				bc7_block(b, px);
+				break;
 			}
-			write += 3 * width;
-		}
-		return true;
-	case 2:
-		for(y=0;y<height>>2;y++) {
-			for(x=0;x<width>>2;x++) {
-				int ap = 0;
-				for(k=0;k<4;k++) {
-					int a0 = data[index++];
-					int a1 = data[index++];
-					alpha[ap++] = 17 * ((a0 & 0xF0) >> 4);
-					alpha[ap++] = 17 * (a0 & 0x0F);
-					alpha[ap++] = 17 * ((a1 & 0xF0) >> 4);
-					alpha[ap++] = 17 * (a1 & 0x0F);
-				}
-				ap = 0;
-				int c0 = data[index] | (data[index + 1] << 8); index += 2;
-				int c1 = data[index] | (data[index + 1] << 8); index += 2;
-				for (int k = 0; k<4; k++) {
-					int c = data[index++];
-					int t0 = c & 0x03;
-					int t1 = (c & 0x0C) >> 2;
-					int t2 = (c & 0x30) >> 4;
-					int t3 = (c & 0xC0) >> 6;
-					int w = write + k * width;
-					out[w++] = dxtColor(c0, c1, alpha[ap++], t0);
-					out[w++] = dxtColor(c0, c1, alpha[ap++], t1);
-					out[w++] = dxtColor(c0, c1, alpha[ap++], t2);
-					out[w++] = dxtColor(c0, c1, alpha[ap++], t3);
+			if( w > 4 ) w = 4;
+			if( h > 4 ) h = 4;
+			for(y=0;y<h;y++)
+				memcpy(c->pixels + (by * 4 + y) * c->width + bx * 4, px + y * 4, w * sizeof(int));
+		}
+}
+
+/* ------------------------------------------------- ENCODING --------------------------------------------------- */
+
+typedef struct {
+	float p[16][4];
+	int count;
+} dxt_points;
+
+// principal axis of the points through their mean
+static void dxt_axis( const dxt_points *pts, int n, float *mean, float *axis ) {
+	float cov[4][4], v[4], len;
+	int i, j, k, it;
+	memset(mean, 0, sizeof(float) * 4);
+	memset(cov, 0, sizeof(cov));
+	for(k=0;k<pts->count;k++)
+		for(i=0;i<n;i++)
+			mean[i] += pts->p[k][i];
+	for(i=0;i<n;i++)
+		mean[i] /= pts->count;
+	for(k=0;k<pts->count;k++)
+		for(i=0;i<n;i++)
+			for(j=0;j<n;j++)
+				cov[i][j] += (pts->p[k][i] - mean[i]) * (pts->p[k][j] - mean[j]);
+	// start from the channel with the largest variance
+	j = 0;
+	for(i=1;i<n;i++)
+		if( cov[i][i] > cov[j][j] ) j = i;
+	memset(axis, 0, sizeof(float) * 4);
+	for(i=0;i<n;i++)
+		axis[i] = cov[j][i];
+	for(it=0;it<8;it++) {
+		len = 0;
+		for(i=0;i<n;i++) {
+			v[i] = 0;
+			for(j=0;j<n;j++)
+				v[i] += cov[i][j] * axis[j];
+			if( fabsf(v[i]) > len ) len = fabsf(v[i]);
+		}
+		if( len == 0 ) break;
+		for(i=0;i<n;i++)
+			axis[i] = v[i] / len;
+	}
+}
+
+// squared distance of the points to their principal axis
+static float dxt_residual( const dxt_points *pts, int n ) {
+	float mean[4], axis[4], len = 0, err = 0;
+	int i, k;
+	dxt_axis(pts, n, mean, axis);
+	for(i=0;i<n;i++)
+		len += axis[i] * axis[i];
+	for(k=0;k<pts->count;k++) {
+		float d[4], t = 0, dd = 0;
+		for(i=0;i<n;i++) {
+			d[i] = pts->p[k][i] - mean[i];
+			t += d[i] * axis[i];
+			dd += d[i] * d[i];
+		}
+		err += len > 0 ? dd - t * t / len : dd;
+	}
+	return err;
+}
+
+// endpoints at the extremes of the projection of the points on the axis
+static void dxt_extents( const dxt_points *pts, int n, float e[2][4] ) {
+	float mean[4], axis[4], tmin = 0, tmax = 0, t;
+	int i, k;
+	dxt_axis(pts, n, mean, axis);
+	for(k=0;k<pts->count;k++) {
+		t = 0;
+		for(i=0;i<n;i++)
+			t += (pts->p[k][i] - mean[i]) * axis[i];
+		if( k == 0 || t < tmin ) tmin = t;
+		if( k == 0 || t > tmax ) tmax = t;
+	}
+	for(i=0;i<4;i++) {
+		e[0][i] = mean[i] + axis[i] * tmin;
+		e[1][i] = mean[i] + axis[i] * tmax;
+	}
+}
+
+// least squares endpoints for the given interpolation weights (0 = first endpoint, 1 = second)
+static bool dxt_refine( const dxt_points *pts, int n, const float *w, float e[2][4] ) {
+	float a = 0, b = 0, c = 0, x[4] = { 0 }, y[4] = { 0 }, det;
+	int i, k;
+	for(k=0;k<pts->count;k++) {
+		float w1 = w[k], w0 = 1 - w1;
+		a += w0 * w0;
+		b += w0 * w1;
+		c += w1 * w1;
+		for(i=0;i<n;i++) {
+			x[i] += w0 * pts->p[k][i];
+			y[i] += w1 * pts->p[k][i];
+		}
+	}
+	det = a * c - b * b;
+	if( fabsf(det) < 1e-6f ) return false;
+	for(i=0;i<n;i++) {
+		e[0][i] = (c * x[i] - b * y[i]) / det;
+		e[1][i] = (a * y[i] - b * x[i]) / det;
+	}
+	return true;
+}
+
+static int dxt_clamp( float v, int max ) {
+	int i = (int)(v + 0.5f);
+	return i < 0 ? 0 : i > max ? max : i;
+}
+
+static int dxt_pack565( const float *c ) {
+	return (dxt_clamp(c[0] * 31.f / 255.f, 31) << 11) | (dxt_clamp(c[1] * 63.f / 255.f, 63) << 5) | dxt_clamp(c[2] * 31.f / 255.f, 31);
+}
+
+// the indices are chosen against the palette exactly as dxt_decode will compute it
+static int dxt_color_indices( const int *px, int c0, int c1, bool punch, unsigned int *bits ) {
+	int pal[4], k, t, n = c0 > c1 ? 4 : 3, err = 0;
+	unsigned int out = 0;
+	for(t=0;t<4;t++)
+		pal[t] = dxtColor(c0, c1, 0, t);
+	for(k=0;k<16;k++) {
+		int p = px[k], best = 0, berr = 0x7FFFFFFF;
+		if( punch && ((p >> 24) & 0xFF) < 128 ) {
+			out |= 3u << (k << 1);
+			continue;
+		}
+		for(t=0;t<n;t++) {
+			int dr = (p & 0xFF) - (pal[t] & 0xFF);
+			int dg = ((p >> 8) & 0xFF) - ((pal[t] >> 8) & 0xFF);
+			int db = ((p >> 16) & 0xFF) - ((pal[t] >> 16) & 0xFF);
+			int e = dr * dr + dg * dg + db * db;
+			if( e < berr ) {
+				berr = e;
+				best = t;
+			}
+		}
+		out |= (unsigned int)best << (k << 1);
+		err += berr;
+	}
+	*bits = out;
+	return err;
+}
+
+static void dxt_color_encode( const int *px, unsigned char *out, bool punch, int quality ) {
+	static const float W4[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+	static const float W3[4] = { 0.f, 1.f, 0.5f, 0.f };
+	dxt_points pts;
+	float e[2][4], w[16];
+	int k, it, c0, c1, err, best0 = 0, best1 = 0, berr = 0x7FFFFFFF;
+	unsigned int bits, bbits = 0;
+	bool transparent = false;
+	pts.count = 0;
+	for(k=0;k<16;k++) {
+		int p = px[k];
+		if( punch && ((p >> 24) & 0xFF) < 128 ) {
+			transparent = true;
+			continue;
+		}
+		pts.p[pts.count][0] = (float)(p & 0xFF);
+		pts.p[pts.count][1] = (float)((p >> 8) & 0xFF);
+		pts.p[pts.count][2] = (float)((p >> 16) & 0xFF);
+		pts.count++;
+	}
+	if( pts.count == 0 ) {
+		memset(out, 0, 4);
+		memset(out + 4, 0xFF, 4);
+		return;
+	}
+	dxt_extents(&pts, 3, e);
+	for(it=0;it<=quality * 2;it++) {
+		if( it > 0 ) {
+			// refine the endpoints with the weights of the current best indices
+			const float *tw = best0 > best1 ? W4 : W3;
+			int n = 0;
+			for(k=0;k<16;k++) {
+				int t = (bbits >> (k << 1)) & 3;
+				if( punch && ((px[k] >> 24) & 0xFF) < 128 ) continue;
+				w[n++] = tw[t];
+			}
+			if( !dxt_refine(&pts, 3, w, e) ) break;
+		}
+		c0 = dxt_pack565(e[0]);
+		c1 = dxt_pack565(e[1]);
+		// four colors needs c0 > c1, transparency needs c0 <= c1
+		if( transparent ? c0 > c1 : c0 < c1 ) {
+			int t = c0;
+			c0 = c1;
+			c1 = t;
+		}
+		err = dxt_color_indices(px, c0, c1, transparent, &bits);
+		if( err >= berr ) break;
+		berr = err;
+		best0 = c0;
+		best1 = c1;
+		bbits = bits;
+	}
+	out[0] = (unsigned char)best0;
+	out[1] = (unsigned char)(best0 >> 8);
+	out[2] = (unsigned char)best1;
+	out[3] = (unsigned char)(best1 >> 8);
+	out[4] = (unsigned char)bbits;
+	out[5] = (unsigned char)(bbits >> 8);
+	out[6] = (unsigned char)(bbits >> 16);
+	out[7] = (unsigned char)(bbits >> 24);
+}
+
+static int dxt_alpha_indices( const int *a, int a0, int a1, uint64 *bits ) {
+	int pal[8], k, t, err = 0;
+	uint64 out = 0;
+	for(t=0;t<8;t++)
+		pal[t] = dxtAlpha(a0, a1, t);
+	for(k=0;k<16;k++) {
+		int best = 0, berr = 0x7FFFFFFF;
+		for(t=0;t<8;t++) {
+			int e = (a[k] - pal[t]) * (a[k] - pal[t]);
+			if( e < berr ) {
+				berr = e;
+				best = t;
+			}
+		}
+		out |= (uint64)best << (k * 3);
+		err += berr;
+	}
+	*bits = out;
+	return err;
+}
+
+// a = 16 values of one channel
+static void dxt_alpha_encode( const int *a, unsigned char *out, int quality ) {
+	int k, min = 255, max = 0, min6 = 255, max6 = 0, err, berr, b0, b1, d0, d1;
+	uint64 bits, bbits;
+	for(k=0;k<16;k++) {
+		int v = a[k];
+		if( v < min ) min = v;
+		if( v > max ) max = v;
+		if( v > 0 && v < min6 ) min6 = v;
+		if( v < 255 && v > max6 ) max6 = v;
+	}
+	// eight values mode needs a0 > a1, a single value is exact in the six values mode
+	b0 = max;
+	b1 = min;
+	berr = dxt_alpha_indices(a, b0, b1, &bbits);
+	if( quality >= 1 && (min == 0 || max == 255) && min6 <= max6 ) {
+		err = dxt_alpha_indices(a, min6, max6, &bits);
+		if( err < berr ) {
+			berr = err;
+			b0 = min6;
+			b1 = max6;
+			bbits = bits;
+		}
+	}
+	if( quality >= 2 && max > min + 1 && berr > 0 ) {
+		int s0 = b0, s1 = b1;
+		for(d0=-2;d0<=2;d0++)
+			for(d1=-2;d1<=2;d1++) {
+				int e0 = s0 + d0, e1 = s1 + d1;
+				if( e0 < 0 || e1 < 0 || e0 > 255 || e1 > 255 || (e0 > e1) != (s0 > s1) ) continue;
+				err = dxt_alpha_indices(a, e0, e1, &bits);
+				if( err < berr ) {
+					berr = err;
+					b0 = e0;
+					b1 = e1;
+					bbits = bits;
 				}
-				write += 4;
 			}
-			write += 3 * width;
-		}
-		return true;
-	case 3:
-		for(y=0;y<height>>2;y++) {
-			for(x=0;x<width>>2;x++) {
-				int a0 = data[index++];
-				int a1 = data[index++];
-				int b0 = data[index] | (data[index + 1] << 8) | (data[index + 2] << 16); index += 3;
-				int b1 = data[index] | (data[index + 1] << 8) | (data[index + 2] << 16); index += 3;
-				alpha[0] = b0 & 0x07;
-				alpha[1] = (b0 >> 3) & 0x07;
-				alpha[2] = (b0 >> 6) & 0x07;
-				alpha[3] = (b0 >> 9) & 0x07;
-				alpha[4] = (b0 >> 12) & 0x07;
-				alpha[5] = (b0 >> 15) & 0x07;
-				alpha[6] = (b0 >> 18) & 0x07;
-				alpha[7] = (b0 >> 21) & 0x07;
-				alpha[8] = b1 & 0x07;
-				alpha[9] = (b1 >> 3) & 0x07;
-				alpha[10] = (b1 >> 6) & 0x07;
-				alpha[11] = (b1 >> 9) & 0x07;
-				alpha[12] = (b1 >> 12) & 0x07;
-				alpha[13] = (b1 >> 15) & 0x07;
-				alpha[14] = (b1 >> 18) & 0x07;
-				alpha[15] = (b1 >> 21) & 0x07;
-				int c0 = data[index] | (data[index + 1] << 8); index += 2;
-				int c1 = data[index] | (data[index + 1] << 8); index += 2;
-				int ap = 0;
-				for (int k = 0; k<4; k++) {
-					int c = data[index++];
-					int t0 = c & 0x03;
-					int t1 = (c & 0x0C) >> 2;
-					int t2 = (c & 0x30) >> 4;
-					int t3 = (c & 0xC0) >> 6;
-					int w = write + k * width;
-					out[w++] = dxtColor(c0, c1, dxtAlpha(a0, a1, alpha[ap++]), t0);
-					out[w++] = dxtColor(c0, c1, dxtAlpha(a0, a1, alpha[ap++]), t1);
-					out[w++] = dxtColor(c0, c1, dxtAlpha(a0, a1, alpha[ap++]), t2);
-					out[w++] = dxtColor(c0, c1, dxtAlpha(a0, a1, alpha[ap++]), t3);
+	}
+	dxt_write64(out, ((bbits << 16) | (b1 << 8) | b0));
+}
+
+typedef struct {
+	int q[3][2][4];	// quantized endpoints, without pbit
+	int p[3][2];	// pbits
+	int e[3][2][4];	// endpoints as decoded
+	int idx[16];
+} bc7_state;
+
+static int bc7_quant( float v, int bits, int haspbit, int pbit, int *deq, float *err ) {
+	int n = bits + haspbit, max = (1 << bits) - 1, q, q0, best = 0;
+	float f = v * ((1 << n) - 1) / 255.f, berr = 1e30f;
+	q0 = haspbit ? (int)floorf((f - pbit) * 0.5f + 0.5f) : (int)floorf(f + 0.5f);
+	if( q0 < 0 ) q0 = 0;
+	if( q0 > max ) q0 = max;
+	for(q=q0-1;q<=q0+1;q++) {
+		float d;
+		int x;
+		if( q < 0 || q > max ) continue;
+		x = bc7_expand(haspbit ? (q << 1) | pbit : q, n);
+		d = (x - v) * (x - v);
+		if( d < berr ) {
+			berr = d;
+			best = q;
+			*deq = x;
+		}
+	}
+	*err += berr;
+	return best;
+}
+
+// quantizes the endpoints of subset s, choosing the pbits that best match them
+static void bc7_quantize( const bc7_mode *m, float e[2][4], int s, bc7_state *st ) {
+	int haspbit = m->epb | m->spb, np = haspbit ? 2 : 1, i, c, p, d[4];
+	float perr[2][2];
+	for(i=0;i<2;i++)
+		for(p=0;p<np;p++) {
+			perr[i][p] = 0;
+			for(c=0;c<3;c++)
+				bc7_quant(e[i][c], m->cb, haspbit, p, &d[c], &perr[i][p]);
+			if( m->ab )
+				bc7_quant(e[i][3], m->ab, haspbit, p, &d[3], &perr[i][p]);
+		}
+	for(i=0;i<2;i++) {
+		int best = 0;
+		if( m->epb )
+			best = perr[i][1] < perr[i][0] ? 1 : 0;
+		else if( m->spb )
+			best = perr[0][1] + perr[1][1] < perr[0][0] + perr[1][0] ? 1 : 0;
+		st->p[s][i] = best;
+		for(c=0;c<4;c++) {
+			float dummy = 0;
+			if( c == 3 && !m->ab ) {
+				st->q[s][i][c] = 0;
+				st->e[s][i][c] = 255;
+				continue;
+			}
+			st->q[s][i][c] = bc7_quant(e[i][c], c < 3 ? m->cb : m->ab, haspbit, best, &st->e[s][i][c], &dummy);
+		}
+	}
+}
+
+static int bc7_indices( const bc7_mode *m, int part, int s, const int *px, bc7_state *st ) {
+	const int *w = bc7_weights(m->ib);
+	int pal[16][4], n = 1 << m->ib, k, t, c, err = 0;
+	for(t=0;t<n;t++)
+		for(c=0;c<4;c++)
+			pal[t][c] = bc7_interp(st->e[s][0][c], st->e[s][1][c], w[t]);
+	for(k=0;k<16;k++) {
+		int best = 0, berr = 0x7FFFFFFF;
+		if( bc7_subset(m->ns, part, k) != s ) continue;
+		for(t=0;t<n;t++) {
+			int e = 0;
+			for(c=0;c<4;c++) {
+				int d = ((px[k] >> (c << 3)) & 0xFF) - pal[t][c];
+				e += d * d;
+			}
+			if( e < berr ) {
+				berr = e;
+				best = t;
+			}
+		}
+		st->idx[k] = best;
+		err += berr;
+	}
+	return err;
+}
+
+static int bc7_fit_subset( const bc7_mode *m, int part, int s, const int *px, int quality, bc7_state *st ) {
+	dxt_points pts;
+	bc7_state tmp;
+	float e[2][4], w[16];
+	int k, c, it, n = m->ab ? 4 : 3, err, berr;
+	pts.count = 0;
+	for(k=0;k<16;k++) {
+		if( bc7_subset(m->ns, part, k) != s ) continue;
+		for(c=0;c<4;c++)
+			pts.p[pts.count][c] = (float)((px[k] >> (c << 3)) & 0xFF);
+		pts.count++;
+	}
+	dxt_extents(&pts, n, e);
+	bc7_quantize(m, e, s, st);
+	berr = bc7_indices(m, part, s, px, st);
+	for(it=0;it<quality * 2 && berr > 0;it++) {
+		const int *bw = bc7_weights(m->ib);
+		int j = 0;
+		for(k=0;k<16;k++)
+			if( bc7_subset(m->ns, part, k) == s )
+				w[j++] = bw[st->idx[k]] / 64.f;
+		if( !dxt_refine(&pts, n, w, e) ) break;
+		tmp = *st;
+		bc7_quantize(m, e, s, &tmp);
+		err = bc7_indices(m, part, s, px, &tmp);
+		if( err >= berr ) break;
+		berr = err;
+		*st = tmp;
+	}
+	return berr;
+}
+
+static void bc7_pack( int mode, int part, bc7_state *st, unsigned char *out ) {
+	const bc7_mode *m = &BC7_MODES[mode];
+	bc7_bits bits;
+	int s, i, c, k, max = (1 << m->ib) - 1;
+	// the anchor index of each subset has an implicit zero high bit
+	for(s=0;s<m->ns;s++) {
+		int a = bc7_anchor(m->ns, part, s);
+		if( st->idx[a] <= max >> 1 ) continue;
+		for(c=0;c<4;c++) {
+			int t = st->q[s][0][c];
+			st->q[s][0][c] = st->q[s][1][c];
+			st->q[s][1][c] = t;
+		}
+		i = st->p[s][0];
+		st->p[s][0] = st->p[s][1];
+		st->p[s][1] = i;
+		for(k=0;k<16;k++)
+			if( bc7_subset(m->ns, part, k) == s )
+				st->idx[k] = max - st->idx[k];
+	}
+	bits.lo = bits.hi = 0;
+	bits.pos = 0;
+	bc7_write(&bits, 1 << mode, mode + 1);
+	bc7_write(&bits, part, m->pb);
+	for(c=0;c<3;c++)
+		for(s=0;s<m->ns;s++)
+			for(i=0;i<2;i++)
+				bc7_write(&bits, st->q[s][i][c], m->cb);
+	for(s=0;s<m->ns;s++)
+		for(i=0;i<2;i++)
+			bc7_write(&bits, st->q[s][i][3], m->ab);
+	for(s=0;s<m->ns;s++) {
+		if( m->spb ) bc7_write(&bits, st->p[s][0], 1);
+		for(i=0;i<2 && m->epb;i++)
+			bc7_write(&bits, st->p[s][i], 1);
+	}
+	for(k=0;k<16;k++)
+		bc7_write(&bits, st->idx[k], m->ib - (k == bc7_anchor(m->ns, part, bc7_subset(m->ns, part, k)) ? 1 : 0));
+	dxt_write64(out, bits.lo);
+	dxt_write64(out + 8, bits.hi);
+}
+
+/*
+	BC7 encoding uses mode 6 (one subset, 7 bits RGBA endpoints, 4 bits indices), and at quality 2
+	tries mode 1 (two subsets, 6 bits RGB endpoints, 3 bits indices) on opaque blocks.
+*/
+static void bc7_encode( const int *px, unsigned char *out, int quality ) {
+	bc7_state best, st;
+	int k, part, err, berr, bpart = 0, cand[4] = { 0 }, cerr[4], i, j;
+	bool opaque = true;
+	for(k=0;k<16;k++)
+		if( ((px[k] >> 24) & 0xFF) != 0xFF ) opaque = false;
+	berr = bc7_fit_subset(&BC7_MODES[6], 0, 0, px, quality, &best);
+	if( quality >= 2 && opaque && berr > 0 ) {
+		const bc7_mode *m = &BC7_MODES[1];
+		// rank the partitions by how well each subset fits a line, then fit the best ones
+		for(i=0;i<4;i++) cerr[i] = 0x7FFFFFFF;
+		for(part=0;part<64;part++) {
+			dxt_points pts[2];
+			pts[0].count = pts[1].count = 0;
+			for(k=0;k<16;k++) {
+				dxt_points *p = &pts[(BC7_P2[part] >> k) & 1];
+				for(j=0;j<3;j++)
+					p->p[p->count][j] = (float)((px[k] >> (j << 3)) & 0xFF);
+				p->count++;
+			}
+			err = (int)(dxt_residual(&pts[0], 3) + dxt_residual(&pts[1], 3));
+			for(i=0;i<4;i++)
+				if( err < cerr[i] ) {
+					for(j=3;j>i;j--) {
+						cerr[j] = cerr[j - 1];
+						cand[j] = cand[j - 1];
+					}
+					cerr[i] = err;
+					cand[i] = part;
+					break;
 				}
-				write += 4;
+		}
+		for(i=0;i<4;i++) {
+			err = bc7_fit_subset(m, cand[i], 0, px, quality, &st);
+			err += bc7_fit_subset(m, cand[i], 1, px, quality, &st);
+			if( err < berr ) {
+				berr = err;
+				bpart = cand[i];
+				best = st;
+				bpart |= 0x100;
 			}
-			write += 3 * width;
 		}
-		return true;
-	default:
-		return false;
 	}
+	if( bpart & 0x100 )
+		bc7_pack(1, bpart & 0xFF, &best, out);
+	else
+		bc7_pack(6, 0, &best, out);
+}
+
+static void dxt_encode_rows( dxt_ctx *c, int from, int to ) {
+	int size = dxt_block_size(c->format);
+	int px[16], a[16], k, x, y, bx, by;
+	for(by=from;by<to;by++)
+		for(bx=0;bx<c->bw;bx++) {
+			unsigned char *b = c->data + (by * c->bw + bx) * size;
+			// clamp to the edges for partial blocks
+			for(y=0;y<4;y++) {
+				int sy = by * 4 + y;
+				if( sy >= c->height ) sy = c->height - 1;
+				for(x=0;x<4;x++) {
+					int sx = bx * 4 + x;
+					if( sx >= c->width ) sx = c->width - 1;
+					px[y * 4 + x] = c->pixels[sy * c->width + sx];
+				}
+			}
+			switch( c->format ) {
+			case 1:
+				dxt_color_encode(px, b, true, c->quality);
+				break;
+			case 3:
+				for(k=0;k<16;k++)
+					a[k] = (px[k] >> 24) & 0xFF;
+				dxt_alpha_encode(a, b, c->quality);
+				dxt_color_encode(px, b + 8, false, c->quality);
+				break;
+			case 4:
+				for(k=0;k<16;k++)
+					a[k] = px[k] & 0xFF;
+				dxt_alpha_encode(a, b, c->quality);
+				break;
+			case 5:
+				for(k=0;k<16;k++)
+					a[k] = px[k] & 0xFF;
+				dxt_alpha_encode(a, b, c->quality);
+				for(k=0;k<16;k++)
+					a[k] = (px[k] >> 8) & 0xFF;
+				dxt_alpha_encode(a, b + 8, c->quality);
+				break;
+			case 7:
+				bc7_encode(px, b, c->quality);
+				break;
+			}
+		}
+}
+
+/* ------------------------------------------------- THREADS --------------------------------------------------- */
+
+static void dxt_band( dxt_ctx *c, int band ) {
+	c->band(c, c->rows[band], c->rows[band + 1]);
+}
+
+static int dxt_threads( int rows, int minRows ) {
+	int n = rows / minRows;
+	if( n > hl_cpu_count() ) n = hl_cpu_count();
+	if( n > MAX_THREADS ) n = MAX_THREADS;
+	return n < 1 ? 1 : n;
+}
+
+static void dxt_process( dxt_ctx *c, int flags, int minRows ) {
+	int nbands = 1, b;
+	if( flags & DXT_THREADS ) nbands = dxt_threads(c->bh, minRows);
+	for(b=0;b<=nbands;b++)
+		c->rows[b] = (int)((int64)c->bh * b / nbands);
+	// the bands only access the blocks and pixels : they run outside of the GC
+	hl_blocking(true);
+	hl_parallel_for(nbands, (void(*)(void*,int))dxt_band, c);
+	hl_blocking(false);
+}
+
+static bool dxt_init( dxt_ctx *c, vbyte *data, int *pixels, int width, int height, int format ) {
+	memset(c, 0, sizeof(dxt_ctx));
+	c->format = format & 0xFF;
+	if( width <= 0 || height <= 0 || dxt_block_size(c->format) == 0 ) return false;
+	c->data = data;
+	c->pixels = pixels;
+	c->width = width;
+	c->height = height;
+	c->bw = (width + 3) >> 2;
+	c->bh = (height + 3) >> 2;
+	return true;
+}
+
+HL_PRIM bool HL_NAME(dxt_decode)( vbyte *data, int *out, int width, int height, int format ) {
+	dxt_ctx c;
+	if( !dxt_init(&c, data, out, width, height, format) ) return false;
+	c.band = dxt_decode_rows;
+	dxt_process(&c, format, MIN_DECODE_ROWS);
+	return true;
+}
+
+/*
+	Encodes width x height 32 bits pixels into blocks of the given format (BC2 is not supported).
+	quality : 0 = fastest, 1 = least squares refinement, 2 = exhaustive (BC7 partitions)
+*/
+HL_PRIM bool HL_NAME(dxt_encode)( int *pixels, vbyte *out, int width, int height, int format, int quality ) {
+	dxt_ctx c;
+	if( !dxt_init(&c, out, pixels, width, height, format) || c.format == 2 ) return false;
+	c.quality = quality < 0 ? 0 : quality > 2 ? 2 : quality;
+	c.band = dxt_encode_rows;
+	dxt_process(&c, format, MIN_ENCODE_ROWS);
+	return true;
 }
 
 DEFINE_PRIM(_BOOL, dxt_decode, _BYTES _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_BOOL, dxt_encode, _BYTES _BYTES _I32 _I32 _I32 _I32);
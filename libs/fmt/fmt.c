@@ -18,10 +18,6 @@ extern bool sys_jpg_decode( vbyte *data, int dataLen, vbyte *out, int width, int
 
 /* ------------------------------------------------- IMG --------------------------------------------------- */
 
-typedef struct {
-	unsigned char a,r,g,b;
-} pixel;
-
 HL_PRIM vbyte* HL_NAME(jpg_encode)(vbyte* data, int width, int height, int stride, int format, int subSamp, int quality, int flags, int* outLength) {
 #if defined(HL_CONSOLE) && !defined(HL_XBO)
 	hl_blocking(true);
@@ -131,54 +127,9 @@ HL_PRIM bool HL_NAME(png_decode)( vbyte *data, int dataLen, vbyte *out, int widt
 	return true;
 }
 
-HL_PRIM void HL_NAME(img_scale)( vbyte *out, int outPos, int outStride, int outWidth, int outHeight, vbyte *in, int inPos, int inStride, int inWidth, int inHeight, int flags ) {
-	int x, y;
-	float scaleX = outWidth <= 1 ? 0.0f : (float)((inWidth - 1.001f) / (outWidth - 1));
-	float scaleY = outHeight <= 1 ? 0.0f : (float)((inHeight - 1.001f) / (outHeight - 1));
-	out += outPos;
-	in += inPos;
-	hl_blocking(true);
-	for(y=0;y<outHeight;y++) {
-		for(x=0;x<outWidth;x++) {
-			float fx = x * scaleX;
-			float fy = y * scaleY;
-			int ix = (int)fx;
-			int iy = (int)fy;
-			if( (flags & 1) == 0 ) {
-				// nearest
-				vbyte *rin = in + iy * inStride;
-				*(pixel*)out = *(pixel*)(rin + (ix<<2));
-				out += 4;
-			} else {
-				// bilinear
-				float rx = fx - ix;
-				float ry = fy - iy;
-				float rx1 = 1.0f - rx;
-				float ry1 = 1.0f - ry;
-				int w1 = (int)(rx1 * ry1 * 256.0f);
-				int w2 = (int)(rx * ry1 * 256.0f);
-				int w3 = (int)(rx1 * ry * 256.0f);
-				int w4 = (int)(rx * ry * 256.0f);
-				vbyte *rin = in + iy * inStride;
-				pixel p1 = *(pixel*)(rin + (ix<<2));
-				pixel p2 = *(pixel*)(rin + ((ix + 1)<<2));
-				pixel p3 = *(pixel*)(rin + inStride + (ix<<2));
-				pixel p4 = *(pixel*)(rin + inStride + ((ix + 1)<<2));
-				*out++ = (unsigned char)((p1.a * w1 + p2.a * w2 + p3.a * w3 + p4.a * w4 + 128)>>8);
-				*out++ = (unsigned char)((p1.r * w1 + p2.r * w2 + p3.r * w3 + p4.r * w4 + 128)>>8);
-				*out++ = (unsigned char)((p1.g * w1 + p2.g * w2 + p3.g * w3 + p4.g * w4 + 128)>>8);
-				*out++ = (unsigned char)((p1.b * w1 + p2.b * w2 + p3.b * w3 + p4.b * w4 + 128)>>8);
-			}
-		}
-		out += outStride - (outWidth << 2);
-	}
-	hl_blocking(false);
-}
-
 DEFINE_PRIM(_BYTES, jpg_encode, _BYTES _I32 _I32 _I32 _I32 _I32 _I32 _I32 _REF(_I32));
 DEFINE_PRIM(_BOOL, jpg_decode, _BYTES _I32 _BYTES _I32 _I32 _I32 _I32 _I32);
 DEFINE_PRIM(_BOOL, png_decode, _BYTES _I32 _BYTES _I32 _I32 _I32 _I32 _I32);
-DEFINE_PRIM(_VOID, img_scale, _BYTES _I32 _I32 _I32 _I32 _BYTES _I32 _I32 _I32 _I32 _I32);
 
 
 /* ------------------------------------------------- ZLIB --------------------------------------------------- */
@@ -774,42 +725,139 @@ static void md5_finish( md5_context *ctx, uint8 digest[16] ) {
 }
 
 #include "sha1.h"
+#include "sha256.h"
+#include "checksum.h"
+
+/*
+	Digest formats : 0 md5, 1 sha1, 2 crc32, 3 adler32, 4 sha256, 5 crc32c, 6 xxh64 (seed 0).
+	Checksums are written as a native int (int64 for xxh64), hashes as bytes.
+*/
+typedef struct {
+	int format;
+	union {
+		md5_context md5;
+		SHA1_CTX sha1;
+		SHA256_CTX sha256;
+		XXH64_CTX xxh64;
+		unsigned int sum;
+	} ctx;
+} fmt_hash;
+
+static int digest_size( int format ) {
+	switch( format ) {
+	case 0: return 16;
+	case 1: return 20;
+	case 2: case 3: case 5: return 4;
+	case 4: return SHA256_SIZE;
+	case 6: return 8;
+	default: return -1;
+	}
+}
+
+static bool digest_start( fmt_hash *d, int format ) {
+	d->format = format;
+	switch( format ) {
+	case 0: md5_starts(&d->ctx.md5); break;
+	case 1: sha1_init(&d->ctx.sha1); break;
+	case 2: case 5: d->ctx.sum = 0; break;
+	case 3: d->ctx.sum = 1; break;
+	case 4: sha256_init(&d->ctx.sha256); break;
+	case 6: xxh64_init(&d->ctx.xxh64, 0); break;
+	default: return false;
+	}
+	return true;
+}
+
+static void digest_feed( fmt_hash *d, vbyte *in, int length ) {
+	switch( d->format ) {
+	case 0: md5_update(&d->ctx.md5, in, (uint32)length); break;
+	case 1: sha1_update(&d->ctx.sha1, in, length); break;
+	case 2: d->ctx.sum = crc32_fast(d->ctx.sum, in, length); break;
+	case 3: d->ctx.sum = adler32(d->ctx.sum, in, length); break;
+	case 4: sha256_update(&d->ctx.sha256, in, length); break;
+	case 5: d->ctx.sum = crc32c(d->ctx.sum, in, length); break;
+	case 6: xxh64_update(&d->ctx.xxh64, in, length); break;
+	}
+}
+
+static void digest_end( fmt_hash *d, vbyte *out ) {
+	switch( d->format ) {
+	case 0: md5_finish(&d->ctx.md5, out); break;
+	case 1: sha1_final(&d->ctx.sha1, out); break;
+	case 2: case 3: case 5: *((int*)out) = (int)d->ctx.sum; break;
+	case 4: sha256_final(&d->ctx.sha256, out); break;
+	case 6:
+		{
+			uint64 h = xxh64_final(&d->ctx.xxh64);
+			memcpy(out, &h, 8);
+		}
+		break;
+	}
+}
 
 HL_PRIM void HL_NAME(digest)( vbyte *out, vbyte *in, int length, int format ) {
+	fmt_hash d;
 	if( format & 256 ) {
 		in = (vbyte*)hl_to_utf8((uchar*)in);
 		length = (int)strlen((char*)in);
 	}
-	hl_blocking(true);
-	switch( format & 0xFF ) {
-	case 0:
-		{
-			md5_context ctx;
-			md5_starts(&ctx);
-			md5_update(&ctx,in,(uint32)length);
-			md5_finish(&ctx,out);
-		}
-		break;
-	case 1:
-		{
-			SHA1_CTX ctx;
-			sha1_init(&ctx);
-			sha1_update(&ctx,in,length);
-			sha1_final(&ctx,out);
-		}
-		break;
-	case 2:
-		*((int*)out) = crc32(*(int*)out, in, length);
-		break;
-	case 3:
-		*((int*)out) = adler32(*(int*)out, in, length);
-		break;
-	default:
-		hl_blocking(false);
+	if( !digest_start(&d, format & 0xFF) )
 		hl_error("Unknown digest format %d",format&0xFF);
-		break;
+	// checksums continue from the value in out
+	switch( d.format ) {
+	case 2: case 3: case 5: d.ctx.sum = *(unsigned int*)out; break;
 	}
+	hl_blocking(true);
+	digest_feed(&d, in, length);
+	digest_end(&d, out);
 	hl_blocking(false);
 }
 
+// hashes count buffers, buffer i being in[offsets[i]..offsets[i+1]], results are stored one after the other in out
+HL_PRIM void HL_NAME(digest_many)( vbyte *out, vbyte *in, int *offsets, int count, int format ) {
+	fmt_hash d;
+	int size = digest_size(format);
+	int i;
+	if( size < 0 )
+		hl_error("Unknown digest format %d",format);
+	hl_blocking(true);
+	for(i=0;i<count;i++) {
+		digest_start(&d, format);
+		digest_feed(&d, in + offsets[i], offsets[i+1] - offsets[i]);
+		digest_end(&d, out + i * size);
+	}
+	hl_blocking(false);
+}
+
+HL_PRIM fmt_hash *HL_NAME(digest_init)( int format ) {
+	fmt_hash *d = (fmt_hash*)hl_gc_alloc_noptr(sizeof(fmt_hash));
+	if( !digest_start(d, format) )
+		hl_error("Unknown digest format %d",format);
+	return d;
+}
+
+HL_PRIM void HL_NAME(digest_update)( fmt_hash *d, vbyte *in, int pos, int length ) {
+	hl_blocking(true);
+	digest_feed(d, in + pos, length);
+	hl_blocking(false);
+}
+
+// writes the result and resets the state so the digest can be reused
+HL_PRIM int HL_NAME(digest_final)( fmt_hash *d, vbyte *out ) {
+	digest_end(d, out);
+	digest_start(d, d->format);
+	return digest_size(d->format);
+}
+
+// disables accelerated digest code (1 : SSE4.2, 2 : PCLMUL, 4 : SHA) to test the portable one, returns what the cpu supports
+HL_PRIM int HL_NAME(digest_disable_cpu)( int caps ) {
+	return fmt_cpu_disable(caps);
+}
+
+#define _HASH _ABSTRACT(fmt_hash)
 DEFINE_PRIM(_VOID, digest, _BYTES _BYTES _I32 _I32);
+DEFINE_PRIM(_VOID, digest_many, _BYTES _BYTES _BYTES _I32 _I32);
+DEFINE_PRIM(_HASH, digest_init, _I32);
+DEFINE_PRIM(_VOID, digest_update, _HASH _BYTES _I32 _I32);
+DEFINE_PRIM(_I32, digest_final, _HASH _BYTES);
+DEFINE_PRIM(_I32, digest_disable_cpu, _I32);
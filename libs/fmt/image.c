@@ -0,0 +1,904 @@
+#define HL_NAME(n) fmt_##n
+#include <png.h>
+#include <hl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <zlib.h>
+#include "checksum.h"
+
+#if !defined(HL_CONSOLE) || defined(HL_XBO)
+#	include <jpeglib.h>
+#	define IMG_JPEG
+#endif
+
+/*
+	PNG encoding, incremental PNG/JPEG decoding and batch decoding.
+
+	format follows jpg_decode / png_decode :
+		0 : RGB, 1 : BGR, 7 : RGBA, 8 : BGRA, 9 : ABGR, 10 : ARGB
+		JPEG also supports 2 : RGBX, 3 : BGRX, 4 : XBGR, 5 : XRGB, 6 : GRAY
+		PNG alpha is discarded when decoding to RGB or BGR
+	flags :
+		1 : bottom-up rows
+		2 : use several threads
+*/
+
+#define IMG_BOTTOMUP	1
+#define IMG_THREADS		2
+
+#define IMG_PNG			0
+#define IMG_JPG			1
+
+// decoding states
+#define IMG_ERROR		-1
+#define IMG_NEED_DATA	0
+#define IMG_HEADER		1
+#define IMG_DONE		2
+
+#define MAX_THREADS		8
+#define BAND_SIZE		(256 << 10)
+#define DICT_SIZE		(32 << 10)
+
+static int img_bpp( int kind, int format ) {
+	switch( format ) {
+	case 0: case 1: return 3;
+	case 7: case 8: case 9: case 10: return 4;
+	case 2: case 3: case 4: case 5: return kind == IMG_JPG ? 4 : 0;
+	case 6: return kind == IMG_JPG ? 1 : 0;
+	default: return 0;
+	}
+}
+
+static int img_threads( int jobs ) {
+	int n = jobs < hl_cpu_count() ? jobs : hl_cpu_count();
+	if( n > MAX_THREADS ) n = MAX_THREADS;
+	return n < 1 ? 1 : n;
+}
+
+/* ------------------------------------------------- PNG ENCODING --------------------------------------------------- */
+
+/*
+	The filtered scanlines are split into bands of about BAND_SIZE bytes. Each band is deflated
+	separately, primed with the previous 32KB as dictionary and ended with a sync flush, so
+	the bands are concatenated into a single zlib stream. Output does not depend on the number
+	of threads.
+*/
+
+typedef struct {
+	unsigned char *out;
+	int size;
+	unsigned int adler;
+	int err;
+} png_band;
+
+typedef struct {
+	unsigned char *src;
+	int stride;
+	int width;
+	int height;
+	int format;
+	int channels;
+	int rowbytes;
+	int filter;
+	int level;
+	int nthreads;
+	int nbands;
+	int bandRows;
+	unsigned char *filtered;
+	png_band *bands;
+} png_enc;
+
+// copies a source row into RGB(A) order
+static void png_enc_row( png_enc *e, int y, unsigned char *dst ) {
+	unsigned char *p = e->src + (int64)y * e->stride;
+	int x;
+	switch( e->format ) {
+	case 1:
+		for(x=0;x<e->width;x++, p += 3, dst += 3) {
+			dst[0] = p[2];
+			dst[1] = p[1];
+			dst[2] = p[0];
+		}
+		break;
+	case 8:
+		for(x=0;x<e->width;x++, p += 4, dst += 4) {
+			dst[0] = p[2];
+			dst[1] = p[1];
+			dst[2] = p[0];
+			dst[3] = p[3];
+		}
+		break;
+	case 9:
+		for(x=0;x<e->width;x++, p += 4, dst += 4) {
+			dst[0] = p[3];
+			dst[1] = p[2];
+			dst[2] = p[1];
+			dst[3] = p[0];
+		}
+		break;
+	case 10:
+		for(x=0;x<e->width;x++, p += 4, dst += 4) {
+			dst[0] = p[1];
+			dst[1] = p[2];
+			dst[2] = p[3];
+			dst[3] = p[0];
+		}
+		break;
+	default:
+		memcpy(dst, p, e->rowbytes);
+		break;
+	}
+}
+
+static int png_paeth( int a, int b, int c ) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return (pa <= pb && pa <= pc) ? a : pb <= pc ? b : c;
+}
+
+// filters cur (prev is NULL for the first row) into out[1..], returns the sum of absolute values
+static int png_filter_row( int filter, const unsigned char *cur, const unsigned char *prev, int len, int bpp, unsigned char *out ) {
+	int i, sum = 0;
+	out[0] = (unsigned char)filter;
+	out++;
+	for(i=0;i<len;i++) {
+		int a = i >= bpp ? cur[i - bpp] : 0;
+		int b = prev ? prev[i] : 0;
+		int c = prev && i >= bpp ? prev[i - bpp] : 0;
+		int v;
+		switch( filter ) {
+		case 1: v = cur[i] - a; break;
+		case 2: v = cur[i] - b; break;
+		case 3: v = cur[i] - ((a + b) >> 1); break;
+		case 4: v = cur[i] - png_paeth(a, b, c); break;
+		default: v = cur[i]; break;
+		}
+		out[i] = (unsigned char)v;
+		sum += abs((signed char)out[i]);
+	}
+	return sum;
+}
+
+static void png_enc_filter( png_enc *e, int band, unsigned char *tmp ) {
+	int y = band * e->bandRows;
+	int end = y + e->bandRows;
+	int line = e->rowbytes + 1;
+	unsigned char *prev = tmp, *cur = tmp + e->rowbytes, *best = tmp + e->rowbytes * 2;
+	if( end > e->height ) end = e->height;
+	if( y > 0 ) png_enc_row(e, y - 1, prev);
+	for(;y<end;y++) {
+		unsigned char *out = e->filtered + (int64)y * line;
+		unsigned char *p = y > 0 ? prev : NULL, *t;
+		png_enc_row(e, y, cur);
+		if( e->filter <= 4 )
+			png_filter_row(e->filter, cur, p, e->rowbytes, e->channels, out);
+		else {
+			// libpng heuristic : the filter with the smallest sum of absolute differences
+			int f, sum, bsum = png_filter_row(0, cur, p, e->rowbytes, e->channels, out);
+			for(f=1;f<=4;f++) {
+				sum = png_filter_row(f, cur, p, e->rowbytes, e->channels, best);
+				if( sum < bsum ) {
+					bsum = sum;
+					memcpy(out, best, line);
+				}
+			}
+		}
+		t = prev;
+		prev = cur;
+		cur = t;
+	}
+}
+
+static void png_enc_compress( png_enc *e, int band ) {
+	png_band *b = &e->bands[band];
+	int line = e->rowbytes + 1;
+	int64 start = (int64)band * e->bandRows * line;
+	int rows = e->height - band * e->bandRows;
+	int len, dict, bound, err;
+	z_stream z;
+	if( rows > e->bandRows ) rows = e->bandRows;
+	len = rows * line;
+	dict = start < DICT_SIZE ? (int)start : DICT_SIZE;
+	memset(&z, 0, sizeof(z));
+	if( (err = deflateInit2(&z, e->level, Z_DEFLATED, -15, 8, e->filter == 0 ? Z_DEFAULT_STRATEGY : Z_FILTERED)) != Z_OK ) {
+		b->err = err;
+		return;
+	}
+	bound = (int)deflateBound(&z, len) + 16;
+	b->out = (unsigned char*)malloc(bound);
+	if( b->out == NULL ) {
+		deflateEnd(&z);
+		b->err = Z_MEM_ERROR;
+		return;
+	}
+	if( dict )
+		deflateSetDictionary(&z, e->filtered + start - dict, dict);
+	z.next_in = e->filtered + start;
+	z.avail_in = len;
+	z.next_out = b->out;
+	z.avail_out = bound;
+	err = deflate(&z, band == e->nbands - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+	if( err < 0 || z.avail_in )
+		b->err = err < 0 ? err : Z_BUF_ERROR;
+	b->size = bound - z.avail_out;
+	b->adler = (unsigned int)adler32(1, e->filtered + start, len);
+	deflateEnd(&z);
+}
+
+static void png_enc_bands( void *ctx, int t ) {
+	png_enc *e = (png_enc*)ctx;
+	unsigned char *tmp = (unsigned char*)malloc(e->rowbytes * 3);
+	int i;
+	for(i=t;i<e->nbands;i+=e->nthreads) {
+		if( tmp == NULL ) {
+			e->bands[i].err = Z_MEM_ERROR;
+			continue;
+		}
+		png_enc_filter(e, i, tmp);
+	}
+	free(tmp);
+}
+
+static void png_enc_deflate( void *ctx, int t ) {
+	png_enc *e = (png_enc*)ctx;
+	int i;
+	for(i=t;i<e->nbands;i+=e->nthreads)
+		if( e->bands[i].err == Z_OK )
+			png_enc_compress(e, i);
+}
+
+static void png_put32( unsigned char *p, unsigned int v ) {
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+// writes a chunk whose data is already at p + 8, returns its total size
+static int png_chunk( unsigned char *p, const char *type, int len ) {
+	png_put32(p, len);
+	memcpy(p + 4, type, 4);
+	png_put32(p + 8 + len, crc32_fast(0, p + 4, len + 4));
+	return len + 12;
+}
+
+/*
+	filter : 0-4 for a fixed PNG filter, 5 to choose the best one per row
+	level : zlib compression level
+*/
+HL_PRIM vbyte *HL_NAME(png_encode)( vbyte *data, int width, int height, int stride, int format, int filter, int level, int flags, int *outLength ) {
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png_enc e;
+	unsigned char *out;
+	unsigned int adler = 1;
+	int i, zsize = 0, pos, err = Z_OK;
+	memset(&e, 0, sizeof(e));
+	e.channels = img_bpp(IMG_PNG, format);
+	if( e.channels == 0 ) hl_error("Unsupported format");
+	if( width <= 0 || height <= 0 || width > 0x7FFFFFFF / 4 - 1 ) hl_error("Invalid size");
+	e.width = width;
+	e.height = height;
+	e.format = format;
+	e.rowbytes = width * e.channels;
+	e.stride = flags & IMG_BOTTOMUP ? -stride : stride;
+	e.src = data + (flags & IMG_BOTTOMUP ? (int64)(height - 1) * stride : 0);
+	e.filter = filter < 0 || filter > 5 ? 5 : filter;
+	e.level = level < 0 || level > 9 ? Z_DEFAULT_COMPRESSION : level;
+	e.bandRows = BAND_SIZE / (e.rowbytes + 1);
+	if( e.bandRows < 1 ) e.bandRows = 1;
+	e.nbands = (height + e.bandRows - 1) / e.bandRows;
+	e.nthreads = 1;
+	e.filtered = (unsigned char*)malloc((size_t)height * (e.rowbytes + 1));
+	e.bands = (png_band*)calloc(e.nbands, sizeof(png_band));
+	if( e.filtered == NULL || e.bands == NULL ) {
+		free(e.filtered);
+		free(e.bands);
+		hl_error("Out of memory");
+	}
+	if( flags & IMG_THREADS ) e.nthreads = img_threads(e.nbands);
+	// the threads only access the buffers
+	hl_blocking(true);
+	hl_parallel_for(e.nthreads, png_enc_bands, &e);
+	hl_parallel_for(e.nthreads, png_enc_deflate, &e);
+	for(i=0;i<e.nbands;i++) {
+		png_band *b = &e.bands[i];
+		int rows = height - i * e.bandRows;
+		if( rows > e.bandRows ) rows = e.bandRows;
+		if( b->err != Z_OK && err == Z_OK ) err = b->err;
+		zsize += b->size;
+		adler = (unsigned int)adler32_combine(adler, b->adler, rows * (e.rowbytes + 1));
+	}
+	free(e.filtered);
+	hl_blocking(false);
+	if( err != Z_OK || zsize > 0x7FFFFFFF - 64 ) {
+		for(i=0;i<e.nbands;i++)
+			free(e.bands[i].out);
+		free(e.bands);
+		hl_error("PNG encoding failed (%d)", err);
+	}
+	// signature + IHDR + IDAT + IEND
+	*outLength = 8 + 25 + 12 + 2 + zsize + 4 + 12;
+	out = (unsigned char*)hl_alloc_bytes(*outLength);
+	memcpy(out, signature, 8);
+	pos = 8;
+	png_put32(out + pos + 8, width);
+	png_put32(out + pos + 12, height);
+	out[pos + 16] = 8;
+	out[pos + 17] = e.channels == 4 ? 6 : 2;
+	out[pos + 18] = 0;
+	out[pos + 19] = 0;
+	out[pos + 20] = 0;
+	pos += png_chunk(out + pos, "IHDR", 13);
+	out[pos + 8] = 0x78;
+	out[pos + 9] = e.level == 0 || e.level == 1 ? 0x01 : (e.level >= 2 && e.level <= 5) ? 0x5E : e.level >= 7 ? 0xDA : 0x9C;
+	zsize = 2;
+	for(i=0;i<e.nbands;i++) {
+		memcpy(out + pos + 8 + zsize, e.bands[i].out, e.bands[i].size);
+		zsize += e.bands[i].size;
+		free(e.bands[i].out);
+	}
+	free(e.bands);
+	png_put32(out + pos + 8 + zsize, adler);
+	pos += png_chunk(out + pos, "IDAT", zsize + 4);
+	png_chunk(out + pos, "IEND", 0);
+	return out;
+}
+
+/* ------------------------------------------------- PNG DECODING --------------------------------------------------- */
+
+typedef struct {
+	png_structp png;
+	png_infop info;
+	int format;
+	int flags;
+	int state;
+	int width;
+	int height;
+	int rows;
+	int passes;
+	unsigned char *out;
+	int stride;
+	char error[128];
+} png_reader;
+
+static void png_reader_error( png_structp png, png_const_charp msg ) {
+	png_reader *r = (png_reader*)png_get_error_ptr(png);
+	strncpy(r->error, msg, sizeof(r->error) - 1);
+	png_longjmp(png, 1);
+}
+
+static void png_reader_warning( png_structp png, png_const_charp msg ) {
+}
+
+static void png_reader_info( png_structp png, png_infop info ) {
+	png_reader *r = (png_reader*)png_get_progressive_ptr(png);
+	bool alpha = (png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA) || png_get_valid(png, info, PNG_INFO_tRNS);
+	bool alphaFirst = r->format == 9 || r->format == 10;
+	png_set_expand(png);
+#	ifdef PNG_READ_SCALE_16_TO_8_SUPPORTED
+	png_set_scale_16(png);
+#	else
+	png_set_strip_16(png);
+#	endif
+	if( !(png_get_color_type(png, info) & PNG_COLOR_MASK_COLOR) )
+		png_set_gray_to_rgb(png);
+	if( r->format == 1 || r->format == 8 || r->format == 9 )
+		png_set_bgr(png);
+	if( r->format == 0 || r->format == 1 ) {
+		if( alpha ) png_set_strip_alpha(png);
+	} else if( !alpha )
+		png_set_add_alpha(png, 0xFF, alphaFirst ? PNG_FILLER_BEFORE : PNG_FILLER_AFTER);
+	else if( alphaFirst )
+		png_set_swap_alpha(png);
+	r->passes = png_set_interlace_handling(png);
+	png_read_update_info(png, info);
+	r->width = (int)png_get_image_width(png, info);
+	r->height = (int)png_get_image_height(png, info);
+	if( png_get_rowbytes(png, info) != (png_size_t)r->width * img_bpp(IMG_PNG, r->format) )
+		png_error(png, "Unsupported image layout");
+	r->state = IMG_HEADER;
+	// let the caller provide the output buffer, the remaining input is kept by libpng
+	png_process_data_pause(png, 1);
+}
+
+static void png_reader_row( png_structp png, png_bytep row, png_uint_32 y, int pass ) {
+	png_reader *r = (png_reader*)png_get_progressive_ptr(png);
+	if( row == NULL ) return;
+	if( r->out == NULL ) png_error(png, "Missing output buffer");
+	if( pass == r->passes - 1 ) r->rows = y + 1;
+	if( r->flags & IMG_BOTTOMUP ) y = r->height - 1 - y;
+	// interlaced passes are expanded to fill the rows that are not decoded yet
+	png_progressive_combine_row(png, r->out + (int64)y * r->stride, row);
+}
+
+static void png_reader_end( png_structp png, png_infop info ) {
+	png_reader *r = (png_reader*)png_get_progressive_ptr(png);
+	r->rows = r->height;
+	r->state = IMG_DONE;
+}
+
+static bool png_reader_init( png_reader *r, int format, int flags ) {
+	memset(r, 0, sizeof(png_reader));
+	r->format = format;
+	r->flags = flags;
+	r->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, r, png_reader_error, png_reader_warning);
+	if( r->png == NULL ) return false;
+	r->info = png_create_info_struct(r->png);
+	if( r->info == NULL ) {
+		png_destroy_read_struct(&r->png, NULL, NULL);
+		return false;
+	}
+	png_set_progressive_read_fn(r->png, r, png_reader_info, png_reader_row, png_reader_end);
+	return true;
+}
+
+static int png_reader_feed( png_reader *r, unsigned char *data, int len ) {
+	if( r->state == IMG_ERROR || r->state == IMG_DONE ) return r->state;
+	r->state = IMG_NEED_DATA;
+	if( setjmp(png_jmpbuf(r->png)) ) {
+		r->state = IMG_ERROR;
+		return IMG_ERROR;
+	}
+	png_process_data(r->png, r->info, data, len);
+	return r->state;
+}
+
+static void png_reader_free( png_reader *r ) {
+	if( r->png ) png_destroy_read_struct(&r->png, &r->info, NULL);
+	r->png = NULL;
+}
+
+/* ------------------------------------------------- JPEG DECODING --------------------------------------------------- */
+
+#ifdef IMG_JPEG
+
+typedef struct {
+	struct jpeg_error_mgr pub;
+	jmp_buf jmp;
+} jpg_error;
+
+typedef struct {
+	struct jpeg_decompress_struct d;
+	struct jpeg_source_mgr src;
+	jpg_error err;
+	bool created;
+	bool eof;
+	int step;
+	int format;
+	int flags;
+	int state;
+	int width;
+	int height;
+	int rows;
+	unsigned char *out;
+	int stride;
+	// input not consumed yet by libjpeg
+	unsigned char *buf;
+	size_t bufsize;
+	size_t skip;
+	char error[JMSG_LENGTH_MAX];
+} jpg_reader;
+
+static void jpg_error_exit( j_common_ptr d ) {
+	jpg_reader *r = (jpg_reader*)d->client_data;
+	d->err->format_message(d, r->error);
+	longjmp(r->err.jmp, 1);
+}
+
+static void jpg_output_message( j_common_ptr d ) {
+}
+
+static void jpg_init_source( j_decompress_ptr d ) {
+}
+
+// suspends libjpeg until more data is fed, or ends the stream once all of it was given
+static boolean jpg_fill_input( j_decompress_ptr d ) {
+	static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+	jpg_reader *r = (jpg_reader*)d->client_data;
+	if( !r->eof ) return FALSE;
+	d->src->next_input_byte = eoi;
+	d->src->bytes_in_buffer = 2;
+	return TRUE;
+}
+
+static void jpg_skip_input( j_decompress_ptr d, long count ) {
+	jpg_reader *r = (jpg_reader*)d->client_data;
+	if( count <= 0 ) return;
+	if( (size_t)count > d->src->bytes_in_buffer ) {
+		r->skip += count - d->src->bytes_in_buffer;
+		d->src->next_input_byte += d->src->bytes_in_buffer;
+		d->src->bytes_in_buffer = 0;
+	} else {
+		d->src->next_input_byte += count;
+		d->src->bytes_in_buffer -= count;
+	}
+}
+
+static void jpg_term_source( j_decompress_ptr d ) {
+}
+
+static bool jpg_reader_init( jpg_reader *r, int format, int flags ) {
+	memset(r, 0, sizeof(jpg_reader));
+	r->format = format;
+	r->flags = flags;
+	r->d.err = jpeg_std_error(&r->err.pub);
+	r->err.pub.error_exit = jpg_error_exit;
+	r->err.pub.output_message = jpg_output_message;
+	r->d.client_data = r;
+	if( setjmp(r->err.jmp) )
+		return false;
+	jpeg_create_decompress(&r->d);
+	r->created = true;
+	r->src.init_source = jpg_init_source;
+	r->src.fill_input_buffer = jpg_fill_input;
+	r->src.skip_input_data = jpg_skip_input;
+	r->src.resync_to_restart = jpeg_resync_to_restart;
+	r->src.term_source = jpg_term_source;
+	r->d.src = &r->src;
+	return true;
+}
+
+static J_COLOR_SPACE jpg_color_space( int format ) {
+	switch( format ) {
+	case 0: return JCS_EXT_RGB;
+	case 1: return JCS_EXT_BGR;
+	case 2: return JCS_EXT_RGBX;
+	case 3: return JCS_EXT_BGRX;
+	case 4: return JCS_EXT_XBGR;
+	case 5: return JCS_EXT_XRGB;
+	case 6: return JCS_GRAYSCALE;
+	case 7: return JCS_EXT_RGBA;
+	case 8: return JCS_EXT_BGRA;
+	case 9: return JCS_EXT_ABGR;
+	default: return JCS_EXT_ARGB;
+	}
+}
+
+static int jpg_reader_feed( jpg_reader *r, unsigned char *data, int len, bool eof ) {
+	size_t pending = r->src.bytes_in_buffer;
+	if( r->state == IMG_ERROR || r->state == IMG_DONE ) return r->state;
+	if( r->skip ) {
+		size_t n = r->skip < (size_t)len ? r->skip : (size_t)len;
+		r->skip -= n;
+		data += n;
+		len -= (int)n;
+	}
+	if( pending + len > r->bufsize ) {
+		size_t size = r->bufsize ? r->bufsize : 4096;
+		unsigned char *buf;
+		while( size < pending + len ) size <<= 1;
+		buf = (unsigned char*)malloc(size);
+		if( buf == NULL ) {
+			strcpy(r->error, "Out of memory");
+			r->state = IMG_ERROR;
+			return IMG_ERROR;
+		}
+		if( pending ) memcpy(buf, r->src.next_input_byte, pending);
+		free(r->buf);
+		r->buf = buf;
+		r->bufsize = size;
+	} else if( pending && r->src.next_input_byte != r->buf )
+		memmove(r->buf, r->src.next_input_byte, pending);
+	if( len ) memcpy(r->buf + pending, data, len);
+	r->src.next_input_byte = r->buf;
+	r->src.bytes_in_buffer = pending + len;
+	if( eof ) r->eof = true;
+	r->state = IMG_NEED_DATA;
+	if( setjmp(r->err.jmp) ) {
+		r->state = IMG_ERROR;
+		return IMG_ERROR;
+	}
+	switch( r->step ) {
+	case 0:
+		if( jpeg_read_header(&r->d, TRUE) == JPEG_SUSPENDED ) return IMG_NEED_DATA;
+		r->d.out_color_space = jpg_color_space(r->format);
+		jpeg_calc_output_dimensions(&r->d);
+		r->width = r->d.output_width;
+		r->height = r->d.output_height;
+		r->step++;
+		r->state = IMG_HEADER;
+		return IMG_HEADER;
+	case 1:
+		if( r->out == NULL ) {
+			strcpy(r->error, "Missing output buffer");
+			r->state = IMG_ERROR;
+			return IMG_ERROR;
+		}
+		if( !jpeg_start_decompress(&r->d) ) return IMG_NEED_DATA;
+		r->step++;
+		// fallthrough
+	case 2:
+		while( r->d.output_scanline < r->d.output_height ) {
+			int y = r->d.output_scanline;
+			JSAMPROW row = r->out + (int64)(r->flags & IMG_BOTTOMUP ? r->height - 1 - y : y) * r->stride;
+			if( jpeg_read_scanlines(&r->d, &row, 1) == 0 ) return IMG_NEED_DATA;
+			r->rows = r->d.output_scanline;
+		}
+		r->step++;
+		// fallthrough
+	case 3:
+		if( !jpeg_finish_decompress(&r->d) ) return IMG_NEED_DATA;
+		r->step++;
+		r->state = IMG_DONE;
+		break;
+	}
+	return r->state;
+}
+
+static void jpg_reader_free( jpg_reader *r ) {
+	if( r->created ) jpeg_destroy_decompress(&r->d);
+	r->created = false;
+	free(r->buf);
+	r->buf = NULL;
+}
+
+#endif
+
+/* ------------------------------------------------- READERS --------------------------------------------------- */
+
+typedef struct {
+	int kind;
+	png_reader png;
+#	ifdef IMG_JPEG
+	jpg_reader jpg;
+#	endif
+} img_reader;
+
+static bool img_reader_init( img_reader *r, int kind, int format, int flags ) {
+	r->kind = kind;
+	if( kind == IMG_PNG ) return png_reader_init(&r->png, format, flags);
+#	ifdef IMG_JPEG
+	if( kind == IMG_JPG ) return jpg_reader_init(&r->jpg, format, flags);
+#	endif
+	return false;
+}
+
+static int img_reader_feed( img_reader *r, unsigned char *data, int len, bool eof ) {
+#	ifdef IMG_JPEG
+	if( r->kind == IMG_JPG ) return jpg_reader_feed(&r->jpg, data, len, eof);
+#	endif
+	return png_reader_feed(&r->png, data, len);
+}
+
+static void img_reader_output( img_reader *r, unsigned char *out, int stride ) {
+#	ifdef IMG_JPEG
+	if( r->kind == IMG_JPG ) {
+		r->jpg.out = out;
+		r->jpg.stride = stride;
+		return;
+	}
+#	endif
+	r->png.out = out;
+	r->png.stride = stride;
+}
+
+static void img_reader_info( img_reader *r, int *width, int *height, int *rows ) {
+#	ifdef IMG_JPEG
+	if( r->kind == IMG_JPG ) {
+		*width = r->jpg.width;
+		*height = r->jpg.height;
+		*rows = r->jpg.rows;
+		return;
+	}
+#	endif
+	*width = r->png.width;
+	*height = r->png.height;
+	*rows = r->png.rows;
+}
+
+static const char *img_reader_error( img_reader *r ) {
+#	ifdef IMG_JPEG
+	if( r->kind == IMG_JPG ) return r->jpg.error;
+#	endif
+	return r->png.error;
+}
+
+static void img_reader_free( img_reader *r ) {
+#	ifdef IMG_JPEG
+	if( r->kind == IMG_JPG ) {
+		jpg_reader_free(&r->jpg);
+		return;
+	}
+#	endif
+	png_reader_free(&r->png);
+}
+
+static int img_detect( unsigned char *data, int len ) {
+	if( len >= 8 && png_sig_cmp(data, 0, 8) == 0 ) return IMG_PNG;
+	if( len >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF ) return IMG_JPG;
+	return -1;
+}
+
+/* ------------------------------------------------- STREAMS --------------------------------------------------- */
+
+typedef struct _fmt_img_stream fmt_img_stream;
+struct _fmt_img_stream {
+	void (*finalize)( fmt_img_stream * );
+	img_reader r;
+	bool init;
+};
+
+static void img_stream_finalize( fmt_img_stream *s ) {
+	if( s->init ) img_reader_free(&s->r);
+	s->init = false;
+}
+
+/*
+	Incremental decoding : feed the data as it arrives. img_stream_feed returns 1 once the
+	header is read, then img_stream_info gives the size and the output buffer must be
+	passed to the next calls. It returns 2 when the image is complete and 0 when more
+	data is needed.
+*/
+HL_PRIM fmt_img_stream *HL_NAME(img_stream_init)( int kind, int format, int flags ) {
+	fmt_img_stream *s;
+	if( kind != IMG_PNG && kind != IMG_JPG ) hl_error("Unsupported image kind");
+#	ifndef IMG_JPEG
+	if( kind == IMG_JPG ) hl_error("JPEG streaming is not supported on this platform");
+#	endif
+	if( img_bpp(kind, format) == 0 ) hl_error("Unsupported format");
+	s = (fmt_img_stream*)hl_gc_alloc_finalizer(sizeof(fmt_img_stream));
+	memset(s, 0, sizeof(fmt_img_stream));
+	s->finalize = img_stream_finalize;
+	if( !img_reader_init(&s->r, kind, format, flags) ) {
+		img_reader_free(&s->r);
+		hl_error("Failed to initialize decoder");
+	}
+	s->init = true;
+	return s;
+}
+
+HL_PRIM int HL_NAME(img_stream_feed)( fmt_img_stream *s, vbyte *src, int srcpos, int srclen, vbyte *out, int stride, bool eof ) {
+	int state;
+	if( !s->init ) hl_error("Stream is closed");
+	if( srcpos < 0 || srclen < 0 ) hl_error("Out of range");
+	img_reader_output(&s->r, out, stride);
+	hl_blocking(true);
+	state = img_reader_feed(&s->r, src ? src + srcpos : NULL, srclen, eof);
+	hl_blocking(false);
+	if( state == IMG_ERROR )
+		hl_error("%s Error : %s", s->r.kind == IMG_PNG ? USTR("PNG") : USTR("JPEG"), hl_to_utf16(img_reader_error(&s->r)));
+	if( state == IMG_NEED_DATA && eof ) hl_error("Unexpected end of image data");
+	return state;
+}
+
+HL_PRIM void HL_NAME(img_stream_info)( fmt_img_stream *s, int *width, int *height, int *rows ) {
+	if( !s->init ) hl_error("Stream is closed");
+	img_reader_info(&s->r, width, height, rows);
+}
+
+HL_PRIM void HL_NAME(img_stream_end)( fmt_img_stream *s ) {
+	img_stream_finalize(s);
+}
+
+/* ------------------------------------------------- BATCH --------------------------------------------------- */
+
+/*
+	Returns the kind (0 PNG, 1 JPEG) and size of an image from its header, or false if it
+	is not recognized.
+*/
+HL_PRIM bool HL_NAME(img_info)( vbyte *data, int pos, int len, int *kind, int *width, int *height ) {
+	img_reader r;
+	int k, state, rows;
+	data += pos;
+	k = img_detect(data, len);
+	if( k < 0 ) return false;
+	if( k == IMG_PNG ) {
+		// IHDR is always the first chunk
+		if( len < 24 || memcmp(data + 12, "IHDR", 4) != 0 ) return false;
+		*kind = k;
+		*width = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+		*height = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+		return true;
+	}
+#	ifdef IMG_JPEG
+	if( !img_reader_init(&r, k, 0, 0) ) {
+		img_reader_free(&r);
+		return false;
+	}
+	state = img_reader_feed(&r, data, len, true);
+	img_reader_info(&r, width, height, &rows);
+	img_reader_free(&r);
+	*kind = k;
+	return state == IMG_HEADER;
+#	else
+	return false;
+#	endif
+}
+
+typedef struct {
+	unsigned char *data;
+	int *offsets;
+	unsigned char *out;
+	int *outOffsets;
+	int *status;
+	int count;
+	int format;
+	int flags;
+	int next;
+	hl_mutex *lock;
+} img_batch;
+
+static bool img_decode_one( img_batch *b, int i ) {
+	unsigned char *data = b->data + b->offsets[i];
+	int len = b->offsets[i + 1] - b->offsets[i];
+	int kind = img_detect(data, len);
+	int width, height, rows, state, bpp;
+	img_reader r;
+	bool ok = false;
+	if( kind < 0 || len < 0 ) return false;
+	bpp = img_bpp(kind, b->format);
+	if( !img_reader_init(&r, kind, b->format, b->flags) ) {
+		img_reader_free(&r);
+		return false;
+	}
+	state = img_reader_feed(&r, data, len, true);
+	img_reader_info(&r, &width, &height, &rows);
+	if( state == IMG_HEADER && (int64)width * height * bpp <= b->outOffsets[i + 1] - b->outOffsets[i] ) {
+		img_reader_output(&r, b->out + b->outOffsets[i], width * bpp);
+		ok = img_reader_feed(&r, NULL, 0, true) == IMG_DONE;
+	}
+	img_reader_free(&r);
+	return ok;
+}
+
+static void img_batch_run( void *ctx, int t ) {
+	img_batch *b = (img_batch*)ctx;
+	while( true ) {
+		int i;
+#		ifdef HL_THREADS
+		if( b->lock ) hl_mutex_acquire(b->lock);
+#		endif
+		i = b->next++;
+#		ifdef HL_THREADS
+		if( b->lock ) hl_mutex_release(b->lock);
+#		endif
+		if( i >= b->count ) break;
+		b->status[i] = img_decode_one(b, i) ? 1 : 0;
+	}
+}
+
+/*
+	Decodes count PNG or JPEG images. Image i is read from data[offsets[i]..offsets[i+1]]
+	and written with tight rows at out[outOffsets[i]..outOffsets[i+1]], status[i] is set
+	to 1 on success. Returns the number of decoded images.
+*/
+HL_PRIM int HL_NAME(img_decode_many)( vbyte *data, int *offsets, vbyte *out, int *outOffsets, int *status, int count, int format, int flags ) {
+	img_batch b;
+	int i, nthreads = 1, decoded = 0;
+	if( img_bpp(IMG_JPG, format) == 0 ) hl_error("Unsupported format");
+	if( count <= 0 ) return 0;
+	memset(&b, 0, sizeof(b));
+	b.data = data;
+	b.offsets = offsets;
+	b.out = out;
+	b.outOffsets = outOffsets;
+	b.status = status;
+	b.count = count;
+	b.format = format;
+	b.flags = flags & IMG_BOTTOMUP;
+	if( flags & IMG_THREADS ) nthreads = img_threads(count);
+#	ifdef HL_THREADS
+	if( nthreads > 1 ) b.lock = hl_mutex_alloc(false);
+#	endif
+	hl_blocking(true);
+	hl_parallel_for(nthreads, img_batch_run, &b);
+	hl_blocking(false);
+#	ifdef HL_THREADS
+	if( b.lock ) hl_mutex_free(b.lock);
+#	endif
+	for(i=0;i<count;i++)
+		decoded += status[i];
+	return decoded;
+}
+
+#define _IMG_STREAM _ABSTRACT(fmt_img_stream)
+
+DEFINE_PRIM(_BYTES, png_encode, _BYTES _I32 _I32 _I32 _I32 _I32 _I32 _I32 _REF(_I32));
+DEFINE_PRIM(_IMG_STREAM, img_stream_init, _I32 _I32 _I32);
+DEFINE_PRIM(_I32, img_stream_feed, _IMG_STREAM _BYTES _I32 _I32 _BYTES _I32 _BOOL);
+DEFINE_PRIM(_VOID, img_stream_info, _IMG_STREAM _REF(_I32) _REF(_I32) _REF(_I32));
+DEFINE_PRIM(_VOID, img_stream_end, _IMG_STREAM);
+DEFINE_PRIM(_BOOL, img_info, _BYTES _I32 _I32 _REF(_I32) _REF(_I32) _REF(_I32));
+DEFINE_PRIM(_I32, img_decode_many, _BYTES _BYTES _BYTES _BYTES _BYTES _I32 _I32 _I32);
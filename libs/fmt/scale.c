@@ -0,0 +1,357 @@
+#define HL_NAME(n) fmt_##n
+#include <hl.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define SCALE_SSE2
+#endif
+
+/*
+	Separable scaling of 4 bytes pixels. The taps and weights of each output column and
+	row are computed once, then each input row is resampled horizontally into 16 bits
+	fixed point (TMP_BITS fractional bits) and the output rows are combined vertically.
+
+	flags :
+		1 : bilinear, same sampling as nearest (no filtering when downscaling)
+		2 : box filter (area average when downscaling)
+		4 : lanczos3 filter
+		8 : split the output rows between several threads
+	nearest is used when no filter is set
+*/
+
+#define SCALE_BILINEAR	1
+#define SCALE_BOX		2
+#define SCALE_LANCZOS	4
+#define SCALE_THREADS	8
+
+#define WEIGHT_BITS		14
+#define TMP_BITS		7
+#define MAX_THREADS		8
+#define MIN_BAND_ROWS	16
+
+typedef struct {
+	int *start;
+	int *count;
+	short *weights;
+	int ksize;
+} scale_coefs;
+
+typedef struct {
+	unsigned char *out;
+	int outStride;
+	int outWidth;
+	unsigned char *in;
+	int inStride;
+	scale_coefs *xc;
+	scale_coefs *yc;
+	bool nearest;
+	short *tmp;
+	unsigned char *ready;
+	int tmpStride;
+	int rows[MAX_THREADS + 1];
+	int inFirst[MAX_THREADS];
+	int tmpRow[MAX_THREADS];
+} scale_ctx;
+
+static double filter_box( double x ) {
+	return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+}
+
+static double filter_lanczos( double x ) {
+	double px;
+	if( x == 0 ) return 1.0;
+	if( x <= -3.0 || x >= 3.0 ) return 0.0;
+	px = x * 3.14159265358979323846;
+	return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+}
+
+static bool coefs_alloc( scale_coefs *c, int n, int ksize ) {
+	c->ksize = ksize;
+	c->start = (int*)malloc(sizeof(int) * n * 2);
+	c->weights = (short*)calloc(n * ksize, sizeof(short));
+	if( c->start == NULL || c->weights == NULL ) {
+		free(c->start);
+		free(c->weights);
+		c->start = NULL;
+		c->weights = NULL;
+		return false;
+	}
+	c->count = c->start + n;
+	return true;
+}
+
+static void coefs_free( scale_coefs *c ) {
+	free(c->start);
+	free(c->weights);
+	c->start = NULL;
+	c->weights = NULL;
+}
+
+// stores the normalized weights in fixed point, their sum is exactly 1 << WEIGHT_BITS
+static void coefs_set( scale_coefs *c, int i, int start, int count, double *w ) {
+	short *out = c->weights + i * c->ksize;
+	double sum = 0;
+	int k, total = 0, best = 0;
+	while( count > 1 && w[0] == 0 ) {
+		w++;
+		start++;
+		count--;
+	}
+	while( count > 1 && w[count - 1] == 0 )
+		count--;
+	for(k=0;k<count;k++)
+		sum += w[k];
+	if( sum == 0 ) {
+		count = 1;
+		w[0] = sum = 1;
+	}
+	for(k=0;k<count;k++) {
+		int v = (int)floor(w[k] / sum * (1 << WEIGHT_BITS) + 0.5);
+		out[k] = (short)v;
+		total += v;
+		if( w[k] > w[best] ) best = k;
+	}
+	out[best] = (short)(out[best] + (1 << WEIGHT_BITS) - total);
+	c->start[i] = start;
+	c->count[i] = count;
+}
+
+// nearest and bilinear : same coordinates as the previous per pixel implementation
+static bool coefs_linear( scale_coefs *c, int in, int out, bool bilinear ) {
+	float scale = out <= 1 ? 0.0f : (float)((in - 1.001f) / (out - 1));
+	int i;
+	if( !coefs_alloc(c, out, 2) ) return false;
+	for(i=0;i<out;i++) {
+		float f = i * scale;
+		int ix = (int)f;
+		double w[2];
+		w[0] = 1.0f - (f - ix);
+		w[1] = f - ix;
+		if( !bilinear || ix + 1 >= in ) {
+			c->start[i] = ix;
+			c->count[i] = 1;
+			c->weights[i * 2] = 1 << WEIGHT_BITS;
+		} else
+			coefs_set(c, i, ix, 2, w);
+	}
+	return true;
+}
+
+static bool coefs_filter( scale_coefs *c, int in, int out, double (*filter)( double ), double support ) {
+	double scale = (double)in / out;
+	double fscale = scale < 1.0 ? 1.0 : scale;
+	double *w;
+	int i;
+	support *= fscale;
+	if( !coefs_alloc(c, out, (int)ceil(support) * 2 + 2) ) return false;
+	w = (double*)malloc(sizeof(double) * c->ksize);
+	if( w == NULL ) {
+		coefs_free(c);
+		return false;
+	}
+	for(i=0;i<out;i++) {
+		double center = (i + 0.5) * scale;
+		int xmin = (int)floor(center - support);
+		int xmax = (int)ceil(center + support);
+		int x;
+		if( xmin < 0 ) xmin = 0;
+		if( xmax > in ) xmax = in;
+		if( xmax - xmin > c->ksize ) xmax = xmin + c->ksize;
+		for(x=xmin;x<xmax;x++)
+			w[x - xmin] = filter((x + 0.5 - center) / fscale);
+		if( xmax <= xmin ) {
+			// can only happen on rounding at the image borders
+			xmin = xmin >= in ? in - 1 : xmin;
+			xmax = xmin + 1;
+			w[0] = 1;
+		}
+		coefs_set(c, i, xmin, xmax - xmin, w);
+	}
+	free(w);
+	return true;
+}
+
+static void scale_row_h( const unsigned char *src, short *dst, scale_coefs *c, int width ) {
+	int x;
+#	ifdef SCALE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (WEIGHT_BITS - TMP_BITS - 1));
+#	endif
+	for(x=0;x<width;x++) {
+		const unsigned char *p = src + (c->start[x] << 2);
+		const short *w = c->weights + x * c->ksize;
+		int n = c->count[x], k = 0;
+#		ifdef SCALE_SSE2
+		__m128i acc = zero;
+		for(;k+1<n;k+=2) {
+			// a0 a1 r0 r1 g0 g1 b0 b1 * w0 w1 w0 w1 ...
+			__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + (k << 2))), zero);
+			v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, _mm_set1_epi32((int)((unsigned short)w[k] | ((unsigned int)(unsigned short)w[k+1] << 16)))));
+		}
+		if( k < n ) {
+			__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)(p + (k << 2))), zero), zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, _mm_set1_epi32((unsigned short)w[k])));
+		}
+		acc = _mm_srai_epi32(_mm_add_epi32(acc, round), WEIGHT_BITS - TMP_BITS);
+		acc = _mm_max_epi16(_mm_packs_epi32(acc, acc), zero);
+		_mm_storel_epi64((__m128i*)(dst + (x << 2)), acc);
+#		else
+		int acc[4] = { 0, 0, 0, 0 }, i;
+		for(;k<n;k++) {
+			const unsigned char *q = p + (k << 2);
+			for(i=0;i<4;i++)
+				acc[i] += q[i] * w[k];
+		}
+		for(i=0;i<4;i++) {
+			int v = (acc[i] + (1 << (WEIGHT_BITS - TMP_BITS - 1))) >> (WEIGHT_BITS - TMP_BITS);
+			dst[(x << 2) + i] = (short)(v < 0 ? 0 : v > 32767 ? 32767 : v);
+		}
+#		endif
+	}
+}
+
+// the tmp rows are padded to an even number of pixels so the SSE2 loop can always read 2 pixels
+static void scale_row_v( const short *src, int stride, const short *w, int n, unsigned char *dst, int width ) {
+	int x, lanes = width << 2;
+#	ifdef SCALE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi32(1 << (WEIGHT_BITS + TMP_BITS - 1));
+	for(x=0;x<lanes;x+=8) {
+		__m128i acc0 = zero, acc1 = zero, r;
+		const short *p = src + x;
+		int k = 0;
+		for(;k+1<n;k+=2) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(p + k * stride));
+			__m128i b = _mm_loadu_si128((const __m128i*)(p + (k + 1) * stride));
+			__m128i wk = _mm_set1_epi32((int)((unsigned short)w[k] | ((unsigned int)(unsigned short)w[k+1] << 16)));
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wk));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wk));
+		}
+		if( k < n ) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(p + k * stride));
+			__m128i wk = _mm_set1_epi32((unsigned short)w[k]);
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), wk));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), wk));
+		}
+		acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, round), WEIGHT_BITS + TMP_BITS);
+		acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, round), WEIGHT_BITS + TMP_BITS);
+		r = _mm_packs_epi32(acc0, acc1);
+		r = _mm_packus_epi16(r, r);
+		if( x + 8 <= lanes )
+			_mm_storel_epi64((__m128i*)(dst + x), r);
+		else
+			*(int*)(dst + x) = _mm_cvtsi128_si32(r);
+	}
+#	else
+	for(x=0;x<lanes;x++) {
+		int acc = 0, k, v;
+		for(k=0;k<n;k++)
+			acc += src[k * stride + x] * w[k];
+		v = (acc + (1 << (WEIGHT_BITS + TMP_BITS - 1))) >> (WEIGHT_BITS + TMP_BITS);
+		dst[x] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+	}
+#	endif
+}
+
+static void scale_band( scale_ctx *c, int band ) {
+	int y, r;
+	if( c->nearest ) {
+		for(y=c->rows[band];y<c->rows[band+1];y++) {
+			const int *src = (const int*)(c->in + c->yc->start[y] * c->inStride);
+			int *dst = (int*)(c->out + y * c->outStride);
+			int x;
+			for(x=0;x<c->outWidth;x++)
+				dst[x] = src[c->xc->start[x]];
+		}
+		return;
+	}
+	{
+		int first = c->inFirst[band];
+		short *tmp = c->tmp + c->tmpRow[band] * c->tmpStride;
+		unsigned char *ready = c->ready + c->tmpRow[band];
+		for(y=c->rows[band];y<c->rows[band+1];y++) {
+			int start = c->yc->start[y] - first;
+			int n = c->yc->count[y];
+			// only resample the input rows that are used (sparse when downscaling with bilinear)
+			for(r=start;r<start+n;r++)
+				if( !ready[r] ) {
+					scale_row_h(c->in + (first + r) * c->inStride, tmp + r * c->tmpStride, c->xc, c->outWidth);
+					ready[r] = 1;
+				}
+			scale_row_v(tmp + start * c->tmpStride, c->tmpStride, c->yc->weights + y * c->yc->ksize, n, c->out + y * c->outStride, c->outWidth);
+		}
+	}
+}
+
+static int scale_threads( int rows ) {
+	int n = rows / MIN_BAND_ROWS;
+	if( n > hl_cpu_count() ) n = hl_cpu_count();
+	if( n > MAX_THREADS ) n = MAX_THREADS;
+	return n < 1 ? 1 : n;
+}
+
+HL_PRIM void HL_NAME(img_scale)( vbyte *out, int outPos, int outStride, int outWidth, int outHeight, vbyte *in, int inPos, int inStride, int inWidth, int inHeight, int flags ) {
+	scale_ctx c;
+	scale_coefs xc, yc;
+	int nbands = 1, b, tmpRows = 0;
+	bool ok;
+	if( outWidth <= 0 || outHeight <= 0 || inWidth <= 0 || inHeight <= 0 ) return;
+	memset(&c, 0, sizeof(c));
+	c.out = out + outPos;
+	c.outStride = outStride;
+	c.outWidth = outWidth;
+	c.in = in + inPos;
+	c.inStride = inStride;
+	c.xc = &xc;
+	c.yc = &yc;
+	c.nearest = (flags & (SCALE_BILINEAR | SCALE_BOX | SCALE_LANCZOS)) == 0;
+	if( flags & SCALE_LANCZOS ) {
+		ok = coefs_filter(&xc, inWidth, outWidth, filter_lanczos, 3.0);
+		ok = ok && coefs_filter(&yc, inHeight, outHeight, filter_lanczos, 3.0);
+	} else if( flags & SCALE_BOX ) {
+		ok = coefs_filter(&xc, inWidth, outWidth, filter_box, 0.5);
+		ok = ok && coefs_filter(&yc, inHeight, outHeight, filter_box, 0.5);
+	} else {
+		ok = coefs_linear(&xc, inWidth, outWidth, !c.nearest);
+		ok = ok && coefs_linear(&yc, inHeight, outHeight, !c.nearest);
+	}
+	if( !ok ) {
+		if( xc.start ) coefs_free(&xc);
+		hl_error("Out of memory");
+	}
+	if( flags & SCALE_THREADS ) nbands = scale_threads(outHeight);
+	for(b=0;b<=nbands;b++)
+		c.rows[b] = (int)((int64)outHeight * b / nbands);
+	if( !c.nearest ) {
+		for(b=0;b<nbands;b++) {
+			int y, last = 0;
+			for(y=c.rows[b];y<c.rows[b+1];y++)
+				if( yc.start[y] + yc.count[y] > last ) last = yc.start[y] + yc.count[y];
+			c.inFirst[b] = yc.start[c.rows[b]];
+			c.tmpRow[b] = tmpRows;
+			tmpRows += last - c.inFirst[b];
+		}
+		c.tmpStride = ((outWidth + 1) & ~1) << 2;
+		c.tmp = (short*)malloc((size_t)tmpRows * c.tmpStride * sizeof(short));
+		c.ready = (unsigned char*)calloc(tmpRows, 1);
+		if( c.tmp == NULL || c.ready == NULL ) {
+			free(c.tmp);
+			free(c.ready);
+			coefs_free(&xc);
+			coefs_free(&yc);
+			hl_error("Out of memory");
+		}
+	}
+	// the bands only access the pixels : they run outside of the GC
+	hl_blocking(true);
+	hl_parallel_for(nbands, (void(*)(void*,int))scale_band, &c);
+	hl_blocking(false);
+	free(c.tmp);
+	free(c.ready);
+	coefs_free(&xc);
+	coefs_free(&yc);
+}
+
+DEFINE_PRIM(_VOID, img_scale, _BYTES _I32 _I32 _I32 _I32 _BYTES _I32 _I32 _I32 _I32 _I32);
@@ -21,6 +21,7 @@
  */
 #include <hl.h>
 #include "sha1.h"
+#include "cpu.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -81,6 +82,56 @@ static void sha1_transform( unsigned int state[5], unsigned char buffer[64] ) {
 	state[4] += e;
 }
 
+#ifdef FMT_X86
+// SHA extensions : each sha1rnds4 does four rounds, sha1nexte computes E from the previous A
+#define SHA1_RNDS4(abcd,e,f) \
+	switch( f ) { \
+	case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break; \
+	case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break; \
+	case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break; \
+	default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break; \
+	}
+
+FMT_TARGET("sha,sse4.1")
+static void sha1_blocks_ni( unsigned int state[5], const unsigned char *data, unsigned int n ) {
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+	__m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+	__m128i w[4];
+	while( n-- ) {
+		__m128i abcd_save = abcd, e_save = e0, e, prev = abcd;
+		int i;
+		for(i=0;i<20;i++) {
+			if( i < 4 )
+				w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), mask);
+			else
+				w[i&3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w[i&3], w[(i+1)&3]), w[(i+2)&3]), w[(i+3)&3]);
+			e = i == 0 ? _mm_add_epi32(e0, w[0]) : _mm_sha1nexte_epu32(prev, w[i&3]);
+			prev = abcd;
+			SHA1_RNDS4(abcd, e, i / 5);
+		}
+		e0 = _mm_sha1nexte_epu32(prev, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+		data += 64;
+	}
+	_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = (unsigned int)_mm_extract_epi32(e0, 3);
+}
+#endif
+
+static void sha1_blocks( unsigned int state[5], const unsigned char *data, unsigned int n ) {
+#	ifdef FMT_X86
+	if( fmt_cpu_caps() & CPU_SHA ) {
+		sha1_blocks_ni(state, data, n);
+		return;
+	}
+#	endif
+	while( n-- ) {
+		sha1_transform(state, (unsigned char*)data);
+		data += 64;
+	}
+}
+
 void sha1_init( SHA1_CTX *context ) {
 	/* SHA1 initialization constants */
 	context->state[0] = 0x67452301;
@@ -99,8 +150,10 @@ void sha1_update( SHA1_CTX *context, const unsigned char *data, unsigned int len
 	if ((j + len) > 63) {
 		memcpy(&context->buffer[j], data, (i = 64-j));
 		sha1_transform(context->state, context->buffer);
-		for ( ; i + 63 < len; i += 64 )
-			sha1_transform(context->state, (unsigned char *)&data[i]);
+		if( len - i >= 64 ) {
+			sha1_blocks(context->state, data + i, (len - i) >> 6);
+			i += (len - i) & ~63;
+		}
 		j = 0;
 	} else
 		i = 0;
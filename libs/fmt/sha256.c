@@ -0,0 +1,151 @@
+#include <hl.h>
+#include "sha256.h"
+#include "cpu.h"
+#include <string.h>
+
+static const unsigned int K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ror(v,n) (((v) >> (n)) | ((v) << (32 - (n))))
+
+static void sha256_blocks_c( unsigned int state[8], const unsigned char *data, unsigned int n ) {
+	unsigned int w[64];
+	while( n-- ) {
+		unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+		unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+		int i;
+		for(i=0;i<16;i++)
+			w[i] = ((unsigned int)data[i*4] << 24) | ((unsigned int)data[i*4+1] << 16) | ((unsigned int)data[i*4+2] << 8) | data[i*4+3];
+		for(i=16;i<64;i++) {
+			unsigned int s0 = ror(w[i-15],7) ^ ror(w[i-15],18) ^ (w[i-15] >> 3);
+			unsigned int s1 = ror(w[i-2],17) ^ ror(w[i-2],19) ^ (w[i-2] >> 10);
+			w[i] = w[i-16] + s0 + w[i-7] + s1;
+		}
+		for(i=0;i<64;i++) {
+			unsigned int t1 = h + (ror(e,6) ^ ror(e,11) ^ ror(e,25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+			unsigned int t2 = (ror(a,2) ^ ror(a,13) ^ ror(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+		data += 64;
+	}
+}
+
+#ifdef FMT_X86
+// SHA extensions : the state is kept as ABEF/CDGH, each sha256rnds2 does two rounds
+FMT_TARGET("sha,sse4.1")
+static void sha256_blocks_ni( unsigned int state[8], const unsigned char *data, unsigned int n ) {
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i s0, s1, tmp, w[4];
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+	s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+	s0 = _mm_alignr_epi8(tmp, s1, 8);
+	s1 = _mm_blend_epi16(s1, tmp, 0xF0);
+	while( n-- ) {
+		__m128i save0 = s0, save1 = s1;
+		int i;
+		for(i=0;i<16;i++) {
+			__m128i m;
+			if( i < 4 )
+				w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), mask);
+			else {
+				m = _mm_add_epi32(_mm_sha256msg1_epu32(w[i&3], w[(i+1)&3]), _mm_alignr_epi8(w[(i+3)&3], w[(i+2)&3], 4));
+				w[i&3] = _mm_sha256msg2_epu32(m, w[(i+3)&3]);
+			}
+			m = _mm_add_epi32(w[i&3], _mm_loadu_si128((const __m128i*)&K[i * 4]));
+			s1 = _mm_sha256rnds2_epu32(s1, s0, m);
+			s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0E));
+		}
+		s0 = _mm_add_epi32(s0, save0);
+		s1 = _mm_add_epi32(s1, save1);
+		data += 64;
+	}
+	tmp = _mm_shuffle_epi32(s0, 0x1B);
+	s1 = _mm_shuffle_epi32(s1, 0xB1);
+	s0 = _mm_blend_epi16(tmp, s1, 0xF0);
+	s1 = _mm_alignr_epi8(s1, tmp, 8);
+	_mm_storeu_si128((__m128i*)&state[0], s0);
+	_mm_storeu_si128((__m128i*)&state[4], s1);
+}
+#endif
+
+static void sha256_blocks( unsigned int state[8], const unsigned char *data, unsigned int n ) {
+#	ifdef FMT_X86
+	if( fmt_cpu_caps() & CPU_SHA ) {
+		sha256_blocks_ni(state, data, n);
+		return;
+	}
+#	endif
+	sha256_blocks_c(state, data, n);
+}
+
+void sha256_init( SHA256_CTX *c ) {
+	c->state[0] = 0x6a09e667;
+	c->state[1] = 0xbb67ae85;
+	c->state[2] = 0x3c6ef372;
+	c->state[3] = 0xa54ff53a;
+	c->state[4] = 0x510e527f;
+	c->state[5] = 0x9b05688c;
+	c->state[6] = 0x1f83d9ab;
+	c->state[7] = 0x5be0cd19;
+	c->count[0] = c->count[1] = 0;
+}
+
+void sha256_update( SHA256_CTX *c, const unsigned char *data, unsigned int len ) {
+	unsigned int j = c->count[0] & 63;
+	if( (c->count[0] += len) < len ) c->count[1]++;
+	if( j ) {
+		unsigned int k = 64 - j;
+		if( len < k ) {
+			memcpy(c->buffer + j, data, len);
+			return;
+		}
+		memcpy(c->buffer + j, data, k);
+		sha256_blocks(c->state, c->buffer, 1);
+		data += k;
+		len -= k;
+	}
+	if( len >= 64 ) {
+		sha256_blocks(c->state, data, len >> 6);
+		data += len & ~63;
+		len &= 63;
+	}
+	memcpy(c->buffer, data, len);
+}
+
+void sha256_final( SHA256_CTX *c, unsigned char digest[SHA256_SIZE] ) {
+	unsigned int hi = (c->count[1] << 3) | (c->count[0] >> 29);
+	unsigned int lo = c->count[0] << 3;
+	unsigned int j = c->count[0] & 63;
+	int i;
+	c->buffer[j++] = 0x80;
+	if( j > 56 ) {
+		memset(c->buffer + j, 0, 64 - j);
+		sha256_blocks(c->state, c->buffer, 1);
+		j = 0;
+	}
+	memset(c->buffer + j, 0, 56 - j);
+	for(i=0;i<4;i++) {
+		c->buffer[56 + i] = (unsigned char)(hi >> (24 - i * 8));
+		c->buffer[60 + i] = (unsigned char)(lo >> (24 - i * 8));
+	}
+	sha256_blocks(c->state, c->buffer, 1);
+	for(i=0;i<SHA256_SIZE;i++)
+		digest[i] = (unsigned char)(c->state[i >> 2] >> ((3 - (i & 3)) * 8));
+}
@@ -0,0 +1,16 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#define SHA256_SIZE 32
+
+typedef struct {
+	unsigned int state[8];
+	unsigned int count[2];
+	unsigned char buffer[64];
+} SHA256_CTX;
+
+void sha256_init( SHA256_CTX *c );
+void sha256_update( SHA256_CTX *c, const unsigned char *data, unsigned int len );
+void sha256_final( SHA256_CTX *c, unsigned char digest[SHA256_SIZE] );
+
+#endif
@@ -0,0 +1,345 @@
+#define HL_NAME(n) fmt_##n
+#include <hl.h>
+#include <zlib.h>
+#include <string.h>
+#include "checksum.h"
+
+#ifdef HL_LIBDEFLATE
+#	include <libdeflate.h>
+#endif
+
+/*
+	One-shot compression of a whole buffer.
+
+	flags :
+		0 / 1 / 2 : zlib, gzip or raw deflate stream
+		4 : compress independent blocks (each primed with the previous 32KB of input as
+			dictionary), possibly on several threads, then concatenate them into a single
+			stream. Output is the same whatever the number of threads.
+		8 : use libdeflate when fmt is built with it (ignored otherwise and for blocks)
+
+	As with inflate_buffer/deflate_buffer, srclen and dstlen are the buffers sizes.
+	zip_compress and zip_uncompress return the number of bytes written or -1 if dst is too small.
+*/
+
+#define ZIP_FORMAT		3
+#define ZIP_GZIP		1
+#define ZIP_RAW			2
+#define ZIP_BLOCKS		4
+#define ZIP_FAST		8
+
+#define BLOCK_SIZE		(128 << 10)
+#define DICT_SIZE		(32 << 10)
+#define MAX_THREADS		8
+
+static int zip_wbits( int flags ) {
+	switch( flags & ZIP_FORMAT ) {
+	case ZIP_GZIP: return 31;
+	case ZIP_RAW: return -15;
+	default: return 15;
+	}
+}
+
+static void zip_error( z_stream *z, int err ) {
+	if( z && z->msg )
+		hl_error("ZLib Error : %s (%d)", hl_to_utf16(z->msg), err);
+	hl_error("ZLib Error : %d", err);
+}
+
+static void zip_check_range( int srcpos, int srclen, int dstpos, int dstlen ) {
+	if( srcpos < 0 || dstpos < 0 || srclen < srcpos || dstlen < dstpos )
+		hl_error("Out of range");
+}
+
+/* ------------------------------------------------- BLOCKS --------------------------------------------------- */
+
+typedef struct {
+	unsigned char *out;
+	int size;
+	unsigned int check;
+	int err;
+} zip_block;
+
+typedef struct {
+	unsigned char *src;
+	int len;
+	int level;
+	int gzip;
+	int nblocks;
+	int nthreads;
+	zip_block *blocks;
+} zip_ctx;
+
+static void zip_compress_block( zip_ctx *c, int i ) {
+	zip_block *b = &c->blocks[i];
+	unsigned char *src = c->src + i * BLOCK_SIZE;
+	int len = (i == c->nblocks - 1) ? c->len - i * BLOCK_SIZE : BLOCK_SIZE;
+	int dict = i == 0 ? 0 : DICT_SIZE;
+	z_stream z;
+	int err, bound;
+	memset(&z, 0, sizeof(z));
+	if( (err = deflateInit2(&z, c->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) != Z_OK ) {
+		b->err = err;
+		return;
+	}
+	// sync flush marker
+	bound = (int)deflateBound(&z, len) + 16;
+	b->out = (unsigned char*)malloc(bound);
+	if( b->out == NULL ) {
+		deflateEnd(&z);
+		b->err = Z_MEM_ERROR;
+		return;
+	}
+	if( dict )
+		deflateSetDictionary(&z, src - dict, dict);
+	z.next_in = src;
+	z.avail_in = len;
+	z.next_out = b->out;
+	z.avail_out = bound;
+	// a sync flush ends the block on a byte boundary without marking it as the last one
+	err = deflate(&z, i == c->nblocks - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+	if( err < 0 || z.avail_in )
+		b->err = err < 0 ? err : Z_BUF_ERROR;
+	b->size = bound - z.avail_out;
+	b->check = c->gzip ? crc32_fast(0, src, len) : (unsigned int)adler32(1, src, len);
+	deflateEnd(&z);
+}
+
+static void zip_compress_blocks( zip_ctx *c, int t ) {
+	int i;
+	for(i=t;i<c->nblocks;i+=c->nthreads)
+		zip_compress_block(c, i);
+}
+
+static int zip_threads( int nblocks ) {
+	int n = nblocks < hl_cpu_count() ? nblocks : hl_cpu_count();
+	if( n > MAX_THREADS ) n = MAX_THREADS;
+	return n < 1 ? 1 : n;
+}
+
+static void zip_put32be( unsigned char *p, unsigned int v ) {
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+static void zip_put32le( unsigned char *p, unsigned int v ) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+static int zip_deflate_blocks( unsigned char *src, int len, unsigned char *dst, int dstlen, int level, int flags ) {
+	zip_ctx c;
+	int format = flags & ZIP_FORMAT;
+	int i, pos = 0, err = Z_OK;
+	unsigned int check;
+	c.src = src;
+	c.len = len;
+	c.level = level;
+	c.gzip = format == ZIP_GZIP;
+	c.nblocks = len == 0 ? 1 : (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	c.nthreads = zip_threads(c.nblocks);
+	c.blocks = (zip_block*)calloc(c.nblocks, sizeof(zip_block));
+	if( c.blocks == NULL )
+		hl_error("Out of memory");
+	hl_blocking(true);
+	// the threads only access the buffers
+	hl_parallel_for(c.nthreads, (void(*)(void*,int))zip_compress_blocks, &c);
+	// header
+	if( format == ZIP_GZIP ) {
+		static const unsigned char gzip_header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+		if( dstlen >= 10 ) {
+			memcpy(dst, gzip_header, 10);
+			if( level == 9 ) dst[8] = 2; else if( level == 1 ) dst[8] = 4;
+		}
+		pos = 10;
+	} else if( format != ZIP_RAW ) {
+		if( dstlen >= 2 ) {
+			dst[0] = 0x78;
+			dst[1] = level == 0 || level == 1 ? 0x01 : (level >= 2 && level <= 5) ? 0x5E : level >= 7 ? 0xDA : 0x9C;
+		}
+		pos = 2;
+	}
+	check = c.gzip ? 0 : 1;
+	for(i=0;i<c.nblocks;i++) {
+		zip_block *b = &c.blocks[i];
+		int blen = (i == c.nblocks - 1) ? len - i * BLOCK_SIZE : BLOCK_SIZE;
+		if( b->err != Z_OK && err == Z_OK ) err = b->err;
+		if( err == Z_OK && pos + b->size <= dstlen )
+			memcpy(dst + pos, b->out, b->size);
+		pos += b->size;
+		check = c.gzip ? (unsigned int)crc32_combine(check, b->check, blen) : (unsigned int)adler32_combine(check, b->check, blen);
+		free(b->out);
+	}
+	free(c.blocks);
+	hl_blocking(false);
+	if( err != Z_OK )
+		zip_error(NULL, err);
+	// trailer
+	if( format == ZIP_GZIP ) {
+		if( pos + 8 <= dstlen ) {
+			zip_put32le(dst + pos, check);
+			zip_put32le(dst + pos + 4, (unsigned int)len);
+		}
+		pos += 8;
+	} else if( format != ZIP_RAW ) {
+		if( pos + 4 <= dstlen )
+			zip_put32be(dst + pos, check);
+		pos += 4;
+	}
+	return pos > dstlen ? -1 : pos;
+}
+
+/* ------------------------------------------------- LIBDEFLATE --------------------------------------------------- */
+
+#ifdef HL_LIBDEFLATE
+static int zip_libdeflate_compress( unsigned char *src, int len, unsigned char *dst, int dstlen, int level, int flags ) {
+	struct libdeflate_compressor *c = libdeflate_alloc_compressor(level < 0 ? 6 : level);
+	size_t size;
+	if( c == NULL )
+		hl_error("Out of memory");
+	hl_blocking(true);
+	switch( flags & ZIP_FORMAT ) {
+	case ZIP_GZIP:
+		size = libdeflate_gzip_compress(c, src, len, dst, dstlen);
+		break;
+	case ZIP_RAW:
+		size = libdeflate_deflate_compress(c, src, len, dst, dstlen);
+		break;
+	default:
+		size = libdeflate_zlib_compress(c, src, len, dst, dstlen);
+		break;
+	}
+	libdeflate_free_compressor(c);
+	hl_blocking(false);
+	return size == 0 ? -1 : (int)size;
+}
+
+static int zip_libdeflate_uncompress( unsigned char *src, int len, unsigned char *dst, int dstlen, int flags ) {
+	struct libdeflate_decompressor *d = libdeflate_alloc_decompressor();
+	enum libdeflate_result r;
+	size_t size = 0;
+	if( d == NULL )
+		hl_error("Out of memory");
+	hl_blocking(true);
+	switch( flags & ZIP_FORMAT ) {
+	case ZIP_GZIP:
+		r = libdeflate_gzip_decompress(d, src, len, dst, dstlen, &size);
+		break;
+	case ZIP_RAW:
+		r = libdeflate_deflate_decompress(d, src, len, dst, dstlen, &size);
+		break;
+	default:
+		r = libdeflate_zlib_decompress(d, src, len, dst, dstlen, &size);
+		break;
+	}
+	libdeflate_free_decompressor(d);
+	hl_blocking(false);
+	if( r == LIBDEFLATE_INSUFFICIENT_SPACE )
+		return -1;
+	if( r != LIBDEFLATE_SUCCESS )
+		hl_error("Invalid compressed data");
+	return (int)size;
+}
+#endif
+
+/* ------------------------------------------------- PRIMS --------------------------------------------------- */
+
+HL_PRIM int HL_NAME(zip_compress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen, int level, int flags ) {
+	z_stream z;
+	int err, size;
+	zip_check_range(srcpos, srclen, dstpos, dstlen);
+	src += srcpos;
+	srclen -= srcpos;
+	dst += dstpos;
+	dstlen -= dstpos;
+	if( flags & ZIP_BLOCKS )
+		return zip_deflate_blocks(src, srclen, dst, dstlen, level, flags);
+#	ifdef HL_LIBDEFLATE
+	if( flags & ZIP_FAST )
+		return zip_libdeflate_compress(src, srclen, dst, dstlen, level, flags);
+#	endif
+	memset(&z, 0, sizeof(z));
+	if( (err = deflateInit2(&z, level, Z_DEFLATED, zip_wbits(flags), 8, Z_DEFAULT_STRATEGY)) != Z_OK )
+		zip_error(NULL, err);
+	hl_blocking(true);
+	z.next_in = src;
+	z.avail_in = srclen;
+	z.next_out = dst;
+	z.avail_out = dstlen;
+	err = deflate(&z, Z_FINISH);
+	size = dstlen - z.avail_out;
+	deflateEnd(&z);
+	hl_blocking(false);
+	if( err == Z_STREAM_END )
+		return size;
+	if( err == Z_OK || err == Z_BUF_ERROR )
+		return -1;
+	zip_error(NULL, err);
+	return -1;
+}
+
+HL_PRIM int HL_NAME(zip_uncompress)( vbyte *src, int srcpos, int srclen, vbyte *dst, int dstpos, int dstlen, int flags ) {
+	z_stream z;
+	int err, size;
+	zip_check_range(srcpos, srclen, dstpos, dstlen);
+	src += srcpos;
+	srclen -= srcpos;
+	dst += dstpos;
+	dstlen -= dstpos;
+#	ifdef HL_LIBDEFLATE
+	if( flags & ZIP_FAST )
+		return zip_libdeflate_uncompress(src, srclen, dst, dstlen, flags);
+#	endif
+	memset(&z, 0, sizeof(z));
+	if( (err = inflateInit2(&z, zip_wbits(flags))) != Z_OK )
+		zip_error(NULL, err);
+	hl_blocking(true);
+	z.next_in = src;
+	z.avail_in = srclen;
+	z.next_out = dst;
+	z.avail_out = dstlen;
+	err = inflate(&z, Z_FINISH);
+	size = dstlen - z.avail_out;
+	hl_blocking(false);
+	if( err == Z_STREAM_END ) {
+		inflateEnd(&z);
+		return size;
+	}
+	if( (err == Z_OK || err == Z_BUF_ERROR) && z.avail_out == 0 ) {
+		inflateEnd(&z);
+		return -1;
+	}
+	if( err == Z_OK || err == Z_BUF_ERROR ) err = Z_DATA_ERROR;
+	if( z.msg ) {
+		uchar *msg = hl_to_utf16(z.msg);
+		inflateEnd(&z);
+		hl_error("ZLib Error : %s (%d)", msg, err);
+	}
+	inflateEnd(&z);
+	zip_error(NULL, err);
+	return -1;
+}
+
+HL_PRIM int HL_NAME(zip_compress_bound)( int size, int flags ) {
+	int bound = (int)compressBound(size) + 32;
+	if( flags & ZIP_BLOCKS )
+		bound += (size / BLOCK_SIZE + 1) * 16;
+	return bound;
+}
+
+HL_PRIM bool HL_NAME(zip_has_fast)() {
+#	ifdef HL_LIBDEFLATE
+	return true;
+#	else
+	return false;
+#	endif
+}
+
+DEFINE_PRIM(_I32, zip_compress, _BYTES _I32 _I32 _BYTES _I32 _I32 _I32 _I32);
+DEFINE_PRIM(_I32, zip_uncompress, _BYTES _I32 _I32 _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_I32, zip_compress_bound, _I32 _I32);
+DEFINE_PRIM(_BOOL, zip_has_fast, _NO_ARG);
@@ -93,6 +93,55 @@ static void myp_close( MYSQL *m ) {
 	m->s = INVALID_SOCKET;
 }
 
+static void stream_error( MYSQL_RES *r, const char *msg ) {
+	if( r->error == NULL )
+		r->error = strdup(msg);
+}
+
+static void stream_detach( MYSQL *m, const char *msg ) {
+	MYSQL_RES *r = m->unbuffered;
+	if( r == NULL )
+		return;
+	if( msg ) {
+		stream_error(r,msg);
+		m->drain = 1;
+	}
+	r->m = NULL;
+	r->current = NULL;
+	m->unbuffered = NULL;
+}
+
+// skip the rows of a stream which was not read until its end
+static void stream_drain( MYSQL *m ) {
+	MYSQL_PACKET *p = &m->packet;
+	m->drain = 0;
+	while( myp_read_packet(m,p) ) {
+		unsigned char c = (unsigned char)p->buf[0];
+		if( (c == 0xFE && p->size < 9) || c == 0xFF )
+			break;
+	}
+}
+
+// called before sending a new command
+static void flush_pending( MYSQL *m ) {
+	stream_detach(m,"Result was discarded by another request");
+	if( m->drain )
+		stream_drain(m);
+	if( m->nclosed ) {
+		// COM_STMT_CLOSE has no answer
+		MYSQL_PACKET *p = &m->packet;
+		int i;
+		for(i=0;i<m->nclosed;i++) {
+			int pcount = 0;
+			myp_begin_packet(p,5);
+			myp_write_byte(p,COM_STMT_CLOSE);
+			myp_write_int(p,m->closed_stmts[i]);
+			myp_send_packet(m,p,&pcount);
+		}
+		m->nclosed = 0;
+	}
+}
+
 MYSQL *mysql_init( void *unused ) {
 	MYSQL *m = (MYSQL*)malloc(sizeof(struct _MYSQL));
 	psock_init();
@@ -257,6 +306,7 @@ send_cnx_packet:
 int mysql_select_db( MYSQL *m, const char *dbname ) {
 	MYSQL_PACKET *p = &m->packet;
 	int pcount = 0;
+	flush_pending(m);
 	myp_begin_packet(p,0);
 	myp_write_byte(p,COM_INIT_DB);
 	myp_write_string_eof(p,dbname);
@@ -267,30 +317,45 @@ int mysql_select_db( MYSQL *m, const char *dbname ) {
 	return myp_ok(m,0) ? 0 : -1;
 }
 
-int mysql_real_query( MYSQL *m, const char *query, int qlength ) {
+int mysql_send_query( MYSQL *m, const char *query, int qlength ) {
 	MYSQL_PACKET *p = &m->packet;
 	int pcount = 0;
+	flush_pending(m);
 	myp_begin_packet(p,0);
 	myp_write_byte(p,COM_QUERY);
 	myp_write(p,query,qlength);
-	m->last_field_count = -1;
-	m->affected_rows = -1;
-	m->last_insert_id = -1;
+	m->binary = 0;
 	if( !myp_send_packet(m,p,&pcount) ) {
 		error(m,"Failed to send packet",NULL);
 		return -1;
 	}
+	return 0;
+}
+
+// reads the answer of a sent query : several queries can be sent before
+// reading their answers, as long as each result is stored before the next read
+int mysql_read_query_result( MYSQL *m ) {
+	m->last_field_count = -1;
+	m->affected_rows = -1;
+	m->last_insert_id = -1;
 	if( !myp_ok(m,1) )
 		return -1;
-	p->id = IS_QUERY;
+	m->packet.id = IS_QUERY;
 	return 0;
 }
 
-static int do_store( MYSQL *m, MYSQL_RES *r ) {
+int mysql_real_query( MYSQL *m, const char *query, int qlength ) {
+	if( mysql_send_query(m,query,qlength) != 0 )
+		return -1;
+	return mysql_read_query_result(m);
+}
+
+static int read_fields( MYSQL *m, MYSQL_RES *r ) {
 	int i;
 	MYSQL_PACKET *p = &m->packet;
 	p->pos = 0;
 	r->nfields = myp_read_bin(p);
+	r->binary = m->binary;
 	if( p->error ) return 0;
 	r->fields = (MYSQL_FIELD*)malloc(sizeof(MYSQL_FIELD) * r->nfields);
 	memset(r->fields,0,sizeof(MYSQL_FIELD) * r->nfields);
@@ -322,6 +387,114 @@ static int do_store( MYSQL *m, MYSQL_RES *r ) {
 		return 0;
 	if( myp_read_byte(p) != 0xFE || p->size >= 9 )
 		return 0;
+	return 1;
+}
+
+static void read_row( MYSQL_PACKET *p, int nfields, MYSQL_ROW_DATA *current ) {
+	int i;
+	int prev = 0;
+	for(i=0;i<nfields;i++) {
+		int l = myp_read_bin(p);
+		if( !p->error )
+			p->buf[prev] = 0;
+		if( l == -1 ) {
+			current->lengths[i] = 0;
+			current->datas[i] = NULL;
+		} else {
+			current->lengths[i] = l;
+			current->datas[i] = p->buf + p->pos;
+			p->pos += l;
+		}
+		prev = p->pos;
+	}
+	if( !p->error )
+		p->buf[prev] = 0;
+}
+
+static int binary_size( MYSQL_FIELD *f ) {
+	switch( f->type ) {
+	case FIELD_TYPE_TINY:
+		return 1;
+	case FIELD_TYPE_SHORT:
+	case FIELD_TYPE_YEAR:
+		return 2;
+	case FIELD_TYPE_LONG:
+	case FIELD_TYPE_INT24:
+	case FIELD_TYPE_FLOAT:
+		return 4;
+	case FIELD_TYPE_LONGLONG:
+	case FIELD_TYPE_DOUBLE:
+		return 8;
+	case FIELD_TYPE_DATE:
+	case FIELD_TYPE_DATETIME:
+	case FIELD_TYPE_TIMESTAMP:
+	case FIELD_TYPE_TIME:
+		return -1; // one byte length
+	default:
+		return 0; // length encoded
+	}
+}
+
+#define BINARY_SLOT	16
+
+/*
+	Binary rows store fixed size values without separators. They are copied
+	after the packet data (one slot per field) so that strings can then be
+	null terminated in place like in text rows.
+*/
+static void read_binary_row( MYSQL_PACKET *p, MYSQL_RES *r, MYSQL_ROW_DATA *current ) {
+	int i;
+	int nbytes = (r->nfields + 9) >> 3;
+	int extra = r->nfields * BINARY_SLOT;
+	unsigned char *nulls;
+	char *slots;
+	if( p->mem < p->size + extra ) {
+		p->buf = (char*)realloc(p->buf,p->size + extra + 1);
+		p->mem = p->size + extra;
+	}
+	slots = p->buf + p->size + 1;
+	nulls = (unsigned char*)p->buf + 1;
+	p->pos = 1 + nbytes;
+	if( p->pos > p->size ) {
+		p->error = 1;
+		return;
+	}
+	for(i=0;i<r->nfields;i++) {
+		int size;
+		if( nulls[(i + 2) >> 3] & (1 << ((i + 2) & 7)) ) {
+			current->lengths[i] = 0;
+			current->datas[i] = NULL;
+			continue;
+		}
+		size = binary_size(r->fields + i);
+		if( size < 0 )
+			size = myp_read_byte(p);
+		else if( size == 0 ) {
+			size = myp_read_bin(p);
+			if( size < 0 ) p->error = 1;
+		}
+		if( p->error || p->pos + size > p->size ) {
+			p->error = 1;
+			return;
+		}
+		if( binary_size(r->fields + i) == 0 ) {
+			current->datas[i] = p->buf + p->pos;
+		} else {
+			current->datas[i] = slots + i * BINARY_SLOT;
+			memcpy(current->datas[i],p->buf + p->pos,size > BINARY_SLOT ? BINARY_SLOT : size);
+		}
+		current->lengths[i] = size;
+		p->pos += size;
+	}
+	for(i=0;i<r->nfields;i++)
+		if( current->datas[i] && binary_size(r->fields + i) == 0 )
+			current->datas[i][current->lengths[i]] = 0;
+}
+
+static int do_store( MYSQL *m, MYSQL_RES *r ) {
+	MYSQL_PACKET *p = &m->packet;
+	if( !read_fields(m,r) )
+		return 0;
 	// reset packet buffer (to prevent to store large buffer in row data)
 	free(p->buf);
 	p->buf = NULL;
@@ -350,26 +523,13 @@ static int do_store( MYSQL *m, MYSQL_RES *r ) {
 		// read row fields
 		{
 			MYSQL_ROW_DATA *current = r->rows + r->row_count++;
-			int prev = 0;			
-			current->raw = p->buf;
 			current->lengths = (unsigned long*)malloc(sizeof(unsigned long) * r->nfields);
 			current->datas = (char**)malloc(sizeof(char*) * r->nfields);
-			for(i=0;i<r->nfields;i++) {
-				int l = myp_read_bin(p);
-				if( !p->error )
-					p->buf[prev] = 0;
-				if( l == -1 ) {
-					current->lengths[i] = 0;
-					current->datas[i] = NULL;
-				} else {
-					current->lengths[i] = l;
-					current->datas[i] = p->buf + p->pos;
-					p->pos += l;
-				}
-				prev = p->pos;
-			}
-			if( !p->error )
-				p->buf[prev] = 0;
+			if( r->binary )
+				read_binary_row(p,r,current);
+			else
+				read_row(p,r->nfields,current);
+			current->raw = p->buf;
 		}
 		// the packet buffer as been stored, don't reuse it
 		p->buf = NULL;
@@ -406,6 +566,68 @@ MYSQL_RES *mysql_store_result( MYSQL *m ) {
 	return r;
 }
 
+MYSQL_RES *mysql_use_result( MYSQL *m ) {
+	MYSQL_RES *r;
+	MYSQL_PACKET *p = &m->packet;
+	if( p->id != IS_QUERY )
+		return NULL;
+	if( p->buf[0] == 0 )
+		return mysql_store_result(m);
+	r = (MYSQL_RES*)malloc(sizeof(struct _MYSQL_RES));
+	memset(r,0,sizeof(struct _MYSQL_RES));
+	m->errcode = 0;
+	if( !read_fields(m,r) ) {
+		mysql_free_result(r);
+		if( !m->errcode )
+			error(m,"Failure while reading result fields",NULL);
+		return NULL;
+	}
+	// rows are read one packet at a time by mysql_fetch_row, reusing the packet buffer
+	r->unbuffered = 1;
+	r->m = m;
+	r->stream_row.lengths = (unsigned long*)malloc(sizeof(unsigned long) * r->nfields);
+	r->stream_row.datas = (char**)malloc(sizeof(char*) * r->nfields);
+	m->unbuffered = r;
+	m->last_field_count = r->nfields;
+	return r;
+}
+
+static MYSQL_ROW stream_fetch_row( MYSQL_RES *r ) {
+	MYSQL *m = r->m;
+	MYSQL_PACKET *p;
+	if( m == NULL )
+		return NULL;
+	p = &m->packet;
+	if( !myp_read_packet(m,p) ) {
+		stream_error(r,"Failed to read packet");
+		stream_detach(m,NULL);
+		return NULL;
+	}
+	// EOF : end of datas
+	if( (unsigned char)p->buf[0] == 0xFE && p->size < 9 ) {
+		stream_detach(m,NULL);
+		return NULL;
+	}
+	if( (unsigned char)p->buf[0] == 0xFF ) {
+		save_error(m,p);
+		stream_error(r,m->last_error);
+		stream_detach(m,NULL);
+		return NULL;
+	}
+	if( r->binary )
+		read_binary_row(p,r,&r->stream_row);
+	else
+		read_row(p,r->nfields,&r->stream_row);
+	if( p->error ) {
+		stream_error(r,"Failed to decode row");
+		stream_detach(m,NULL);
+		return NULL;
+	}
+	r->row_count++;
+	r->current = &r->stream_row;
+	return r->stream_row.datas;
+}
+
 int mysql_field_count( MYSQL *m ) {
 	return m->last_field_count;
 }
@@ -437,7 +659,9 @@ int mysql_real_escape_string( MYSQL *m, char *sout, const char *sin, int length
 }
 
 void mysql_close( MYSQL *m ) {
+	stream_detach(m,"Connection was closed");
 	myp_close(m);
+	free(m->closed_stmts);
 	free(m->packet.buf);
 	free(m->infos.server_version);
 	free(m);
@@ -447,6 +671,11 @@ const char *mysql_error( MYSQL *m ) {
 	return m->last_error;
 }
 
+// server error code, -1 on network or protocol errors
+int mysql_errno( MYSQL *m ) {
+	return m->errcode;
+}
+
 // RESULTS API
 
 unsigned int mysql_num_rows( MYSQL_RES *r ) {
@@ -467,6 +696,8 @@ unsigned long *mysql_fetch_lengths( MYSQL_RES *r ) {
 
 MYSQL_ROW mysql_fetch_row( MYSQL_RES * r ) {
 	MYSQL_ROW_DATA *cur = r->current;
+	if( r->unbuffered )
+		return stream_fetch_row(r);
 	if( cur == NULL )
 		cur = r->rows;
 	else {
@@ -491,6 +722,14 @@ MYSQL_ROW mysql_fetch_row( MYSQL_RES * r ) {
 }
 
 void mysql_free_result( MYSQL_RES *r ) {
+	if( r->m ) {
+		// the remaining rows will be skipped before the next request
+		r->m->unbuffered = NULL;
+		r->m->drain = 1;
+	}
+	free(r->stream_row.lengths);
+	free(r->stream_row.datas);
+	free(r->error);
 	if( r->fields ) {
 		int i;
 		for(i=0;i<r->nfields;i++) {
@@ -517,4 +756,121 @@ void mysql_free_result( MYSQL_RES *r ) {
 	free(r);
 }
 
+const char *mysql_result_error( MYSQL_RES *r ) {
+	return r->error;
+}
+
+// STATEMENTS API
+
+// skip parameters or columns definitions
+static int skip_definitions( MYSQL *m ) {
+	MYSQL_PACKET *p = &m->packet;
+	while( 1 ) {
+		if( !myp_read_packet(m,p) )
+			return 0;
+		if( (unsigned char)p->buf[0] == 0xFE && p->size < 9 )
+			return 1;
+	}
+}
+
+MYSQL_STMT *mysql_stmt_prepare( MYSQL *m, const char *query, int qlength ) {
+	MYSQL_PACKET *p = &m->packet;
+	MYSQL_STMT *s;
+	int pcount = 0;
+	flush_pending(m);
+	myp_begin_packet(p,0);
+	myp_write_byte(p,COM_STMT_PREPARE);
+	myp_write(p,query,qlength);
+	if( !myp_send_packet(m,p,&pcount) ) {
+		error(m,"Failed to send packet",NULL);
+		return NULL;
+	}
+	if( !myp_ok(m,0) )
+		return NULL;
+	s = (MYSQL_STMT*)malloc(sizeof(struct _MYSQL_STMT));
+	s->m = m;
+	s->id = myp_read_int(p);
+	s->nfields = myp_read_ui16(p);
+	s->nparams = myp_read_ui16(p);
+	// columns are sent again with each result
+	if( p->error || (s->nparams && !skip_definitions(m)) || (s->nfields && !skip_definitions(m)) ) {
+		free(s);
+		error(m,"Failed to read prepared statement",NULL);
+		return NULL;
+	}
+	return s;
+}
+
+int mysql_stmt_param_count( MYSQL_STMT *s ) {
+	return s->nparams;
+}
+
+int mysql_stmt_send_execute( MYSQL_STMT *s, MYSQL_PARAM *params ) {
+	MYSQL *m = s->m;
+	MYSQL_PACKET *p = &m->packet;
+	int pcount = 0;
+	int i;
+	flush_pending(m);
+	myp_begin_packet(p,0);
+	myp_write_byte(p,COM_STMT_EXECUTE);
+	myp_write_int(p,s->id);
+	myp_write_byte(p,0); // no cursor
+	myp_write_int(p,1); // iteration count
+	if( s->nparams ) {
+		int nbytes = (s->nparams + 7) >> 3;
+		int start = p->size;
+		for(i=0;i<nbytes;i++)
+			myp_write_byte(p,0);
+		for(i=0;i<s->nparams;i++)
+			if( params[i].type == FIELD_TYPE_NULL )
+				p->buf[start + (i >> 3)] |= 1 << (i & 7);
+		myp_write_byte(p,1); // types follow
+		for(i=0;i<s->nparams;i++) {
+			myp_write_byte(p,params[i].type);
+			myp_write_byte(p,0);
+		}
+		for(i=0;i<s->nparams;i++) {
+			MYSQL_PARAM *a = params + i;
+			switch( a->type ) {
+			case FIELD_TYPE_NULL:
+				break;
+			case FIELD_TYPE_LONGLONG:
+				myp_write(p,&a->ival,8);
+				break;
+			case FIELD_TYPE_DOUBLE:
+				myp_write(p,&a->fval,8);
+				break;
+			default:
+				myp_write_bin(p,a->length);
+				myp_write(p,a->data,a->length);
+				break;
+			}
+		}
+	}
+	m->binary = 1;
+	if( !myp_send_packet(m,p,&pcount) ) {
+		error(m,"Failed to send packet",NULL);
+		return -1;
+	}
+	return 0;
+}
+
+int mysql_stmt_execute( MYSQL_STMT *s, MYSQL_PARAM *params ) {
+	if( mysql_stmt_send_execute(s,params) != 0 )
+		return -1;
+	return mysql_read_query_result(s->m);
+}
+
+void mysql_stmt_close( MYSQL_STMT *s ) {
+	MYSQL *m = s->m;
+	// closed with the next command, so it can be called from a finalizer
+	m->closed_stmts = (int*)realloc(m->closed_stmts,sizeof(int) * (m->nclosed + 1));
+	m->closed_stmts[m->nclosed++] = s->id;
+	free(s);
+}
+
+void mysql_stmt_free( MYSQL_STMT *s ) {
+	free(s);
+}
+
 /* ************************************************************************ */
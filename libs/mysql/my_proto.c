@@ -235,13 +235,15 @@ void myp_write_bin( MYSQL_PACKET *p, int size ) {
 		myp_write(p,&l,2);
 	} else if( size < 0x1000000 ) {
 		unsigned char c = 253;
-		unsigned int l = (unsigned short)size;
+		unsigned int l = (unsigned int)size;
 		myp_write(p,&c,1);
 		myp_write(p,&l,3);
 	} else {
 		unsigned char c = 254;
+		int high = 0;
 		myp_write(p,&c,1);
 		myp_write(p,&size,4);
+		myp_write(p,&high,4);
 	}
 }
 
@@ -122,9 +122,21 @@ struct _MYSQL {
 	int last_field_count;
 	int affected_rows;
 	int last_insert_id;
+	MYSQL_RES *unbuffered; // result currently streamed
+	int drain; // rows of a discarded stream are still pending
+	int binary; // results of the last command use the binary protocol
+	int *closed_stmts; // statements to close before the next command
+	int nclosed;
 	char last_error[MAX_ERR_SIZE];
 };
 
+struct _MYSQL_STMT {
+	MYSQL *m;
+	int id;
+	int nparams;
+	int nfields;
+};
+
 typedef struct {
 	char *raw;
 	unsigned long *lengths;
@@ -138,6 +150,12 @@ struct _MYSQL_RES {
 	MYSQL_ROW_DATA *current;
 	int row_count;
 	int memory_rows;
+	int binary;
+	// unbuffered results
+	int unbuffered;
+	MYSQL *m;
+	MYSQL_ROW_DATA stream_row;
+	char *error;
 };
 
 
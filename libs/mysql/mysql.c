@@ -27,12 +27,16 @@
 #include "mysql.h"
 #include <string.h>
 
-static void error( MYSQL *m, const char *msg ) {
+static hl_buffer *error_buffer( MYSQL *m, const char *msg ) {
 	hl_buffer *b = hl_alloc_buffer();
 	hl_buffer_cstr(b,msg);
 	hl_buffer_cstr(b," ");
 	hl_buffer_cstr(b,mysql_error(m));
-	hl_throw_buffer(b);
+	return b;
+}
+
+static void error( MYSQL *m, const char *msg ) {
+	hl_throw_buffer(error_buffer(m,msg));
 }
 
 // ---------------------------------------------------------------
@@ -58,13 +62,46 @@ typedef struct {
 	CONV *fields_convs;
 	int *fields_ids;
 	MYSQL_ROW current;
+	int pending; // current row was read but not fetched yet
+	int binary; // rows of a prepared statement
+	MYSQL_FIELD *fields;
 } result;
 
+#define STMT_CACHE		16
+#define PIPELINE_WINDOW	64
+// the server stops reading queries while it sends a large answer : the queries
+// in flight must fit in the socket buffers or both sides block on send
+#define PIPELINE_BYTES	(16 << 10)
+
+typedef struct _stmt stmt;
+
+// idle prepared statement, ready to be reused for the same SQL
+typedef struct {
+	char *sql;
+	int len;
+	MYSQL_STMT *s;
+	int stamp;
+} cached_stmt;
+
 typedef struct {
 	void *free;
 	MYSQL *c;
+	stmt *stmts; // live prepared statements
+	void *root; // the connection itself, rooted while it has live statements
+	int ncached;
+	int stamp;
+	cached_stmt cache[STMT_CACHE];
 } connection;
 
+struct _stmt {
+	void *free;
+	connection *c;
+	MYSQL_STMT *s;
+	char *sql;
+	int len;
+	stmt *next;
+};
+
 static vclosure *conv_string = NULL;
 static vclosure *conv_json = NULL;
 static vclosure *conv_bytes = NULL;
@@ -76,6 +113,141 @@ static void free_result( result *r ) {
 	free(r->fields_convs);
 }
 
+// binary protocol values
+
+static int64 bin_int( result *r, int i, const char *v );
+
+static double bin_float( result *r, int i, const char *v ) {
+	switch( r->fields[i].type ) {
+	case FIELD_TYPE_FLOAT:
+		{
+			float f;
+			memcpy(&f,v,4);
+			return f;
+		}
+	case FIELD_TYPE_DOUBLE:
+		{
+			double d;
+			memcpy(&d,v,8);
+			return d;
+		}
+	case FIELD_TYPE_TINY:
+	case FIELD_TYPE_SHORT:
+	case FIELD_TYPE_YEAR:
+	case FIELD_TYPE_LONG:
+	case FIELD_TYPE_INT24:
+		return (double)bin_int(r,i,v);
+	case FIELD_TYPE_LONGLONG:
+		if( r->fields[i].flags & UNSIGNED_FLAG )
+			return (double)(unsigned long long)bin_int(r,i,v);
+		return (double)bin_int(r,i,v);
+	default:
+		return atof(v);
+	}
+}
+
+static int64 bin_int( result *r, int i, const char *v ) {
+	bool u = (r->fields[i].flags & UNSIGNED_FLAG) != 0;
+	switch( r->fields[i].type ) {
+	case FIELD_TYPE_TINY:
+		return u ? (int64)*(unsigned char*)v : (int64)*(signed char*)v;
+	case FIELD_TYPE_SHORT:
+	case FIELD_TYPE_YEAR:
+		{
+			short x;
+			memcpy(&x,v,2);
+			return u ? (int64)(unsigned short)x : (int64)x;
+		}
+	case FIELD_TYPE_LONG:
+	case FIELD_TYPE_INT24:
+		{
+			int x;
+			memcpy(&x,v,4);
+			return u ? (int64)(unsigned int)x : (int64)x;
+		}
+	case FIELD_TYPE_LONGLONG:
+		{
+			int64 x;
+			memcpy(&x,v,8);
+			return x;
+		}
+	case FIELD_TYPE_FLOAT:
+	case FIELD_TYPE_DOUBLE:
+		return (int64)bin_float(r,i,v);
+	default:
+		return strtoll(v,NULL,10);
+	}
+}
+
+static int bin_time( const char *v, unsigned long len ) {
+	const unsigned char *b = (const unsigned char*)v;
+	struct tm t;
+	memset(&t,0,sizeof(t));
+	if( len >= 4 ) {
+		t.tm_year = (b[0] | (b[1] << 8)) - 1900;
+		t.tm_mon = b[2] - 1;
+		t.tm_mday = b[3];
+	}
+	if( len >= 7 ) {
+		t.tm_hour = b[4];
+		t.tm_min = b[5];
+		t.tm_sec = b[6];
+	}
+	t.tm_isdst = -1;
+	return (int)mktime(&t);
+}
+
+// formats binary values as the text protocol would send them
+static const char *bin_string( result *r, int i, const char *v, unsigned long len, char *tmp ) {
+	const unsigned char *b = (const unsigned char*)v;
+	switch( r->fields[i].type ) {
+	case FIELD_TYPE_TINY:
+	case FIELD_TYPE_SHORT:
+	case FIELD_TYPE_YEAR:
+	case FIELD_TYPE_LONG:
+	case FIELD_TYPE_INT24:
+	case FIELD_TYPE_LONGLONG:
+		if( r->fields[i].type == FIELD_TYPE_LONGLONG && (r->fields[i].flags & UNSIGNED_FLAG) )
+			sprintf(tmp,"%llu",(unsigned long long)bin_int(r,i,v));
+		else
+			sprintf(tmp,"%lld",(long long)bin_int(r,i,v));
+		return tmp;
+	case FIELD_TYPE_FLOAT:
+		sprintf(tmp,"%.7g",bin_float(r,i,v));
+		return tmp;
+	case FIELD_TYPE_DOUBLE:
+		sprintf(tmp,"%.17g",bin_float(r,i,v));
+		return tmp;
+	case FIELD_TYPE_DATE:
+	case FIELD_TYPE_DATETIME:
+	case FIELD_TYPE_TIMESTAMP:
+		{
+			int y = len >= 4 ? b[0] | (b[1] << 8) : 0;
+			int mo = len >= 4 ? b[2] : 0, d = len >= 4 ? b[3] : 0;
+			int h = len >= 7 ? b[4] : 0, mi = len >= 7 ? b[5] : 0, sec = len >= 7 ? b[6] : 0;
+			if( r->fields[i].type == FIELD_TYPE_DATE )
+				sprintf(tmp,"%04d-%02d-%02d",y,mo,d);
+			else
+				sprintf(tmp,"%04d-%02d-%02d %02d:%02d:%02d",y,mo,d,h,mi,sec);
+		}
+		return tmp;
+	case FIELD_TYPE_TIME:
+		{
+			int days = 0, h = 0, mi = 0, sec = 0;
+			if( len >= 8 ) {
+				days = b[1] | (b[2] << 8) | (b[3] << 16) | (b[4] << 24);
+				h = b[5];
+				mi = b[6];
+				sec = b[7];
+			}
+			sprintf(tmp,"%s%02d:%02d:%02d",len >= 8 && b[0] ? "-" : "",days * 24 + h,mi,sec);
+		}
+		return tmp;
+	default:
+		return v;
+	}
+}
+
 HL_PRIM int HL_NAME(result_get_length)( result *r ) {
 	if( r->r == NULL )
 		return r->nfields;	
@@ -95,13 +267,43 @@ HL_PRIM varray *HL_NAME(result_get_fields_names)( result *r ) {
 	return a;
 }
 
+// the row datas are released at the end of the result or when another request
+// detaches a stream : the current row is only valid while the result still has it
+static MYSQL_ROW current_row( result *r ) {
+	if( r->current && mysql_fetch_lengths(r->r) == NULL ) {
+		r->current = NULL;
+		r->pending = 0;
+	}
+	return r->current;
+}
+
+static MYSQL_ROW fetch_row( result *r ) {
+	MYSQL_ROW row;
+	if( r->pending && current_row(r) ) {
+		// row left by result_fetch
+		r->pending = 0;
+		return r->current;
+	}
+	row = mysql_fetch_row(r->r);
+	if( row == NULL && mysql_result_error(r->r) ) {
+		hl_buffer *b = hl_alloc_buffer();
+		hl_buffer_cstr(b,"Failed to read row ");
+		hl_buffer_cstr(b,mysql_result_error(r->r));
+		hl_throw_buffer(b);
+	}
+	return row;
+}
+
 HL_PRIM vdynamic *HL_NAME(result_next)( result *r ) {
 	unsigned long *lengths = NULL;
-	MYSQL_ROW row = mysql_fetch_row(r->r);
+	if( r->r == NULL )
+		return NULL;
+	MYSQL_ROW row = fetch_row(r);
 	if( row == NULL )
 		return NULL;
 	int i;
 	struct tm t;
+	char tmp[64];
 	vdynamic *obj = (vdynamic*)hl_alloc_dynobj();
 	vdynamic arg;
 	vdynamic length;
@@ -110,22 +312,24 @@ HL_PRIM vdynamic *HL_NAME(result_next)( result *r ) {
 	pargs[1] = &length;
 	length.t = &hlt_i32;
 	r->current = row;
+	if( r->binary )
+		lengths = mysql_fetch_lengths(r->r);
 	for(i=0;i<r->nfields;i++) {
 		if( row[i] == NULL ) continue;		
 		vdynamic *value = NULL;
 		switch( r->fields_convs[i] ) {
 		case CONV_INT:
-			hl_dyn_seti(obj, r->fields_ids[i], &hlt_i32, atoi(row[i]));
+			hl_dyn_seti(obj, r->fields_ids[i], &hlt_i32, r->binary ? (int)bin_int(r,i,row[i]) : atoi(row[i]));
 			break;
 		case CONV_I64:
 			{
 			    char *endptr;
-				hl_dyn_seti64(obj, r->fields_ids[i], strtoll(row[i],&endptr,10));
+				hl_dyn_seti64(obj, r->fields_ids[i], r->binary ? bin_int(r,i,row[i]) : strtoll(row[i],&endptr,10));
 			}
 			break;
 		case CONV_STRING:
 			arg.t = &hlt_bytes;
-			arg.v.ptr = row[i];
+			arg.v.ptr = r->binary ? (void*)bin_string(r,i,row[i],lengths[i],tmp) : row[i];
 			value = hl_dyn_call(conv_string, pargs, 1);
 			break;
 		case CONV_JSON:
@@ -134,10 +338,10 @@ HL_PRIM vdynamic *HL_NAME(result_next)( result *r ) {
 			value = hl_dyn_call(conv_json, pargs, 1);
 			break;
 		case CONV_BOOL:
-			hl_dyn_seti(obj, r->fields_ids[i], &hlt_bool, (int)(*row[i] != '0'));
+			hl_dyn_seti(obj, r->fields_ids[i], &hlt_bool, r->binary ? (int)(bin_int(r,i,row[i]) != 0) : (int)(*row[i] != '0'));
 			break;
 		case CONV_FLOAT:
-			hl_dyn_setd(obj, r->fields_ids[i], atof(row[i]));
+			hl_dyn_setd(obj, r->fields_ids[i], r->binary ? bin_float(r,i,row[i]) : atof(row[i]));
 			break;
 		case CONV_BINARY:
 			if( lengths == NULL ) {
@@ -150,6 +354,12 @@ HL_PRIM vdynamic *HL_NAME(result_next)( result *r ) {
 			value = hl_dyn_call(conv_bytes, pargs, 2);
 			break;
 		case CONV_DATE:
+			if( r->binary ) {
+				arg.t = &hlt_i32;
+				arg.v.i = bin_time(row[i],lengths[i]);
+				value = hl_dyn_call(conv_date,pargs, 1);
+				break;
+			}
 			sscanf(row[i],"%4d-%2d-%2d",&t.tm_year,&t.tm_mon,&t.tm_mday);
 			t.tm_hour = 0;
 			t.tm_min = 0;
@@ -162,6 +372,12 @@ HL_PRIM vdynamic *HL_NAME(result_next)( result *r ) {
 			value = hl_dyn_call(conv_date,pargs, 1);
 			break;
 		case CONV_DATETIME:
+			if( r->binary ) {
+				arg.t = &hlt_i32;
+				arg.v.i = bin_time(row[i],lengths[i]);
+				value = hl_dyn_call(conv_date,pargs, 1);
+				break;
+			}
 			sscanf(row[i],"%4d-%2d-%2d %2d:%2d:%2d",&t.tm_year,&t.tm_mon,&t.tm_mday,&t.tm_hour,&t.tm_min,&t.tm_sec);
 			t.tm_isdst = -1;
 			t.tm_year -= 1900;
@@ -184,12 +400,22 @@ HL_PRIM vbyte *HL_NAME(result_get)( result *r, int n ) {
 	const char *str;
 	if( n < 0 || n >= r->nfields )
 		return NULL;
-	if( !r->current ) {
+	if( !current_row(r) ) {
 		HL_NAME(result_next)(r);
 		if( !r->current )
 			return NULL;
 	}
 	str = r->current[n];
+	if( str && r->binary ) {
+		char tmp[64];
+		const char *v = bin_string(r,n,str,mysql_fetch_lengths(r->r)[n],tmp);
+		if( v == tmp ) {
+			int len = (int)strlen(tmp);
+			vbyte *b = hl_gc_alloc_noptr(len + 1);
+			memcpy(b,tmp,len + 1);
+			return b;
+		}
+	}
 	return (vbyte*)(str ? str : "");
 }
 
@@ -197,12 +423,14 @@ HL_PRIM int HL_NAME(result_get_int)( result *r, int n ) {
 	const char *str;
 	if( n < 0 || n >= r->nfields )
 		return 0;
-	if( !r->current ) {
+	if( !current_row(r) ) {
 		HL_NAME(result_next)(r);
 		if( !r->current )
 			return 0;
 	}
 	str = r->current[n];
+	if( str && r->binary )
+		return (int)bin_int(r,n,str);
 	return str ? atoi(str) : 0;
 }
 
@@ -210,15 +438,93 @@ HL_PRIM double HL_NAME(result_get_float)( result *r, int n ) {
 	const char *str;
 	if( n < 0 || n >= r->nfields )
 		return 0.;
-	if( !r->current ) {
+	if( !current_row(r) ) {
 		HL_NAME(result_next)(r);
 		if( !r->current )
 			return 0.;
 	}
 	str = r->current[n];
+	if( str && r->binary )
+		return bin_float(r,n,str);
 	return str ? atof(str) : 0.;
 }
 
+#define FETCH_INT		0
+#define FETCH_INT64		1
+#define FETCH_FLOAT		2
+#define FETCH_TEXT		3
+#define FETCH_SKIP		4
+#define FETCH_BLOB		5
+
+// fills typed column buffers with up to max rows, text and binary values are copied
+// into the arena as (offset,length) pairs starting at arenaUsed. Stops early when the
+// arena is full : the row is kept for the next call, after the caller reset arenaUsed.
+HL_PRIM int HL_NAME(result_fetch)( result *r, int max, int *types, varray *columns, vbyte *nulls, vbyte *arena, int arenaSize, int *arenaUsed ) {
+	int row = 0, i;
+	if( r->r == NULL )
+		return 0;
+	if( columns->size < r->nfields )
+		hl_error("Missing column buffers");
+	while( row < max ) {
+		int used = *arenaUsed;
+		unsigned long *lengths;
+		MYSQL_ROW cur = fetch_row(r);
+		if( cur == NULL )
+			break;
+		r->current = cur;
+		lengths = mysql_fetch_lengths(r->r);
+		for(i=0;i<r->nfields;i++) {
+			vbyte *col = hl_aptr(columns,vbyte*)[i];
+			const char *str = cur[i];
+			char tmp[64];
+			if( nulls )
+				nulls[row * r->nfields + i] = str == NULL;
+			switch( types[i] ) {
+			case FETCH_INT:
+				((int*)col)[row] = str ? (r->binary ? (int)bin_int(r,i,str) : atoi(str)) : 0;
+				break;
+			case FETCH_INT64:
+				((int64*)col)[row] = str ? (r->binary ? bin_int(r,i,str) : strtoll(str,NULL,10)) : 0;
+				break;
+			case FETCH_FLOAT:
+				((double*)col)[row] = str ? (r->binary ? bin_float(r,i,str) : atof(str)) : 0.;
+				break;
+			case FETCH_TEXT:
+			case FETCH_BLOB:
+			{
+				int size = str ? (int)lengths[i] : 0;
+				if( str && r->binary ) {
+					const char *v = bin_string(r,i,str,lengths[i],tmp);
+					if( v == tmp ) {
+						str = tmp;
+						size = (int)strlen(tmp);
+					}
+				}
+				if( used + size > arenaSize ) {
+					r->pending = 1;
+					if( row == 0 ) {
+						if( *arenaUsed > 0 )
+							hl_error("Arena is full, arenaUsed must be reset");
+						hl_error("Arena is too small for one row");
+					}
+					return row;
+				}
+				if( size ) memcpy(arena + used, str, size);
+				((int*)col)[row << 1] = used;
+				((int*)col)[(row << 1) + 1] = size;
+				used += size;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+		*arenaUsed = used;
+		row++;
+	}
+	return row;
+}
+
 static CONV convert_type( enum enum_field_types t, int flags, unsigned int length ) {
 	// FIELD_TYPE_TIME
 	// FIELD_TYPE_YEAR
@@ -274,6 +580,9 @@ static result *alloc_result( connection *c, MYSQL_RES *r ) {
 	res->free = free_result;
 	res->r = r;
 	res->current = NULL;
+	res->pending = 0;
+	res->binary = 0;
+	res->fields = fields;
 	res->nfields = num_fields;
 	res->fields_ids = (int*)malloc(sizeof(int)*num_fields);
 	res->fields_convs = (CONV*)malloc(sizeof(CONV)*num_fields);	
@@ -292,8 +601,33 @@ static result *alloc_result( connection *c, MYSQL_RES *r ) {
 // ---------------------------------------------------------------
 // Connection
 
+static void free_cached( connection *c ) {
+	int i;
+	for(i=0;i<c->ncached;i++) {
+		free(c->cache[i].sql);
+		mysql_stmt_free(c->cache[i].s);
+	}
+	c->ncached = 0;
+}
+
 HL_PRIM void HL_NAME(close_wrap)( connection *c ) {	
 	if( c->c ) {
+		// statements die with the connection
+		while( c->stmts ) {
+			stmt *s = c->stmts;
+			c->stmts = s->next;
+			mysql_stmt_free(s->s);
+			free(s->sql);
+			s->s = NULL;
+			s->sql = NULL;
+			s->c = NULL;
+			s->next = NULL;
+		}
+		if( c->root ) {
+			hl_remove_root(&c->root);
+			c->root = NULL;
+		}
+		free_cached(c);
 		mp_close(c->c);
 		c->c = NULL;
 	}
@@ -303,10 +637,11 @@ HL_PRIM bool HL_NAME(select_db_wrap)( connection *c, const char *db ) {
 	return mysql_select_db(c->c,db) == 0;
 }
 
-HL_PRIM result *HL_NAME(request)( connection *c, const char *rq, int rqLen  ) {
-	if( mysql_real_query(c->c,rq,rqLen) != 0 )
+// reads the answer of a query or statement that was already sent
+static result *read_result( connection *c, const char *rq, bool stream, bool binary ) {
+	if( mysql_read_query_result(c->c) != 0 )
 		error(c->c,rq);
-	MYSQL_RES *res = mysql_store_result(c->c);
+	MYSQL_RES *res = stream ? mysql_use_result(c->c) : mysql_store_result(c->c);
 	if( res == NULL ) {
 		if( mysql_field_count(c->c) != 0 )
 			error(c->c,rq);
@@ -315,9 +650,295 @@ HL_PRIM result *HL_NAME(request)( connection *c, const char *rq, int rqLen  ) {
 		r->nfields = (int)mysql_affected_rows(c->c);
 		return r;
 	}
-	return alloc_result(c,res);
+	result *r = alloc_result(c,res);
+	r->binary = binary;
+	return r;
+}
+
+static result *do_request( connection *c, const char *rq, int rqLen, bool stream ) {
+	if( mysql_send_query(c->c,rq,rqLen) != 0 )
+		error(c->c,rq);
+	return read_result(c,rq,stream,false);
+}
+
+
+HL_PRIM result *HL_NAME(request)( connection *c, const char *rq, int rqLen ) {
+	return do_request(c,rq,rqLen,false);
 }
 
+// rows are decoded as they are read from the socket : the result must be read
+// until its end or freed before the connection can be used again
+HL_PRIM result *HL_NAME(request_stream)( connection *c, const char *rq, int rqLen ) {
+	return do_request(c,rq,rqLen,true);
+}
+
+// sends all queries before reading their answers, a window of queries is kept
+// in flight so that the server never waits for the client between two queries.
+// A query larger than PIPELINE_BYTES is only sent once the previous answers are read.
+HL_PRIM varray *HL_NAME(request_pipeline)( connection *c, varray *queries, int *lengths ) {
+	varray *a = hl_alloc_array(&hlt_abstract,queries->size);
+	hl_buffer *failed = NULL;
+	int sent = 0, inflight = 0, i;
+	for(i=0;i<queries->size;i++) {
+		const char *rq = (const char*)hl_aptr(queries,vbyte*)[i];
+		while( sent < queries->size && sent < i + PIPELINE_WINDOW && (sent == i || inflight + lengths[sent] <= PIPELINE_BYTES) ) {
+			if( mysql_send_query(c->c,(const char*)hl_aptr(queries,vbyte*)[sent],lengths[sent]) != 0 )
+				error(c->c,(const char*)hl_aptr(queries,vbyte*)[sent]);
+			inflight += lengths[sent];
+			sent++;
+		}
+		inflight -= lengths[i];
+		if( mysql_read_query_result(c->c) != 0 ) {
+			// the connection is lost, other answers will never come
+			if( mysql_errno(c->c) < 0 )
+				error(c->c,rq);
+			if( failed == NULL ) failed = error_buffer(c->c,rq);
+			continue;
+		}
+		MYSQL_RES *res = mysql_store_result(c->c);
+		if( res == NULL ) {
+			if( mysql_field_count(c->c) != 0 ) {
+				if( mysql_errno(c->c) < 0 )
+					error(c->c,rq);
+				if( failed == NULL ) failed = error_buffer(c->c,rq);
+				continue;
+			}
+			result *r = (result*)hl_gc_alloc_noptr(sizeof(result));
+			memset(r,0,sizeof(result));
+			r->nfields = (int)mysql_affected_rows(c->c);
+			hl_aptr(a,result*)[i] = r;
+		} else
+			hl_aptr(a,result*)[i] = alloc_result(c,res);
+	}
+	// all answers are read so the connection can still be used
+	if( failed )
+		hl_throw_buffer(failed);
+	return a;
+}
+
+// ---------------------------------------------------------------
+// Statements
+
+static void stmt_release( stmt *s, bool cache ) {
+	connection *c = s->c;
+	stmt **prev;
+	if( c == NULL )
+		return;
+	prev = &c->stmts;
+	while( *prev != s )
+		prev = &(*prev)->next;
+	*prev = s->next;
+	if( c->stmts == NULL ) {
+		hl_remove_root(&c->root);
+		c->root = NULL;
+	}
+	if( cache ) {
+		cached_stmt *e;
+		if( c->ncached == STMT_CACHE ) {
+			// evict least recently used
+			int i, old = 0;
+			for(i=1;i<c->ncached;i++)
+				if( c->cache[i].stamp < c->cache[old].stamp )
+					old = i;
+			free(c->cache[old].sql);
+			mysql_stmt_close(c->cache[old].s);
+			c->cache[old] = c->cache[--c->ncached];
+		}
+		e = c->cache + c->ncached++;
+		e->sql = s->sql;
+		e->len = s->len;
+		e->s = s->s;
+		e->stamp = c->stamp++;
+	} else {
+		mysql_stmt_close(s->s);
+		free(s->sql);
+	}
+	s->c = NULL;
+	s->s = NULL;
+	s->sql = NULL;
+	s->next = NULL;
+}
+
+static void free_stmt( stmt *s ) {
+	stmt_release(s,true);
+}
+
+HL_PRIM stmt *HL_NAME(prepare)( connection *c, const char *sql, int len ) {
+	MYSQL_STMT *ms = NULL;
+	char *copy = NULL;
+	stmt *s;
+	int i;
+	for(i=0;i<c->ncached;i++) {
+		cached_stmt *e = c->cache + i;
+		if( e->len == len && memcmp(e->sql,sql,len) == 0 ) {
+			ms = e->s;
+			copy = e->sql;
+			c->cache[i] = c->cache[--c->ncached];
+			break;
+		}
+	}
+	if( ms == NULL ) {
+		ms = mysql_stmt_prepare(c->c,sql,len);
+		if( ms == NULL )
+			error(c->c,sql);
+		copy = (char*)malloc(len + 1);
+		memcpy(copy,sql,len);
+		copy[len] = 0;
+	}
+	s = (stmt*)hl_gc_alloc_finalizer(sizeof(stmt));
+	s->free = free_stmt;
+	s->c = c;
+	s->s = ms;
+	s->sql = copy;
+	s->len = len;
+	s->next = c->stmts;
+	// statements only keep a raw pointer to the connection
+	if( c->stmts == NULL ) {
+		c->root = c;
+		hl_add_root(&c->root);
+	}
+	c->stmts = s;
+	return s;
+}
+
+HL_PRIM int HL_NAME(param_count)( stmt *s ) {
+	if( s->s == NULL ) hl_error("Statement is closed");
+	return mysql_stmt_param_count(s->s);
+}
+
+// binds the values of one row, using the result_fetch column layout
+static void bind_row( MYSQL_PARAM *params, int nparams, int *types, varray *columns, vbyte *nulls, vbyte *arena, int row ) {
+	int i;
+	for(i=0;i<nparams;i++) {
+		vbyte *col = hl_aptr(columns,vbyte*)[i];
+		MYSQL_PARAM *p = params + i;
+		if( nulls && nulls[row * nparams + i] ) {
+			p->type = FIELD_TYPE_NULL;
+			continue;
+		}
+		switch( types[i] ) {
+		case FETCH_INT:
+			p->type = FIELD_TYPE_LONGLONG;
+			p->ival = ((int*)col)[row];
+			break;
+		case FETCH_INT64:
+			p->type = FIELD_TYPE_LONGLONG;
+			p->ival = ((int64*)col)[row];
+			break;
+		case FETCH_FLOAT:
+			p->type = FIELD_TYPE_DOUBLE;
+			p->fval = ((double*)col)[row];
+			break;
+		case FETCH_TEXT:
+		case FETCH_BLOB:
+			p->type = types[i] == FETCH_TEXT ? FIELD_TYPE_VAR_STRING : FIELD_TYPE_BLOB;
+			p->data = (const char*)arena + ((int*)col)[row << 1];
+			p->length = ((int*)col)[(row << 1) + 1];
+			break;
+		default:
+			p->type = FIELD_TYPE_NULL;
+			break;
+		}
+	}
+}
+
+// approximate size of an execute packet
+static int params_size( MYSQL_PARAM *params, int nparams ) {
+	int i, size = 16 + nparams * 2;
+	for(i=0;i<nparams;i++)
+		switch( params[i].type ) {
+		case FIELD_TYPE_NULL:
+			break;
+		case FIELD_TYPE_LONGLONG:
+		case FIELD_TYPE_DOUBLE:
+			size += 8;
+			break;
+		default:
+			size += 9 + params[i].length;
+			break;
+		}
+	return size;
+}
+
+static MYSQL_PARAM *alloc_params( stmt *s, varray *columns ) {
+	int n;
+	if( s->s == NULL ) hl_error("Statement is closed");
+	n = mysql_stmt_param_count(s->s);
+	if( columns->size < n )
+		hl_error("Missing column buffers");
+	return (MYSQL_PARAM*)malloc(sizeof(MYSQL_PARAM) * (n ? n : 1));
+}
+
+HL_PRIM result *HL_NAME(execute)( stmt *s, int *types, varray *columns, vbyte *nulls, vbyte *arena, int row, bool stream ) {
+	MYSQL_PARAM *params = alloc_params(s,columns);
+	int r;
+	bind_row(params,mysql_stmt_param_count(s->s),types,columns,nulls,arena,row);
+	r = mysql_stmt_send_execute(s->s,params);
+	free(params);
+	if( r != 0 )
+		error(s->c->c,s->sql);
+	return read_result(s->c,s->sql,stream,true);
+}
+
+// executes the statement once per row, pipelined like request_pipeline : returns the total of affected rows
+HL_PRIM int HL_NAME(execute_batch)( stmt *s, int count, int *types, varray *columns, vbyte *nulls, vbyte *arena ) {
+	MYSQL_PARAM *params = alloc_params(s,columns);
+	int nparams = mysql_stmt_param_count(s->s);
+	MYSQL *m = s->c->c;
+	hl_buffer *failed = NULL;
+	int sizes[PIPELINE_WINDOW];
+	int sent = 0, inflight = 0, total = 0, i;
+	for(i=0;i<count;i++) {
+		while( sent < count && sent < i + PIPELINE_WINDOW ) {
+			int size;
+			bind_row(params,nparams,types,columns,nulls,arena,sent);
+			size = params_size(params,nparams);
+			if( sent > i && inflight + size > PIPELINE_BYTES )
+				break;
+			if( mysql_stmt_send_execute(s->s,params) != 0 ) {
+				free(params);
+				error(m,s->sql);
+			}
+			sizes[sent % PIPELINE_WINDOW] = size;
+			inflight += size;
+			sent++;
+		}
+		inflight -= sizes[i % PIPELINE_WINDOW];
+		if( mysql_read_query_result(m) != 0 ) {
+			if( mysql_errno(m) < 0 ) {
+				free(params);
+				error(m,s->sql);
+			}
+			if( failed == NULL ) failed = error_buffer(m,s->sql);
+			continue;
+		}
+		MYSQL_RES *res = mysql_store_result(m);
+		if( res ) {
+			// ignore rows
+			mysql_free_result(res);
+			continue;
+		}
+		if( mysql_field_count(m) != 0 ) {
+			if( mysql_errno(m) < 0 ) {
+				free(params);
+				error(m,s->sql);
+			}
+			if( failed == NULL ) failed = error_buffer(m,s->sql);
+			continue;
+		}
+		total += mysql_affected_rows(m);
+	}
+	if( failed ) {
+		free(params);
+		hl_throw_buffer(failed);
+	}
+	free(params);
+	return total;
+}
+
+HL_PRIM void HL_NAME(finalize)( stmt *s ) {
+	stmt_release(s,true);
+}
 
 HL_PRIM vbyte *HL_NAME(escape)( connection *c, const char *str, int len ) {
 	int wlen = len * 2;
@@ -369,10 +990,13 @@ HL_PRIM void HL_NAME(set_conv_funs)( vclosure *fstring, vclosure *fbytes, vclosu
 
 #define _CNX _ABSTRACT(mysql_cnx)
 #define _RESULT _ABSTRACT(mysql_result)
+#define _STMT _ABSTRACT(mysql_stmt)
 
 DEFINE_PRIM(_CNX, connect_wrap, _OBJ(_BYTES _BYTES _BYTES _BYTES _I32) );
 DEFINE_PRIM(_VOID, close_wrap, _CNX);
 DEFINE_PRIM(_RESULT, request, _CNX _BYTES _I32);
+DEFINE_PRIM(_RESULT, request_stream, _CNX _BYTES _I32);
+DEFINE_PRIM(_ARR, request_pipeline, _CNX _ARR _BYTES);
 DEFINE_PRIM(_BOOL, select_db_wrap, _CNX _BYTES);
 DEFINE_PRIM(_BYTES, escape, _CNX _BYTES _I32);
 
@@ -383,6 +1007,13 @@ DEFINE_PRIM(_DYN, result_next, _RESULT);
 DEFINE_PRIM(_BYTES, result_get, _RESULT _I32);
 DEFINE_PRIM(_I32, result_get_int, _RESULT _I32);
 DEFINE_PRIM(_F64, result_get_float, _RESULT _I32);
+DEFINE_PRIM(_I32, result_fetch, _RESULT _I32 _BYTES _ARR _BYTES _BYTES _I32 _REF(_I32));
+
+DEFINE_PRIM(_STMT, prepare, _CNX _BYTES _I32);
+DEFINE_PRIM(_I32, param_count, _STMT);
+DEFINE_PRIM(_RESULT, execute, _STMT _BYTES _ARR _BYTES _BYTES _I32 _BOOL);
+DEFINE_PRIM(_I32, execute_batch, _STMT _I32 _BYTES _ARR _BYTES _BYTES);
+DEFINE_PRIM(_VOID, finalize, _STMT);
 
 DEFINE_PRIM(_VOID, set_conv_funs, _DYN _DYN _DYN _DYN);
 
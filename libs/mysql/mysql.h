@@ -25,8 +25,10 @@
 
 struct _MYSQL;
 struct _MYSQL_RES;
+struct _MYSQL_STMT;
 typedef struct _MYSQL MYSQL; 
 typedef struct _MYSQL_RES MYSQL_RES;
+typedef struct _MYSQL_STMT MYSQL_STMT;
 typedef char **MYSQL_ROW;
 
 typedef enum enum_field_types {
@@ -89,35 +91,59 @@ typedef struct {
 	FIELD_TYPE type;
 } MYSQL_FIELD;
 
+// statement parameter : type is FIELD_TYPE_NULL, LONGLONG, DOUBLE, VAR_STRING or BLOB
+typedef struct {
+	FIELD_TYPE type;
+	long long ival;
+	double fval;
+	const char *data;
+	int length;
+} MYSQL_PARAM;
+
 #define	mysql_init			mp_init
 #define mysql_real_connect	mp_real_connect
 #define mysql_select_db		mp_select_db
 #define mysql_real_query	mp_real_query
+#define mysql_send_query	mp_send_query
+#define mysql_read_query_result	mp_read_query_result
 #define mysql_store_result	mp_store_result
+#define mysql_use_result	mp_use_result
 #define mysql_field_count	mp_field_count
 #define mysql_affected_rows	mp_affected_rows
 #define mysql_escape_string	mp_escape_string
 #define mysql_real_escape_string mp_real_escape_string
 #define mysql_close			mp_close
 #define mysql_error			mp_error
+#define mysql_errno			mp_errno
 #define mysql_num_rows		mp_num_rows
 #define mysql_num_fields	mp_num_fields
 #define mysql_fetch_fields	mp_fetch_fields
 #define mysql_fetch_lengths	mp_fetch_lengths
 #define mysql_fetch_row		mp_fetch_row
 #define mysql_free_result	mp_free_result
+#define mysql_result_error	mp_result_error
+#define mysql_stmt_prepare	mp_stmt_prepare
+#define mysql_stmt_param_count	mp_stmt_param_count
+#define mysql_stmt_send_execute	mp_stmt_send_execute
+#define mysql_stmt_execute	mp_stmt_execute
+#define mysql_stmt_close	mp_stmt_close
+#define mysql_stmt_free		mp_stmt_free
 
 MYSQL *mysql_init( void * );
 MYSQL *mysql_real_connect( MYSQL *m, const char *host, const char *user, const char *pass, void *unused, int port, const char *socket, int options );
 int mysql_select_db( MYSQL *m, const char *dbname );
 int mysql_real_query( MYSQL *m, const char *query, int qlength );
+int mysql_send_query( MYSQL *m, const char *query, int qlength );
+int mysql_read_query_result( MYSQL *m );
 MYSQL_RES *mysql_store_result( MYSQL *m );
+MYSQL_RES *mysql_use_result( MYSQL *m );
 int mysql_field_count( MYSQL *m );
 int mysql_affected_rows( MYSQL *m );
 int mysql_escape_string( MYSQL *m, char *sout, const char *sin, int length );
 int mysql_real_escape_string( MYSQL *m, char *sout, const char *sin, int length );
 void mysql_close( MYSQL *m );
 const char *mysql_error( MYSQL *m );
+int mysql_errno( MYSQL *m );
 const char *mysql_character_set_name( MYSQL *m );
 
 unsigned int mysql_num_rows( MYSQL_RES *r );
@@ -126,6 +152,14 @@ MYSQL_FIELD *mysql_fetch_fields( MYSQL_RES *r );
 unsigned long *mysql_fetch_lengths( MYSQL_RES *r );
 MYSQL_ROW mysql_fetch_row( MYSQL_RES * r );
 void mysql_free_result( MYSQL_RES *r );
+const char *mysql_result_error( MYSQL_RES *r );
+
+MYSQL_STMT *mysql_stmt_prepare( MYSQL *m, const char *query, int qlength );
+int mysql_stmt_param_count( MYSQL_STMT *s );
+int mysql_stmt_send_execute( MYSQL_STMT *s, MYSQL_PARAM *params );
+int mysql_stmt_execute( MYSQL_STMT *s, MYSQL_PARAM *params );
+void mysql_stmt_close( MYSQL_STMT *s );
+void mysql_stmt_free( MYSQL_STMT *s );
 
 #endif
 /* ************************************************************************ */
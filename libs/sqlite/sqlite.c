@@ -16,10 +16,26 @@
 typedef struct _database sqlite_database;
 typedef struct _result sqlite_result;
 
+#define CACHE_SIZE	16
+
+// idle prepared statement, ready to be reused for the same SQL
+typedef struct {
+	uchar *sql;
+	sqlite3_stmt *r;
+	int ncols;
+	int *names;
+	int *bools;
+	int stamp;
+} sqlite_cached;
+
 struct _database {
 	void (*finalize)( sqlite_database * );
 	sqlite3 *db;
 	sqlite_result *last;
+	sqlite_result *stmts; // live prepared statements
+	int ncached;
+	int stamp;
+	sqlite_cached cache[CACHE_SIZE];
 };
 
 struct _result {
@@ -31,6 +47,9 @@ struct _result {
 	int *bools;
 	int done;
 	int first;
+	int pending; // current row was stepped but not fetched yet
+	uchar *sql; // set for prepared statements
+	sqlite_result *next;
 	sqlite3_stmt *r;
 };
 
@@ -46,8 +65,14 @@ static void HL_NAME(error)( sqlite3 *db, bool close ) {
 static void HL_NAME(finalize_request)(sqlite_result *r, bool exc ) {
 	r->first = 0;
 	r->done = 1;
+	r->pending = 0;
 	if( r->ncols == 0 )
 		r->count = sqlite3_changes(r->db->db);
+	if( r->sql ) {
+		// prepared statements are kept until finalize
+		sqlite3_reset(r->r);
+		return;
+	}
 	if( sqlite3_finalize(r->r) != SQLITE_OK && exc )
 		hl_error("SQLite error: Could not finalize request");
 	r->r = NULL;
@@ -58,8 +83,69 @@ static void HL_NAME(finalize_request)(sqlite_result *r, bool exc ) {
 	r->names = NULL;
 	r->bools = NULL;
 }
+static void HL_NAME(free_cached)( sqlite_cached *c ) {
+	sqlite3_finalize(c->r);
+	free(c->sql);
+	free(c->names);
+	free(c->bools);
+}
+
+static void HL_NAME(release)( sqlite_result *r, bool cache ) {
+	sqlite_database *db = r->db;
+	sqlite_result **prev = &db->stmts;
+	while( *prev != r )
+		prev = &(*prev)->next;
+	*prev = r->next;
+	if( cache ) {
+		sqlite_cached *c = NULL;
+		int i;
+		sqlite3_reset(r->r);
+		sqlite3_clear_bindings(r->r);
+		// several statements were prepared with the same SQL : keep the most recent one
+		for(i=0;i<db->ncached;i++)
+			if( ucmp(db->cache[i].sql, r->sql) == 0 ) {
+				c = &db->cache[i];
+				HL_NAME(free_cached)(c);
+				break;
+			}
+		if( c == NULL && db->ncached == CACHE_SIZE ) {
+			int lru = 0;
+			for(i=1;i<CACHE_SIZE;i++)
+				if( db->cache[i].stamp < db->cache[lru].stamp )
+					lru = i;
+			HL_NAME(free_cached)(&db->cache[lru]);
+			db->cache[lru] = db->cache[--db->ncached];
+		}
+		if( c == NULL ) c = &db->cache[db->ncached++];
+		c->sql = r->sql;
+		c->r = r->r;
+		c->ncols = r->ncols;
+		c->names = r->names;
+		c->bools = r->bools;
+		c->stamp = ++db->stamp;
+	} else {
+		sqlite3_finalize(r->r);
+		free(r->sql);
+		free(r->names);
+		free(r->bools);
+	}
+	r->first = 0;
+	r->done = 1;
+	r->pending = 0;
+	r->sql = NULL;
+	r->r = NULL;
+	r->names = NULL;
+	r->bools = NULL;
+	r->db = NULL;
+}
+
 static void HL_NAME(finalize_result)(sqlite_result *r ) {
-	if (r && r->db) HL_NAME(finalize_request)(r, false);
+	if( r && r->db ) {
+		if( r->sql )
+			HL_NAME(release)(r, true);
+		else
+			HL_NAME(finalize_request)(r, false);
+	}
 }
 
 /**
@@ -67,8 +153,14 @@ close : 'db -> void
 <doc>Closes the database.</doc>
 **/
 HL_PRIM void HL_NAME(close)( sqlite_database *db ) {
+	int i;
 	if (db->last != NULL)
 		HL_NAME(finalize_request)(db->last, false);
+	while( db->stmts )
+		HL_NAME(release)(db->stmts, false);
+	for(i=0;i<db->ncached;i++)
+		HL_NAME(free_cached)(&db->cache[i]);
+	db->ncached = 0;
 	if (sqlite3_close(db->db) != SQLITE_OK) {
 		// No exception : we shouldn't alloc memory in a finalizer anyway
 	}
@@ -93,6 +185,9 @@ HL_PRIM sqlite_database *HL_NAME(connect)( vbyte *filename ) {
 	db->finalize = HL_NAME(finalize_database);
 	db->db = sqlite;
 	db->last = NULL;
+	db->stmts = NULL;
+	db->ncached = 0;
+	db->stamp = 0;
 	return db;
 }
 
@@ -104,44 +199,36 @@ HL_PRIM int HL_NAME(last_id)(sqlite_database *db ) {
 	return (int)sqlite3_last_insert_rowid(db->db);
 }
 
-/**
-	request : 'db -> sql:string -> 'result
-	<doc>Executes the SQL request and returns its result</doc>
-**/
-HL_PRIM sqlite_result *HL_NAME(request)(sqlite_database *db, vbyte *sql ) {
-	sqlite_result *r;
-	const char *tl;
-	int i,j;
-
-	r = (sqlite_result*)hl_gc_alloc_finalizer(sizeof(sqlite_result));
-	r->finalize = HL_NAME(finalize_result);
-	r->db = NULL;
-
-	if( sqlite3_prepare16_v2(db->db, sql, -1, &r->r, (const void**)&tl) != SQLITE_OK ) {
-		HL_NAME(error)(db->db, false);
-	}
-
-	if( *tl ) {
+// a registered statement is finalized with its result : only the columns are released
+static void HL_NAME(free_columns)( sqlite_result *r ) {
+	if( r->db == NULL )
 		sqlite3_finalize(r->r);
-		hl_error("SQLite error: Cannot execute several SQL requests at the same time");
-	}
+	free(r->names);
+	free(r->bools);
+	r->names = NULL;
+	r->bools = NULL;
+	r->ncols = 0;
+}
 
-	r->db = db;
+static void HL_NAME(init_columns)( sqlite_result *r, vbyte *sql ) {
+	int i,j;
 	r->ncols = sqlite3_column_count(r->r);
 	r->names = (int*)malloc(sizeof(int)*r->ncols);
 	r->bools = (int*)malloc(sizeof(int)*r->ncols);
 	r->first = 1;
 	r->done = 0;
+	r->pending = 0;
+	r->count = 0;
 	for(i=0;i<r->ncols;i++) {
 		int id = hl_hash_gen((uchar*)sqlite3_column_name16(r->r,i), true);
 		const char *dtype = sqlite3_column_decltype(r->r,i);
 		for(j=0;j<i;j++)
 			if( r->names[j] == id ) {
 				if( strcmp(sqlite3_column_name16(r->r,i), sqlite3_column_name16(r->r,j)) == 0 ) {
-					sqlite3_finalize(r->r);
+					HL_NAME(free_columns)(r);
 					hl_buffer *b = hl_alloc_buffer();
 					hl_buffer_str(b, USTR("SQLite error: Same field is two times in the request: "));
-					hl_buffer_str(b, (uchar*)sql);
+					if( sql ) hl_buffer_str(b, (uchar*)sql);
 
 					hl_error("%s",hl_buffer_content(b, NULL));
 				} else {
@@ -151,13 +238,52 @@ HL_PRIM sqlite_result *HL_NAME(request)(sqlite_database *db, vbyte *sql ) {
 					hl_buffer_str(b, USTR(" and "));
 					hl_buffer_str(b, sqlite3_column_name16(r->r,j));
 
-					sqlite3_finalize(r->r);
+					HL_NAME(free_columns)(r);
 					hl_error("%s",hl_buffer_content(b, NULL));
 				}
 			}
 		r->names[i] = id;
 		r->bools[i] = dtype?(strcmp(dtype,"BOOL") == 0):0;
 	}
+}
+
+/*
+	sqlite recompiles a statement on its first step after a schema change :
+	the columns of a cached statement (SELECT * ...) might have changed.
+*/
+static void HL_NAME(check_columns)( sqlite_result *r ) {
+	if( sqlite3_column_count(r->r) == r->ncols )
+		return;
+	free(r->names);
+	free(r->bools);
+	HL_NAME(init_columns)(r, (vbyte*)r->sql);
+}
+
+/**
+	request : 'db -> sql:string -> 'result
+	<doc>Executes the SQL request and returns its result</doc>
+**/
+HL_PRIM sqlite_result *HL_NAME(request)(sqlite_database *db, vbyte *sql ) {
+	sqlite_result *r;
+	const char *tl;
+
+	r = (sqlite_result*)hl_gc_alloc_finalizer(sizeof(sqlite_result));
+	r->finalize = HL_NAME(finalize_result);
+	r->db = NULL;
+	r->sql = NULL;
+
+	if( sqlite3_prepare16_v2(db->db, sql, -1, &r->r, (const void**)&tl) != SQLITE_OK ) {
+		HL_NAME(error)(db->db, false);
+	}
+
+	if( *tl ) {
+		sqlite3_finalize(r->r);
+		hl_error("SQLite error: Cannot execute several SQL requests at the same time");
+	}
+
+	HL_NAME(init_columns)(r, sql);
+	r->db = db;
+
 	// changes in an update/delete
 	if( db->last != NULL )
 		HL_NAME(finalize_request)(db->last, false);
@@ -166,6 +292,55 @@ HL_PRIM sqlite_result *HL_NAME(request)(sqlite_database *db, vbyte *sql ) {
 	return db->last;
 }
 
+/**
+	prepare : 'db -> sql:string -> 'result
+	<doc>
+	Prepares a statement which can be bound, stepped and reset several times.
+	Finalized statements are kept in a per-connection cache and reused when
+	the same SQL is prepared again.
+	</doc>
+**/
+HL_PRIM sqlite_result *HL_NAME(prepare)( sqlite_database *db, vbyte *sql ) {
+	sqlite_result *r;
+	const char *tl;
+	int i;
+	r = (sqlite_result*)hl_gc_alloc_finalizer(sizeof(sqlite_result));
+	r->finalize = HL_NAME(finalize_result);
+	r->db = NULL;
+	r->sql = NULL;
+	for(i=0;i<db->ncached;i++) {
+		sqlite_cached *c = &db->cache[i];
+		if( ucmp(c->sql, (uchar*)sql) == 0 ) {
+			r->sql = c->sql;
+			r->r = c->r;
+			r->ncols = c->ncols;
+			r->names = c->names;
+			r->bools = c->bools;
+			r->first = 1;
+			r->done = 0;
+			r->pending = 0;
+			r->count = 0;
+			*c = db->cache[--db->ncached];
+			r->db = db;
+			r->next = db->stmts;
+			db->stmts = r;
+			return r;
+		}
+	}
+	if( sqlite3_prepare16_v2(db->db, sql, -1, &r->r, (const void**)&tl) != SQLITE_OK )
+		HL_NAME(error)(db->db, false);
+	if( *tl ) {
+		sqlite3_finalize(r->r);
+		hl_error("SQLite error: Cannot prepare several SQL requests at the same time");
+	}
+	HL_NAME(init_columns)(r, sql);
+	r->sql = ustrdup((uchar*)sql);
+	r->db = db;
+	r->next = db->stmts;
+	db->stmts = r;
+	return r;
+}
+
 /**
 	result_get_length : 'result -> int
 	<doc>Returns the number of rows in the result or the number of rows changed by the request.</doc>
@@ -207,8 +382,11 @@ HL_PRIM varray *HL_NAME(result_get_fields)( sqlite_result *r ) {
 HL_PRIM varray *HL_NAME(result_next)( sqlite_result *r ) {
 	if( r->done )
 		return NULL;
-	switch( sqlite3_step(r->r) ) {
+	// a row left by result_fetch is returned first
+	switch( r->pending ? SQLITE_ROW : sqlite3_step(r->r) ) {
 	case SQLITE_ROW:
+		HL_NAME(check_columns)(r);
+		r->pending = 0;
 		r->first = 0;
 		varray *a = hl_alloc_array(&hlt_dyn, r->ncols);
 		int i;
@@ -317,6 +495,294 @@ HL_PRIM vdynamic *HL_NAME(result_get_float)( sqlite_result *r, int n ) {
 	return hl_make_dyn(&value, &hlt_f64);
 }
 
+#define FETCH_INT		0
+#define FETCH_INT64		1
+#define FETCH_FLOAT		2
+#define FETCH_TEXT		3
+#define FETCH_SKIP		4
+#define FETCH_BLOB		5
+
+/**
+	result_fetch : 'result -> max:int -> types:bytes -> columns:array<bytes> -> nulls:bytes -> arena:bytes -> arenaSize:int -> arenaUsed:ref<int> -> int
+	<doc>
+	Fetches up to [max] rows into typed column buffers, without allocating per cell.
+	[types] gives one type per column :
+		0 : int (int[max]), 1 : int64 (int64[max]), 2 : float (double[max]),
+		3 or 5 : text or blob (int[max * 2] of offset and length in the arena), 4 : skip
+	Text and blobs are copied as UTF-8 into [arena] starting at [arenaUsed], which is updated.
+	[nulls] (optional) receives one byte per cell (row * ncols + column), NULL values are stored as 0.
+	Stops early when the arena is full, the row is kept for the next call : the caller resets
+	[arenaUsed] to 0 once it is done with the fetched rows. A row that doesn't fit in the space
+	left (arenaSize - arenaUsed) when no row was fetched yet is an error.
+	Returns the number of rows fetched, 0 once the result is over.
+	</doc>
+**/
+HL_PRIM int HL_NAME(result_fetch)( sqlite_result *r, int max, int *types, varray *columns, vbyte *nulls, vbyte *arena, int arenaSize, int *arenaUsed ) {
+	int row = 0, i;
+	if( columns->size < r->ncols )
+		hl_error("SQLite error: Missing column buffers");
+	while( row < max && !r->done ) {
+		int used = *arenaUsed;
+		if( !r->pending ) {
+			switch( sqlite3_step(r->r) ) {
+			case SQLITE_ROW:
+				HL_NAME(check_columns)(r);
+				if( columns->size < r->ncols )
+					hl_error("SQLite error: Missing column buffers");
+				r->first = 0;
+				r->pending = 1;
+				break;
+			case SQLITE_DONE:
+				HL_NAME(finalize_request)(r, true);
+				return row;
+			case SQLITE_BUSY:
+				hl_error("SQLite error: Database is busy");
+			default:
+				HL_NAME(error)(r->db->db, false);
+			}
+		}
+		for(i=0;i<r->ncols;i++) {
+			vbyte *col = hl_aptr(columns, vbyte*)[i];
+			bool isnull = sqlite3_column_type(r->r, i) == SQLITE_NULL;
+			if( nulls )
+				nulls[row * r->ncols + i] = isnull;
+			switch( types[i] ) {
+			case FETCH_INT:
+				((int*)col)[row] = sqlite3_column_int(r->r, i);
+				break;
+			case FETCH_INT64:
+				((int64*)col)[row] = sqlite3_column_int64(r->r, i);
+				break;
+			case FETCH_FLOAT:
+				((double*)col)[row] = sqlite3_column_double(r->r, i);
+				break;
+			case FETCH_TEXT:
+			case FETCH_BLOB:
+			{
+				const void *data = isnull ? NULL : sqlite3_column_type(r->r, i) == SQLITE_BLOB ? sqlite3_column_blob(r->r, i) : sqlite3_column_text(r->r, i);
+				int size = isnull ? 0 : sqlite3_column_bytes(r->r, i);
+				if( used + size > arenaSize ) {
+					// keep the row for the next call
+					if( row == 0 ) {
+						if( *arenaUsed > 0 )
+							hl_error("SQLite error: Arena is full, arenaUsed must be reset");
+						hl_error("SQLite error: Arena is too small for one row");
+					}
+					return row;
+				}
+				if( size ) memcpy(arena + used, data, size);
+				((int*)col)[row << 1] = used;
+				((int*)col)[(row << 1) + 1] = size;
+				used += size;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+		*arenaUsed = used;
+		r->pending = 0;
+		row++;
+	}
+	return row;
+}
+
+static sqlite_result *HL_NAME(check_stmt)( sqlite_result *r ) {
+	if( r->r == NULL )
+		hl_error("SQLite error: Statement is finalized");
+	return r;
+}
+
+static void HL_NAME(check_bind)( sqlite_result *r, int rc ) {
+	if( rc != SQLITE_OK )
+		HL_NAME(error)(r->db->db, false);
+}
+
+/**
+	bind_null : 'result -> index:int -> void
+	<doc>Binds NULL to the parameter [index], starting at 1.</doc>
+**/
+HL_PRIM void HL_NAME(bind_null)( sqlite_result *r, int index ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_null(HL_NAME(check_stmt)(r)->r, index));
+}
+
+/**
+	bind_int : 'result -> index:int -> int -> void
+	<doc>Binds an int to the parameter [index].</doc>
+**/
+HL_PRIM void HL_NAME(bind_int)( sqlite_result *r, int index, int v ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_int(HL_NAME(check_stmt)(r)->r, index, v));
+}
+
+/**
+	bind_int64 : 'result -> index:int -> int64 -> void
+	<doc>Binds an int64 to the parameter [index].</doc>
+**/
+HL_PRIM void HL_NAME(bind_int64)( sqlite_result *r, int index, int64 v ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_int64(HL_NAME(check_stmt)(r)->r, index, v));
+}
+
+/**
+	bind_float : 'result -> index:int -> float -> void
+	<doc>Binds a float to the parameter [index].</doc>
+**/
+HL_PRIM void HL_NAME(bind_float)( sqlite_result *r, int index, double v ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_double(HL_NAME(check_stmt)(r)->r, index, v));
+}
+
+/**
+	bind_text : 'result -> index:int -> string -> void
+	<doc>Binds a string to the parameter [index], the string is copied.</doc>
+**/
+HL_PRIM void HL_NAME(bind_text)( sqlite_result *r, int index, vbyte *str ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_text16(HL_NAME(check_stmt)(r)->r, index, str, -1, SQLITE_TRANSIENT));
+}
+
+/**
+	bind_blob : 'result -> index:int -> bytes -> pos:int -> len:int -> void
+	<doc>Binds [len] bytes to the parameter [index], the bytes are copied.</doc>
+**/
+HL_PRIM void HL_NAME(bind_blob)( sqlite_result *r, int index, vbyte *data, int pos, int len ) {
+	HL_NAME(check_bind)(r, sqlite3_bind_blob(HL_NAME(check_stmt)(r)->r, index, data + pos, len, SQLITE_TRANSIENT));
+}
+
+/**
+	param_count : 'result -> int
+	<doc>Returns the number of parameters of the statement.</doc>
+**/
+HL_PRIM int HL_NAME(param_count)( sqlite_result *r ) {
+	return sqlite3_bind_parameter_count(HL_NAME(check_stmt)(r)->r);
+}
+
+/**
+	step : 'result -> bool
+	<doc>
+	Executes the statement until the next row. Returns [false] once done.
+	The row can then be read with result_get, result_next or result_fetch.
+	</doc>
+**/
+HL_PRIM bool HL_NAME(step)( sqlite_result *r ) {
+	if( r->done )
+		return false;
+	switch( sqlite3_step(r->r) ) {
+	case SQLITE_ROW:
+		HL_NAME(check_columns)(r);
+		r->first = 0;
+		r->pending = 1;
+		return true;
+	case SQLITE_DONE:
+		HL_NAME(finalize_request)(r, true);
+		return false;
+	case SQLITE_BUSY:
+		hl_error("SQLite error: Database is busy");
+	default:
+		HL_NAME(error)(r->db->db, false);
+	}
+	return false;
+}
+
+/**
+	reset : 'result -> clear:bool -> void
+	<doc>Resets a prepared statement so it can be executed again, optionally clearing its bindings.</doc>
+**/
+HL_PRIM void HL_NAME(reset)( sqlite_result *r, bool clear ) {
+	HL_NAME(check_stmt)(r);
+	sqlite3_reset(r->r);
+	if( clear )
+		sqlite3_clear_bindings(r->r);
+	r->first = 1;
+	r->done = 0;
+	r->pending = 0;
+	r->count = 0;
+}
+
+/**
+	finalize : 'result -> void
+	<doc>Releases a prepared statement, which goes back to the connection cache.</doc>
+**/
+HL_PRIM void HL_NAME(finalize)( sqlite_result *r ) {
+	if( r->sql )
+		HL_NAME(release)(r, true);
+	else if( r->db )
+		HL_NAME(finalize_request)(r, true);
+}
+
+/**
+	execute_batch : 'result -> count:int -> types:bytes -> columns:array<bytes> -> nulls:bytes -> arena:bytes -> int
+	<doc>
+	Executes the statement once per row of parameters, inside a transaction
+	unless one is already open. Parameters use the same typed column layout
+	as result_fetch, with 3 binding UTF-8 text and 5 binding a blob from the arena.
+	Parameters of type 4 keep their current binding. Bindings are cleared at the end.
+	Returns the number of rows changed.
+	</doc>
+**/
+HL_PRIM int HL_NAME(execute_batch)( sqlite_result *r, int count, int *types, varray *columns, vbyte *nulls, vbyte *arena ) {
+	sqlite3 *db;
+	int nparams, changes, row, i, rc = SQLITE_OK;
+	bool trans;
+	HL_NAME(check_stmt)(r);
+	db = r->db->db;
+	nparams = sqlite3_bind_parameter_count(r->r);
+	if( columns->size < nparams )
+		hl_error("SQLite error: Missing parameter buffers");
+	trans = sqlite3_get_autocommit(db) != 0;
+	if( trans && sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK )
+		HL_NAME(error)(db, false);
+	changes = sqlite3_total_changes(db);
+	sqlite3_reset(r->r);
+	for(row=0;row<count && rc == SQLITE_OK;row++) {
+		for(i=0;i<nparams && rc == SQLITE_OK;i++) {
+			vbyte *col = hl_aptr(columns, vbyte*)[i];
+			int *text = (int*)col;
+			if( nulls && nulls[row * nparams + i] ) {
+				rc = sqlite3_bind_null(r->r, i + 1);
+				continue;
+			}
+			switch( types[i] ) {
+			case FETCH_INT:
+				rc = sqlite3_bind_int(r->r, i + 1, ((int*)col)[row]);
+				break;
+			case FETCH_INT64:
+				rc = sqlite3_bind_int64(r->r, i + 1, ((int64*)col)[row]);
+				break;
+			case FETCH_FLOAT:
+				rc = sqlite3_bind_double(r->r, i + 1, ((double*)col)[row]);
+				break;
+			case FETCH_TEXT:
+				// the arena outlives the batch : no copy
+				rc = sqlite3_bind_text(r->r, i + 1, (char*)arena + text[row << 1], text[(row << 1) + 1], SQLITE_STATIC);
+				break;
+			case FETCH_BLOB:
+				rc = sqlite3_bind_blob(r->r, i + 1, arena + text[row << 1], text[(row << 1) + 1], SQLITE_STATIC);
+				break;
+			default:
+				break;
+			}
+		}
+		if( rc != SQLITE_OK )
+			break;
+		while( (rc = sqlite3_step(r->r)) == SQLITE_ROW ) {
+		}
+		rc = sqlite3_reset(r->r);
+	}
+	sqlite3_clear_bindings(r->r);
+	if( rc == SQLITE_OK && trans && sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK )
+		rc = SQLITE_ERROR;
+	if( rc != SQLITE_OK ) {
+		hl_buffer *b = hl_alloc_buffer();
+		hl_buffer_str(b, USTR("SQLite error: "));
+		hl_buffer_str(b, sqlite3_errmsg16(db));
+		if( trans )
+			sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+		hl_error("%s",hl_buffer_content(b,NULL));
+	}
+	r->first = 1;
+	r->done = 0;
+	r->pending = 0;
+	return sqlite3_total_changes(db) - changes;
+}
+
 #define _CONNECTION _ABSTRACT( sqlite_database )
 #define _RESULT _ABSTRACT( sqlite_result )
 
@@ -324,6 +790,7 @@ DEFINE_PRIM(_CONNECTION, connect, _BYTES);
 DEFINE_PRIM(_VOID,       close,   _CONNECTION);
 DEFINE_PRIM(_RESULT,     request, _CONNECTION _BYTES);
 DEFINE_PRIM(_I32,        last_id, _CONNECTION);
+DEFINE_PRIM(_RESULT,     prepare, _CONNECTION _BYTES);
 
 DEFINE_PRIM(_ARR,          result_next,      _RESULT);
 DEFINE_PRIM(_BYTES,        result_get,       _RESULT _I32);
@@ -332,3 +799,16 @@ DEFINE_PRIM(_NULL(_F64),   result_get_float, _RESULT _I32);
 DEFINE_PRIM(_NULL(_I32),   result_get_length, _RESULT);
 DEFINE_PRIM(_I32,          result_get_nfields, _RESULT);
 DEFINE_PRIM(_ARR,          result_get_fields, _RESULT);
+DEFINE_PRIM(_I32,          result_fetch,     _RESULT _I32 _BYTES _ARR _BYTES _BYTES _I32 _REF(_I32));
+
+DEFINE_PRIM(_VOID,         bind_null,        _RESULT _I32);
+DEFINE_PRIM(_VOID,         bind_int,         _RESULT _I32 _I32);
+DEFINE_PRIM(_VOID,         bind_int64,       _RESULT _I32 _I64);
+DEFINE_PRIM(_VOID,         bind_float,       _RESULT _I32 _F64);
+DEFINE_PRIM(_VOID,         bind_text,        _RESULT _I32 _BYTES);
+DEFINE_PRIM(_VOID,         bind_blob,        _RESULT _I32 _BYTES _I32 _I32);
+DEFINE_PRIM(_I32,          param_count,      _RESULT);
+DEFINE_PRIM(_BOOL,         step,             _RESULT);
+DEFINE_PRIM(_VOID,         reset,            _RESULT _BOOL);
+DEFINE_PRIM(_VOID,         finalize,         _RESULT);
+DEFINE_PRIM(_I32,          execute_batch,    _RESULT _I32 _BYTES _ARR _BYTES _BYTES);
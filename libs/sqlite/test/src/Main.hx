@@ -8,6 +8,7 @@ class Main
 		var r = new haxe.unit.TestRunner();
 		r.add(new BasicTestCase());
 		r.add(new ResultSetTestCase());
+		r.add(new StatementTestCase());
 		r.add(new ExceptionTestCase());
 		r.run();
 	}
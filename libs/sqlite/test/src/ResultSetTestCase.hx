@@ -13,6 +13,8 @@ class ResultSetTestCase extends TestCase
 	var file : String;
 	var cnx : Connection;
 
+	@:hlNative("sqlite", "result_fetch") static function resultFetch( r : hl.Abstract<"sqlite_result">, max : Int, types : hl.Bytes, columns : hl.NativeArray<hl.Bytes>, nulls : hl.Bytes, arena : hl.Bytes, arenaSize : Int, arenaUsed : hl.Ref<Int> ) : Int { return 0; }
+
 	override public function setup( ) : Void
 	{
 		super.setup();
@@ -128,4 +130,41 @@ class ResultSetTestCase extends TestCase
 		assertEquals("\x111111", vals.bl);
 		assertEquals(true, vals.bo);
 	}
+
+	public function testFetch( ) : Void
+	{
+		var res : ResultSet = cnx.request('SELECT * FROM t1 ORDER BY i');
+		var types = haxe.io.Bytes.alloc(5 * 4);
+		for( i => t in [0, 2, 3, 4, 0] )
+			types.setInt32(i * 4, t);
+		var ints = haxe.io.Bytes.alloc(2 * 4), floats = haxe.io.Bytes.alloc(2 * 8), texts = haxe.io.Bytes.alloc(2 * 8), bools = haxe.io.Bytes.alloc(2 * 4);
+		var columns = new hl.NativeArray<hl.Bytes>(5);
+		columns[0] = ints;
+		columns[1] = floats;
+		columns[2] = texts;
+		columns[4] = bools;
+		// only fits one "Привет!" at a time
+		var arena = haxe.io.Bytes.alloc(16);
+		var r : hl.Abstract<"sqlite_result"> = Reflect.field(res, "r");
+
+		var used = 0;
+		assertEquals(2, resultFetch(r, 2, types, columns, null, arena, arena.length, used));
+		assertEquals(12, used);
+		assertEquals(1, ints.getInt32(0));
+		assertEquals(2, ints.getInt32(4));
+		assertEquals(0.00002, floats.getDouble(8));
+		assertEquals("goodbye", arena.getString(texts.getInt32(8), texts.getInt32(12)));
+		assertEquals(0, bools.getInt32(4));
+
+		// the next row doesn't fit in the space left : the arena has to be reset first
+		var error = null;
+		try resultFetch(r, 2, types, columns, null, arena, arena.length, used) catch( e : Dynamic ) error = Std.string(e);
+		assertEquals("SQLite error: Arena is full, arenaUsed must be reset", error);
+
+		used = 0;
+		assertEquals(1, resultFetch(r, 2, types, columns, null, arena, arena.length, used));
+		assertEquals(3, ints.getInt32(0));
+		assertEquals("Привет!", arena.getString(texts.getInt32(0), texts.getInt32(4)));
+		assertEquals(0, resultFetch(r, 2, types, columns, null, arena, arena.length, used));
+	}
 }
@@ -0,0 +1,132 @@
+package ;
+
+import haxe.unit.TestCase;
+import sys.FileSystem;
+
+import sys.db.Connection;
+import sys.db.Sqlite;
+
+private typedef Stmt = hl.Abstract<"sqlite_result">;
+
+class StatementTestCase extends TestCase
+{
+	var file : String;
+	var cnx : Connection;
+	var db : hl.Abstract<"sqlite_database">;
+
+	@:hlNative("sqlite", "prepare") static function prepare( db : hl.Abstract<"sqlite_database">, sql : hl.Bytes ) : Stmt { return null; }
+	@:hlNative("sqlite", "bind_int") static function bindInt( s : Stmt, index : Int, v : Int ) : Void {}
+	@:hlNative("sqlite", "bind_text") static function bindText( s : Stmt, index : Int, v : hl.Bytes ) : Void {}
+	@:hlNative("sqlite", "step") static function step( s : Stmt ) : Bool { return false; }
+	@:hlNative("sqlite", "reset") static function reset( s : Stmt, clear : Bool ) : Void {}
+	@:hlNative("sqlite", "finalize") static function finalize( s : Stmt ) : Void {}
+	@:hlNative("sqlite", "result_get_int") static function getInt( s : Stmt, n : Int ) : Null<Int> { return null; }
+	@:hlNative("sqlite", "result_get_nfields") static function nfields( s : Stmt ) : Int { return 0; }
+	@:hlNative("sqlite", "execute_batch") static function executeBatch( s : Stmt, count : Int, types : hl.Bytes, columns : hl.NativeArray<hl.Bytes>, nulls : hl.Bytes, arena : hl.Bytes ) : Int { return 0; }
+
+	override public function setup( ) : Void
+	{
+		super.setup();
+
+		file = '${currentTest.classname}-${currentTest.method}.sqlite';
+		cnx = Sqlite.open(file);
+		db = Reflect.field(cnx, "c");
+
+		cnx.request('CREATE TABLE t1(i int PRIMARY KEY, t text)');
+	}
+
+	override public function tearDown( ) : Void
+	{
+		super.tearDown();
+
+		cnx.close();
+		FileSystem.deleteFile(file);
+	}
+
+	function count( ) : Int
+	{
+		return cnx.request('SELECT COUNT(*) FROM t1').getIntResult(0);
+	}
+
+	public function testBind( ) : Void
+	{
+		var s = prepare(db, @:privateAccess "INSERT INTO t1 VALUES(?, ?)".bytes);
+		for( i in 0...3 ) {
+			reset(s, true);
+			bindInt(s, 1, i);
+			bindText(s, 2, @:privateAccess "hello".bytes);
+			assertFalse(step(s));
+		}
+		finalize(s);
+		assertEquals(3, count());
+
+		var s = prepare(db, @:privateAccess "SELECT i FROM t1 ORDER BY i".bytes);
+		var total = 0;
+		while( step(s) )
+			total += getInt(s, 0);
+		assertEquals(3, total);
+		finalize(s);
+	}
+
+	public function testSchemaChange( ) : Void
+	{
+		cnx.request('INSERT INTO t1 VALUES(1, "a")');
+		var sql = @:privateAccess "SELECT * FROM t1".bytes;
+		var s = prepare(db, sql);
+		assertTrue(step(s));
+		assertEquals(2, nfields(s));
+		finalize(s);
+
+		// the cached statement is recompiled with the new column
+		cnx.request('ALTER TABLE t1 ADD COLUMN n int DEFAULT 7');
+		var s = prepare(db, sql);
+		assertTrue(step(s));
+		assertEquals(3, nfields(s));
+		assertEquals(7, getInt(s, 2));
+		finalize(s);
+	}
+
+	public function testSameSql( ) : Void
+	{
+		// both statements go back to the cache : the second one replaces the first
+		var sql = @:privateAccess "SELECT COUNT(*) FROM t1".bytes;
+		var a = prepare(db, sql), b = prepare(db, sql);
+		assertTrue(step(a));
+		assertTrue(step(b));
+		finalize(a);
+		finalize(b);
+		for( i in 0...3 ) {
+			var s = prepare(db, sql);
+			assertTrue(step(s));
+			assertEquals(0, getInt(s, 0));
+			finalize(s);
+		}
+	}
+
+	public function testBatch( ) : Void
+	{
+		var s = prepare(db, @:privateAccess "INSERT INTO t1 VALUES(?, ?)".bytes);
+		var types = haxe.io.Bytes.alloc(2 * 4);
+		types.setInt32(0, 0);
+		types.setInt32(4, 3);
+		var ints = haxe.io.Bytes.alloc(100 * 4), texts = haxe.io.Bytes.alloc(100 * 8);
+		var arena = haxe.io.Bytes.ofString("row");
+		for( i in 0...100 ) {
+			ints.setInt32(i * 4, i);
+			texts.setInt32(i * 8 + 4, 3);
+		}
+		var columns = new hl.NativeArray<hl.Bytes>(2);
+		columns[0] = ints;
+		columns[1] = texts;
+		assertEquals(100, executeBatch(s, 100, types, columns, null, arena));
+		assertEquals(100, count());
+
+		// duplicate key : the whole batch is rolled back
+		ints.setInt32(0, 1000);
+		var failed = false;
+		try executeBatch(s, 2, types, columns, null, arena) catch( e : Dynamic ) failed = true;
+		assertTrue(failed);
+		assertEquals(100, count());
+		finalize(s);
+	}
+}
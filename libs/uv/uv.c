@@ -158,6 +158,41 @@ DEFINE_PRIM(_BOOL, stream_listen, _HANDLE _I32 _CALLB);
 
 // TCP
 
+static void on_send_file( uv_fs_t *req ) {
+	vdynamic i;
+	vdynamic *args = &i;
+	i.t = &hlt_i32;
+	i.v.i = (int)req->result;
+	uv_fs_req_cleanup(req);
+	trigger_callb((uv_handle_t*)req,EVT_FS,&args,1,false);
+	on_close((uv_handle_t*)req);
+}
+
+/*
+	Send a file range to the stream with sendfile, without copying it through
+	user space. The callback receives the number of bytes sent, which can be less
+	than len, or a negative error code (UV_EAGAIN : retry when writable).
+*/
+HL_PRIM bool HL_NAME(stream_send_file)( uv_stream_t *s, int fd, int64 offset, int len, vclosure *c ) {
+#	ifdef _WIN32
+	return false;
+#	else
+	uv_os_fd_t out;
+	uv_fs_t *req;
+	if( !s || uv_fileno((uv_handle_t*)s,&out) < 0 ) return false;
+	req = UV_ALLOC(uv_fs_t);
+	init_hl_data((uv_handle_t*)req);
+	register_callb((uv_handle_t*)req,c,EVT_FS);
+	if( uv_fs_sendfile(s->loop,req,out,fd,offset,len,on_send_file) < 0 ) {
+		on_close((uv_handle_t*)req);
+		return false;
+	}
+	return true;
+#	endif
+}
+
+DEFINE_PRIM(_BOOL, stream_send_file, _HANDLE _I32 _I64 _I32 _FUN(_VOID,_I32));
+
 #define _TCP _HANDLE
 
 HL_PRIM uv_tcp_t *HL_NAME(tcp_init_wrap)( uv_loop_t *loop ) {
@@ -0,0 +1,145 @@
+typedef Ring = hl.Abstract<"hl_aio">;
+typedef SocketHandle = hl.Abstract<"hl_socket">;
+
+class AsyncIO {
+
+	@:hlNative("std","aio_alloc") static function alloc( entries : Int ) : Ring { return null; }
+	@:hlNative("std","aio_is_uring") static function isUring( a : Ring ) : Bool { return false; }
+	@:hlNative("std","aio_read") static function read( a : Ring, fd : Int, buf : hl.Bytes, pos : Int, len : Int, offset : haxe.Int64, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_write") static function write( a : Ring, fd : Int, buf : hl.Bytes, pos : Int, len : Int, offset : haxe.Int64, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_fsync") static function fsync( a : Ring, fd : Int, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_open") static function open( a : Ring, path : hl.Bytes, mode : Int, perms : Int, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_close") static function close( a : Ring, fd : Int, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_recv") static function recv( a : Ring, fd : Int, buf : hl.Bytes, pos : Int, len : Int, tag : Int ) : Bool { return false; }
+	@:hlNative("std","aio_submit") static function submit( a : Ring ) : Int { return 0; }
+	@:hlNative("std","aio_wait") static function wait( a : Ring, tags : hl.Bytes, results : hl.Bytes, max : Int, minCount : Int, timeout : Float ) : Int { return 0; }
+	@:hlNative("std","aio_pending") static function pending( a : Ring ) : Int { return 0; }
+	@:hlNative("std","aio_free") static function free( a : Ring ) : Void {}
+	@:hlNative("std","socket_fd") static function socketFd( s : SocketHandle ) : Int { return 0; }
+
+	static var tags = new hl.Bytes(64 * 4);
+	static var results = new hl.Bytes(64 * 4);
+
+	// submits what was queued and waits for a single completion with the given tag
+	static function one( a : Ring, tag : Int ) : Int {
+		if( submit(a) < 0 ) throw "Submit failed";
+		if( wait(a, tags, results, 1, 1, 5.) != 1 ) throw "Timeout waiting for " + tag;
+		if( tags.getI32(0) != tag ) throw "Invalid tag " + tags.getI32(0) + " should be " + tag;
+		return results.getI32(0);
+	}
+
+	static function checkRoundTrip( file : String ) {
+		var a = alloc(32);
+		var path = @:privateAccess file.toUtf8();
+		open(a, path, 1, 420, 1);
+		var fd = one(a, 1);
+		if( fd < 0 ) throw "Open failed : " + fd;
+		var data = new hl.Bytes(65536);
+		for( i in 0...65536 ) data[i] = i * 7;
+		for( i in 0...16 )
+			if( !write(a, fd, data, i * 4096, 4096, i * 4096, 10 + i) ) throw "Queue full";
+		if( pending(a) != 16 ) throw "Pending " + pending(a);
+		submit(a);
+		var count = 0, total = 0;
+		while( count < 16 ) {
+			var n = wait(a, tags, results, 64, 1, 5.);
+			if( n <= 0 ) throw "Timeout with " + count + " writes";
+			for( k in 0...n ) {
+				var r = results.getI32(k << 2);
+				if( r != 4096 ) throw "Write failed : " + r;
+				total += r;
+			}
+			count += n;
+		}
+		if( total != 65536 ) throw "Wrote " + total;
+		fsync(a, fd, 2);
+		if( one(a, 2) != 0 ) throw "Fsync failed";
+		close(a, fd, 3);
+		one(a, 3);
+
+		open(a, path, 0, 0, 4);
+		fd = one(a, 4);
+		var back = new hl.Bytes(65536);
+		read(a, fd, back, 0, 65536, 0, 5);
+		if( one(a, 5) != 65536 ) throw "Short read";
+		if( back.compare(0, data, 0, 65536) != 0 ) throw "Data mismatch";
+		close(a, fd, 6);
+		one(a, 6);
+		if( pending(a) != 0 ) throw "Pending " + pending(a);
+
+		// a freed ring refuses any further use, and can be freed again
+		free(a);
+		free(a);
+		if( write(a, 0, data, 0, 1, 0, 7) ) throw "Queued on a freed ring";
+		if( submit(a) != -1 ) throw "Submitted on a freed ring";
+		if( wait(a, tags, results, 1, 1, 0.) != -1 ) throw "Waited on a freed ring";
+		sys.FileSystem.deleteFile(file);
+	}
+
+	// rings that are never freed must release their worker threads when collected :
+	// without it every ring leaks its workers
+	static function checkCollect() {
+		for( i in 0...1000 ) {
+			alloc(8);
+			if( i % 100 == 0 ) hl.Gc.major();
+		}
+		hl.Gc.major();
+	}
+
+	// a ring freed with a pending receive must not write into its buffer afterwards
+	static function checkFreePending() {
+		var port = 6110;
+		var server = new sys.net.Socket();
+		server.bind(new sys.net.Host("127.0.0.1"), port);
+		server.listen(1);
+		var c = new sys.net.Socket();
+		c.connect(new sys.net.Host("127.0.0.1"), port);
+		var s = server.accept();
+		var fd = socketFd(@:privateAccess s.__s);
+
+		var a = alloc(8);
+		var buf = new hl.Bytes(64);
+		buf.fill(0, 64, 0);
+		recv(a, fd, buf, 0, 64, 1);
+		if( submit(a) != 1 || pending(a) != 1 ) throw "Receive not submitted";
+		// the worker threads finish their running operation : give them some data later
+		var sent = false;
+		sys.thread.Thread.create(function() {
+			Sys.sleep(0.2);
+			c.output.writeString("hello");
+			sent = true;
+		});
+		free(a);
+		var copy = buf.sub(0, 64);
+		while( !sent ) Sys.sleep(0.01);
+		Sys.sleep(0.2);
+		if( buf.compare(0, copy, 0, 64) != 0 ) throw "Buffer written after free";
+		if( isUring(alloc(1)) ) {
+			// the receive was canceled : the data is still in the socket
+			if( copy[0] != 0 ) throw "Receive completed after cancel";
+			if( s.input.readString(5) != "hello" ) throw "Data lost";
+		}
+
+		// same thing when the rings are collected with a pending receive
+		for( i in 0...50 ) {
+			var a = alloc(8);
+			recv(a, fd, new hl.Bytes(64), 0, 64, 1);
+			submit(a);
+		}
+		hl.Gc.major();
+		for( i in 0...50 ) c.output.writeByte(i);
+		for( i in 0...1000 ) new hl.Bytes(65536).fill(0, 65536, 0xFF);
+		hl.Gc.major();
+		s.close();
+		c.close();
+		server.close();
+	}
+
+	public static function main() {
+		checkRoundTrip("aio_test.bin");
+		checkCollect();
+		checkFreePending();
+		Sys.println("AsyncIO OK (" + (isUring(alloc(1)) ? "io_uring" : "threads") + ")");
+	}
+
+}
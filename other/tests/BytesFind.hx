@@ -0,0 +1,105 @@
+class BytesFind {
+
+	@:hlNative("std","bytes_find") static function find( where : hl.Bytes, pos : Int, len : Int, which : hl.Bytes, wpos : Int, wlen : Int ) : Int {
+		return 0;
+	}
+
+	@:hlNative("std","bytes_rfind") static function rfind( where : hl.Bytes, len : Int, which : hl.Bytes, wlen : Int ) : Int {
+		return 0;
+	}
+
+	@:hlNative("std","bytes_find16") static function find16( where : hl.Bytes, pos : Int, len : Int, which : hl.Bytes, wpos : Int, wlen : Int ) : Int {
+		return 0;
+	}
+
+	@:hlNative("std","bytes_compare16") static function compare16( a : hl.Bytes, b : hl.Bytes, len : Int ) : Int {
+		return 0;
+	}
+
+	static inline function hb( b : haxe.io.Bytes ) : hl.Bytes {
+		return @:privateAccess b.b;
+	}
+
+	static function naiveFind( s : haxe.io.Bytes, w : haxe.io.Bytes ) {
+		for( i in 0...s.length - w.length + 1 ) {
+			var ok = true;
+			for( k in 0...w.length )
+				if( s.get(i + k) != w.get(k) ) {
+					ok = false;
+					break;
+				}
+			if( ok ) return i;
+		}
+		return -1;
+	}
+
+	static function check() {
+		var rnd = 1;
+		for( n in 0...2000 ) {
+			rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+			var s = haxe.io.Bytes.alloc(rnd % 300);
+			for( i in 0...s.length ) s.set(i, 97 + ((rnd >> (i & 15)) + i * 7) % (1 + n % 3));
+			var w = haxe.io.Bytes.alloc(1 + (rnd >> 8) % 40);
+			for( i in 0...w.length ) w.set(i, 97 + ((rnd >> (i & 7)) + i) % (1 + n % 3));
+			var r = find(hb(s), 0, s.length, hb(w), 0, w.length);
+			if( r != naiveFind(s, w) ) throw "Invalid find result " + r + " for " + w.toString() + " in " + s.toString();
+			if( r >= 0 && rfind(hb(s), s.length, hb(w), w.length) < r ) throw "Invalid rfind result";
+		}
+	}
+
+	static function bench( name : String, data : haxe.io.Bytes, needle : String, count : Int ) {
+		var w = haxe.io.Bytes.ofString(needle);
+		var t0 = Sys.time();
+		var found = 0;
+		for( i in 0...count ) {
+			var pos = 0;
+			while( true ) {
+				var r = find(hb(data), pos, data.length - pos, hb(w), 0, w.length);
+				if( r < 0 ) break;
+				found++;
+				pos = r + 1;
+			}
+		}
+		var t = Sys.time() - t0;
+		Sys.println(name + " '" + needle + "' " + Std.int(data.length * count / (t * 1e6)) + " MB/s (" + Std.int(found / count) + " matches)");
+	}
+
+	public static function main() {
+		check();
+
+		var words = ["GET ", "/api/v1/", "user=", "status=200 ", "latency=12ms ", "INFO ", "WARN ", "\n"];
+		var b = new haxe.io.BytesBuffer();
+		var rnd = 7;
+		while( b.length < 16 << 20 ) {
+			rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+			b.addString(words[(rnd >> 8) % words.length]);
+			if( rnd % 5000 == 0 ) b.addString("ERROR connection reset by peer while reading response header from upstream\n");
+		}
+		var data = b.getBytes();
+		for( n in ["E", "WARN", "status=500", "connection reset by peer", "ERROR connection reset by peer while reading response header from upstream"] )
+			bench("bytes", data, n, 5);
+
+		var str = data.getString(0, 1 << 20);
+		var u = @:privateAccess str.bytes;
+		var t0 = Sys.time();
+		var found = 0;
+		var needle = "connection reset";
+		for( i in 0...20 ) {
+			var pos = 0;
+			while( true ) {
+				var r = find16(u, pos, str.length - pos, @:privateAccess needle.bytes, 0, needle.length);
+				if( r < 0 ) break;
+				found++;
+				pos = r + 1;
+			}
+		}
+		Sys.println("utf16 '" + needle + "' " + Std.int(str.length * 2 * 20 / ((Sys.time() - t0) * 1e6)) + " MB/s (" + Std.int(found / 20) + " matches)");
+
+		var copy = @:privateAccess str.bytes.sub(0, str.length << 1);
+		t0 = Sys.time();
+		for( i in 0...50 )
+			if( compare16(u, copy, str.length) != 0 ) throw "compare16 failed";
+		Sys.println("compare16 " + Std.int(str.length * 2 * 50 / ((Sys.time() - t0) * 1e6)) + " MB/s");
+	}
+
+}
@@ -0,0 +1,134 @@
+typedef Zip = hl.Abstract<"fmt_zip">;
+typedef Codec = hl.Abstract<"fmt_codec">;
+
+class Codecs {
+
+	@:hlNative("fmt","deflate_init") static function deflateInit( level : Int ) : Zip { return null; }
+	@:hlNative("fmt","inflate_init") static function inflateInit( wbits : Int ) : Zip { return null; }
+	@:hlNative("fmt","zip_flush_mode") static function zipFlushMode( z : Zip, mode : Int ) : Void {}
+	@:hlNative("fmt","zip_end") static function zipEnd( z : Zip ) : Void {}
+	@:hlNative("fmt","deflate_buffer") static function deflateBuffer( z : Zip, src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, read : hl.Ref<Int>, write : hl.Ref<Int> ) : Bool { return false; }
+	@:hlNative("fmt","inflate_buffer") static function inflateBuffer( z : Zip, src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, read : hl.Ref<Int>, write : hl.Ref<Int> ) : Bool { return false; }
+
+	@:hlNative("fmt","codec_supported") static function supported( codec : Int ) : Bool { return false; }
+	@:hlNative("fmt","zstd_compress_init") static function zstdCompressInit( level : Int ) : Codec { return null; }
+	@:hlNative("fmt","zstd_decompress_init") static function zstdDecompressInit() : Codec { return null; }
+	@:hlNative("fmt","lz4_compress_init") static function lz4CompressInit( level : Int ) : Codec { return null; }
+	@:hlNative("fmt","lz4_decompress_init") static function lz4DecompressInit() : Codec { return null; }
+	@:hlNative("fmt","codec_flush_mode") static function codecFlushMode( c : Codec, mode : Int ) : Void {}
+	@:hlNative("fmt","codec_end") static function codecEnd( c : Codec ) : Void {}
+	@:hlNative("fmt","codec_buffer") static function codecBuffer( c : Codec, src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, read : hl.Ref<Int>, write : hl.Ref<Int> ) : Bool { return false; }
+	@:hlNative("fmt","lz4_compress") static function lz4Compress( src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, level : Int ) : Int { return 0; }
+	@:hlNative("fmt","lz4_decompress") static function lz4Decompress( src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int ) : Int { return 0; }
+	@:hlNative("fmt","lz4_compress_bound") static function lz4CompressBound( size : Int ) : Int { return 0; }
+
+	static inline function hb( b : haxe.io.Bytes ) : hl.Bytes {
+		return @:privateAccess b.b;
+	}
+
+	// streams src through a zip or codec handle with 64KB chunks on both sides
+	static function pump( buffer : (src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, read : hl.Ref<Int>, write : hl.Ref<Int>) -> Bool, src : haxe.io.Bytes, len : Int, dst : haxe.io.Bytes ) {
+		var spos = 0, dpos = 0;
+		while( true ) {
+			var read = 0, write = 0;
+			var slen = len - spos < 65536 ? len - spos : 65536;
+			var dlen = dst.length - dpos < 65536 ? dst.length - dpos : 65536;
+			var done = buffer(hb(src), spos, spos + slen, hb(dst), dpos, dpos + dlen, read, write);
+			spos += read;
+			dpos += write;
+			if( done ) break;
+			if( read == 0 && write == 0 ) throw "Stream is stuck";
+		}
+		return dpos;
+	}
+
+	static function payload( kind : Int, size : Int ) {
+		var b = new haxe.io.BytesBuffer();
+		var rnd = 5;
+		while( b.length < size ) {
+			rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+			switch( kind ) {
+			case 0:
+				b.addString('{"id":${rnd % 100000},"name":"user${rnd % 977}","active":${rnd % 3 == 0},"score":${(rnd >> 4) % 1000 / 10}},\n');
+			case 1:
+				// mesh like data : slowly varying floats
+				b.addFloat(Math.sin(b.length * 0.001) * 100 + (rnd % 16) / 256);
+			default:
+				b.addByte(rnd >> 8);
+			}
+		}
+		return b.getBytes().sub(0, size);
+	}
+
+	static function report( name : String, payload : String, size : Int, csize : Int, tc : Float, td : Float ) {
+		Sys.println(StringTools.rpad(name, " ", 8) + StringTools.rpad(payload, " ", 8)
+			+ " ratio " + Std.int(size * 1000.0 / csize) / 1000
+			+ " compress " + Std.int(size / (tc * 1e6)) + " MB/s"
+			+ " decompress " + Std.int(size / (td * 1e6)) + " MB/s");
+	}
+
+	static function check( src : haxe.io.Bytes, out : haxe.io.Bytes, len : Int, name : String ) {
+		if( len != src.length || out.sub(0, len).compare(src) != 0 )
+			throw name + " roundtrip failed";
+	}
+
+	public static function main() {
+		var names = ["json", "floats", "random"];
+		for( kind in 0...names.length ) {
+			var src = payload(kind, 4 << 20);
+			var tmp = haxe.io.Bytes.alloc(src.length + (src.length >> 3) + 1024);
+			var out = haxe.io.Bytes.alloc(src.length);
+
+			var t0 = Sys.time();
+			var z = deflateInit(6);
+			zipFlushMode(z, 3);
+			var clen = pump(deflateBuffer.bind(z), src, src.length, tmp);
+			zipEnd(z);
+			var t1 = Sys.time();
+			z = inflateInit(15);
+			var dlen = pump(inflateBuffer.bind(z), tmp, clen, out);
+			zipEnd(z);
+			check(src, out, dlen, "deflate");
+			report("deflate", names[kind], src.length, clen, t1 - t0, Sys.time() - t1);
+
+			if( supported(0) ) {
+				for( level in [1, 3, 9] ) {
+					t0 = Sys.time();
+					var c = zstdCompressInit(level);
+					codecFlushMode(c, 3);
+					clen = pump(codecBuffer.bind(c), src, src.length, tmp);
+					codecEnd(c);
+					t1 = Sys.time();
+					c = zstdDecompressInit();
+					dlen = pump(codecBuffer.bind(c), tmp, clen, out);
+					codecEnd(c);
+					check(src, out, dlen, "zstd");
+					report("zstd" + level, names[kind], src.length, clen, t1 - t0, Sys.time() - t1);
+				}
+			}
+
+			if( supported(1) ) {
+				t0 = Sys.time();
+				var c = lz4CompressInit(0);
+				codecFlushMode(c, 3);
+				clen = pump(codecBuffer.bind(c), src, src.length, tmp);
+				codecEnd(c);
+				t1 = Sys.time();
+				c = lz4DecompressInit();
+				dlen = pump(codecBuffer.bind(c), tmp, clen, out);
+				codecEnd(c);
+				check(src, out, dlen, "lz4 frame");
+				report("lz4", names[kind], src.length, clen, t1 - t0, Sys.time() - t1);
+
+				var block = haxe.io.Bytes.alloc(lz4CompressBound(src.length));
+				t0 = Sys.time();
+				clen = lz4Compress(hb(src), 0, src.length, hb(block), 0, block.length, 0);
+				t1 = Sys.time();
+				dlen = lz4Decompress(hb(block), 0, clen, hb(out), 0, out.length);
+				check(src, out, dlen, "lz4 block");
+				report("lz4blk", names[kind], src.length, clen, t1 - t0, Sys.time() - t1);
+			}
+		}
+	}
+
+}
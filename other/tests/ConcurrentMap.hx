@@ -0,0 +1,61 @@
+typedef IntCMap = hl.Abstract<"hl_int_cmap">;
+
+class ConcurrentMap {
+
+	static var WAIT = [];
+	static var OPS = 1000000;
+	static var KEYS = 50000;
+
+	@:hlNative("std","thread_create") static function thread_create( f : Void -> Void ) : hl.Abstract<"hl_thread"> {
+		return null;
+	}
+
+	@:hlNative("std","chialloc") static function chialloc() : IntCMap {
+		return null;
+	}
+
+	@:hlNative("std","chiset") static function chiset( m : IntCMap, k : Int, v : Dynamic ) : Void {
+	}
+
+	@:hlNative("std","chiget") static function chiget( m : IntCMap, k : Int ) : Dynamic {
+		return null;
+	}
+
+	@:hlNative("std","chisize") static function chisize( m : IntCMap ) : Int {
+		return 0;
+	}
+
+	static function run( m : IntCMap, i : Int, k : Int ) {
+		for( n in 0...Math.ceil(OPS/k) ) {
+			var key = (n * 7919 + i) % KEYS;
+			// 90% reads, 10% writes
+			if( n % 10 == 0 )
+				chiset(m, key, key);
+			else {
+				var v : Null<Int> = chiget(m, key);
+				if( v != null && v != key ) throw "Invalid value for key " + key;
+			}
+		}
+		WAIT[i] = false;
+	}
+
+	public static function main() {
+		var m = chialloc();
+		for( COUNT in [1,2,4,8,16,32] ) {
+			for( i in 0...COUNT )
+				WAIT[i] = true;
+			var t0 = Sys.time();
+			for( i in 0...COUNT )
+				thread_create(run.bind(m,i,COUNT));
+			var i = 0;
+			while( i < COUNT ) {
+				if( WAIT[i] ) {
+					i = 0;
+					Sys.sleep(0);
+				} else i++;
+			}
+			trace(COUNT+" threads "+(Sys.time() - t0)+" ("+chisize(m)+" keys)");
+		}
+	}
+
+}
@@ -0,0 +1,116 @@
+typedef Hash = hl.Abstract<"fmt_hash">;
+
+class Digests {
+
+	static inline var SHA1 = 1;
+	static inline var CRC32 = 2;
+	static inline var ADLER32 = 3;
+	static inline var SHA256 = 4;
+	static inline var CRC32C = 5;
+	static inline var XXH64 = 6;
+	static inline var ALL_CPU = 7;
+
+	@:hlNative("fmt","digest") static function digest( out : hl.Bytes, bytes : hl.Bytes, size : Int, format : Int ) : Void {}
+	@:hlNative("fmt","digest_init") static function init( format : Int ) : Hash { return null; }
+	@:hlNative("fmt","digest_update") static function update( h : Hash, bytes : hl.Bytes, pos : Int, size : Int ) : Void {}
+	@:hlNative("fmt","digest_final") static function finish( h : Hash, out : hl.Bytes ) : Int { return 0; }
+	@:hlNative("fmt","digest_disable_cpu") static function disableCpu( caps : Int ) : Int { return 0; }
+
+	// checksums and xxh64 are native integers, the hashes are bytes
+	static function hex( out : hl.Bytes, format : Int ) {
+		return switch( format ) {
+		case CRC32, ADLER32, CRC32C: StringTools.hex(out.getI32(0), 8);
+		case XXH64: StringTools.hex(out.getI32(4), 8) + StringTools.hex(out.getI32(0), 8);
+		case SHA1: out.toBytes(20).toHex().toUpperCase();
+		default: out.toBytes(32).toHex().toUpperCase();
+		}
+	}
+
+	static function generate( size : Int ) {
+		var b = new hl.Bytes(size);
+		for( i in 0...size )
+			b[i] = i * 167 + (i >> 11);
+		return b;
+	}
+
+	static function text( s : String ) {
+		var b = haxe.io.Bytes.ofString(s);
+		return { bytes : @:privateAccess b.b, size : b.length };
+	}
+
+	static var VECTORS : Array<{ name : String, data : { bytes : hl.Bytes, size : Int }, expected : Map<Int,String> }>;
+
+	static function check( name : String ) {
+		var out = new hl.Bytes(32);
+		for( v in VECTORS )
+			for( format => expected in v.expected ) {
+				// one shot, checksums start from the value in out
+				out.setI32(0, format == ADLER32 ? 1 : 0);
+				digest(out, v.data.bytes, v.data.size, format);
+				if( hex(out, format) != expected ) throw name + " : format " + format + " of " + v.name + " is " + hex(out, format) + " instead of " + expected;
+				// incremental, with chunks that don't align with the blocks
+				var h = init(format);
+				var pos = 0, chunk = 1;
+				while( pos < v.data.size ) {
+					var len = v.data.size - pos < chunk ? v.data.size - pos : chunk;
+					update(h, v.data.bytes, pos, len);
+					pos += len;
+					chunk = chunk * 3 + 5;
+				}
+				finish(h, out);
+				if( hex(out, format) != expected ) throw name + " : incremental format " + format + " of " + v.name + " is " + hex(out, format);
+			}
+	}
+
+	public static function main() {
+		VECTORS = [
+			{ name : "empty", data : text(""), expected : [
+				SHA1 => "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709",
+				CRC32 => "00000000",
+				ADLER32 => "00000001",
+				SHA256 => "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855",
+				CRC32C => "00000000",
+				XXH64 => "EF46DB3751D8E999",
+			] },
+			{ name : "abc", data : text("abc"), expected : [
+				SHA1 => "A9993E364706816ABA3E25717850C26C9CD0D89D",
+				CRC32 => "352441C2",
+				ADLER32 => "024D0127",
+				SHA256 => "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD",
+				CRC32C => "364B3FB7",
+				XXH64 => "44BC2CF5AD770999",
+			] },
+			{ name : "fox", data : text("The quick brown fox jumps over the lazy dog"), expected : [
+				SHA1 => "2FD4E1C67A2D28FCED849EE1BB76E7391B93EB12",
+				CRC32 => "414FA339",
+				ADLER32 => "5BDC0FDA",
+				SHA256 => "D7A8FBB307D7809469CA9ABCB0082E4F8D5651E46D3CDB762D02D0BF37C9E592",
+				CRC32C => "22620404",
+				XXH64 => "0B242D361FDA71BC",
+			] },
+			{ name : "1000 bytes", data : { bytes : generate(1000), size : 1000 }, expected : [
+				SHA1 => "09B80732A3FA14159F18102E10F8E82DA11220B1",
+				CRC32 => "909B1A7A",
+				ADLER32 => "0278F1C4",
+				SHA256 => "005B09AEEA716DD9B9C57C384AF35CD3DE9095FA238224FF03C7A085DCCFB978",
+				CRC32C => "C9032B7F",
+				XXH64 => "8E41989B9BAE6395",
+			] },
+			{ name : "3MB", data : { bytes : generate((3 << 20) + 17), size : (3 << 20) + 17 }, expected : [
+				SHA1 => "F8D8451BECBD9837DB3DF79F8D2A26FFC81356DF",
+				CRC32 => "A220F652",
+				ADLER32 => "38546F60",
+				SHA256 => "B19D6A1BA1E3F5FE412143850CDDA41CA0F689BEA593FB3E7B885A1E609A9726",
+				CRC32C => "31037D13",
+				XXH64 => "738E376C6B436EC5",
+			] },
+		];
+		var caps = disableCpu(0);
+		check("accelerated (cpu " + caps + ")");
+		disableCpu(ALL_CPU);
+		check("portable");
+		disableCpu(0);
+		Sys.println("Digests OK");
+	}
+
+}
@@ -0,0 +1,179 @@
+class Dxt {
+
+	static inline var BC1 = 1;
+	static inline var BC3 = 3;
+	static inline var BC4 = 4;
+	static inline var BC5 = 5;
+	static inline var BC7 = 7;
+	static inline var THREADS = 256;
+
+	@:hlNative("fmt","dxt_decode") static function decode( data : hl.Bytes, out : hl.Bytes, width : Int, height : Int, format : Int ) : Bool { return false; }
+	@:hlNative("fmt","dxt_encode") static function encode( pixels : hl.Bytes, out : hl.Bytes, width : Int, height : Int, format : Int, quality : Int ) : Bool { return false; }
+
+	static function blockSize( format : Int ) {
+		return format == BC1 || format == BC4 ? 8 : 16;
+	}
+
+	static function rgba( r : Int, g : Int, b : Int, a : Int ) {
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	static function expand( v : Int, bits : Int ) {
+		return Math.round(v * 255 / ((1 << bits) - 1));
+	}
+
+	static function decodeBlock( block : hl.Bytes, format : Int ) {
+		var out = new hl.Bytes(16 * 4);
+		if( !decode(block, out, 4, 4, format) ) throw "Decode failed";
+		return out;
+	}
+
+	static function checkTexels( out : hl.Bytes, expected : Int -> Int, name : String ) {
+		for( k in 0...16 )
+			if( out.getI32(k * 4) != expected(k) )
+				throw name + " texel " + k + " is " + StringTools.hex(out.getI32(k * 4), 8) + " should be " + StringTools.hex(expected(k), 8);
+	}
+
+	// blocks built by hand from the format specifications
+	static function checkReference() {
+		// BC1 : 565 endpoints, 4 colors when c0 > c1, 3 colors and transparent black otherwise
+		var c0 = (20 << 11) | (40 << 5) | 10, c1 = (3 << 11) | (11 << 5) | 29;
+		var r0 = expand(20, 5), g0 = expand(40, 6), b0 = expand(10, 5);
+		var r1 = expand(3, 5), g1 = expand(11, 6), b1 = expand(29, 5);
+		var b = new hl.Bytes(8);
+		b.setUI16(0, c0);
+		b.setUI16(2, c1);
+		b.setI32(4, 0xE4E4E4E4); // texel k uses index k & 3
+		checkTexels(decodeBlock(b, BC1), function(k) return switch( k & 3 ) {
+			case 0: rgba(r0, g0, b0, 255);
+			case 1: rgba(r1, g1, b1, 255);
+			case 2: rgba(Std.int((2 * r0 + r1) / 3), Std.int((2 * g0 + g1) / 3), Std.int((2 * b0 + b1) / 3), 255);
+			default: rgba(Std.int((r0 + 2 * r1) / 3), Std.int((g0 + 2 * g1) / 3), Std.int((b0 + 2 * b1) / 3), 255);
+		}, "BC1");
+		b.setUI16(0, c1);
+		b.setUI16(2, c0);
+		checkTexels(decodeBlock(b, BC1), function(k) return switch( k & 3 ) {
+			case 0: rgba(r1, g1, b1, 255);
+			case 1: rgba(r0, g0, b0, 255);
+			case 2: rgba(Std.int((r0 + r1) / 2), Std.int((g0 + g1) / 2), Std.int((b0 + b1) / 2), 255);
+			default: 0;
+		}, "BC1 punch-through");
+
+		// BC4 : 8 values when r0 > r1, 3 bits index of texel k at bit 16 + 3k
+		var b = new hl.Bytes(8);
+		b[0] = 200;
+		b[1] = 100;
+		for( k in 0...16 ) {
+			var bit = 16 + k * 3;
+			for( i in 0...3 )
+				if( ((k >> i) & 1) != 0 ) b[(bit + i) >> 3] |= 1 << ((bit + i) & 7);
+		}
+		checkTexels(decodeBlock(b, BC4), function(k) {
+			var t = k & 7;
+			var v = t == 0 ? 200 : t == 1 ? 100 : Std.int(((8 - t) * 200 + (t - 1) * 100) / 7);
+			return rgba(v, 0, 0, 255);
+		}, "BC4");
+
+		// BC7 mode 6 : one subset of 7 bits RGBA endpoints with a pbit each, 4 bits indices
+		var b = new hl.Bytes(16);
+		b.fill(0, 16, 0);
+		var pos = 0;
+		function write( bits : Int, v : Int ) {
+			for( i in 0...bits )
+				if( ((v >> i) & 1) != 0 ) b[(pos + i) >> 3] |= 1 << ((pos + i) & 7);
+			pos += bits;
+		}
+		write(7, 1 << 6);
+		for( c in 0...4 ) {
+			write(7, [127, 100, 0, 64][c]);
+			write(7, [0, 27, 127, 64][c]);
+		}
+		write(1, 1);
+		write(1, 0);
+		write(3, 0); // anchor texel
+		for( k in 1...16 ) write(4, k);
+		var weights = [0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64];
+		var e0 = [for( v in [127, 100, 0, 64] ) (v << 1) | 1], e1 = [for( v in [0, 27, 127, 64] ) v << 1];
+		checkTexels(decodeBlock(b, BC7), function(k) {
+			var w = weights[k];
+			var c = [for( i in 0...4 ) ((64 - w) * e0[i] + w * e1[i] + 32) >> 6];
+			return rgba(c[0], c[1], c[2], c[3]);
+		}, "BC7");
+	}
+
+	static function psnr( a : hl.Bytes, b : hl.Bytes, count : Int, channels : Int ) {
+		var se = 0.;
+		for( i in 0...count )
+			for( c in 0...channels ) {
+				var d = a[i * 4 + c] - b[i * 4 + c];
+				se += d * d;
+			}
+		return se == 0 ? 100. : 10 * Math.log(255 * 255 * count * channels / se) / Math.log(10);
+	}
+
+	static function checkRoundTrip() {
+		// partial blocks on both edges
+		var w = 203, h = 131;
+		var src = new hl.Bytes(w * h * 4);
+		for( y in 0...h )
+			for( x in 0...w )
+				src.setI32((y * w + x) * 4, rgba(Std.int(128 + 100 * Math.sin(x * 0.05) * Math.cos(y * 0.07)), Std.int(x * 255 / w), Std.int(128 + 120 * Math.sin((x + y) * 0.1)), Std.int(y * 255 / h)));
+		var opaque = src.sub(0, w * h * 4);
+		for( i in 0...w * h ) opaque[i * 4 + 3] = 255;
+		var size = ((w + 3) >> 2) * ((h + 3) >> 2);
+		// minimum PSNR and checked channels for each format
+		for( f in [[BC1, 34, 3], [BC3, 35, 4], [BC4, 48, 1], [BC5, 50, 2], [BC7, 40, 4]] ) {
+			var format = f[0];
+			var pixels = format == BC1 ? opaque : src;
+			var last = 0.;
+			for( quality in 0...3 ) {
+				var len = size * blockSize(format);
+				var single = new hl.Bytes(len), threaded = new hl.Bytes(len);
+				if( !encode(pixels, single, w, h, format, quality) || !encode(pixels, threaded, w, h, format | THREADS, quality) ) throw "Encode failed";
+				if( single.compare(0, threaded, 0, len) != 0 ) throw "Threaded encoding mismatch for format " + format + " quality " + quality;
+				var out = new hl.Bytes(w * h * 4), out2 = new hl.Bytes(w * h * 4);
+				decode(single, out, w, h, format);
+				decode(single, out2, w, h, format | THREADS);
+				if( out.compare(0, out2, 0, w * h * 4) != 0 ) throw "Threaded decoding mismatch for format " + format;
+				var p = psnr(out, pixels, w * h, f[2]);
+				if( p < f[1] ) throw "Format " + format + " quality " + quality + " PSNR " + p;
+				if( p < last - 0.01 ) throw "Format " + format + " quality " + quality + " is worse than the lower quality";
+				last = p;
+			}
+		}
+	}
+
+	// cases with an exact encoding
+	static function checkExact() {
+		var w = 8, h = 8;
+		var src = new hl.Bytes(w * h * 4), out = new hl.Bytes(w * h * 4), blocks = new hl.Bytes(4 * 16);
+		// flat colors : BC7 mode 6 endpoints share their pbit, so the channels must have the same parity
+		for( color in [0, rgba(2, 4, 6, 8), rgba(255, 129, 77, 201), -1] ) {
+			for( i in 0...w * h ) src.setI32(i * 4, color);
+			for( format in [BC4, BC5, BC7] ) {
+				encode(src, blocks, w, h, format, 2);
+				decode(blocks, out, w, h, format);
+				var mask = format == BC4 ? 0xFF : format == BC5 ? 0xFFFF : -1;
+				var extra = format == BC7 ? 0 : 0xFF000000;
+				for( i in 0...w * h )
+					if( out.getI32(i * 4) != ((color & mask) | extra) ) throw "Flat color " + StringTools.hex(color, 8) + " changed with format " + format;
+			}
+		}
+		// BC1 keeps transparent texels transparent and the others opaque
+		for( i in 0...w * h ) src.setI32(i * 4, rgba(i * 4, 255 - i * 4, 100, (i * 37) & 0xFF));
+		encode(src, blocks, w, h, BC1, 2);
+		decode(blocks, out, w, h, BC1);
+		for( i in 0...w * h ) {
+			var a = out[i * 4 + 3];
+			if( src[i * 4 + 3] < 128 ? out.getI32(i * 4) != 0 : a != 255 ) throw "Invalid BC1 alpha at " + i;
+		}
+	}
+
+	public static function main() {
+		checkReference();
+		checkRoundTrip();
+		checkExact();
+		Sys.println("Dxt OK");
+	}
+
+}
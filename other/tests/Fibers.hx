@@ -0,0 +1,97 @@
+typedef Fiber = hl.Abstract<"hl_fiber">;
+typedef FiberSched = hl.Abstract<"hl_fiber_sched">;
+
+class Fibers {
+
+	static var PAIRS = 200;
+	static var ITER = 200;
+
+	@:hlNative("std","thread_create") static function thread_create( f : Void -> Void ) : hl.Abstract<"hl_thread"> {
+		return null;
+	}
+
+	@:hlNative("std","fiber_create") static function create( f : Void -> Void, stackSize : Int ) : Fiber { return null; }
+	@:hlNative("std","fiber_resume") static function resume( f : Fiber ) : Bool { return false; }
+	@:hlNative("std","fiber_yield") static function yield() : Void {}
+	@:hlNative("std","fiber_current") static function current() : Fiber { return null; }
+	@:hlNative("std","fiber_is_done") static function isDone( f : Fiber ) : Bool { return false; }
+	@:hlNative("std","fiber_sched_alloc") static function schedAlloc( capacity : Int ) : FiberSched { return null; }
+	@:hlNative("std","fiber_spawn") static function spawn( s : FiberSched, f : Void -> Void, stackSize : Int ) : Fiber { return null; }
+	@:hlNative("std","fiber_suspend") static function suspend() : Void {}
+	@:hlNative("std","fiber_wake") static function wake( f : Fiber ) : Void {}
+	@:hlNative("std","fiber_sched_run") static function schedRun( s : FiberSched ) : Void {}
+
+	// an exception thrown after the fiber was moved to another thread reaches its new resumer
+	static function checkMigration() {
+		var f = create(function() {
+			yield();
+			throw "boom";
+		}, 0);
+		resume(f);
+		var result = null;
+		thread_create(function() {
+			try {
+				resume(f);
+				result = "no exception";
+			} catch( e : String ) {
+				result = e;
+			}
+		});
+		while( result == null ) Sys.sleep(0.001);
+		if( result != "boom" ) throw "Invalid exception : " + result;
+		if( !isDone(f) ) throw "Fiber should be done";
+	}
+
+	// wakes are sent twice, and to the running fiber itself before it yields or suspends :
+	// each fiber must only be queued once
+	static function checkScheduler() {
+		var s = schedAlloc(0);
+		var finished = 0;
+		var lock = new sys.thread.Mutex();
+		for( i in 0...PAIRS ) {
+			var done = false;
+			var sleeper = spawn(s, function() {
+				while( !done ) suspend();
+				lock.acquire();
+				finished++;
+				lock.release();
+			}, 0);
+			spawn(s, function() {
+				for( k in 0...ITER ) {
+					wake(sleeper);
+					wake(sleeper);
+					wake(current());
+					if( k & 1 == 0 ) yield() else suspend();
+				}
+				done = true;
+				wake(sleeper);
+				lock.acquire();
+				finished++;
+				lock.release();
+			}, 0);
+		}
+		for( i in 0...3 )
+			thread_create(schedRun.bind(s));
+		schedRun(s);
+		if( finished != PAIRS * 2 ) throw "Only " + finished + " fibers finished";
+	}
+
+	// abandoned suspended fibers are collected with their stacks : without it
+	// the process runs out of memory mappings
+	static function checkCollect() {
+		for( i in 0...100000 ) {
+			var f = create(yield, 0);
+			resume(f);
+			if( i % 5000 == 0 ) hl.Gc.major();
+		}
+		hl.Gc.major();
+	}
+
+	public static function main() {
+		checkMigration();
+		checkScheduler();
+		checkCollect();
+		Sys.println("Fibers OK");
+	}
+
+}
@@ -0,0 +1,55 @@
+typedef FileMapping = hl.Abstract<"hl_fmap">;
+
+class FileMap {
+
+	static inline var READ_ONLY = 0;
+	static inline var COPY_ON_WRITE = 1;
+
+	@:hlNative("std","file_map") static function map( name : hl.Bytes, mode : Int ) : FileMapping { return null; }
+	@:hlNative("std","file_map_bytes") static function mapBytes( m : FileMapping ) : hl.Bytes { return null; }
+	@:hlNative("std","file_map_size") static function mapSize( m : FileMapping ) : haxe.Int64 { return 0; }
+	@:hlNative("std","file_map_advise") static function advise( m : FileMapping, kind : Int, pos : haxe.Int64, len : haxe.Int64 ) : Bool { return false; }
+	@:hlNative("std","file_unmap") static function unmap( m : FileMapping ) : Void {}
+
+	static function path( file : String ) : hl.Bytes {
+		return @:privateAccess Sys.getPath(file);
+	}
+
+	public static function main() {
+		var file = "file_map_test.bin";
+		var size = 3 * 4096 + 123;
+		var data = haxe.io.Bytes.alloc(size);
+		for( i in 0...size ) data.set(i, i * 7 + (i >> 9));
+		sys.io.File.saveBytes(file, data);
+
+		// the mapping gives the file content
+		var m = map(path(file), READ_ONLY);
+		if( m == null ) throw "Map failed";
+		if( mapSize(m) != size ) throw "Invalid size " + mapSize(m);
+		var b = mapBytes(m);
+		if( b.compare(0, @:privateAccess data.b, 0, size) != 0 ) throw "Content mismatch";
+		// advices on unaligned ranges, the whole file, and out of range
+		if( !advise(m, 1, 5000, 3000) || !advise(m, 3, 0, 0) ) throw "Advise failed";
+		if( advise(m, 1, size - 10, 11) || advise(m, 1, -1, 1) ) throw "Advised out of range";
+		unmap(m);
+		unmap(m);
+		if( mapBytes(m) != null || mapSize(m) != 0 || advise(m, 1, 0, 0) ) throw "Used after unmap";
+
+		// copy on write changes stay private to the mapping
+		var m = map(path(file), COPY_ON_WRITE);
+		var b = mapBytes(m);
+		for( i in 0...size ) b[i] = 0xFF - b[i];
+		if( sys.io.File.getBytes(file).compare(data) != 0 ) throw "Private write reached the file";
+		unmap(m);
+
+		// empty and missing files
+		sys.io.File.saveBytes(file, haxe.io.Bytes.alloc(0));
+		var m = map(path(file), READ_ONLY);
+		if( m == null || mapSize(m) != 0 ) throw "Empty file map failed";
+		unmap(m);
+		sys.FileSystem.deleteFile(file);
+		if( map(path(file), READ_ONLY) != null ) throw "Mapped a missing file";
+		Sys.println("FileMap OK");
+	}
+
+}
@@ -0,0 +1,122 @@
+typedef Buffer = hl.Abstract<"hl_buffer">;
+
+class FlatBuffer {
+
+	static inline var UTF8 = 1;
+	static inline var MALLOC = 2;
+
+	@:hlNative("std","alloc_buffer_flat") static function alloc( size : Int, flags : Int ) : Buffer { return null; }
+	@:hlNative("std","buffer_str_sub") static function addSub( b : Buffer, s : hl.Bytes, len : Int ) : Void {}
+	@:hlNative("std","buffer_char") static function addChar( b : Buffer, c : Int ) : Void {}
+	@:hlNative("std","buffer_val") static function addValue( b : Buffer, v : Dynamic ) : Void {}
+	@:hlNative("std","buffer_utf8") static function addUtf8( b : Buffer, s : hl.Bytes, len : Int ) : Void {}
+	@:hlNative("std","buffer_length") static function length( b : Buffer ) : Int { return 0; }
+	@:hlNative("std","buffer_content") static function content( b : Buffer, len : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("std","buffer_bytes") static function bytes( b : Buffer, size : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("std","buffer_reset") static function reset( b : Buffer ) : Void {}
+
+	static function add( b : Buffer, s : String ) {
+		addSub(b, @:privateAccess s.bytes, s.length);
+	}
+
+	static function toString( b : Buffer ) {
+		var len = 0;
+		return @:privateAccess String.fromUCS2(content(b, len));
+	}
+
+	// the zero-copy view holds the exact UTF-8 encoding, NUL terminated
+	static function checkUtf8( b : Buffer, expected : String, name : String ) {
+		var size = 0;
+		var out = bytes(b, size);
+		var utf8 = haxe.io.Bytes.ofString(expected);
+		if( size != utf8.length || length(b) != utf8.length ) throw name + " : size " + size + " should be " + utf8.length;
+		if( out.compare(0, @:privateAccess utf8.b, 0, size) != 0 || out[size] != 0 ) throw name + " : invalid UTF-8 bytes";
+		if( toString(b) != expected ) throw name + " : invalid content " + toString(b);
+	}
+
+	static function checkMode( flags : Int ) {
+		var text = "ascii é 中文 \u{1F600} end";
+		var b = alloc(16, flags);
+		add(b, text);
+		if( toString(b) != text ) throw "Invalid content " + toString(b) + " with flags " + flags;
+		if( (flags & UTF8) != 0 ) checkUtf8(b, text, "mixed text");
+		else if( length(b) != text.length ) throw "Invalid UTF-16 length " + length(b);
+
+		// grows past its initial size, the view stays valid until the next write
+		reset(b);
+		if( length(b) != 0 || toString(b) != "" ) throw "Reset failed with flags " + flags;
+		var long = new StringBuf();
+		for( i in 0...5000 ) {
+			var s = i + (i % 7 == 0 ? "\u{1F600}" : "é");
+			add(b, s);
+			long.add(s);
+		}
+		if( toString(b) != long.toString() ) throw "Invalid grown content with flags " + flags;
+		var size = 0, size2 = 0;
+		var v1 = bytes(b, size);
+		var v2 = bytes(b, size2);
+		if( v1 != v2 || size != size2 ) throw "The view is not zero-copy with flags " + flags;
+
+		// raw UTF-8 is copied as-is, or decoded in UTF-16 mode
+		reset(b);
+		var utf8 = haxe.io.Bytes.ofString(text);
+		addUtf8(b, @:privateAccess utf8.b, utf8.length);
+		if( toString(b) != text ) throw "Invalid UTF-8 input with flags " + flags;
+
+		// any value formats like Std.string
+		reset(b);
+		var value : Dynamic = { a : [1, 2], b : "x\u{1F600}", c : 1.5 };
+		addValue(b, value);
+		if( toString(b) != Std.string(value) ) throw "Invalid value " + toString(b) + " with flags " + flags;
+	}
+
+	// a surrogate pair split between two writes is still encoded as one 4 bytes sequence
+	static function checkSplitPairs() {
+		var b = alloc(16, UTF8);
+		addChar(b, "a".code);
+		addChar(b, 0xD83D);
+		addChar(b, 0xDE00);
+		var pair = "\u{1F600}";
+		add(b, pair.substr(0, 1));
+		add(b, pair.substr(1, 1) + "b" + pair.substr(0, 1));
+		add(b, pair.substr(1, 1));
+		checkUtf8(b, "a" + pair + pair + "b" + pair, "split pairs");
+		// a pending high surrogate is dropped by reset
+		reset(b);
+		addChar(b, 0xD83D);
+		reset(b);
+		addChar(b, "a".code);
+		checkUtf8(b, "a", "reset with a pending surrogate");
+	}
+
+	static function residentMB() : Float {
+		if( !sys.FileSystem.exists("/proc/self/statm") ) return 0;
+		var pages = Std.parseInt(sys.io.File.getContent("/proc/self/statm").split(" ")[1]);
+		return pages * 4096 / (1024 * 1024);
+	}
+
+	// malloc buffers release their block when collected
+	static function checkFinalizer() {
+		hl.Gc.major();
+		var start = residentMB();
+		var chunk = "0123456789abcdef";
+		for( i in 0...500 ) {
+			var b = alloc(16, MALLOC | UTF8);
+			for( k in 0...(1 << 16) ) add(b, chunk);
+			if( length(b) != 1 << 20 ) throw "Invalid length " + length(b);
+			if( i % 10 == 0 ) hl.Gc.major();
+		}
+		hl.Gc.major();
+		var grow = residentMB() - start;
+		if( grow > 200 ) throw "Malloc buffers are not released : +" + Std.int(grow) + "MB";
+	}
+
+	public static function main() {
+		for( flags in [0, UTF8, MALLOC, MALLOC | UTF8] )
+			checkMode(flags);
+		checkSplitPairs();
+		checkFinalizer();
+		Sys.println("FlatBuffer OK");
+	}
+
+}
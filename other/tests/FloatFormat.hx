@@ -0,0 +1,324 @@
+class FloatFormat {
+
+	// doubles (high bits, low bits) with their expected Std.string output
+	static var FORMAT : Array<Dynamic> = [
+		[1069128089, -1717986918, "0.1"],
+		[1070176665, -1717986918, "0.2"],
+		[1070805811, 858993460, "0.3"],
+		[1070945621, 1431655765, "0.333333333333333"],
+		[1071994197, 1431655765, "0.666666666666667"],
+		[1124887541, 640942080, "1e+15"],
+		[1128383353, 937459712, "1e+16"],
+		[1124887541, 640942072, "999999999999999"],
+		[1128383353, 937459711, "1e+16"],
+		[1055193269, -1998362383, "1e-05"],
+		[1058682594, -350469331, "0.0001"],
+		[1059073181, -306433891, "0.0001234"],
+		[1132161460, -1167913163, "1.23456789012346e+17"],
+		[2146435071, -1, "1.79769313486232e+308"],
+		[1048576, 0, "2.2250738585072e-308"],
+		[0, 1, "4.94065645841247e-324"],
+		[1145772772, -689770672, "1e+21"],
+		[1149300943, 105764242, "1e+22"],
+		[1152724226, -941536522, "1e+23"],
+		[1128267776, 0, "9.00719925474099e+15"],
+		[1071644672, 0, "0.5"],
+		[1079574528, 0, "100"],
+		[1420970413, 630506365, "1e+100"],
+		[1079958831, 446676599, "123.456"],
+		[2118249261, 1711298613, "1.5e+300"],
+		[-2147483648, 0, "-0"],
+		[-1074266112, 0, "-1.5"],
+		[1074340347, 1413754136, "3.14159265358979"],
+		[1074118410, -1961601175, "2.71828182845905"],
+		[1079354490, -515396076, "86.57"],
+		[1079331717, 515396076, "85.18"],
+		[1075078758, 1717986918, "5.1"],
+		[994583790, -1217875525, "3.994334e-23"],
+		[-1297668904, 1573665239, "-1.09882360940634e-64"],
+		[1141267796, -781862760, "5.15692e+19"],
+		[1093153023, 773094113, "792703.59"],
+		[1074413115, 1017867538, "3.28038642309333"],
+		[1130693110, -1613054057, "4.73050661313569e+16"],
+		[989715844, -2032583024, "1.544e-24"],
+		[1032583353, 826029099, "3.18e-12"],
+		[1608066736, 1633781753, "5.26908601341532e+153"],
+		[2042402590, 627208201, "2.53404766814796e+278"],
+		[491761847, 1074604649, "1.67941768406237e-167"],
+		[1092794950, -1632087572, "613667.31"],
+		[-980843142, 503526740, "-9.87311132735849e+26"],
+		[1062576788, 337550070, "0.0013205"],
+		[1042992363, 1273507863, "3.11998479764891e-09"],
+		[1056096653, 2095064099, "1.78871776413161e-05"],
+		[1093442538, -1030792151, "937461.38"],
+		[1114037982, 1321794401, "785827132999.856"],
+		[1092152206, -1717986918, "408291.65"],
+		[-619574498, 630639128, "-5.00284680846657e+130"],
+		[1065215158, -1862991002, "0.00729819598137813"],
+		[-345986699, 129532949, "-1.71179842272066e+209"],
+		[1131632250, 1720123384, "8.70897322179951e+16"],
+		[1623001485, 948816622, "9.9667632682658e+157"],
+		[1093405135, -2147483648, "918759.75"],
+		[1010109137, 205664807, "1.14070278383554e-18"],
+		[1902979687, -1963083073, "2.3739858976164e+238"],
+		[1613458113, 624303563, "1.83800999795895e+155"],
+		[1092959352, -2061584302, "695868.26"],
+		[1073702436, 950528896, "1.9624368870852"],
+		[1005787654, 739855815, "6.4718930224569e-20"],
+		[-1295178295, 1984367243, "-5.53546121818803e-64"],
+		[1092037393, -1202590843, "379588.43"],
+		[1038245487, 532200114, "1.33651214974383e-10"],
+		[1288783016, -2017696178, "1.10995688077371e+62"],
+		[1092544831, -171798692, "506447.99"],
+		[-2041577571, 404342350, "-2.82048318642185e-278"],
+		[-1319714269, -1995663998, "-5.15230891910569e-71"],
+		[1152950765, 1243679183, "1.163238199e+23"],
+		[1756151383, -974155491, "1.67860011805765e+196"],
+		[1107453630, -1808341296, "9879147142.8627"],
+		[1073202163, -533263139, "1.48534"],
+		[-1246202570, -1779140681, "-6.5370116218082e-50"],
+		[1037112094, 1519919501, "6.2117330939184e-11"],
+		[-1813028785, -1431326222, "-1.16502068151759e-212"],
+		[1091652189, 1374389535, "283287.33"],
+		[1037229702, 1548146010, "6.86458867780089e-11"],
+		[204002291, 1576319089, "4.33465126783991e-250"],
+		[1098659083, 1073741824, "29577396"],
+		[1134832360, 951257616, "7.2661458e+17"],
+		[1091724663, -1717986918, "301405.9"],
+		[1032313882, -1948871397, "2.71254294415515e-12"],
+		[1022289841, -1311326897, "3.43115038111509e-15"],
+		[-337401881, 238675891, "-5.16962720962616e+211"],
+		[1040197387, 396912681, "4.701e-10"],
+		[1084919808, 0, "3400"],
+		[1163341446, 1263559248, "1.121e+26"],
+		[1029877904, 870760029, "5.31193232950104e-13"],
+		[1034891942, -1659911927, "1.4187141833e-11"],
+		[1091304589, 1962076516, "229265.682103942"],
+		[327068200, -273313464, "8.89532136591986e-215"],
+		[1135077090, 527410431, "8.61156266080371e+17"],
+		[1128212833, -2155115, "8.77122515940904e+15"],
+		[1092989373, -1717986918, "710878.8"],
+		[993898670, -1744839517, "2.45591281180801e-23"],
+		[1092926176, -1202590843, "679280.36"],
+		[1025353139, 633614043, "2.63320608200703e-14"],
+		[1092891328, 0, "661856"],
+		[-739829743, -1112302099, "-1.54151652613748e+96"],
+		[1016853882, -801182876, "9.70019385464251e-17"],
+		[1150069466, -1499592817, "1.69222454333728e+22"],
+		[1092682289, 601295421, "557336.57"],
+		[-402217838, 753847029, "-1.29133354320083e+193"],
+		[1091205971, -1717986918, "216938.45"],
+		[1093384968, 230133475, "908676.026791063"],
+		[1090787117, 858993459, "164581.65"],
+		[1092096919, 1202590843, "394469.82"],
+		[1102176675, 0, "300000000"],
+		[1089484275, -1541089241, "66399.2275742"],
+		[1059235468, -31389532, "0.00014229270078842"],
+		[1122417860, 512753664, "200000000000000"],
+		[1093232012, -773094113, "832198.41"],
+		[1136447570, 1149221581, "2.076249882372e+18"],
+		[-32557488, 48699746, "-1.63301251703595e+299"],
+		[1020001229, -355540522, "7.76701225485932e-16"],
+		[-1510348466, -1011395338, "-9.56956061222381e-126"],
+		[1083371204, -1683627180, "1211.692"],
+		[1264599344, -1000604471, "1.2455089609626e+55"],
+		[1091603619, -171798692, "271144.99"],
+		[1093145841, 773094113, "789112.59"],
+		[1088985644, -744475887, "50385.400833225"],
+		[-854584838, -26740890, "-1.65272792237274e+63"],
+		[-636076816, 307942904, "-9.40837624867098e+125"],
+		[1036179185, 219048849, "3.42690612276454e-11"],
+		[1093337306, 1717986918, "884845.2"],
+		[1057768076, -313377859, "5.39016015547104e-05"],
+		[1006305559, -874606757, "9.14940234364882e-20"],
+		[1061850036, 478066440, "0.000810110993361341"],
+		[1023503718, -221274812, "7.73929903237098e-15"],
+		[86819153, -251785469, "9.66873894043925e-284"],
+		[1010241670, 1237658631, "1.25033171071381e-18"],
+		[1082985940, -519593524, "929.728944835305"],
+		[-1718529008, 601979881, "-1.59301705077486e-185"],
+		[1093403367, -687194767, "917875.92"],
+		[1093148285, 0, "790334.5"],
+		[1093001834, -1975684956, "717109.27"],
+		[-2144443904, 1688542929, "-8.45050189871158e-308"],
+		[1119278047, 1293634208, "25099240282954.6"],
+	];
+
+	// strings with the bits of their expected Std.parseFloat result
+	static var PARSE : Array<Dynamic> = [
+		["0", 0, 0],
+		["-0", -2147483648, 0],
+		["1", 1072693248, 0],
+		[".5", 1071644672, 0],
+		["5.", 1075052544, 0],
+		["1e5", 1090021888, 0],
+		["1E-5", 1055193269, -1998362383],
+		["  12.5", 1076428800, 0],
+		[" -3.25e+2", -1066119168, 0],
+		["1.5abc", 1073217536, 0],
+		["1e", 1072693248, 0],
+		["1e+", 1072693248, 0],
+		["0x10", 0, 0],
+		["-.e1", 2146959360, 0],
+		["123456789012345678901234", 1153049755, 521183341],
+		["0.30000000000000004", 1070805811, 858993460],
+		["1.7976931348623157e308", 2146435071, -1],
+		["4.9e-324", 0, 1],
+		["2.2250738585072011e-308", 1048575, -1],
+		["9007199254740993", 1128267776, 0],
+		["1e23", 1152724226, -941536522],
+		["8.98846567431158e307", 2145386496, 0],
+		["0.000000000000000000000000000001", 0, 0],
+		["3.14159265358979323846", 1074340347, 1413754136],
+		["-5.7301173755776427e+121", -650760002, 1984364161],
+		["8.73562966086173e+214", 1821390798, -687320639],
+		["-2.5955130717980014e+29", -972409538, 2036224277],
+		["1.6106489082645868e+299", 2114898147, 1022811241],
+		["2.89146129750979e-106", 704985235, 1944118392],
+		["-7.8967553490296305e+269", -134747507, 1866104223],
+		["-3.35693218304665e-141", -1564182593, -1002790350],
+		["-4.7286430140493501e-111", -1459175824, 733240595],
+		["3.81607847113572e-286", 78450118, -819221744],
+		["3.878831e-03", 1064289919, -1990872510],
+		["2.2500135558039218e-282", 91547979, 169440726],
+		["2.226798e-290", 63686382, -504020449],
+		["4.5394087084359247e+114", 1472036413, -9490402],
+		["-3.209521e+283", -87318395, 1689022818],
+		["5.444045e+234", 1890280750, 1168974688],
+		["-4.70772767353081e+126", -633613946, -804950828],
+		["-1.6222199697182382e+91", -757081407, -1377707705],
+		["-5.61168416436274e+211", -337291730, -1066205179],
+		["-4.88420255853307e-104", -1434713799, 990665351],
+		["-3.47098905385098e-226", -1860144646, -1456611215],
+		["8.470751e-218", 316532450, -679534130],
+		["1.426081e-05", 1055778870, -850132803],
+		["1.9602681170035455e-22", 997039979, -2096723156],
+		["2.844391e+197", 1760456948, 393124006],
+		["-3.272560e-282", -2055312855, -853316806],
+		["-9.31213433114494e-240", -1907422218, 182504392],
+		["-1.30199063185347e+51", -896805155, 2031440357],
+		["-2.41592167603986e+306", -7633431, 1908344408],
+		["-3.9191141715067459e+170", -480643545, 431969339],
+		["1.6886926122837293e-86", 773901288, -715792762],
+		["-8.58515952872107e-55", -1263203075, -230753788],
+		["1.463691e+144", 1574830578, -173721996],
+		["5.3024497693158729e+112", 1465257063, -1877029222],
+		["2.20357100206871e+107", 1446511886, -1419594647],
+		["-2.421572e-45", -1230264765, 1283217303],
+		["7.74875440475239e-304", 16843030, -1684603855],
+		["-3.7063600702658426e+70", -829064433, -1178987703],
+		["-3.811212e+24", -989251471, -1150702786],
+		["3.51810270053838e-306", 8635283, 1142666069],
+		["-8.020440e-105", -1437440746, 308573145],
+		["1.57587443987711e+49", 1243975853, 330041850],
+		["2.54219312553942e-108", 697819581, 1428407853],
+		["-3.8118066907838675e-290", -2083011020, -1181704001],
+		["-7.408372e-121", -1493263423, -181540714],
+		["1.40112356610286e-37", 944232128, -77456201],
+		["-1.25317239172797e-144", -1576055819, 1583032779],
+		["7.758539e+278", 2044060228, -1258015931],
+		["-1.5131237389939308e-201", -1774344572, -110134993],
+		["1.0184815646568542e-69", 832314881, 820158089],
+		["-5.595151e+203", -365130338, 1066738460],
+		["-9.191621e-120", -1489519571, 157953415],
+		["5.4710404358749277e+60", 1284193458, 988017554],
+		["9.857119230126585e+157", 1622980550, 2140897566],
+		["3.2904168870272156e+142", 1569035815, 993489957],
+		["-2.3995628179270029e-293", -2094094712, -1433133555],
+		["-9.803108e+88", -764894270, 66764373],
+		["-4.11571827696006e+197", -386529781, 719716820],
+		["5.5342940585743821e-292", 58070868, -1805163146],
+		["-3.0328232376611871e+226", -285967399, -1088118432],
+		["-4.0699892657562364e-70", -1316587306, -1070314371],
+		["4.07339037150747e-192", 405968296, 1957893310],
+		["-4.58102114011249e+55", -880941954, -1450339002],
+		["-3.68597982917488e+37", -943998224, 1569459665],
+		["1.292773e-89", 762992017, 2062627396],
+		["-1.791436e+214", -328557730, 610025623],
+		["-2.26323496681237e+142", -578964976, -386555735],
+		["-2.858146e+91", -756281390, -464872395],
+		["-1.687327e-183", -1711493710, -377476239],
+		["-2.853274e-295", -2100866227, -752347725],
+		["1.997163e+206", 1791223799, 84223065],
+		["-1.3904214856836495e-109", -1454053854, -430086517],
+		["3.252890e+148", 1589926411, 2083400950],
+		["-1.6615559891248083e+143", -575979436, 1567303352],
+		["-1.0200031412317136e-16", -1130535349, 1969799816],
+		["-4.8816749168381542e-104", -1434714749, 1833059961],
+		["-8.100563052340524e-117", -1479250581, 1671076704],
+		["5.46725281616023e+302", 2127135502, -1942016304],
+		["-3.49488079289495e-172", -1672111079, 76126930],
+		["4.033871e+229", 1872403257, -1186113412],
+		["1.7414970162274122e-278", 105103841, -1053998353],
+		["-1.2043198780696615e+120", -656549572, 148609649],
+		["3.35848054506121e+27", 1168487459, -699264859],
+		["3.547422e-51", 896875624, -1934789112],
+		["8.4306581568897e+258", 1974569945, 1575243305],
+		["5.165753e+193", 1747363082, 2139841955],
+		["-6.70030313461711e-169", -1660667210, -294544217],
+		["2.882139e-03", 1063754824, -1746158605],
+		["-1.030183e+39", -938985424, 989212318],
+		["9.852650e-262", 163513946, -1623709346],
+		["-0.0233058456147066", -1080566404, -756934979],
+		["8.8110595835014305e+79", 1351075712, -274088580],
+		["3.255842e+68", 1311254326, -1305837167],
+		["1.77116588636021e-115", 672918077, 677102185],
+		["-1.8961772668516e-241", -1913373985, -184784317],
+		["9.9899844154863933e-212", 337694921, -1705133704],
+		["2.951172e+285", 2066995364, 1334428053],
+		["-5.03081565689646e+97", -734556806, -2075975690],
+		["-4.6306863174181224e+286", -76319098, 1116076385],
+		["5.7375473310802649e+68", 1312114720, 2130499050],
+		["5.462991e+45", 1231986433, -189122175],
+		["-3.629833e+244", -223001690, 602063122],
+		["7.32995949331948e+255", 1963933249, 346665518],
+		["-2.110043e-271", -2017687180, -728422434],
+		["1.9038056859764756e-243", 227147680, -520747793],
+		["9.8991946212310554e+86", 1375721745, 1647169839],
+		["-1.490053e-223", -1851026500, 1613924385],
+		["-6.9075354497610853e-183", -1709352496, 1698602726],
+		["-4.22682611141508e+30", -968184626, 1314250238],
+		["-2.29130272179119e+113", -680013397, -20142877],
+		["-3.681438e-31", -1180836340, 780561222],
+		["-1.349015e+105", -708652427, -1251894806],
+		["-3.2594897016657914e-99", -1417902996, -945317595],
+		["1.33823002967527e-190", 411243641, -580553392],
+		["-5.37832580452833e+245", -218910423, 1252854874],
+		["1.40870864410579e+267", 2003163161, -1087701967],
+		["-9.487115e+145", -566336528, 2038531245],
+	];
+
+	public static function main() {
+		var errors = 0;
+		for( f in FORMAT ) {
+			var d = haxe.io.FPHelper.i64ToDouble(f[1], f[0]);
+			var s = Std.string(d);
+			if( s != f[2] ) {
+				Sys.println("format " + f[2] + " : got " + s);
+				errors++;
+			}
+			var back = Std.parseFloat(s);
+			if( s.length < 15 && back != d ) {
+				Sys.println("round-trip " + s + " : got " + back);
+				errors++;
+			}
+		}
+		for( p in PARSE ) {
+			var d = Std.parseFloat(p[0]);
+			var b = haxe.io.FPHelper.doubleToI64(d);
+			if( Math.isNaN(d) ? p[1] != 0x7FF80000 : (b.high != p[1] || b.low != p[2]) ) {
+				Sys.println("parse " + p[0] + " : got " + d);
+				errors++;
+			}
+		}
+		var t0 = Sys.time();
+		var acc = 0.;
+		for( i in 0...1000000 ) {
+			var s = Std.string(i * 0.01);
+			acc += Std.parseFloat(s);
+		}
+		Sys.println("1M format+parse " + Std.int((Sys.time() - t0) * 1000) + "ms (" + acc + ")");
+		if( errors > 0 ) throw errors + " errors";
+	}
+
+}
@@ -0,0 +1,100 @@
+typedef ImgStream = hl.Abstract<"fmt_img_stream">;
+
+class Images {
+
+	static inline var PNG = 0;
+	static inline var JPG = 1;
+	static inline var RGB = 0;
+	static inline var RGBA = 7;
+	static inline var THREADS = 2;
+
+	@:hlNative("fmt","png_encode") static function pngEncode( data : hl.Bytes, width : Int, height : Int, stride : Int, format : Int, filter : Int, level : Int, flags : Int, outLength : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("fmt","png_decode") static function pngDecode( data : hl.Bytes, dataLen : Int, out : hl.Bytes, width : Int, height : Int, stride : Int, format : Int, flags : Int ) : Bool { return false; }
+	@:hlNative("fmt","jpg_encode") static function jpgEncode( data : hl.Bytes, width : Int, height : Int, stride : Int, format : Int, subSamp : Int, quality : Int, flags : Int, outLength : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("fmt","img_stream_init") static function streamInit( kind : Int, format : Int, flags : Int ) : ImgStream { return null; }
+	@:hlNative("fmt","img_stream_feed") static function streamFeed( s : ImgStream, src : hl.Bytes, srcPos : Int, srcLen : Int, out : hl.Bytes, stride : Int, eof : Bool ) : Int { return 0; }
+	@:hlNative("fmt","img_stream_info") static function streamInfo( s : ImgStream, width : hl.Ref<Int>, height : hl.Ref<Int>, rows : hl.Ref<Int> ) : Void {}
+	@:hlNative("fmt","img_stream_end") static function streamEnd( s : ImgStream ) : Void {}
+	@:hlNative("fmt","img_info") static function imgInfo( data : hl.Bytes, pos : Int, len : Int, kind : hl.Ref<Int>, width : hl.Ref<Int>, height : hl.Ref<Int> ) : Bool { return false; }
+	@:hlNative("fmt","img_decode_many") static function decodeMany( data : hl.Bytes, offsets : hl.Bytes, out : hl.Bytes, outOffsets : hl.Bytes, status : hl.Bytes, count : Int, format : Int, flags : Int ) : Int { return 0; }
+
+	static var W = 301;
+	static var H = 203;
+
+	// decodes a single image with img_decode_many
+	static function decodeOne( data : hl.Bytes, len : Int, size : Int, format : Int ) : hl.Bytes {
+		var offsets = new hl.Bytes(8), outOffsets = new hl.Bytes(8), status = new hl.Bytes(4);
+		offsets.setI32(0, 0);
+		offsets.setI32(4, len);
+		outOffsets.setI32(0, 0);
+		outOffsets.setI32(4, size);
+		var out = new hl.Bytes(size);
+		if( decodeMany(data, offsets, out, outOffsets, status, 1, format, 0) != 1 ) throw "Batch decode failed";
+		return out;
+	}
+
+	// feeds the image by chunks of the given size, the output buffer is given once the header is read
+	static function decodeStream( kind : Int, data : hl.Bytes, len : Int, chunk : Int, format : Int, bpp : Int ) : hl.Bytes {
+		var s = streamInit(kind, format, 0);
+		var out : hl.Bytes = null;
+		var width = 0, height = 0, rows = 0;
+		var pos = 0;
+		while( true ) {
+			var n = len - pos < chunk ? len - pos : chunk;
+			var state = streamFeed(s, data, pos, n, out, width * bpp, pos + n == len);
+			pos += n;
+			if( state == 1 ) {
+				streamInfo(s, width, height, rows);
+				if( width != W || height != H ) throw "Invalid size " + width + "x" + height;
+				out = new hl.Bytes(width * height * bpp);
+				state = streamFeed(s, null, 0, 0, out, width * bpp, pos == len);
+			}
+			if( state == 2 ) break;
+		}
+		streamEnd(s);
+		return out;
+	}
+
+	static function checkPng() {
+		var size = W * H * 4;
+		var src = new hl.Bytes(size);
+		for( i in 0...size )
+			src[i] = (i & 3) == 3 ? Std.int(i / 97) : Std.int(i * 31 / 7) ^ (i >> 9);
+		for( flags in [0, THREADS] ) {
+			var len = 0;
+			var png = pngEncode(src, W, H, W * 4, RGBA, 5, 6, flags, len);
+			var kind = -1, width = 0, height = 0;
+			if( !imgInfo(png, 0, len, kind, width, height) || kind != PNG || width != W || height != H ) throw "Invalid PNG header";
+			// encode then decode gives back the source pixels, with both decoders
+			var ref = new hl.Bytes(size);
+			if( !pngDecode(png, len, ref, W, H, W * 4, RGBA, 0) ) throw "PNG decode failed";
+			if( ref.compare(0, src, 0, size) != 0 ) throw "PNG round trip mismatch";
+			if( decodeOne(png, len, size, RGBA).compare(0, src, 0, size) != 0 ) throw "PNG batch decode mismatch";
+			for( chunk in [1, 13, 4096, len] )
+				if( decodeStream(PNG, png, len, chunk, RGBA, 4).compare(0, src, 0, size) != 0 )
+					throw "PNG stream mismatch with " + chunk + " bytes chunks";
+		}
+	}
+
+	static function checkJpeg() {
+		var size = W * H * 3;
+		var src = new hl.Bytes(size);
+		for( i in 0...size )
+			src[i] = Std.int(i * 13 / 5) ^ (i >> 10);
+		var len = 0;
+		var jpg = jpgEncode(src, W, H, W * 3, RGB, 0, 90, 0, len);
+		if( jpg == null ) throw "JPEG encode failed";
+		// lossy : the streamed image must match the one-shot decoding
+		var ref = decodeOne(jpg, len, size, RGB);
+		for( chunk in [1, 13, 4096, len] )
+			if( decodeStream(JPG, jpg, len, chunk, RGB, 3).compare(0, ref, 0, size) != 0 )
+				throw "JPEG stream mismatch with " + chunk + " bytes chunks";
+	}
+
+	public static function main() {
+		checkPng();
+		checkJpeg();
+		Sys.println("Images OK");
+	}
+
+}
@@ -0,0 +1,274 @@
+typedef Connection = hl.Abstract<"mysql_cnx">;
+typedef Result = hl.Abstract<"mysql_result">;
+typedef Statement = hl.Abstract<"mysql_stmt">;
+
+@:keep private class ConnectionParams {
+	public var host : hl.Bytes;
+	public var user : hl.Bytes;
+	public var pass : hl.Bytes;
+	public var socket : hl.Bytes;
+	public var port : Int;
+	public function new() {}
+}
+
+/*
+	Runs against other/tests/mysql_stub.py, which sets MYSQL_HOST and MYSQL_PORT :
+	the queries are the ones the stub answers. Skipped when MYSQL_HOST is not set.
+*/
+class Mysql {
+
+	static inline var FETCH_INT = 0;
+	static inline var FETCH_INT64 = 1;
+	static inline var FETCH_FLOAT = 2;
+	static inline var FETCH_TEXT = 3;
+
+	@:hlNative("mysql","connect_wrap") static function connect( p : ConnectionParams ) : Connection { return null; }
+	@:hlNative("mysql","close_wrap") static function close( c : Connection ) : Void {}
+	@:hlNative("mysql","select_db_wrap") static function selectDb( c : Connection, db : hl.Bytes ) : Bool { return false; }
+	@:hlNative("mysql","request") static function request( c : Connection, rq : hl.Bytes, len : Int ) : Result { return null; }
+	@:hlNative("mysql","request_stream") static function requestStream( c : Connection, rq : hl.Bytes, len : Int ) : Result { return null; }
+	@:hlNative("mysql","result_get_length") static function resultLength( r : Result ) : Int { return 0; }
+	@:hlNative("mysql","result_get_int") static function resultGetInt( r : Result, n : Int ) : Int { return 0; }
+	@:hlNative("mysql","request_pipeline") static function requestPipeline( c : Connection, queries : hl.NativeArray<hl.Bytes>, lengths : hl.Bytes ) : hl.NativeArray<Result> { return null; }
+	@:hlNative("mysql","result_get") static function resultGet( r : Result, n : Int ) : hl.Bytes { return null; }
+	@:hlNative("mysql","result_get_float") static function resultGetFloat( r : Result, n : Int ) : Float { return 0.; }
+	@:hlNative("mysql","prepare") static function prepare( c : Connection, sql : hl.Bytes, len : Int ) : Statement { return null; }
+	@:hlNative("mysql","execute") static function execute( s : Statement, types : hl.Bytes, columns : hl.NativeArray<hl.Bytes>, nulls : hl.Bytes, arena : hl.Bytes, row : Int, stream : Bool ) : Result { return null; }
+	@:hlNative("mysql","execute_batch") static function executeBatch( s : Statement, count : Int, types : hl.Bytes, columns : hl.NativeArray<hl.Bytes>, nulls : hl.Bytes, arena : hl.Bytes ) : Int { return 0; }
+	@:hlNative("mysql","set_conv_funs") static function setConvFuns( fstring : Dynamic, fbytes : Dynamic, fdate : Dynamic, fjson : Dynamic ) : Void {}
+	@:hlNative("mysql","result_fetch") static function resultFetch( r : Result, max : Int, types : hl.Bytes, columns : hl.NativeArray<hl.Bytes>, nulls : hl.Bytes, arena : hl.Bytes, arenaSize : Int, arenaUsed : hl.Ref<Int> ) : Int { return 0; }
+
+	static function utf8( s : String ) : hl.Bytes {
+		return s == null ? null : @:privateAccess s.toUtf8();
+	}
+
+	// reads a FETCH_TEXT value from its (offset,length) pair
+	static function text( arena : hl.Bytes, col : hl.Bytes, row : Int ) : String {
+		return arena.offset(col.getI32(row << 3)).toBytes(col.getI32((row << 3) + 4)).toString();
+	}
+
+	static function env( name : String, def : String ) : String {
+		var v = Sys.getEnv(name);
+		return v == null ? def : v;
+	}
+
+	static function query( c : Connection, sql : String, stream = false ) : Result {
+		var b = haxe.io.Bytes.ofString(sql);
+		var rq = @:privateAccess b.b;
+		return stream ? requestStream(c, rq, b.length) : request(c, rq, b.length);
+	}
+
+	static function prep( c : Connection, sql : String ) : Statement {
+		var b = haxe.io.Bytes.ofString(sql);
+		return prepare(c, @:privateAccess b.b, b.length);
+	}
+
+	static function intTypes( types : Array<Int> ) : hl.Bytes {
+		var b = new hl.Bytes(types.length * 4 + 4);
+		for( i in 0...types.length ) b.setI32(i << 2, types[i]);
+		return b;
+	}
+
+	static function expectError( f : Void -> Void, msg : String ) {
+		try {
+			f();
+		} catch( e : Dynamic ) {
+			if( Std.string(e).indexOf(msg) < 0 ) throw "Unexpected error " + e;
+			return;
+		}
+		throw "Missing error " + msg;
+	}
+
+	static function connectEnv() : Connection {
+		var p = new ConnectionParams();
+		p.host = utf8(Sys.getEnv("MYSQL_HOST"));
+		p.user = utf8(env("MYSQL_USER", "root"));
+		p.pass = utf8(env("MYSQL_PASS", ""));
+		p.port = Std.parseInt(env("MYSQL_PORT", "3306"));
+		var c = connect(p);
+		if( !selectDb(c, utf8(env("MYSQL_DB", "test"))) ) throw "Failed to select database";
+		return c;
+	}
+
+	// streamed rows read with result_fetch are the ones of the stored result
+	static function checkStream( c : Connection ) {
+		var rows = 1000;
+		if( resultLength(query(c, "SELECT ROWS " + rows)) != rows ) throw "Invalid row count";
+
+		var types = new hl.Bytes(8);
+		types.setI32(0, FETCH_INT);
+		types.setI32(4, FETCH_TEXT);
+		var columns = new hl.NativeArray<hl.Bytes>(2);
+		columns[0] = new hl.Bytes(64 * 4);
+		columns[1] = new hl.Bytes(64 * 8);
+		var arena = new hl.Bytes(4096);
+		var r = query(c, "SELECT ROWS " + rows, true);
+		var count = 0;
+		while( true ) {
+			var used = 0;
+			var n = resultFetch(r, 64, types, columns, null, arena, 4096, used);
+			if( n == 0 ) break;
+			for( k in 0...n ) {
+				var id = columns[0].getI32(k << 2);
+				var name = text(arena, columns[1], k);
+				if( id != count + k || name != "name" + id ) throw "Invalid row " + (count + k) + " : " + id + " " + name;
+			}
+			count += n;
+		}
+		if( count != rows ) throw "Streamed " + count + " rows";
+
+		// a full arena leaves a row pending until the caller resets arenaUsed
+		r = query(c, "SELECT ROWS " + rows, true);
+		var used = 0;
+		var n = resultFetch(r, 64, types, columns, null, arena, 20, used);
+		if( n == 0 || n >= 64 ) throw "Arena should be full after " + n + " rows";
+		expectError(function() { var full = used; resultFetch(r, 64, types, columns, null, arena, 20, full); }, "arenaUsed must be reset");
+		used = 0;
+		if( resultFetch(r, 1, types, columns, null, arena, 20, used) != 1 || columns[0].getI32(0) != n ) throw "Pending row was lost";
+
+		// the pending row of an arena too small for it is still read with a larger one
+		r = query(c, "SELECT ROWS " + rows, true);
+		expectError(function() { var used = 0; resultFetch(r, 64, types, columns, null, arena, 2, used); }, "too small for one row");
+		used = 0;
+		if( resultFetch(r, 1, types, columns, null, arena, 4096, used) != 1 || columns[0].getI32(0) != 0 ) throw "Row was lost by a small arena";
+
+		// once another request detached the stream, its remaining rows are skipped
+		// and the pending row can't be read anymore, with result_fetch or result_get
+		used = 0;
+		if( resultFetch(r, 64, types, columns, null, arena, 20, used) >= 64 ) throw "Arena should be full";
+		if( resultGetInt(query(c, "SELECT 1"), 0) != 1 ) throw "Stream was not drained";
+		expectError(function() { var used = 0; resultFetch(r, 64, types, columns, null, arena, 4096, used); }, "discarded");
+		expectError(function() resultGetInt(r, 0), "discarded");
+
+		// an error in the middle of the stream is raised by the result_fetch call
+		// that reads it, after the 5 calls that read the rows before
+		r = query(c, "SELECT ROWS 100 ERROR", true);
+		count = 0;
+		expectError(function() {
+			while( true ) {
+				var used = 0;
+				var read = resultFetch(r, 10, types, columns, null, arena, 4096, used);
+				if( read == 0 ) break;
+				count += read;
+			}
+		}, "interrupted");
+		if( count != 50 ) throw "Read " + count + " rows before the error";
+		if( resultLength(query(c, "SELECT ROWS 3")) != 3 ) throw "Connection unusable after a stream error";
+
+		// streamed binary rows, detached before their end
+		var s = prep(c, "SELECT TYPES");
+		var btypes = intTypes([FETCH_TEXT, FETCH_TEXT, FETCH_TEXT, FETCH_TEXT, FETCH_FLOAT, FETCH_FLOAT, FETCH_INT64, FETCH_INT]);
+		var bcolumns = new hl.NativeArray<hl.Bytes>(8);
+		for( i in 0...8 ) bcolumns[i] = new hl.Bytes(3 * 8);
+		var nulls = new hl.Bytes(3 * 8);
+		r = execute(s, null, new hl.NativeArray<hl.Bytes>(0), null, null, 0, true);
+		used = 0;
+		if( resultFetch(r, 3, btypes, bcolumns, nulls, arena, 4096, used) != 3 ) throw "Missing streamed rows";
+		if( text(arena, bcolumns[1], 0) != "-26:03:04" || nulls[8] != 1 || nulls[16] != 1 || nulls[17] != 0 ) throw "Invalid streamed binary rows";
+		r = execute(s, null, new hl.NativeArray<hl.Bytes>(0), null, null, 0, true);
+		used = 0;
+		if( resultFetch(r, 1, btypes, bcolumns, nulls, arena, 4096, used) != 1 ) throw "Missing streamed row";
+		if( resultLength(query(c, "SELECT ROWS 3")) != 3 ) throw "Binary stream was not drained";
+		expectError(function() { var used = 0; resultFetch(r, 3, btypes, bcolumns, nulls, arena, 4096, used); }, "discarded");
+	}
+
+	// values of the binary protocol read the same as with the text protocol
+	static function checkStatements( c : Connection ) {
+		var s = prep(c, "SELECT TYPES");
+		var types = intTypes([FETCH_TEXT, FETCH_TEXT, FETCH_TEXT, FETCH_TEXT, FETCH_FLOAT, FETCH_FLOAT, FETCH_INT64, FETCH_INT]);
+		var columns = new hl.NativeArray<hl.Bytes>(8);
+		for( i in 0...8 ) columns[i] = new hl.Bytes(3 * 8);
+		var nulls = new hl.Bytes(3 * 8);
+		var arena = new hl.Bytes(1024);
+		var used = 0;
+		var r = execute(s, null, new hl.NativeArray<hl.Bytes>(0), null, null, 0, false);
+		if( resultFetch(r, 3, types, columns, nulls, arena, 1024, used) != 3 ) throw "Missing rows";
+		var expect = ["2024-02-29", "-26:03:04", "2024-02-29 13:14:15", "18446744073709551615"];
+		for( i in 0...4 )
+			if( text(arena, columns[i], 0) != expect[i] ) throw "Invalid value " + text(arena, columns[i], 0) + " should be " + expect[i];
+		if( columns[4].getF64(0) != 1.5 || columns[5].getF64(0) != 0.1 ) throw "Invalid floats";
+		if( columns[6].getI64(0) != haxe.Int64.make(0, 0xEE6B2800) || columns[7].getI32(0) != -5 ) throw "Invalid integers";
+		// the null bitmap of binary rows starts at bit 2 : all NULL, then every other column
+		for( i in 0...8 )
+			if( nulls[i] != 0 || nulls[8 + i] != 1 || nulls[16 + i] != ((i & 1) == 0 ? 1 : 0) ) throw "Invalid null flags of column " + i;
+		if( text(arena, columns[1], 2) != expect[1] || text(arena, columns[3], 2) != expect[3] ) throw "Invalid values after NULL";
+		if( columns[5].getF64(2 << 3) != 0.1 || columns[7].getI32(2 << 2) != -5 ) throw "Invalid numbers after NULL";
+		r = execute(s, null, new hl.NativeArray<hl.Bytes>(0), null, null, 0, false);
+		if( resultGetFloat(r, 3) != 18446744073709551615. ) throw "Invalid unsigned float";
+		if( resultGetFloat(r, 4) != 1.5 ) throw "Invalid float";
+		if( @:privateAccess String.fromUTF8(resultGet(r, 3)) != expect[3] ) throw "Invalid unsigned value";
+
+		// parameters
+		var e = prep(c, "SELECT ?, ?, ?");
+		var params = new hl.NativeArray<hl.Bytes>(3);
+		params[0] = new hl.Bytes(8);
+		params[0].setI64(0, haxe.Int64.make(-288, 1234567890));
+		params[1] = new hl.Bytes(8);
+		params[1].setF64(0, 2.25);
+		params[2] = new hl.Bytes(8);
+		params[2].setI32(0, 0);
+		params[2].setI32(4, 5);
+		var pt = intTypes([FETCH_INT64, FETCH_FLOAT, FETCH_TEXT]);
+		var parena = @:privateAccess "hello".toUtf8();
+		r = execute(e, pt, params, null, parena, 0, false);
+		used = 0;
+		if( resultFetch(r, 1, pt, columns, null, arena, 1024, used) != 1 ) throw "Missing row";
+		if( columns[0].getI64(0) != params[0].getI64(0) || columns[1].getF64(0) != 2.25 || text(arena, columns[2], 0) != "hello" ) throw "Invalid parameters echo";
+
+		// batch
+		var count = 1000;
+		var ins = prep(c, "INSERT BATCH ?");
+		var ids = new hl.NativeArray<hl.Bytes>(1);
+		ids[0] = new hl.Bytes(count * 4);
+		for( i in 0...count ) ids[0].setI32(i << 2, i);
+		if( executeBatch(ins, count, intTypes([FETCH_INT]), ids, null, null) != count ) throw "Invalid affected rows";
+		r = query(c, "SELECT BATCH");
+		if( resultGetInt(r, 0) != (count * (count - 1)) >> 1 ) throw "Invalid batch sum";
+	}
+
+	// the statement is the only reference left to its connection
+	static function checkStatementRoot() {
+		var s = prep(connectEnv(), "SELECT 1");
+		for( i in 0...3 ) hl.Gc.major();
+		var r = execute(s, null, new hl.NativeArray<hl.Bytes>(0), null, null, 0, false);
+		if( resultGetInt(r, 0) != 1 ) throw "Invalid statement result";
+	}
+
+	// large queries alternate with large answers : the queries in flight must not fill
+	// the socket while the server is blocked sending an answer
+	static function checkPipeline( c : Connection ) {
+		var count = 100;
+		var queries = new hl.NativeArray<hl.Bytes>(count);
+		var lengths = new hl.Bytes(count * 4);
+		var big = "UPDATE " + StringTools.lpad("", "z", 200000);
+		for( i in 0...count ) {
+			var b = haxe.io.Bytes.ofString((i & 1) == 0 ? "SELECT BIG 16 20000" : big);
+			queries[i] = @:privateAccess b.b;
+			lengths.setI32(i << 2, b.length);
+		}
+		var results = requestPipeline(c, queries, lengths);
+		for( i in 0...count )
+			if( (i & 1) == 0 && resultLength(results[i]) != 16 ) throw "Invalid result " + i;
+	}
+
+	public static function main() {
+		if( Sys.getEnv("MYSQL_HOST") == null ) {
+			Sys.println("Mysql skipped : MYSQL_HOST is not set");
+			return;
+		}
+		setConvFuns(
+			function( v : hl.Bytes ) return @:privateAccess String.fromUTF8(v),
+			function( v : hl.Bytes, len : Int ) return v.toBytes(len),
+			function( t : Int ) return Date.fromTime(1000. * t),
+			function( v : hl.Bytes ) return @:privateAccess String.fromUTF8(v)
+		);
+		var c = connectEnv();
+		checkStream(c);
+		checkStatements(c);
+		checkStatementRoot();
+		checkPipeline(c);
+		close(c);
+		Sys.println("Mysql OK");
+	}
+
+}
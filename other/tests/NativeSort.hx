@@ -0,0 +1,181 @@
+class Item {
+	public var key : Int;
+	public var id : Int;
+	public function new(key, id) {
+		this.key = key;
+		this.id = id;
+	}
+}
+
+class FloatItem {
+	public var key : Float;
+	public var id : Int;
+	public function new(key, id) {
+		this.key = key;
+		this.id = id;
+	}
+}
+
+class NativeSort {
+
+	// odd multipliers and their inverses : v = i * M is a permutation of the integers
+	static inline var M32 = 0x9E3779B1;
+	static inline var INV32 = 0x0E8B2F51;
+	static var M64 = haxe.Int64.make(0x9E3779B9, 0x7F4A7C15);
+	static var INV64 = haxe.Int64.make(0xF1DE83E1, 0x9937733D);
+
+	@:hlNative("std","bytes_sort_i32") static function sortI32( b : hl.Bytes, pos : Int, len : Int, desc : Bool ) : Void {
+	}
+
+	@:hlNative("std","bytes_sort_i64") static function sortI64( b : hl.Bytes, pos : Int, len : Int, desc : Bool ) : Void {
+	}
+
+	@:hlNative("std","bytes_sort_f64") static function sortF64( b : hl.Bytes, pos : Int, len : Int, desc : Bool ) : Void {
+	}
+
+	@:hlNative("std","bytes_sort_key_i32") static function sortKeyI32( b : hl.Bytes, pos : Int, len : Int, key : Dynamic -> Int, desc : Bool ) : Void {
+	}
+
+	@:hlNative("std","bytes_sort_key_f64") static function sortKeyF64( b : hl.Bytes, pos : Int, len : Int, key : Dynamic -> Float, desc : Bool ) : Void {
+	}
+
+	@:hlNative("std","array_bytes") static function arrayBytes( a : hl.NativeArray<Dynamic> ) : hl.Bytes {
+		return null;
+	}
+
+	static function check() {
+		var rnd = 1;
+		for( n in [0, 1, 10, 100, 1000, 100000] ) {
+			for( desc in [false, true] ) {
+				var a = new hl.Bytes(n * 4);
+				var ref = [];
+				for( i in 0...n ) {
+					rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+					var v = (i & 1) == 0 ? rnd : -(rnd % 1000);
+					a.setI32(i << 2, v);
+					ref.push(v);
+				}
+				ref.sort(function(x, y) return desc ? Reflect.compare(y, x) : Reflect.compare(x, y));
+				sortI32(a, 0, n, desc);
+				for( i in 0...n )
+					if( a.getI32(i << 2) != ref[i] ) throw "Invalid i32 sort at " + i;
+			}
+		}
+
+		var values = [3.5, Math.NaN, -0.0, 0.0, -1e300, Math.NEGATIVE_INFINITY, 2.0, Math.POSITIVE_INFINITY, -2.0];
+		var f = new hl.Bytes(values.length * 8);
+		for( desc in [false, true] ) {
+			for( i in 0...values.length ) f.setF64(i << 3, values[i]);
+			sortF64(f, 0, values.length, desc);
+			for( i in 0...ORDER.length ) {
+				var v = f.getF64(i << 3);
+				if( rank(v, desc) != i ) throw "Invalid f64 sort at " + i + " : " + v;
+			}
+			if( !Math.isNaN(f.getF64(ORDER.length << 3)) ) throw "NaN should be last";
+		}
+
+		var i64 = [for( i in 0...1000 ) (haxe.Int64.make(i * 7919, i * M32) * M64) >> (i % 40)];
+		for( i in 0...200 ) i64[i * 5] = -i64[i * 5];
+		var b = new hl.Bytes(i64.length * 8);
+		for( desc in [false, true] ) {
+			for( i in 0...i64.length ) b.setI64(i << 3, i64[i]);
+			sortI64(b, 0, i64.length, desc);
+			var ref = i64.copy();
+			ref.sort(function(x, y) return desc ? haxe.Int64.compare(y, x) : haxe.Int64.compare(x, y));
+			for( i in 0...ref.length )
+				if( b.getI64(i << 3) != ref[i] ) throw "Invalid i64 sort at " + i;
+		}
+
+		var items = [for( i in 0...10000 ) new Item(i % 37, i)];
+		var arr = @:privateAccess (cast items : hl.types.ArrayObj<Dynamic>).array;
+		sortKeyI32(arrayBytes(arr), 0, items.length, function(o : Dynamic) return (o : Item).key, false);
+		for( i in 1...items.length ) {
+			var a = items[i - 1], b = items[i];
+			if( a.key > b.key || (a.key == b.key && a.id > b.id) ) throw "Invalid keyed sort at " + i;
+		}
+
+		// stable, NaN keys last in their original order, -0 before +0
+		for( desc in [false, true] ) {
+			var items = [for( i in 0...9000 ) new FloatItem(values[i % values.length], i)];
+			var arr = @:privateAccess (cast items : hl.types.ArrayObj<Dynamic>).array;
+			sortKeyF64(arrayBytes(arr), 0, items.length, function(o : Dynamic) return (o : FloatItem).key, desc);
+			for( i in 1...items.length ) {
+				var a = items[i - 1], b = items[i];
+				var ra = rank(a.key, desc), rb = rank(b.key, desc);
+				if( ra > rb || (ra == rb && a.id > b.id) ) throw "Invalid f64 keyed sort at " + i;
+			}
+		}
+	}
+
+	static var ORDER = [Math.NEGATIVE_INFINITY, -1e300, -2.0, -0.0, 0.0, 2.0, 3.5, Math.POSITIVE_INFINITY];
+
+	static function rank( v : Float, desc : Bool ) {
+		if( Math.isNaN(v) ) return ORDER.length;
+		for( i in 0...ORDER.length )
+			if( v == ORDER[i] && (v != 0 || (1 / v < 0) == (1 / ORDER[i] < 0)) )
+				return desc ? ORDER.length - 1 - i : i;
+		throw "Unknown value " + v;
+	}
+
+	// above RADIX_PARALLEL_MIN the first pass is split between threads
+	static function checkParallel() {
+		var n = (3 << 20) + 12345;
+		var a = new hl.Bytes(n * 4);
+		for( desc in [false, true] ) {
+			for( i in 0...n ) a.setI32(i << 2, i * M32);
+			sortI32(a, 0, n, desc);
+			for( i in 0...n ) {
+				var v = a.getI32(i << 2);
+				var k = v * INV32;
+				if( k < 0 || k >= n ) throw "Invalid i32 value " + v + " at " + i;
+				if( i > 0 && (desc ? v >= a.getI32((i - 1) << 2) : v <= a.getI32((i - 1) << 2)) ) throw "Invalid parallel i32 sort at " + i;
+			}
+		}
+		var a = new hl.Bytes(n * 8);
+		for( desc in [false, true] ) {
+			for( i in 0...n ) a.setI64(i << 3, M64 * i);
+			sortI64(a, 0, n, desc);
+			for( i in 0...n ) {
+				var v = a.getI64(i << 3);
+				var k = v * INV64;
+				if( k < 0 || k >= n ) throw "Invalid i64 value at " + i;
+				if( i > 0 && (desc ? v >= a.getI64((i - 1) << 3) : v <= a.getI64((i - 1) << 3)) ) throw "Invalid parallel i64 sort at " + i;
+			}
+		}
+		for( desc in [false, true] ) {
+			for( i in 0...n ) a.setF64(i << 3, (i * M32) / 4);
+			sortF64(a, 0, n, desc);
+			for( i in 0...n ) {
+				var v = a.getF64(i << 3);
+				var k = Std.int(v * 4) * INV32;
+				if( k < 0 || k >= n ) throw "Invalid f64 value " + v + " at " + i;
+				if( i > 0 && (desc ? v >= a.getF64((i - 1) << 3) : v <= a.getF64((i - 1) << 3)) ) throw "Invalid parallel f64 sort at " + i;
+			}
+		}
+	}
+
+	public static function main() {
+		check();
+		checkParallel();
+
+		var n = 10000000;
+		var a = new hl.Bytes(n * 4);
+		var ref = new hl.Bytes(n * 4);
+		var rnd = 7;
+		for( i in 0...n ) {
+			rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+			ref.setI32(i << 2, rnd ^ (i << 16));
+		}
+		a.blit(0, ref, 0, n * 4);
+		var t0 = Sys.time();
+		sortI32(a, 0, n, false);
+		Sys.println("native i32 " + n + " : " + Std.int((Sys.time() - t0) * 1000) + "ms");
+		var sorted = a.sub(0, n * 4);
+		a.blit(0, ref, 0, n * 4);
+		t0 = Sys.time();
+		a.sortI32(0, n, function(x, y) return x < y ? -1 : x > y ? 1 : 0);
+		Sys.println("closure i32 " + n + " : " + Std.int((Sys.time() - t0) * 1000) + "ms");
+		if( a.compare(0, sorted, 0, n * 4) != 0 ) throw "Native and closure sorts differ";
+	}
+
+}
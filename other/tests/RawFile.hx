@@ -0,0 +1,72 @@
+typedef RawHandle = hl.Abstract<"hl_fraw">;
+
+class RawFile {
+
+	static inline var READ = 0;
+	static inline var WRITE = 1;
+	static inline var READ_WRITE_CREATE = 4;
+
+	@:hlNative("std","file_raw_open") static function open( name : hl.Bytes, mode : Int, flags : Int ) : RawHandle { return null; }
+	@:hlNative("std","file_raw_close") static function close( f : RawHandle ) : Void {}
+	@:hlNative("std","file_raw_pread") static function pread( f : RawHandle, buf : hl.Bytes, pos : Int, len : Int, offset : haxe.Int64 ) : Int { return 0; }
+	@:hlNative("std","file_raw_pwrite") static function pwrite( f : RawHandle, buf : hl.Bytes, pos : Int, len : Int, offset : haxe.Int64 ) : Int { return 0; }
+	@:hlNative("std","file_raw_readv") static function readv( f : RawHandle, bufs : hl.NativeArray<hl.Bytes>, slices : hl.Bytes, offset : haxe.Int64 ) : Int { return 0; }
+	@:hlNative("std","file_raw_writev") static function writev( f : RawHandle, bufs : hl.NativeArray<hl.Bytes>, slices : hl.Bytes, offset : haxe.Int64 ) : Int { return 0; }
+	@:hlNative("std","file_raw_size") static function size( f : RawHandle ) : haxe.Int64 { return 0; }
+	@:hlNative("std","file_raw_truncate") static function truncate( f : RawHandle, size : haxe.Int64 ) : Bool { return false; }
+	@:hlNative("std","file_raw_sync") static function sync( f : RawHandle, dataOnly : Bool ) : Bool { return false; }
+	@:hlNative("std","file_raw_align_offset") static function alignOffset( buf : hl.Bytes, align : Int ) : Int { return 0; }
+
+	public static function main() {
+		var file = "raw_file_test.bin";
+		var path = @:privateAccess Sys.getPath(file);
+		var src = new hl.Bytes(65536), dst = new hl.Bytes(65536);
+		for( i in 0...65536 ) src[i] = i * 13 + (i >> 8);
+
+		// positional writes in any order don't depend on a file position
+		var f = open(path, READ_WRITE_CREATE, 0);
+		if( f == null ) throw "Open failed";
+		var i = 15;
+		while( i >= 0 ) {
+			if( pwrite(f, src, i * 4096, 4096, i * 4096) != 4096 ) throw "Short write";
+			i--;
+		}
+		if( size(f) != 65536 ) throw "Invalid size " + size(f);
+		if( pread(f, dst, 0, 65536, 0) != 65536 || dst.compare(0, src, 0, 65536) != 0 ) throw "Read mismatch";
+		if( pread(f, dst, 0, 100, 65536) != 0 ) throw "Read after end of file";
+
+		// scatter/gather of several slices at an unaligned offset
+		var slices = new hl.Bytes(6 * 4);
+		for( k in 0...6 ) slices.setI32(k * 4, [0, 3000, 100, 5000, 7, 20000][k]);
+		var bufs = new hl.NativeArray<hl.Bytes>(3);
+		for( k in 0...3 ) bufs[k] = src.offset(k * 10000);
+		if( writev(f, bufs, slices, 12345) != 28000 ) throw "Short writev";
+		dst.fill(0, 65536, 0);
+		for( k in 0...3 ) bufs[k] = dst.offset(k * 20000);
+		if( readv(f, bufs, slices, 12345) != 28000 ) throw "Short readv";
+		if( dst.compare(0, src, 0, 3000) != 0 || dst.compare(20100, src, 10100, 5000) != 0 || dst.compare(40007, src, 20007, 20000) != 0 )
+			throw "Vectored data mismatch";
+
+		// offsets above 4GB, in a sparse file
+		var big = haxe.Int64.make(1, 0x40000000);
+		if( !truncate(f, big + 4096) || size(f) != big + 4096 ) throw "Truncate failed";
+		if( pwrite(f, src, 100, 1000, big) != 1000 ) throw "Write above 4GB failed";
+		if( pread(f, dst, 0, 1000, big) != 1000 || dst.compare(0, src, 100, 1000) != 0 ) throw "Read above 4GB mismatch";
+		if( !sync(f, true) ) throw "Sync failed";
+		if( !truncate(f, 0) ) throw "Truncate failed";
+		close(f);
+		close(f);
+		if( pread(f, dst, 0, 1, 0) != -1 || size(f) != -1 ) throw "Used after close";
+
+		var off = alignOffset(dst, 512);
+		if( off < 0 || off >= 512 || alignOffset(dst.offset(off), 512) != 0 ) throw "Invalid align offset " + off;
+		// write mode truncates
+		f = open(path, WRITE, 0);
+		if( f == null || size(f) != 0 ) throw "Open for writing failed";
+		close(f);
+		sys.FileSystem.deleteFile(file);
+		if( open(path, READ, 0) != null ) throw "Opened a missing file";
+		Sys.println("RawFile OK");
+	}
+
+}
@@ -0,0 +1,85 @@
+class RegexpCache {
+
+	static inline var THREADS = 8;
+	static inline var ROUNDS = 2000;
+	// more distinct patterns than the cache slots
+	static inline var PATTERNS = 200;
+
+	static var PATTERN = "([a-z]+)@([a-z]+)\\.(com|org|net)";
+
+	// more groups than the per-thread match data initially holds
+	static function manyGroups() {
+		var b = new StringBuf();
+		for( i in 0...40 ) b.add("(" + String.fromCharCode("a".code + (i % 26)) + ")");
+		return b.toString();
+	}
+
+	static function checkMatch( r : EReg, name : String ) {
+		if( !r.match("mail bob@example.org now") ) throw name + " : no match";
+		if( r.matched(1) != "bob" || r.matched(2) != "example" || r.matched(3) != "org" ) throw name + " : invalid groups";
+		if( r.matchedLeft() != "mail " || r.matchedRight() != " now" ) throw name + " : invalid bounds";
+		if( r.match("nothing here") ) throw name + " : unexpected match";
+	}
+
+	static function checkGroups( r : EReg, text : String, name : String ) {
+		if( !r.match("<" + text + ">") ) throw name + " : no match with many groups";
+		for( i in 0...40 )
+			if( r.matched(i + 1) != text.charAt(i) ) throw name + " : invalid group " + (i + 1);
+	}
+
+	// compiling the same pattern again reuses the cached code, even after others were evicted
+	static function checkCache() {
+		var t0 = Sys.time();
+		for( i in 0...ROUNDS )
+			checkMatch(new EReg(PATTERN, ""), "cached");
+		var cached = Sys.time() - t0;
+		t0 = Sys.time();
+		for( i in 0...ROUNDS )
+			checkMatch(new EReg(PATTERN + "|z{" + (i + 1) + "}q", ""), "compiled");
+		var compiled = Sys.time() - t0;
+		if( cached >= compiled ) throw "The compiled pattern is not cached : " + cached + "s >= " + compiled + "s";
+		// options are part of the key
+		var r = new EReg(PATTERN, "i");
+		if( !r.match("BOB@EXAMPLE.COM") ) throw "Caseless pattern shares the case sensitive code";
+		if( new EReg(PATTERN, "").match("BOB@EXAMPLE.COM") ) throw "Case sensitive pattern shares the caseless code";
+	}
+
+	// all threads share the compiled code : the matches are per regexp, the match data per thread
+	static function checkThreads() {
+		var text = "";
+		for( i in 0...40 ) text += String.fromCharCode("a".code + (i % 26));
+		var groups = manyGroups();
+		var lock = new sys.thread.Lock();
+		var errors = [];
+		var mutex = new sys.thread.Mutex();
+		for( t in 0...THREADS )
+			sys.thread.Thread.create(function() {
+				try {
+					var shared = new EReg(PATTERN, "");
+					var many = new EReg(groups, "");
+					for( i in 0...ROUNDS ) {
+						checkMatch(shared, "thread " + t);
+						checkGroups(many, text, "thread " + t);
+						// churn the cache while the others match
+						var p = new EReg("^x" + ((i * THREADS + t) % PATTERNS) + "(y*)$", "");
+						if( !p.match("x" + ((i * THREADS + t) % PATTERNS) + "yy") || p.matched(1) != "yy" ) throw "thread " + t + " : invalid evicted pattern";
+					}
+				} catch( e : Dynamic ) {
+					mutex.acquire();
+					errors.push(Std.string(e));
+					mutex.release();
+				}
+				lock.release();
+			});
+		for( t in 0...THREADS )
+			lock.wait();
+		if( errors.length > 0 ) throw errors[0];
+	}
+
+	public static function main() {
+		checkCache();
+		checkThreads();
+		Sys.println("RegexpCache OK");
+	}
+
+}
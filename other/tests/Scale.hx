@@ -0,0 +1,100 @@
+class Scale {
+
+	static inline var NEAREST = 0;
+	static inline var BILINEAR = 1;
+	static inline var BOX = 2;
+	static inline var LANCZOS = 4;
+	static inline var THREADS = 8;
+
+	@:hlNative("fmt","img_scale") static function scale( out : hl.Bytes, outPos : Int, outStride : Int, outWidth : Int, outHeight : Int, src : hl.Bytes, srcPos : Int, srcStride : Int, srcWidth : Int, srcHeight : Int, flags : Int ) : Void {}
+
+	static function lanczos( x : Float ) {
+		if( x == 0 ) return 1.;
+		if( x <= -3 || x >= 3 ) return 0.;
+		var px = x * Math.PI;
+		return 3 * Math.sin(px) * Math.sin(px / 3) / (px * px);
+	}
+
+	// source index and normalized weights of output pixel i, in double precision
+	static function coefs( filter : Int, inSize : Int, outSize : Int, i : Int ) {
+		if( filter == NEAREST || filter == BILINEAR ) {
+			var scale = outSize <= 1 ? 0 : (inSize - 1.001) / (outSize - 1);
+			var f = i * scale;
+			var ix = Std.int(f);
+			if( filter == NEAREST || ix + 1 >= inSize ) return { start : ix, weights : [1.] };
+			return { start : ix, weights : [1 - (f - ix), f - ix] };
+		}
+		var scale = inSize / outSize;
+		var fscale = scale < 1 ? 1 : scale;
+		var support = (filter == BOX ? 0.5 : 3) * fscale;
+		var center = (i + 0.5) * scale;
+		var xmin = Std.int(Math.max(0, Math.floor(center - support)));
+		var xmax = Std.int(Math.min(inSize, Math.ceil(center + support)));
+		var weights = [];
+		var sum = 0.;
+		for( x in xmin...xmax ) {
+			var d = (x + 0.5 - center) / fscale;
+			var w = filter == BOX ? (d >= -0.5 && d < 0.5 ? 1 : 0) : lanczos(d);
+			weights.push(w);
+			sum += w;
+		}
+		return { start : xmin, weights : [for( w in weights ) w / sum] };
+	}
+
+	static function reference( src : hl.Bytes, w : Int, h : Int, outWidth : Int, outHeight : Int, filter : Int ) {
+		var out = new hl.Bytes(outWidth * outHeight * 4);
+		var xcoefs = [for( x in 0...outWidth ) coefs(filter, w, outWidth, x)];
+		for( y in 0...outHeight ) {
+			var yc = coefs(filter, h, outHeight, y);
+			for( x in 0...outWidth ) {
+				var xc = xcoefs[x];
+				for( c in 0...4 ) {
+					var v = 0.;
+					for( j in 0...yc.weights.length )
+						for( i in 0...xc.weights.length )
+							v += yc.weights[j] * xc.weights[i] * src[((yc.start + j) * w + xc.start + i) * 4 + c];
+					var p = Math.floor(v + 0.5);
+					out[(y * outWidth + x) * 4 + c] = p < 0 ? 0 : p > 255 ? 255 : p;
+				}
+			}
+		}
+		return out;
+	}
+
+	public static function main() {
+		var w = 97, h = 61;
+		// a smooth image : the fixed point filters stay within one unit of the reference
+		var src = new hl.Bytes(w * h * 4);
+		for( y in 0...h )
+			for( x in 0...w )
+				for( c in 0...4 )
+					src[(y * w + x) * 4 + c] = Std.int(128 + 100 * Math.sin(x * 0.05 + c) * Math.cos(y * 0.07 + c * 2));
+		for( size in [[33, 20], [250, 190], [97, 61], [300, 17], [1, 1], [40, 400]] ) {
+			var ow = size[0], oh = size[1], len = ow * oh * 4;
+			for( filter in [NEAREST, BILINEAR, BOX, LANCZOS] ) {
+				var single = new hl.Bytes(len), threaded = new hl.Bytes(len);
+				scale(single, 0, ow * 4, ow, oh, src, 0, w * 4, w, h, filter);
+				// the threaded bands give exactly the same pixels
+				scale(threaded, 0, ow * 4, ow, oh, src, 0, w * 4, w, h, filter | THREADS);
+				if( threaded.compare(0, single, 0, len) != 0 ) throw "Threaded scale mismatch " + ow + "x" + oh + " filter " + filter;
+				var ref = reference(src, w, h, ow, oh, filter);
+				for( i in 0...len )
+					if( Std.int(Math.abs(single[i] - ref[i])) > 1 )
+						throw "Scale " + ow + "x" + oh + " filter " + filter + " differs from reference at " + i + " : " + single[i] + " should be " + ref[i];
+			}
+		}
+		// output position and padded stride
+		var ow = 50, oh = 40, stride = ow * 4 + 12;
+		var padded = new hl.Bytes(stride * oh + 16), packed = new hl.Bytes(ow * oh * 4);
+		padded.fill(0, stride * oh + 16, 0xAB);
+		scale(padded, 16, stride, ow, oh, src, 0, w * 4, w, h, LANCZOS | THREADS);
+		scale(packed, 0, ow * 4, ow, oh, src, 0, w * 4, w, h, LANCZOS);
+		for( y in 0...oh ) {
+			if( padded.compare(16 + y * stride, packed, y * ow * 4, ow * 4) != 0 ) throw "Strided row mismatch " + y;
+			for( i in ow * 4...stride )
+				if( y < oh - 1 && padded[16 + y * stride + i] != 0xAB ) throw "Padding overwritten at row " + y;
+		}
+		Sys.println("Scale OK");
+	}
+
+}
@@ -0,0 +1,120 @@
+typedef SocketHandle = hl.Abstract<"hl_socket">;
+typedef RawHandle = hl.Abstract<"hl_fraw">;
+typedef UvHandle = hl.Abstract<"uv_handle">;
+
+class SendFile {
+
+	static inline var READ_WRITE_CREATE = 4;
+	// larger than the socket buffers, sent from an unaligned offset, the last chunk is shorter
+	static inline var SIZE = 8 << 20;
+	static inline var OFFSET = 12345;
+	static inline var LENGTH = SIZE - OFFSET - 1000;
+	static inline var CHUNK = 1 << 20;
+	static inline var UV_EAGAIN = -11;
+
+	@:hlNative("std","socket_send_file") static function sendFile( s : SocketHandle, fd : Int, offset : haxe.Int64, len : Int ) : Int { return 0; }
+	@:hlNative("std","socket_recv") static function recv( s : SocketHandle, buf : hl.Bytes, pos : Int, len : Int ) : Int { return 0; }
+	@:hlNative("std","file_raw_open") static function open( name : hl.Bytes, mode : Int, flags : Int ) : RawHandle { return null; }
+	@:hlNative("std","file_raw_fd") static function rawFd( f : RawHandle ) : Int { return 0; }
+	@:hlNative("std","file_raw_pwrite") static function pwrite( f : RawHandle, buf : hl.Bytes, pos : Int, len : Int, offset : haxe.Int64 ) : Int { return 0; }
+	@:hlNative("std","file_raw_close") static function close( f : RawHandle ) : Void {}
+	@:hlNative("uv","stream_send_file") static function uvSendFile( s : UvHandle, fd : Int, offset : haxe.Int64, len : Int, callb : Int -> Void ) : Bool { return false; }
+
+	static function handle( s : sys.net.Socket ) : SocketHandle {
+		return @:privateAccess s.__s;
+	}
+
+	static function checkSocket( data : hl.Bytes, fd : Int ) {
+		var port = 6120;
+		var server = new sys.net.Socket();
+		server.bind(new sys.net.Host("127.0.0.1"), port);
+		server.listen(1);
+		var c = new sys.net.Socket();
+		c.connect(new sys.net.Host("127.0.0.1"), port);
+		var s = server.accept();
+		// the peer reads while we send, the range doesn't fit in the socket buffers
+		var received = new hl.Bytes(LENGTH);
+		var total = 0, done = false;
+		sys.thread.Thread.create(function() {
+			while( total < LENGTH ) {
+				var n = recv(handle(s), received, total, LENGTH - total);
+				if( n <= 0 ) break;
+				total += n;
+			}
+			done = true;
+		});
+		var pos = 0;
+		while( pos < LENGTH ) {
+			var len = LENGTH - pos < CHUNK ? LENGTH - pos : CHUNK;
+			var n = sendFile(handle(c), fd, OFFSET + pos, len);
+			if( n <= 0 ) throw "Send failed : " + n;
+			pos += n;
+		}
+		while( !done ) Sys.sleep(0.01);
+		if( total != LENGTH ) throw "Received " + total + " bytes";
+		if( received.compare(0, data, OFFSET, LENGTH) != 0 ) throw "Received data mismatch";
+		if( sendFile(handle(c), fd, SIZE, 100) != 0 ) throw "Sent after end of file";
+		s.close();
+		c.close();
+		server.close();
+	}
+
+	static function checkUv( data : hl.Bytes, fd : Int ) {
+		var port = 6121;
+		var host = new sys.net.Host("127.0.0.1");
+		var loop = hl.uv.Loop.getDefault();
+		var server = new hl.uv.Tcp(loop);
+		var received = new haxe.io.BytesBuffer();
+		server.bind(host, port);
+		server.listen(1, function() {
+			var s = server.accept();
+			s.readStart(function(bytes) {
+				if( bytes == null ) {
+					s.close();
+					server.close();
+					return;
+				}
+				received.add(bytes);
+			});
+		});
+		var client = new hl.uv.Tcp(loop);
+		var pos = 0;
+		function next() {
+			var len = LENGTH - pos < CHUNK ? LENGTH - pos : CHUNK;
+			var ok = uvSendFile(@:privateAccess client.handle, fd, OFFSET + pos, len, function(n) {
+				// the socket is not blocking : try again once the peer has read
+				if( n == UV_EAGAIN ) n = 0;
+				if( n < 0 ) throw "Send failed : " + n;
+				pos += n;
+				if( pos < LENGTH ) next() else client.close();
+			});
+			if( !ok ) throw "Send not started";
+		}
+		client.connect(host, port, function(ok) {
+			if( !ok ) throw "Connect failed";
+			next();
+		});
+		loop.run(Default);
+		var bytes = received.getBytes();
+		if( bytes.length != LENGTH ) throw "Received " + bytes.length + " bytes with uv";
+		if( data.compare(OFFSET, @:privateAccess bytes.b, 0, LENGTH) != 0 ) throw "Received data mismatch with uv";
+	}
+
+	public static function main() {
+		var file = "send_file_test.bin";
+		var data = new hl.Bytes(SIZE);
+		var rnd = 7;
+		for( i in 0...SIZE ) {
+			rnd = rnd * 1103515245 + 12345;
+			data[i] = rnd >>> 16;
+		}
+		var f = open(@:privateAccess Sys.getPath(file), READ_WRITE_CREATE, 0);
+		if( f == null || pwrite(f, data, 0, SIZE, 0) != SIZE ) throw "Write failed";
+		checkSocket(data, rawFd(f));
+		checkUv(data, rawFd(f));
+		close(f);
+		sys.FileSystem.deleteFile(file);
+		Sys.println("SendFile OK");
+	}
+
+}
@@ -0,0 +1,115 @@
+typedef SocketHandle = hl.Abstract<"hl_socket">;
+typedef Poller = hl.Abstract<"hl_poll">;
+
+class SocketPoll {
+
+	static inline var READ = 1;
+	static inline var EDGE = 4;
+
+	@:hlNative("std","poll_alloc") static function poll_alloc() : Poller {
+		return null;
+	}
+
+	@:hlNative("std","poll_add") static function poll_add( p : Poller, s : SocketHandle, flags : Int ) : Bool {
+		return false;
+	}
+
+	@:hlNative("std","poll_remove") static function poll_remove( p : Poller, s : SocketHandle ) : Bool {
+		return false;
+	}
+
+	@:hlNative("std","poll_wait") static function poll_wait( p : Poller, out : hl.NativeArray<SocketHandle>, events : hl.Bytes, timeout : Float ) : Int {
+		return 0;
+	}
+
+	@:hlNative("std","socket_recv") static function socket_recv( s : SocketHandle, buf : hl.Bytes, pos : Int, len : Int ) : Int {
+		return 0;
+	}
+
+	static function handle( s : sys.net.Socket ) : SocketHandle {
+		return @:privateAccess s.__s;
+	}
+
+	// a socket closed without being removed frees its fd for the next socket :
+	// adding the new one must still register it
+	static function checkReuse( server : sys.net.Socket, port : Int ) {
+		var poller = poll_alloc();
+		var out = new hl.NativeArray<SocketHandle>(4);
+		var events = new hl.Bytes(4 * 4);
+		var buf = new hl.Bytes(64);
+		if( poll_wait(poller, new hl.NativeArray<SocketHandle>(0), events, 0.) != 0 ) throw "Wait without output should return 0";
+		for( i in 0...2 ) {
+			var c = new sys.net.Socket();
+			c.connect(new sys.net.Host("127.0.0.1"), port);
+			var s = server.accept();
+			// both ends are polled : the next round reuses both fds
+			if( !poll_add(poller, handle(c), READ) || !poll_add(poller, handle(s), READ) ) throw "poll_add failed in round " + i;
+			if( !poll_add(poller, handle(s), READ) ) throw "poll_add failed twice in round " + i;
+			c.output.writeByte(i);
+			if( poll_wait(poller, out, events, 1.) != 1 || out[0] != handle(s) ) throw "Missing event in round " + i;
+			socket_recv(handle(s), buf, 0, 64);
+			s.close();
+			c.close();
+		}
+	}
+
+	public static function main() {
+		var args = Sys.args();
+		var count = args.length > 0 ? Std.parseInt(args[0]) : 10000;
+		var rounds = 20;
+		var port = 6100;
+		var server = new sys.net.Socket();
+		server.bind(new sys.net.Host("127.0.0.1"), port);
+		server.listen(4096);
+		checkReuse(server, port);
+
+		var poller = poll_alloc();
+		var clients = [], peers = [];
+		for( i in 0...count ) {
+			var c = new sys.net.Socket();
+			c.connect(new sys.net.Host("127.0.0.1"), port);
+			var s = server.accept();
+			s.setBlocking(false);
+			clients.push(c);
+			peers.push(s);
+			if( !poll_add(poller, handle(s), READ | EDGE) ) throw "poll_add failed";
+		}
+
+		var out = new hl.NativeArray<SocketHandle>(256);
+		var events = new hl.Bytes(256 * 4);
+		var buf = new hl.Bytes(64);
+		var t0 = Sys.time();
+		var total = 0;
+		for( r in 0...rounds ) {
+			var want = 0;
+			var i = r % 7;
+			while( i < count ) {
+				clients[i].output.writeByte(r);
+				want++;
+				i += 7;
+			}
+			var got = 0;
+			while( got < want ) {
+				var n = poll_wait(poller, out, events, 1.);
+				if( n <= 0 ) throw "Timeout with " + got + "/" + want + " events";
+				for( k in 0...n ) {
+					var s = out[k];
+					// edge triggered : drain everything
+					while( socket_recv(s, buf, 0, 64) > 0 )
+						got++;
+				}
+			}
+			total += got;
+		}
+		trace(count + " connections, " + total + " events in " + (Sys.time() - t0));
+
+		for( s in peers ) {
+			poll_remove(poller, handle(s));
+			s.close();
+		}
+		for( c in clients )
+			c.close();
+		server.close();
+	}
+
+}
@@ -0,0 +1,89 @@
+typedef SocketHandle = hl.Abstract<"hl_socket">;
+
+class UdpBatch {
+
+	static inline var STRIDE = 5;
+	static inline var SLOT = 1024;
+
+	@:hlNative("std","socket_send_batch") static function sendBatch( s : SocketHandle, data : hl.Bytes, entries : hl.Bytes, count : Int ) : Int { return 0; }
+	@:hlNative("std","socket_recv_batch") static function recvBatch( s : SocketHandle, data : hl.Bytes, entries : hl.Bytes, count : Int ) : Int { return 0; }
+
+	static function handle( s : sys.net.UdpSocket ) : SocketHandle {
+		return @:privateAccess s.__s;
+	}
+
+	static function setEntry( e : hl.Bytes, i : Int, pos : Int, len : Int, host : Int, port : Int, segment : Int ) {
+		var p = i * STRIDE * 4;
+		e.setI32(p, pos);
+		e.setI32(p + 4, len);
+		e.setI32(p + 8, host);
+		e.setI32(p + 12, port);
+		e.setI32(p + 16, segment);
+	}
+
+	static inline function entry( e : hl.Bytes, i : Int, field : Int ) {
+		return e.getI32((i * STRIDE + field) * 4);
+	}
+
+	// receives until total bytes arrived, calls check with the data and entries of each datagram
+	static function recvAll( s : sys.net.UdpSocket, total : Int, check : hl.Bytes -> Int -> hl.Bytes -> Void ) {
+		var data = new hl.Bytes(64 * SLOT), entries = new hl.Bytes(64 * STRIDE * 4);
+		while( total > 0 ) {
+			for( i in 0...64 ) setEntry(entries, i, i * SLOT, SLOT, 0, 0, 0);
+			var n = recvBatch(handle(s), data, entries, 64);
+			if( n <= 0 ) throw "Receive failed : " + n;
+			for( i in 0...n ) {
+				check(data, i, entries);
+				total -= entry(entries, i, 1);
+			}
+		}
+	}
+
+	public static function main() {
+		var host = new sys.net.Host("127.0.0.1");
+		var a = new sys.net.UdpSocket(), b = new sys.net.UdpSocket();
+		a.bind(host, 6201);
+		b.bind(host, 6202);
+		b.setTimeout(5);
+
+		var src = new hl.Bytes(65536);
+		for( i in 0...65536 ) src[i] = i * 7 + (i >> 8);
+
+		// datagrams of various sizes are received intact, in order, with their sender
+		var count = 100, pos = 0;
+		var entries = new hl.Bytes(count * STRIDE * 4);
+		for( i in 0...count ) {
+			var len = 1 + (i * 37) % 500;
+			setEntry(entries, i, pos, len, host.ip, 6202, 0);
+			pos += len;
+		}
+		if( sendBatch(handle(a), src, entries, count) != count ) throw "Short batch send";
+		var index = 0;
+		recvAll(b, pos, function(data, i, e) {
+			var len = entry(entries, index, 1);
+			if( entry(e, i, 1) != len ) throw "Datagram " + index + " size " + entry(e, i, 1) + " should be " + len;
+			if( data.compare(entry(e, i, 0), src, entry(entries, index, 0), len) != 0 ) throw "Datagram " + index + " mismatch";
+			if( entry(e, i, 2) != host.ip || entry(e, i, 3) != 6201 ) throw "Invalid sender";
+			index++;
+		});
+
+		// with a segment size, the payload is received as several datagrams on Linux (GSO)
+		// and as a single one elsewhere
+		setEntry(entries, 0, 0, 350, host.ip, 6202, 100);
+		if( sendBatch(handle(a), src, entries, 1) != 1 || entry(entries, 0, 1) != 350 ) throw "Segmented send failed";
+		var sizes = [], offset = 0;
+		recvAll(b, 350, function(data, i, e) {
+			var len = entry(e, i, 1);
+			if( data.compare(entry(e, i, 0), src, offset, len) != 0 ) throw "Segment mismatch at " + offset;
+			sizes.push(len);
+			offset += len;
+		});
+		var expect = Sys.systemName() == "Linux" ? "100,100,100,50" : "350";
+		if( sizes.join(",") != expect ) throw "Segments " + sizes;
+
+		a.close();
+		b.close();
+		Sys.println("UdpBatch OK");
+	}
+
+}
@@ -0,0 +1,97 @@
+class Utf8 {
+
+	@:hlNative("std","utf8_to_utf16") static function toUtf16( str : hl.Bytes, pos : Int, size : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("std","utf16_to_utf8") static function toUtf8( str : hl.Bytes, len : Int, size : hl.Ref<Int> ) : hl.Bytes { return null; }
+	@:hlNative("std","ucs2length") static function ucs2Length( str : hl.Bytes, pos : Int ) : Int { return 0; }
+
+	// reference encoding of a list of code points, without any fast path
+	static function encode( codes : Array<Int> ) {
+		var u8 = new haxe.io.BytesBuffer(), u16 = new haxe.io.BytesBuffer();
+		for( c in codes ) {
+			if( c < 0x80 )
+				u8.addByte(c);
+			else if( c < 0x800 ) {
+				u8.addByte(0xC0 | (c >> 6));
+				u8.addByte(0x80 | (c & 63));
+			} else if( c < 0x10000 ) {
+				u8.addByte(0xE0 | (c >> 12));
+				u8.addByte(0x80 | ((c >> 6) & 63));
+				u8.addByte(0x80 | (c & 63));
+			} else {
+				u8.addByte(0xF0 | (c >> 18));
+				u8.addByte(0x80 | ((c >> 12) & 63));
+				u8.addByte(0x80 | ((c >> 6) & 63));
+				u8.addByte(0x80 | (c & 63));
+			}
+			if( c < 0x10000 )
+				u16.addUInt16(c);
+			else {
+				u16.addUInt16(((c - 0x10000) >> 10) + 0xD800);
+				u16.addUInt16(((c - 0x10000) & 0x3FF) | 0xDC00);
+			}
+		}
+		u8.addByte(0);
+		u16.addUInt16(0);
+		return { u8 : u8.getBytes(), u16 : u16.getBytes() };
+	}
+
+	static var rnd = 1;
+	static function random( n : Int ) {
+		rnd = (rnd * 1103515245 + 12345) & 0x7FFFFFFF;
+		return (rnd >> 8) % n;
+	}
+
+	// mostly ASCII text, with the given ratio of other code points
+	static function text( len : Int, other : Void -> Int, ratio : Int ) {
+		return [for( i in 0...len ) random(100) < ratio ? other() : 32 + random(95)];
+	}
+
+	static function latin() return 0xA0 + random(0x160);
+	static function cjk() return 0x4E00 + random(0x5200);
+	static function emoji() return 0x1F300 + random(0x300);
+
+	static function check() {
+		var kinds = [latin, cjk, emoji];
+		for( n in 0...3000 ) {
+			// lengths around the 8 and 16 units steps, non-ASCII chars at every position
+			var codes = text(random(70), kinds[n % 3], [0, 1, 10, 50, 100][n % 5]);
+			var ref = encode(codes);
+			var u8 = @:privateAccess ref.u8.b, u16 = @:privateAccess ref.u16.b;
+			var len8 = ref.u8.length - 1, len16 = (ref.u16.length >> 1) - 1;
+			var size = 0;
+			var out = toUtf16(u8, 0, size);
+			if( size != len16 << 1 || out.compare(0, u16, 0, size + 2) != 0 ) throw "Invalid UTF-16 for " + codes;
+			if( ucs2Length(out, 0) != len16 ) throw "Invalid length for " + codes;
+			// with an explicit length and with a terminating zero
+			for( len in [len16, 0] ) {
+				var back = toUtf8(u16, len, size);
+				if( size != len8 || back.compare(0, u8, 0, len8) != 0 ) throw "Invalid UTF-8 for " + codes;
+			}
+		}
+	}
+
+	static function bench( name : String, codes : Array<Int> ) {
+		var ref = encode(codes);
+		var u8 = @:privateAccess ref.u8.b, u16 = @:privateAccess ref.u16.b;
+		var len16 = (ref.u16.length >> 1) - 1;
+		var count = 200;
+		var size = 0;
+		var t0 = Sys.time();
+		for( i in 0...count ) toUtf16(u8, 0, size);
+		var t1 = Sys.time();
+		for( i in 0...count ) toUtf8(u16, len16, size);
+		var t2 = Sys.time();
+		var mb = (ref.u8.length - 1) * count / 1e6;
+		Sys.println(name + " utf8->utf16 " + Std.int(mb / (t1 - t0)) + " MB/s, utf16->utf8 " + Std.int(mb / (t2 - t1)) + " MB/s");
+	}
+
+	public static function main() {
+		check();
+		var len = 1 << 20;
+		bench("ascii", text(len, latin, 0));
+		bench("latin", text(len, latin, 10));
+		bench("cjk", text(len, cjk, 100));
+		Sys.println("Utf8 OK");
+	}
+
+}
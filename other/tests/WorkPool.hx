@@ -0,0 +1,113 @@
+typedef Ring = hl.Abstract<"hl_ring">;
+typedef Pool = hl.Abstract<"hl_pool">;
+
+class WorkPool {
+
+	@:hlNative("std","thread_create") static function threadCreate( f : Void -> Void ) : hl.Abstract<"hl_thread"> { return null; }
+	@:hlNative("std","ring_alloc") static function ringAlloc( size : Int ) : Ring { return null; }
+	@:hlNative("std","ring_push") static function ringPush( r : Ring, msg : Dynamic ) : Bool { return false; }
+	@:hlNative("std","ring_pop") static function ringPop( r : Ring, block : Bool ) : Dynamic { return null; }
+	@:hlNative("std","ring_size") static function ringSize( r : Ring ) : Int { return 0; }
+	@:hlNative("std","pool_alloc") static function poolAlloc( workers : Int ) : Pool { return null; }
+	@:hlNative("std","pool_submit") static function poolSubmit( p : Pool, f : Void -> Void ) : Void {}
+	@:hlNative("std","pool_parallel_for") static function parallelFor( p : Pool, start : Int, end : Int, chunk : Int, f : Int -> Int -> Void ) : Void {}
+	@:hlNative("std","pool_workers") static function poolWorkers( p : Pool ) : Int { return 0; }
+
+	static function checkRing() {
+		// the size is rounded to a power of two
+		var r = ringAlloc(5);
+		for( i in 0...8 )
+			if( !ringPush(r, i) ) throw "Ring full at " + i;
+		if( ringPush(r, 8) ) throw "Pushed on a full ring";
+		if( ringSize(r) != 8 ) throw "Invalid size " + ringSize(r);
+		for( i in 0...8 )
+			if( ringPop(r, false) != i ) throw "Invalid order";
+		if( ringPop(r, false) != null ) throw "Popped from an empty ring";
+	}
+
+	// every pushed value is received exactly once, whatever the number of producers and consumers
+	static function checkMPMC( producers : Int, consumers : Int, count : Int ) {
+		var r = ringAlloc(64);
+		var done = ringAlloc(64);
+		var seen = new hl.Bytes(producers * count);
+		seen.fill(0, producers * count, 0);
+		for( p in 0...producers )
+			threadCreate(function() {
+				for( i in 0...count ) {
+					var v = p * count + i;
+					while( !ringPush(r, v) ) Sys.sleep(0);
+				}
+				ringPush(done, -1);
+			});
+		for( c in 0...consumers )
+			threadCreate(function() {
+				var n = 0;
+				while( true ) {
+					var v : Int = ringPop(r, true);
+					if( v < 0 ) break;
+					seen[v]++;
+					n++;
+				}
+				ringPush(done, n);
+			});
+		for( p in 0...producers ) ringPop(done, true);
+		// one stop message per consumer
+		for( c in 0...consumers )
+			while( !ringPush(r, -1) ) Sys.sleep(0);
+		var total = 0;
+		for( c in 0...consumers ) total += (ringPop(done, true) : Int);
+		if( total != producers * count ) throw "Received " + total + " values";
+		for( i in 0...producers * count )
+			if( seen[i] != 1 ) throw "Value " + i + " received " + seen[i] + " times";
+	}
+
+	static function checkParallelFor( p : Pool ) {
+		var size = 100003;
+		var hits = new hl.Bytes(size);
+		for( chunk in [0, 1, 7, 4096, size] ) {
+			hits.fill(0, size, 0);
+			parallelFor(p, 0, size, chunk, function(start, end) {
+				for( i in start...end ) hits[i]++;
+			});
+			for( i in 0...size )
+				if( hits[i] != 1 ) throw "Index " + i + " visited " + hits[i] + " times with chunk " + chunk;
+		}
+		// a sub range, and an empty one
+		hits.fill(0, size, 0);
+		parallelFor(p, 100, 200, 3, function(start, end) for( i in start...end ) hits[i]++);
+		parallelFor(p, 50, 50, 0, function(_, _) throw "Called on an empty range");
+		for( i in 0...size )
+			if( hits[i] != (i >= 100 && i < 200 ? 1 : 0) ) throw "Invalid sub range at " + i;
+		// the exception of a chunk is rethrown in the caller, once all chunks are done
+		var caught = null;
+		try {
+			parallelFor(p, 0, 1000, 10, function(start, end) if( start == 500 ) throw "chunk " + start);
+		} catch( e : String ) {
+			caught = e;
+		}
+		if( caught != "chunk 500" ) throw "Exception not rethrown : " + caught;
+	}
+
+	static function checkSubmit( p : Pool ) {
+		var count = 10000;
+		var done = ringAlloc(count);
+		for( i in 0...count )
+			poolSubmit(p, function() ringPush(done, i));
+		var sum = 0.;
+		for( i in 0...count ) sum += (ringPop(done, true) : Int);
+		if( sum != count * (count - 1) / 2 ) throw "Invalid tasks sum " + sum;
+	}
+
+	public static function main() {
+		checkRing();
+		checkMPMC(1, 1, 100000);
+		checkMPMC(4, 4, 100000);
+		checkMPMC(8, 2, 50000);
+		var p = poolAlloc(4);
+		if( poolWorkers(p) != 4 ) throw "Invalid workers count";
+		checkParallelFor(p);
+		checkSubmit(p);
+		Sys.println("WorkPool OK");
+	}
+
+}
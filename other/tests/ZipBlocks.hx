@@ -0,0 +1,71 @@
+typedef Zip = hl.Abstract<"fmt_zip">;
+
+class ZipBlocks {
+
+	static inline var GZIP = 1;
+	static inline var RAW = 2;
+	static inline var BLOCKS = 4;
+	static inline var FAST = 8;
+
+	@:hlNative("fmt","zip_compress") static function compress( src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, level : Int, flags : Int ) : Int { return 0; }
+	@:hlNative("fmt","zip_uncompress") static function uncompress( src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, flags : Int ) : Int { return 0; }
+	@:hlNative("fmt","zip_compress_bound") static function compressBound( size : Int, flags : Int ) : Int { return 0; }
+	@:hlNative("fmt","zip_has_fast") static function hasFast() : Bool { return false; }
+	@:hlNative("fmt","inflate_init") static function inflateInit( wbits : Int ) : Zip { return null; }
+	@:hlNative("fmt","inflate_buffer") static function inflateBuffer( z : Zip, src : hl.Bytes, srcPos : Int, srcLen : Int, dst : hl.Bytes, dstPos : Int, dstLen : Int, read : hl.Ref<Int>, write : hl.Ref<Int> ) : Bool { return false; }
+	@:hlNative("fmt","zip_end") static function zipEnd( z : Zip ) : Void {}
+
+	// the streaming decoder, fed by small chunks, is the reference
+	static function inflate( src : hl.Bytes, len : Int, dst : hl.Bytes, dstLen : Int, format : Int ) {
+		var z = inflateInit([15, 31, -15][format]);
+		var spos = 0, dpos = 0;
+		while( true ) {
+			var read = 0, write = 0;
+			var slen = len - spos < 1000 ? len - spos : 1000;
+			var dlen = dstLen - dpos < 1000 ? dstLen - dpos : 1000;
+			var done = inflateBuffer(z, src, spos, spos + slen, dst, dpos, dpos + dlen, read, write);
+			spos += read;
+			dpos += write;
+			if( done ) break;
+			if( read == 0 && write == 0 ) throw "Stream is stuck";
+		}
+		zipEnd(z);
+		return dpos;
+	}
+
+	public static function main() {
+		// the build was configured with libdeflate : make sure it is used
+		if( Sys.args()[0] == "libdeflate" && !hasFast() ) throw "fmt was built without libdeflate";
+		var max = 5 << 20;
+		var src = new hl.Bytes(max);
+		var text = "hello world, compress me ";
+		var rnd = 5;
+		for( i in 0...max ) {
+			rnd = rnd * 1103515245 + 12345;
+			src[i] = i % 3000 < 2000 ? StringTools.fastCodeAt(text, i % text.length) : rnd >>> 16;
+		}
+		var flags = [0, BLOCKS, FAST, BLOCKS | FAST];
+		// sizes around the 128KB blocks
+		for( size in [0, 1, 1000, (128 << 10) - 1, 128 << 10, (128 << 10) + 1, (1 << 20) + 777, max] )
+			for( format in [0, GZIP, RAW] )
+				for( f in flags ) {
+					var bound = compressBound(size, f | format);
+					var packed = new hl.Bytes(bound), out = new hl.Bytes(size + 1);
+					var len = compress(src, 0, size, packed, 0, bound, 6, f | format);
+					var name = size + " bytes, format " + format + ", flags " + f;
+					if( len < 0 ) throw "Compress failed with " + name;
+					// any one-shot decoder and the streaming one read all the outputs
+					for( d in flags )
+						if( uncompress(packed, 0, len, out, 0, size, d | format) != size || out.compare(0, src, 0, size) != 0 )
+							throw "Uncompress mismatch with " + name + ", decoder flags " + d;
+					if( inflate(packed, len, out, size + 1, format) != size || out.compare(0, src, 0, size) != 0 )
+						throw "Inflate mismatch with " + name;
+					if( size > 1000 ) {
+						if( uncompress(packed, 0, len, out, 0, size - 1, f | format) != -1 ) throw "Uncompressed in a too small buffer with " + name;
+						if( compress(src, 0, size, packed, 0, len - 1, 6, f | format) != -1 ) throw "Compressed in a too small buffer with " + name;
+					}
+				}
+		Sys.println("ZipBlocks OK (" + (hasFast() ? "libdeflate" : "zlib") + ")");
+	}
+
+}
@@ -0,0 +1,280 @@
+"""
+Minimal MySQL protocol server for Mysql.hx : it only answers the queries of the test.
+
+	python3 mysql_stub.py <command> [args...]
+
+starts the server on a free port, runs the command with MYSQL_HOST and MYSQL_PORT set
+and exits with its status. With --port <port> instead of a command, it only serves.
+
+Queries (text protocol) :
+	SELECT ROWS <n>          n rows of (id INT, name VARCHAR) : (i, "name<i>")
+	SELECT ROWS <n> ERROR    the same, interrupted by an error after n/2 rows
+	SELECT BIG <n> <size>    n rows of one VARCHAR of size bytes
+	SELECT BATCH             the sum of the values inserted with INSERT BATCH ?
+	SELECT <int>             one row with this INT
+	FAIL ...                 an error
+	anything else            OK, one affected row
+
+Prepared statements (binary protocol) :
+	SELECT TYPES             DATE, TIME, DATETIME, BIGINT UNSIGNED, FLOAT, DOUBLE, INT UNSIGNED, TINYINT
+	                         rows : all values, all NULL, every other column NULL
+	SELECT ?, ?, ...         echoes the parameters
+	SELECT <int>             one row with this INT
+	INSERT BATCH ?           adds the parameter to the SELECT BATCH sum
+	anything else            OK, one affected row
+
+The socket buffers are small and a query is only read once the previous answer is sent,
+like a server blocked on a large answer.
+"""
+import os, socket, struct, subprocess, sys, threading
+
+T_TINY, T_LONG, T_FLOAT, T_DOUBLE, T_NULL, T_LONGLONG = 1, 3, 4, 5, 6, 8
+T_DATE, T_TIME, T_DATETIME, T_VAR_STRING = 10, 11, 12, 253
+UNSIGNED = 32
+SOCKET_BUFFER = 1 << 16
+TIMEOUT = 60
+
+def lenenc( n ):
+	if n < 251: return bytes([n])
+	if n < 1 << 16: return b"\xfc" + struct.pack("<H", n)
+	if n < 1 << 24: return b"\xfd" + struct.pack("<I", n)[:3]
+	return b"\xfe" + struct.pack("<Q", n)
+
+def lstr( s ):
+	return lenenc(len(s)) + s
+
+def read_lenenc( d, pos ):
+	if d[pos] == 0xfc: return struct.unpack("<H", d[pos + 1:pos + 3])[0], pos + 3
+	if d[pos] == 0xfd: return struct.unpack("<I", d[pos + 1:pos + 4] + b"\0")[0], pos + 4
+	if d[pos] == 0xfe: return struct.unpack("<Q", d[pos + 1:pos + 9])[0], pos + 9
+	return d[pos], pos + 1
+
+TYPES = [(b"d", T_DATE, 0), (b"t", T_TIME, 0), (b"dt", T_DATETIME, 0), (b"u64", T_LONGLONG, UNSIGNED),
+	(b"f", T_FLOAT, 0), (b"g", T_DOUBLE, 0), (b"u32", T_LONG, UNSIGNED), (b"i8", T_TINY, 0)]
+TYPES_VALUES = [
+	b"\x04" + struct.pack("<HBB", 2024, 2, 29),
+	b"\x08" + struct.pack("<BIBBB", 1, 1, 2, 3, 4), # -26:03:04
+	b"\x07" + struct.pack("<HBBBBB", 2024, 2, 29, 13, 14, 15),
+	struct.pack("<Q", 2 ** 64 - 1),
+	struct.pack("<f", 1.5),
+	struct.pack("<d", 0.1),
+	struct.pack("<I", 4000000000),
+	struct.pack("<b", -5),
+]
+
+class Connection:
+
+	def __init__( self, sock ):
+		self.sock = sock
+		self.seq = 0
+		self.stmts = {}
+		self.next_stmt = 1
+		self.batch = 0
+		self.out = bytearray()
+
+	def send( self, data ):
+		self.out += struct.pack("<I", len(data))[:3] + bytes([self.seq & 255]) + data
+		self.seq += 1
+		if len(self.out) >= 1 << 16: self.flush()
+
+	def flush( self ):
+		self.sock.sendall(self.out)
+		self.out = bytearray()
+
+	def read( self, n ):
+		data = b""
+		while len(data) < n:
+			c = self.sock.recv(n - len(data))
+			if not c: return None
+			data += c
+		return data
+
+	def recv( self ):
+		h = self.read(4)
+		if h is None: return None
+		self.seq = h[3] + 1
+		return self.read(h[0] | (h[1] << 8) | (h[2] << 16))
+
+	def ok( self, affected = 0 ):
+		self.send(b"\0" + lenenc(affected) + lenenc(0) + struct.pack("<HH", 2, 0))
+
+	def eof( self ):
+		self.send(b"\xfe" + struct.pack("<HH", 0, 2))
+
+	def error( self, msg ):
+		self.send(b"\xff" + struct.pack("<H", 1064) + b"#42000" + msg)
+
+	def column( self, name, t, flags = 0 ):
+		self.send(lstr(b"def") + lstr(b"test") + lstr(b"stub") + lstr(b"stub") + lstr(name) + lstr(name)
+			+ b"\x0c" + struct.pack("<HIBHB", 33, 1 << 24, t, flags, 0) + b"\0\0")
+
+	def columns( self, cols ):
+		self.send(lenenc(len(cols)))
+		for c in cols: self.column(*c)
+		self.eof()
+
+	# the null bitmap of a binary row starts at bit 2
+	def binary_row( self, cols, values ):
+		bitmap = bytearray((len(cols) + 9) // 8)
+		body = b""
+		for i, v in enumerate(values):
+			if v is None:
+				bitmap[(i + 2) >> 3] |= 1 << ((i + 2) & 7)
+			elif cols[i][1] in (T_VAR_STRING, T_NULL):
+				body += lstr(v)
+			else:
+				body += v
+		self.send(b"\0" + bytes(bitmap) + body)
+
+	def query( self, q ):
+		w = q.split()
+		if w[:2] == [b"SELECT", b"ROWS"]:
+			n = int(w[2])
+			self.columns([(b"id", T_LONG), (b"name", T_VAR_STRING)])
+			for i in range(n):
+				if w[3:] == [b"ERROR"] and i == n // 2:
+					self.send(b"\xff" + struct.pack("<H", 1317) + b"#70100Query execution was interrupted")
+					return
+				self.send(lstr(b"%d" % i) + lstr(b"name%d" % i))
+			self.eof()
+		elif w[:2] == [b"SELECT", b"BIG"]:
+			self.columns([(b"data", T_VAR_STRING)])
+			for i in range(int(w[2])):
+				self.send(lstr(bytes([65 + i % 26]) * int(w[3])))
+			self.eof()
+		elif w[:2] == [b"SELECT", b"BATCH"]:
+			self.columns([(b"sum", T_LONGLONG)])
+			self.send(lstr(b"%d" % self.batch))
+			self.eof()
+		elif len(w) == 2 and w[0] == b"SELECT" and w[1].isdigit():
+			self.columns([(b"v", T_LONG)])
+			self.send(lstr(w[1]))
+			self.eof()
+		elif w[:1] == [b"FAIL"]:
+			self.error(b"Syntax error")
+		else:
+			self.ok(1)
+
+	def prepare( self, q ):
+		sid = self.next_stmt
+		self.next_stmt += 1
+		nparams = q.count(b"?")
+		w = q.replace(b",", b" ").split()
+		if w[:2] == [b"SELECT", b"TYPES"]:
+			cols = TYPES
+		elif len(w) == 2 and w[0] == b"SELECT" and w[1].isdigit():
+			cols = [(b"v", T_LONG, 0)]
+		elif w[:1] == [b"SELECT"]:
+			cols = [(b"p%d" % i, T_VAR_STRING, 0) for i in range(nparams)]
+		else:
+			cols = []
+		self.stmts[sid] = { "sql" : w, "nparams" : nparams, "types" : [T_NULL] * nparams }
+		self.send(b"\0" + struct.pack("<IHHBH", sid, len(cols), nparams, 0, 0))
+		if nparams:
+			for i in range(nparams): self.column(b"?", T_VAR_STRING)
+			self.eof()
+		if cols:
+			for c in cols: self.column(*c)
+			self.eof()
+
+	def execute( self, d ):
+		sid = struct.unpack("<I", d[:4])[0]
+		s = self.stmts[sid]
+		n = s["nparams"]
+		pos = 9
+		params = []
+		if n:
+			nulls = d[pos:pos + (n + 7) // 8]
+			pos += (n + 7) // 8
+			bound = d[pos]
+			pos += 1
+			if bound:
+				s["types"] = [d[pos + 2 * i] for i in range(n)]
+				pos += 2 * n
+			for i in range(n):
+				t = s["types"][i]
+				if nulls[i >> 3] & (1 << (i & 7)):
+					params.append((None, t))
+				elif t in (T_LONGLONG, T_DOUBLE):
+					params.append((d[pos:pos + 8], t))
+					pos += 8
+				else:
+					size, pos = read_lenenc(d, pos)
+					params.append((d[pos:pos + size], T_VAR_STRING))
+					pos += size
+		w = s["sql"]
+		if w[:2] == [b"SELECT", b"TYPES"]:
+			self.columns(TYPES)
+			self.binary_row(TYPES, TYPES_VALUES)
+			self.binary_row(TYPES, [None] * len(TYPES))
+			self.binary_row(TYPES, [None if (i & 1) == 0 else v for i, v in enumerate(TYPES_VALUES)])
+			self.eof()
+		elif len(w) == 2 and w[0] == b"SELECT" and w[1].isdigit():
+			cols = [(b"v", T_LONG)]
+			self.columns(cols)
+			self.binary_row(cols, [struct.pack("<i", int(w[1]))])
+			self.eof()
+		elif w[:1] == [b"SELECT"]:
+			cols = [(b"p%d" % i, t) for i, (v, t) in enumerate(params)]
+			self.columns(cols)
+			self.binary_row(cols, [v for v, t in params])
+			self.eof()
+		elif w[:2] == [b"INSERT", b"BATCH"]:
+			self.batch += struct.unpack("<q", params[0][0])[0]
+			self.ok(1)
+		else:
+			self.ok(1)
+
+	def run( self ):
+		try:
+			self.serve()
+		except OSError:
+			# the client closed the connection without COM_QUIT
+			pass
+		self.sock.close()
+
+	def serve( self ):
+		self.send(b"\x0a5.7.0-stub\0" + struct.pack("<I", 1) + b"abcdefgh\0" + struct.pack("<HBHH", 512 | 8192 | 32768, 33, 2, 0)
+			+ bytes([21]) + bytes(10) + b"ijklmnopqrst\0" + b"mysql_native_password\0")
+		self.flush()
+		if self.recv() is None: return
+		self.ok()
+		# the whole answer is sent before the next command is read
+		while True:
+			self.flush()
+			d = self.recv()
+			if d is None or d[0] == 1: return
+			if d[0] == 3: self.query(d[1:])
+			elif d[0] == 2: self.ok()
+			elif d[0] == 0x16: self.prepare(d[1:])
+			elif d[0] == 0x17: self.execute(d[1:])
+			elif d[0] == 0x19: self.stmts.pop(struct.unpack("<I", d[1:5])[0], None)
+			else: self.error(b"Unsupported command")
+
+def serve( listener ):
+	while True:
+		c, _ = listener.accept()
+		threading.Thread(target=Connection(c).run, daemon=True).start()
+
+def main():
+	listener = socket.socket()
+	listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	# accepted sockets inherit the buffer sizes
+	listener.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, SOCKET_BUFFER)
+	listener.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, SOCKET_BUFFER)
+	if sys.argv[1:2] == ["--port"]:
+		listener.bind(("127.0.0.1", int(sys.argv[2])))
+		listener.listen(8)
+		serve(listener)
+		return
+	listener.bind(("127.0.0.1", 0))
+	listener.listen(8)
+	threading.Thread(target=serve, args=(listener,), daemon=True).start()
+	env = dict(os.environ, MYSQL_HOST="127.0.0.1", MYSQL_PORT=str(listener.getsockname()[1]))
+	try:
+		sys.exit(subprocess.run(sys.argv[1:], env=env, timeout=TIMEOUT).returncode)
+	except subprocess.TimeoutExpired:
+		print("Timeout after " + str(TIMEOUT) + "s")
+		sys.exit(1)
+
+main()
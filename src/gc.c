@@ -219,6 +219,9 @@ static struct {
 static void ***gc_roots = NULL;
 static int gc_roots_count = 0;
 static int gc_roots_max = 0;
+static hl_stack_region **gc_stacks = NULL;
+static int gc_stacks_count = 0;
+static int gc_stacks_max = 0;
 
 HL_API hl_thread_info *hl_get_thread() {
 	return current_thread;
@@ -299,6 +302,41 @@ HL_PRIM void hl_remove_root( void *v ) {
 	gc_global_lock(false);
 }
 
+/*
+	Extra stack regions scanned in addition to the threads stacks, such as
+	suspended fibers. The region bounds can be updated without locking
+	as long as it's done by a running (non blocking) thread.
+	A region with an owner doesn't keep it alive : it is only scanned once the
+	owner was found reachable, so an abandoned fiber can still be collected.
+*/
+HL_API void hl_gc_add_stack( hl_stack_region *r ) {
+	gc_global_lock(true);
+	if( gc_stacks_count == gc_stacks_max ) {
+		int nstacks = gc_stacks_max ? (gc_stacks_max << 1) : 16;
+		hl_stack_region **stacks = (hl_stack_region**)malloc(sizeof(void*)*nstacks);
+		memcpy(stacks,gc_stacks,sizeof(void*)*gc_stacks_count);
+		free(gc_stacks);
+		gc_stacks = stacks;
+		gc_stacks_max = nstacks;
+	}
+	r->index = gc_stacks_count;
+	gc_stacks[gc_stacks_count++] = r;
+	gc_global_lock(false);
+}
+
+HL_API void hl_gc_remove_stack( hl_stack_region *r ) {
+	int i;
+	gc_global_lock(true);
+	i = r->index;
+	if( i >= 0 && i < gc_stacks_count && gc_stacks[i] == r ) {
+		hl_stack_region *last = gc_stacks[--gc_stacks_count];
+		gc_stacks[i] = last;
+		last->index = i;
+		r->index = -1;
+	}
+	gc_global_lock(false);
+}
+
 HL_PRIM gc_pheader *hl_gc_get_page( void *v ) {
 	gc_pheader *page = GC_GET_PAGE(v);
 	if( page && !INPAGE(v,page) )
@@ -800,6 +838,34 @@ static void gc_mark_stack( void *start, void *end ) {
 	GC_STACK_END();
 }
 
+static void gc_mark_flush() {
+	int i;
+	gc_mstack *st = &global_mark_stack;
+	if( gc_mark_threads <= 1 )
+		gc_flush_mark(st);
+	else {
+		gc_dispatch_mark(st, true);
+		if( GC_STACK_COUNT(st) > 0 )
+			hl_fatal("assert");
+		// wait threads to finish
+		while( mark_threads_active )
+			hl_semaphore_acquire(mark_threads_done);
+		for(i=0;i<gc_mark_threads;i++) {
+			gc_mthread *t = &mark_threads[i];
+			if( GC_STACK_COUNT(&t->stack) > 0 )
+				hl_fatal("assert");
+		}
+	}
+}
+
+static bool gc_is_marked( void *p ) {
+	gc_pheader *page = GC_GET_PAGE(p);
+	int bid;
+	if( !page || !INPAGE(p,page) ) return true;
+	bid = gc_allocator_get_block_id(page, p);
+	return bid < 0 || (page->bmp[bid>>3] & (1<<(bid&7))) != 0;
+}
+
 static void gc_mark() {
 	GC_STACK_BEGIN(&global_mark_stack);
 	int mark_bytes = gc_stats.mark_bytes;
@@ -838,22 +904,31 @@ static void gc_mark() {
 		gc_mark_stack(&t->gc_regs,(void**)&t->gc_regs + (sizeof(jmp_buf) / sizeof(void*) - 1));
 		gc_mark_stack(&t->extra_stack_data,(void**)&t->extra_stack_data + t->extra_stack_size);
 	}
+	// owned regions are moved to the front, until their owner is marked
+	int owned = 0;
+	for(i=0;i<gc_stacks_count;i++) {
+		hl_stack_region *r = gc_stacks[i];
+		if( !r->stack_cur ) continue;
+		if( r->owner ) {
+			gc_stacks[i] = gc_stacks[owned];
+			gc_stacks[owned++] = r;
+		} else
+			gc_mark_stack(r->stack_cur,r->stack_top);
+	}
 
-	gc_mstack *st = &global_mark_stack;
-	if( gc_mark_threads <= 1 )
-		gc_flush_mark(st);
-	else {
-		gc_dispatch_mark(st, true);
-		if( GC_STACK_COUNT(st) > 0 )
-			hl_fatal("assert");
-		// wait threads to finish
-		while( mark_threads_active )
-			hl_semaphore_acquire(mark_threads_done);
-		for(i=0;i<gc_mark_threads;i++) {
-			gc_mthread *t = &mark_threads[i];
-			if( GC_STACK_COUNT(&t->stack) > 0 )
-				hl_fatal("assert");
+	gc_mark_flush();
+
+	while( owned ) {
+		int count = owned;
+		for(i=owned-1;i>=0;i--) {
+			hl_stack_region *r = gc_stacks[i];
+			if( !gc_is_marked(r->owner) ) continue;
+			gc_mark_stack(r->stack_cur,r->stack_top);
+			gc_stacks[i] = gc_stacks[--owned];
+			gc_stacks[owned] = r;
 		}
+		if( count == owned ) break;
+		gc_mark_flush();
 	}
 	gc_allocator_after_mark();
 }
@@ -767,6 +767,16 @@ HL_API void hl_thread_yield(void);
 HL_API void hl_register_thread( void *stack_top );
 HL_API void hl_unregister_thread( void );
 
+typedef struct {
+	void *stack_cur;
+	void *stack_top;
+	void *owner; // when set, only scanned while the owner is reachable
+	int index; // slot in the GC regions list, managed by the GC
+} hl_stack_region;
+
+HL_API void hl_gc_add_stack( hl_stack_region *r );
+HL_API void hl_gc_remove_stack( hl_stack_region *r );
+
 HL_API hl_mutex *hl_mutex_alloc( bool gc_thread );
 HL_API void hl_mutex_acquire( hl_mutex *l );
 HL_API bool hl_mutex_try_acquire( hl_mutex *l );
@@ -779,6 +789,9 @@ HL_API bool hl_semaphore_try_acquire(hl_semaphore *sem, vdynamic *timeout);
 HL_API void hl_semaphore_release(hl_semaphore *sem);
 HL_API void hl_semaphore_free(hl_semaphore *sem);
 
+HL_API int hl_cpu_count( void );
+HL_API void hl_parallel_for( int n, void (*fn)( void *ctx, int index ), void *ctx );
+
 HL_API hl_condition *hl_condition_alloc();
 HL_API void hl_condition_acquire(hl_condition *cond);
 HL_API bool hl_condition_try_acquire(hl_condition *cond);
@@ -790,10 +803,15 @@ HL_API void hl_condition_broadcast(hl_condition *cond);
 HL_API void hl_condition_free(hl_condition *cond);
 
 HL_API hl_tls *hl_tls_alloc( bool gc_value );
+HL_API hl_tls *hl_tls_alloc_destructor( void (*destructor)( void * ) );
 HL_API void hl_tls_set( hl_tls *l, void *value );
 HL_API void *hl_tls_get( hl_tls *l );
 HL_API void hl_tls_free( hl_tls *l );
 
+HL_API int hl_atomic_add32( int *a, int b );
+HL_API int hl_atomic_compare_exchange32( int *a, int expected, int replacement );
+HL_API void *hl_atomic_compare_exchange_ptr( void **a, void *expected, void *replacement );
+
 // ----------------------- ALLOC --------------------------------------------------
 
 #define MEM_HAS_PTR(kind)	(!((kind)&2))
@@ -838,7 +856,11 @@ HL_API void hl_free_executable_memory( void *ptr, int size );
 
 typedef struct hl_buffer hl_buffer;
 
+#define HL_BUFFER_UTF8		1
+#define HL_BUFFER_MALLOC	2
+
 HL_API hl_buffer *hl_alloc_buffer( void );
+HL_API hl_buffer *hl_alloc_buffer_flat( int size, int flags );
 HL_API void hl_buffer_val( hl_buffer *b, vdynamic *v );
 HL_API void hl_buffer_char( hl_buffer *b, uchar c );
 HL_API void hl_buffer_str( hl_buffer *b, const uchar *str );
@@ -846,6 +868,9 @@ HL_API void hl_buffer_cstr( hl_buffer *b, const char *str );
 HL_API void hl_buffer_str_sub( hl_buffer *b, const uchar *str, int len );
 HL_API int hl_buffer_length( hl_buffer *b );
 HL_API uchar *hl_buffer_content( hl_buffer *b, int *len );
+HL_API void hl_buffer_utf8( hl_buffer *b, const char *str, int len );
+HL_API vbyte *hl_buffer_bytes( hl_buffer *b, int *size );
+HL_API void hl_buffer_reset( hl_buffer *b );
 HL_API uchar *hl_to_string( vdynamic *v );
 HL_API const uchar *hl_type_str( hl_type *t );
 HL_API void hl_throw_buffer( hl_buffer *b );
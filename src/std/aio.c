@@ -0,0 +1,801 @@
+/*
+ * Copyright (C)2005-2016 Haxe Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#if defined(__GNUC__) && !defined(__APPLE__)
+#	define _FILE_OFFSET_BITS 64
+#endif
+
+#include <hl.h>
+
+/*
+	Asynchronous I/O ring : operations are queued with a user tag, pushed to the
+	system in one batch by aio_submit, and their results are reaped by aio_wait.
+	Results follow the io_uring convention : >= 0 on success, -errno on failure.
+
+	On Linux this uses io_uring directly through its syscalls. Elsewhere, or when
+	io_uring is not available (old kernel, seccomp), a few worker threads run the
+	operations with regular blocking calls.
+*/
+
+#if !defined(HL_WIN) && !defined(HL_CONSOLE)
+#	define HL_AIO
+#	include <string.h>
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/types.h>
+#	include <sys/socket.h>
+#endif
+
+#ifdef HL_LINUX
+#	include <linux/io_uring.h>
+#	ifdef IORING_FEAT_FAST_POLL
+#		define HAS_URING
+#		include <sys/syscall.h>
+#		include <sys/mman.h>
+#	endif
+#endif
+
+#define AIO_READ	0
+#define AIO_WRITE	1
+#define AIO_FSYNC	2
+#define AIO_OPEN	3
+#define AIO_CLOSE	4
+#define AIO_ACCEPT	5
+#define AIO_RECV	6
+#define AIO_SEND	7
+
+#define AIO_WORKERS	4
+#define AIO_MAX_FIXED	64
+
+HL_PRIM double hl_sys_time();
+
+typedef struct {
+	int kind;
+	int fd;
+	vbyte *buf;
+	int len;
+	int flags;
+	int tag;
+	int result;
+	int64 offset;
+} aio_op;
+
+/*
+	Thread fallback state, shared with the workers. It doesn't reference the
+	ring so that an abandoned ring can still be collected : its finalizer only
+	tells the workers to stop, and the last one leaving releases the pool.
+*/
+typedef struct {
+	hl_condition *cond;
+	aio_op *ops;
+	int capacity;
+	int *pending;
+	int pending_head, pending_count;
+	int *done;
+	int done_head, done_count;
+	int workers;
+	int stop;
+	int detached;
+} aio_pool;
+
+typedef struct _hl_aio hl_aio;
+struct _hl_aio {
+	void (*free)( hl_aio * );
+	// GC raw, rooted : keeps buffers of in-flight operations alive
+	aio_op *ops;
+	int *free_slots;
+	int nfree;
+	int capacity;
+	int inflight;
+	// operations not yet submitted
+	int *staged;
+	int nstaged;
+	// registered buffers
+	vbyte **fixed;
+	int *fixed_size;
+	int nfixed;
+#	ifdef HAS_URING
+	bool uring;
+	int ring_fd;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_size, cq_size, sqes_size;
+	unsigned sq_entries;
+	unsigned wait_seq;
+	bool timed_out;
+#	endif
+	aio_pool *pool;
+};
+
+#ifdef HL_AIO
+
+#define ATOMIC_LOAD_ACQ(v)		__atomic_load_n(v,__ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_REL(v,x)	__atomic_store_n(v,x,__ATOMIC_RELEASE)
+
+#ifdef HAS_URING
+
+#define URING_TIMEOUT	0xFFFFFFFF00000000ULL
+#define URING_CANCEL	0xFFFFFFFE00000000ULL
+
+static bool uring_init( hl_aio *a, unsigned entries ) {
+	struct io_uring_params p;
+	memset(&p,0,sizeof(p));
+	a->ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if( a->ring_fd < 0 ) return false;
+	a->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	a->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if( p.features & IORING_FEAT_SINGLE_MMAP ) {
+		if( a->cq_size > a->sq_size ) a->sq_size = a->cq_size;
+		a->cq_size = 0;
+	}
+	a->sq_ptr = mmap(NULL, a->sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, a->ring_fd, IORING_OFF_SQ_RING);
+	a->cq_ptr = a->cq_size ? mmap(NULL, a->cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, a->ring_fd, IORING_OFF_CQ_RING) : a->sq_ptr;
+	a->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	a->sqes = (struct io_uring_sqe*)mmap(NULL, a->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, a->ring_fd, IORING_OFF_SQES);
+	if( a->sq_ptr == MAP_FAILED || a->cq_ptr == MAP_FAILED || a->sqes == MAP_FAILED ) {
+		if( a->sq_ptr != MAP_FAILED ) munmap(a->sq_ptr, a->sq_size);
+		if( a->cq_size && a->cq_ptr != MAP_FAILED ) munmap(a->cq_ptr, a->cq_size);
+		if( a->sqes != MAP_FAILED ) munmap(a->sqes, a->sqes_size);
+		close(a->ring_fd);
+		return false;
+	}
+	a->sq_head = (unsigned*)((char*)a->sq_ptr + p.sq_off.head);
+	a->sq_tail = (unsigned*)((char*)a->sq_ptr + p.sq_off.tail);
+	a->sq_mask = (unsigned*)((char*)a->sq_ptr + p.sq_off.ring_mask);
+	a->sq_array = (unsigned*)((char*)a->sq_ptr + p.sq_off.array);
+	a->cq_head = (unsigned*)((char*)a->cq_ptr + p.cq_off.head);
+	a->cq_tail = (unsigned*)((char*)a->cq_ptr + p.cq_off.tail);
+	a->cq_mask = (unsigned*)((char*)a->cq_ptr + p.cq_off.ring_mask);
+	a->cqes = (struct io_uring_cqe*)((char*)a->cq_ptr + p.cq_off.cqes);
+	a->sq_entries = p.sq_entries;
+	a->uring = true;
+	return true;
+}
+
+static void uring_free( hl_aio *a ) {
+	munmap(a->sqes, a->sqes_size);
+	if( a->cq_size ) munmap(a->cq_ptr, a->cq_size);
+	munmap(a->sq_ptr, a->sq_size);
+	close(a->ring_fd);
+	a->uring = false;
+}
+
+static int uring_enter( hl_aio *a, unsigned submit, unsigned wait, unsigned flags ) {
+	return (int)syscall(__NR_io_uring_enter, a->ring_fd, submit, wait, flags, NULL, 0);
+}
+
+static struct io_uring_sqe *uring_sqe( hl_aio *a ) {
+	unsigned tail = *a->sq_tail;
+	unsigned idx;
+	struct io_uring_sqe *sqe;
+	if( tail - ATOMIC_LOAD_ACQ(a->sq_head) >= a->sq_entries )
+		return NULL;
+	idx = tail & *a->sq_mask;
+	sqe = &a->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	a->sq_array[idx] = idx;
+	ATOMIC_STORE_REL(a->sq_tail, tail + 1);
+	return sqe;
+}
+
+/*
+	Cancel every submitted operation and reap the completions until none is in
+	flight : the kernel would otherwise keep writing into buffers that are no
+	longer rooted once the ring is released.
+*/
+static void uring_cancel_all( hl_aio *a, bool blocking ) {
+	unsigned queued = 0;
+	char *busy;
+	int i;
+	if( a->inflight == 0 ) return;
+	busy = (char*)malloc(a->capacity);
+	memset(busy,1,a->capacity);
+	for(i=0;i<a->nfree;i++) busy[a->free_slots[i]] = 0;
+	for(i=0;i<a->nstaged;i++) busy[a->staged[i]] = 0;
+	for(i=0;i<a->capacity;i++) {
+		struct io_uring_sqe *sqe;
+		if( !busy[i] ) continue;
+		sqe = uring_sqe(a);
+		if( !sqe ) {
+			uring_enter(a, queued, 0, 0);
+			queued = 0;
+			sqe = uring_sqe(a);
+			if( !sqe ) break;
+		}
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = (unsigned long)i;
+		sqe->user_data = URING_CANCEL;
+		queued++;
+	}
+	free(busy);
+	if( queued ) uring_enter(a, queued, 0, 0);
+	while( a->inflight > 0 ) {
+		unsigned head = *a->cq_head;
+		unsigned tail = ATOMIC_LOAD_ACQ(a->cq_tail);
+		if( head == tail ) {
+			int r;
+			if( blocking ) hl_blocking(true);
+			r = uring_enter(a, 0, 1, IORING_ENTER_GETEVENTS);
+			if( blocking ) hl_blocking(false);
+			if( r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY ) break;
+			continue;
+		}
+		while( head != tail ) {
+			struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+			if( (cqe->user_data >> 32) == 0 ) {
+				a->ops[cqe->user_data].buf = NULL;
+				a->free_slots[a->nfree++] = (int)cqe->user_data;
+				a->inflight--;
+			}
+			head++;
+		}
+		ATOMIC_STORE_REL(a->cq_head, head);
+	}
+}
+
+static int uring_fixed_index( hl_aio *a, vbyte *buf, int len ) {
+	int i;
+	for(i=0;i<a->nfixed;i++)
+		if( buf >= a->fixed[i] && buf + len <= a->fixed[i] + a->fixed_size[i] )
+			return i;
+	return -1;
+}
+
+static void uring_prep( hl_aio *a, struct io_uring_sqe *sqe, int slot ) {
+	aio_op *op = a->ops + slot;
+	int fixed;
+	sqe->fd = op->fd;
+	sqe->user_data = (unsigned)slot;
+	switch( op->kind ) {
+	case AIO_READ:
+	case AIO_WRITE:
+		fixed = uring_fixed_index(a, op->buf, op->len);
+		if( fixed >= 0 ) {
+			sqe->opcode = op->kind == AIO_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+			sqe->buf_index = (unsigned short)fixed;
+		} else
+			sqe->opcode = op->kind == AIO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe->addr = (unsigned long)op->buf;
+		sqe->len = op->len;
+		sqe->off = op->offset < 0 ? (unsigned long long)-1 : (unsigned long long)op->offset;
+		break;
+	case AIO_FSYNC:
+		sqe->opcode = IORING_OP_FSYNC;
+		break;
+	case AIO_OPEN:
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (unsigned long)op->buf;
+		sqe->len = op->len;
+		sqe->open_flags = op->flags;
+		break;
+	case AIO_CLOSE:
+		sqe->opcode = IORING_OP_CLOSE;
+		break;
+	case AIO_ACCEPT:
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->accept_flags = SOCK_CLOEXEC;
+		break;
+	case AIO_RECV:
+	case AIO_SEND:
+		sqe->opcode = op->kind == AIO_RECV ? IORING_OP_RECV : IORING_OP_SEND;
+		sqe->addr = (unsigned long)op->buf;
+		sqe->len = op->len;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		break;
+	}
+}
+
+#endif
+
+// run an operation synchronously, used by the worker threads
+static int aio_exec( aio_op *op ) {
+	int r;
+	hl_blocking(true);
+	switch( op->kind ) {
+	case AIO_READ:
+		r = (int)(op->offset < 0 ? read(op->fd, op->buf, op->len) : pread(op->fd, op->buf, op->len, (off_t)op->offset));
+		break;
+	case AIO_WRITE:
+		r = (int)(op->offset < 0 ? write(op->fd, op->buf, op->len) : pwrite(op->fd, op->buf, op->len, (off_t)op->offset));
+		break;
+	case AIO_FSYNC:
+		r = fsync(op->fd);
+		break;
+	case AIO_OPEN:
+		r = open((char*)op->buf, op->flags | O_CLOEXEC, op->len);
+		break;
+	case AIO_CLOSE:
+		r = close(op->fd);
+		break;
+	case AIO_ACCEPT:
+		r = accept(op->fd, NULL, NULL);
+		if( r >= 0 ) fcntl(r, F_SETFD, FD_CLOEXEC);
+		break;
+	case AIO_RECV:
+		r = (int)recv(op->fd, op->buf, op->len, MSG_NOSIGNAL);
+		break;
+	case AIO_SEND:
+		r = (int)send(op->fd, op->buf, op->len, MSG_NOSIGNAL);
+		break;
+	default:
+		r = -1;
+		errno = EINVAL;
+		break;
+	}
+	hl_blocking(false);
+	return r < 0 ? -errno : r;
+}
+
+static void aio_pool_free( aio_pool *w ) {
+	hl_remove_root(&w->cond);
+	hl_remove_root(&w->ops);
+	free(w->pending);
+	free(w->done);
+	free(w);
+}
+
+static void aio_worker( aio_pool *w ) {
+	bool last;
+	hl_condition_acquire(w->cond);
+	while( true ) {
+		int slot;
+		// timed : the ring finalizer runs during a collection and can't take the lock to wake us
+		while( w->pending_count == 0 && !__atomic_load_n(&w->stop,__ATOMIC_SEQ_CST) )
+			hl_condition_timed_wait(w->cond, 1.);
+		if( __atomic_load_n(&w->stop,__ATOMIC_SEQ_CST) ) break;
+		slot = w->pending[w->pending_head];
+		w->pending_head = (w->pending_head + 1) % w->capacity;
+		w->pending_count--;
+		hl_condition_release(w->cond);
+		w->ops[slot].result = aio_exec(w->ops + slot);
+		hl_condition_acquire(w->cond);
+		w->done[(w->done_head + w->done_count) % w->capacity] = slot;
+		w->done_count++;
+		hl_condition_broadcast(w->cond);
+	}
+	// once released, an explicit aio_free can release the pool at any time
+	last = --w->workers == 0 && __atomic_load_n(&w->detached,__ATOMIC_SEQ_CST);
+	hl_condition_broadcast(w->cond);
+	hl_condition_release(w->cond);
+	if( last )
+		aio_pool_free(w);
+}
+
+static void aio_finalize( hl_aio *a ) {
+#	ifdef HAS_URING
+	if( a->uring ) {
+		// called by the GC : the buffers are still alive until the sweep
+		uring_cancel_all(a, false);
+		uring_free(a);
+	}
+#	endif
+	if( a->pool ) {
+		aio_pool *w = a->pool;
+		// called by the GC : no locking, the workers notice the stop flag with their timed wait
+		if( w->workers == 0 )
+			aio_pool_free(w);
+		else {
+			__atomic_store_n(&w->detached,1,__ATOMIC_SEQ_CST);
+			__atomic_store_n(&w->stop,1,__ATOMIC_SEQ_CST);
+			hl_condition_broadcast(w->cond);
+		}
+		a->pool = NULL;
+	}
+	hl_remove_root(&a->ops);
+	hl_remove_root(&a->fixed);
+	free(a->free_slots);
+	free(a->staged);
+	free(a->fixed_size);
+	a->ops = NULL;
+	a->free_slots = NULL;
+	a->staged = NULL;
+	a->fixed = NULL;
+	a->fixed_size = NULL;
+	a->nfree = 0;
+	a->nstaged = 0;
+	a->inflight = 0;
+	a->nfixed = 0;
+	a->free = NULL;
+}
+
+#endif
+
+HL_PRIM hl_aio *hl_aio_alloc( int entries ) {
+#	ifndef HL_AIO
+	return NULL;
+#	else
+	hl_aio *a;
+	int i;
+	if( entries <= 0 ) entries = 256;
+	a = (hl_aio*)hl_gc_alloc_finalizer(sizeof(hl_aio));
+	memset(a,0,sizeof(hl_aio));
+#	ifdef HAS_URING
+	if( uring_init(a, entries) ) entries = a->sq_entries;
+#	endif
+	// completions can exceed submissions, keep twice as many slots
+	a->capacity = entries * 2;
+	a->ops = (aio_op*)hl_gc_alloc_raw(sizeof(aio_op) * a->capacity);
+	memset(a->ops,0,sizeof(aio_op) * a->capacity);
+	a->free_slots = (int*)malloc(sizeof(int) * a->capacity);
+	for(i=0;i<a->capacity;i++)
+		a->free_slots[i] = a->capacity - 1 - i;
+	a->nfree = a->capacity;
+	a->staged = (int*)malloc(sizeof(int) * a->capacity);
+	hl_add_root(&a->ops);
+	hl_add_root(&a->fixed);
+	a->free = aio_finalize;
+#	ifdef HAS_URING
+	if( a->uring ) return a;
+#	endif
+	{
+		aio_pool *w = (aio_pool*)malloc(sizeof(aio_pool));
+		memset(w,0,sizeof(aio_pool));
+		w->cond = hl_condition_alloc();
+		w->ops = a->ops;
+		w->capacity = a->capacity;
+		w->pending = (int*)malloc(sizeof(int) * a->capacity);
+		w->done = (int*)malloc(sizeof(int) * a->capacity);
+		hl_add_root(&w->cond);
+		hl_add_root(&w->ops);
+		a->pool = w;
+		for(i=0;i<AIO_WORKERS;i++) {
+			hl_condition_acquire(w->cond);
+			w->workers++;
+			hl_condition_release(w->cond);
+			if( hl_thread_start(aio_worker, w, true) == NULL ) {
+				hl_condition_acquire(w->cond);
+				w->workers--;
+				hl_condition_release(w->cond);
+				break;
+			}
+		}
+	}
+	return a;
+#	endif
+}
+
+HL_PRIM bool hl_aio_is_uring( hl_aio *a ) {
+#	ifdef HAS_URING
+	return a && a->uring;
+#	else
+	return false;
+#	endif
+}
+
+#ifdef HL_AIO
+
+static bool aio_queue( hl_aio *a, int kind, int fd, vbyte *buf, int len, int flags, int64 offset, int tag ) {
+	aio_op *op;
+	int slot;
+	if( !a || !a->free || a->nfree == 0 ) return false;
+#	ifdef HAS_URING
+	// the submission ring is full : push what we have first
+	if( a->uring && a->nstaged >= (int)a->sq_entries ) return false;
+#	endif
+	slot = a->free_slots[--a->nfree];
+	op = a->ops + slot;
+	op->kind = kind;
+	op->fd = fd;
+	op->buf = buf;
+	op->len = len;
+	op->flags = flags;
+	op->offset = offset;
+	op->tag = tag;
+	op->result = 0;
+	a->staged[a->nstaged++] = slot;
+	return true;
+}
+
+#endif
+
+HL_PRIM bool hl_aio_read( hl_aio *a, int fd, vbyte *buf, int pos, int len, int64 offset, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_READ, fd, buf + pos, len, 0, offset, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_write( hl_aio *a, int fd, vbyte *buf, int pos, int len, int64 offset, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_WRITE, fd, buf + pos, len, 0, offset, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_fsync( hl_aio *a, int fd, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_FSYNC, fd, NULL, 0, 0, 0, tag);
+#	else
+	return false;
+#	endif
+}
+
+// mode : 0 = read, 1 = write (create/truncate), 2 = append, 3 = read/write
+HL_PRIM bool hl_aio_open( hl_aio *a, vbyte *path, int mode, int perms, int tag ) {
+#	ifdef HL_AIO
+	static const int FLAGS[] = { O_RDONLY, O_WRONLY|O_CREAT|O_TRUNC, O_WRONLY|O_CREAT|O_APPEND, O_RDWR };
+	if( mode < 0 || mode > 3 ) return false;
+	return aio_queue(a, AIO_OPEN, 0, path, perms, FLAGS[mode] | O_CLOEXEC, 0, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_close( hl_aio *a, int fd, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_CLOSE, fd, NULL, 0, 0, 0, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_accept( hl_aio *a, int fd, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_ACCEPT, fd, NULL, 0, 0, 0, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_recv( hl_aio *a, int fd, vbyte *buf, int pos, int len, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_RECV, fd, buf + pos, len, 0, -1, tag);
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_aio_send( hl_aio *a, int fd, vbyte *buf, int pos, int len, int tag ) {
+#	ifdef HL_AIO
+	return aio_queue(a, AIO_SEND, fd, buf + pos, len, 0, -1, tag);
+#	else
+	return false;
+#	endif
+}
+
+// register buffers used by read/write operations, only useful with io_uring
+HL_PRIM bool hl_aio_register_buffers( hl_aio *a, varray *bufs, int *sizes ) {
+#	ifdef HL_AIO
+	int i;
+	if( !a || !a->free || a->nfixed || bufs->size > AIO_MAX_FIXED ) return false;
+	a->fixed = (vbyte**)hl_gc_alloc_raw(sizeof(vbyte*) * bufs->size);
+	a->fixed_size = (int*)malloc(sizeof(int) * bufs->size);
+	for(i=0;i<bufs->size;i++) {
+		a->fixed[i] = hl_aptr(bufs,vbyte*)[i];
+		a->fixed_size[i] = sizes[i];
+	}
+#	ifdef HAS_URING
+	if( a->uring ) {
+		struct iovec iov[AIO_MAX_FIXED];
+		for(i=0;i<bufs->size;i++) {
+			iov[i].iov_base = a->fixed[i];
+			iov[i].iov_len = sizes[i];
+		}
+		if( syscall(__NR_io_uring_register, a->ring_fd, IORING_REGISTER_BUFFERS, iov, bufs->size) < 0 ) {
+			free(a->fixed_size);
+			a->fixed = NULL;
+			a->fixed_size = NULL;
+			return false;
+		}
+	}
+#	endif
+	a->nfixed = bufs->size;
+	return true;
+#	else
+	return false;
+#	endif
+}
+
+// push all queued operations, returns the number submitted or -errno
+HL_PRIM int hl_aio_submit( hl_aio *a ) {
+#	ifdef HL_AIO
+	int i, n;
+	aio_pool *w;
+	if( !a || !a->free ) return -1;
+	n = a->nstaged;
+	if( n == 0 ) return 0;
+#	ifdef HAS_URING
+	if( a->uring ) {
+		int r;
+		for(i=0;i<n;i++) {
+			struct io_uring_sqe *sqe = uring_sqe(a);
+			if( !sqe ) break;
+			uring_prep(a, sqe, a->staged[i]);
+		}
+		r = uring_enter(a, i, 0, 0);
+		// entries not consumed by the kernel stay staged : take them back from the ring
+		if( r < i ) ATOMIC_STORE_REL(a->sq_tail, ATOMIC_LOAD_ACQ(a->sq_head));
+		if( r < 0 ) return -errno;
+		n = r;
+		a->nstaged -= n;
+		memmove(a->staged, a->staged + n, sizeof(int) * a->nstaged);
+		a->inflight += n;
+		return n;
+	}
+#	endif
+	w = a->pool;
+	hl_condition_acquire(w->cond);
+	for(i=0;i<n;i++)
+		w->pending[(w->pending_head + w->pending_count++) % w->capacity] = a->staged[i];
+	hl_condition_broadcast(w->cond);
+	hl_condition_release(w->cond);
+	a->nstaged = 0;
+	a->inflight += n;
+	return n;
+#	else
+	return -1;
+#	endif
+}
+
+#ifdef HL_AIO
+
+static void aio_complete( hl_aio *a, int slot, int result, int *tags, int *results, int *count ) {
+	aio_op *op = a->ops + slot;
+	tags[*count] = op->tag;
+	results[*count] = result;
+	(*count)++;
+	op->buf = NULL;
+	a->free_slots[a->nfree++] = slot;
+	a->inflight--;
+}
+
+#ifdef HAS_URING
+static int uring_reap( hl_aio *a, int *tags, int *results, int max, int count ) {
+	unsigned head = *a->cq_head;
+	unsigned tail = ATOMIC_LOAD_ACQ(a->cq_tail);
+	while( head != tail && count < max ) {
+		struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+		if( (cqe->user_data >> 32) != 0 ) {
+			if( (cqe->user_data & URING_TIMEOUT) == URING_TIMEOUT && (unsigned)cqe->user_data == a->wait_seq ) a->timed_out = true;
+		} else
+			aio_complete(a, (int)cqe->user_data, cqe->res, tags, results, &count);
+		head++;
+	}
+	ATOMIC_STORE_REL(a->cq_head, head);
+	return count;
+}
+#endif
+
+#endif
+
+/*
+	reap up to max completions into tags/results, waiting until at least min_count are available
+	or until timeout (in seconds, < 0 for no timeout). Returns the number of completions.
+*/
+HL_PRIM int hl_aio_wait( hl_aio *a, int *tags, int *results, int max, int min_count, double timeout ) {
+#	ifdef HL_AIO
+	int count = 0;
+	if( !a || !a->free ) return -1;
+	if( min_count > a->inflight ) min_count = a->inflight;
+	if( min_count > max ) min_count = max;
+#	ifdef HAS_URING
+	if( a->uring ) {
+		count = uring_reap(a, tags, results, max, 0);
+		if( count >= min_count ) return count;
+		a->timed_out = false;
+		a->wait_seq++;
+		if( timeout >= 0 ) {
+			struct __kernel_timespec ts;
+			struct io_uring_sqe *sqe = uring_sqe(a);
+			if( sqe ) {
+				ts.tv_sec = (long long)timeout;
+				ts.tv_nsec = (long long)((timeout - (double)ts.tv_sec) * 1e9);
+				sqe->opcode = IORING_OP_TIMEOUT;
+				sqe->addr = (unsigned long)&ts;
+				sqe->len = 1;
+				sqe->off = min_count - count;
+				sqe->user_data = URING_TIMEOUT | a->wait_seq;
+				// the timespec is on our stack : don't leave it in the ring
+				if( uring_enter(a, 1, 0, 0) < 1 ) ATOMIC_STORE_REL(a->sq_tail, ATOMIC_LOAD_ACQ(a->sq_head));
+			}
+		}
+		while( count < min_count && !a->timed_out ) {
+			int r;
+			hl_blocking(true);
+			r = uring_enter(a, 0, 1, IORING_ENTER_GETEVENTS);
+			hl_blocking(false);
+			if( r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY ) break;
+			count = uring_reap(a, tags, results, max, count);
+		}
+		return count;
+	}
+#	endif
+	{
+		aio_pool *w = a->pool;
+		double deadline = timeout < 0 ? 0 : hl_sys_time() + timeout;
+		hl_condition_acquire(w->cond);
+		while( true ) {
+			while( w->done_count > 0 && count < max ) {
+				int slot = w->done[w->done_head];
+				w->done_head = (w->done_head + 1) % w->capacity;
+				w->done_count--;
+				aio_complete(a, slot, a->ops[slot].result, tags, results, &count);
+			}
+			if( count >= min_count ) break;
+			if( timeout < 0 )
+				hl_condition_wait(w->cond);
+			else {
+				double left = deadline - hl_sys_time();
+				if( left <= 0 ) break;
+				hl_condition_timed_wait(w->cond, left);
+			}
+		}
+		hl_condition_release(w->cond);
+	}
+	return count;
+#	else
+	return -1;
+#	endif
+}
+
+HL_PRIM int hl_aio_pending( hl_aio *a ) {
+	return a ? a->inflight + a->nstaged : 0;
+}
+
+// stop and join worker threads and release the ring. With io_uring, operations still in flight
+// are canceled, the worker threads only finish the operation they are running.
+// The ring can't be used anymore, freeing it again does nothing.
+HL_PRIM void hl_aio_free( hl_aio *a ) {
+#	ifdef HL_AIO
+	aio_pool *w;
+	if( !a || !a->free ) return;
+	w = a->pool;
+	if( w ) {
+		hl_condition_acquire(w->cond);
+		w->stop = 1;
+		hl_condition_broadcast(w->cond);
+		while( w->workers > 0 )
+			hl_condition_wait(w->cond);
+		hl_condition_release(w->cond);
+		aio_pool_free(w);
+		a->pool = NULL;
+	}
+#	ifdef HAS_URING
+	if( a->uring ) uring_cancel_all(a, true);
+#	endif
+	aio_finalize(a);
+#	endif
+}
+
+#define _AIO _ABSTRACT(hl_aio)
+DEFINE_PRIM(_AIO, aio_alloc, _I32);
+DEFINE_PRIM(_BOOL, aio_is_uring, _AIO);
+DEFINE_PRIM(_BOOL, aio_read, _AIO _I32 _BYTES _I32 _I32 _I64 _I32);
+DEFINE_PRIM(_BOOL, aio_write, _AIO _I32 _BYTES _I32 _I32 _I64 _I32);
+DEFINE_PRIM(_BOOL, aio_fsync, _AIO _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_open, _AIO _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_close, _AIO _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_accept, _AIO _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_recv, _AIO _I32 _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_send, _AIO _I32 _BYTES _I32 _I32 _I32);
+DEFINE_PRIM(_BOOL, aio_register_buffers, _AIO _ARR _BYTES);
+DEFINE_PRIM(_I32, aio_submit, _AIO);
+DEFINE_PRIM(_I32, aio_wait, _AIO _BYTES _BYTES _I32 _I32 _F64);
+DEFINE_PRIM(_I32, aio_pending, _AIO);
+DEFINE_PRIM(_VOID, aio_free, _AIO);
@@ -35,19 +35,119 @@ typedef struct _stringitem {
 } * stringitem;
 
 struct hl_buffer {
+	void (*finalize)( hl_buffer * );
 	int totlen;
 	int blen;
 	stringitem data;
+	// flat buffers : a single block of size bytes, either UTF-16 or UTF-8
+	int flags;
+	int size;
+	int pos;
+	vbyte *bytes;
+	// UTF-8 : high surrogate waiting for the next char to be encoded with it
+	uchar pending;
 };
 
 HL_PRIM hl_buffer *hl_alloc_buffer() {
 	hl_buffer *b = (hl_buffer*)hl_gc_alloc_raw(sizeof(hl_buffer));
-	b->totlen = 0;
+	memset(b,0,sizeof(hl_buffer));
 	b->blen = 16;
-	b->data = NULL;
 	return b;
 }
 
+static void buffer_finalize( hl_buffer *b ) {
+	free(b->bytes);
+	b->bytes = NULL;
+}
+
+HL_PRIM hl_buffer *hl_alloc_buffer_flat( int size, int flags ) {
+	hl_buffer *b;
+	if( size < 16 ) size = 16;
+	if( flags & HL_BUFFER_MALLOC ) {
+		// not scanned by the GC, which is fine since flat buffers only reference their block
+		b = (hl_buffer*)hl_gc_alloc_finalizer(sizeof(hl_buffer));
+		memset(b,0,sizeof(hl_buffer));
+		b->finalize = buffer_finalize;
+		b->bytes = (vbyte*)malloc(size);
+		if( b->bytes == NULL ) hl_error("Out of memory");
+	} else {
+		b = (hl_buffer*)hl_gc_alloc_raw(sizeof(hl_buffer));
+		memset(b,0,sizeof(hl_buffer));
+		b->bytes = (vbyte*)hl_gc_alloc_noptr(size);
+	}
+	b->flags = flags;
+	b->size = size;
+	return b;
+}
+
+static vbyte *buffer_reserve( hl_buffer *b, int bytes ) {
+	if( b->pos + bytes > b->size ) {
+		int nsize = b->size << 1;
+		vbyte *nb;
+		if( nsize < b->pos + bytes ) nsize = b->pos + bytes;
+		if( b->flags & HL_BUFFER_MALLOC ) {
+			nb = (vbyte*)realloc(b->bytes,nsize);
+			if( nb == NULL ) hl_error("Out of memory");
+		} else {
+			nb = (vbyte*)hl_gc_alloc_noptr(nsize);
+			memcpy(nb,b->bytes,b->pos);
+		}
+		b->bytes = nb;
+		b->size = nsize;
+	}
+	return b->bytes + b->pos;
+}
+
+static int buffer_encode_utf8( vbyte *out, const uchar *s, int len ) {
+	vbyte *start = out;
+	int i;
+	for(i=0;i<len;i++) {
+		unsigned int c = s[i];
+		if( c < 0x80 )
+			*out++ = (vbyte)c;
+		else if( c < 0x800 ) {
+			*out++ = (vbyte)(0xC0|(c>>6));
+			*out++ = (vbyte)(0x80|(c&63));
+		} else if( c >= 0xD800 && c < 0xDC00 && i + 1 < len && s[i+1] >= 0xDC00 && s[i+1] < 0xE000 ) {
+			int k = ((((int)c - 0xD800) << 10) | (((int)s[++i]) - 0xDC00)) + 0x10000;
+			*out++ = (vbyte)(0xF0|(k>>18));
+			*out++ = (vbyte)(0x80|((k>>12)&63));
+			*out++ = (vbyte)(0x80|((k>>6)&63));
+			*out++ = (vbyte)(0x80|(k&63));
+		} else {
+			*out++ = (vbyte)(0xE0|(c>>12));
+			*out++ = (vbyte)(0x80|((c>>6)&63));
+			*out++ = (vbyte)(0x80|(c&63));
+		}
+	}
+	return (int)(out - start);
+}
+
+// write the pending high surrogate, together with next when it's the low surrogate of the pair
+static bool buffer_flush_pending( hl_buffer *b, uchar next ) {
+	uchar pair[2];
+	bool paired = next >= 0xDC00 && next < 0xE000;
+	pair[0] = b->pending;
+	pair[1] = next;
+	b->pending = 0;
+	b->pos += buffer_encode_utf8(buffer_reserve(b,4),pair,paired ? 2 : 1);
+	return paired;
+}
+
+// number of UTF-16 chars hl_from_utf8 will produce for these bytes, ignoring a truncated last sequence
+static int buffer_utf8_chars( const vbyte *s, int len ) {
+	int i = 0, n = 0;
+	while( true ) {
+		int c = s[i];
+		int k = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+		if( i + k > len ) break;
+		i += k;
+		n += k == 4 ? 2 : 1;
+		if( i == len ) break;
+	}
+	return n;
+}
+
 static void buffer_append_new( hl_buffer *b, const uchar *s, int len ) {
 	int size;
 	stringitem it;
@@ -68,6 +168,22 @@ HL_PRIM void hl_buffer_str_sub( hl_buffer *b, const uchar *s, int len ) {
 	int offset = 0;
 	if( s == NULL || len <= 0 )
 		return;
+	if( b->bytes ) {
+		if( b->flags & HL_BUFFER_UTF8 ) {
+			if( b->pending && buffer_flush_pending(b,s[0]) ) {
+				s++;
+				len--;
+			}
+			// the pair might be split between two writes
+			if( len > 0 && s[len-1] >= 0xD800 && s[len-1] < 0xDC00 )
+				b->pending = s[--len];
+			b->pos += buffer_encode_utf8(buffer_reserve(b,len * 3),s,len);
+		} else {
+			memcpy(buffer_reserve(b,len << 1),s,len << 1);
+			b->pos += len << 1;
+		}
+		return;
+	}
 	b->totlen += len;
 	it = b->data;
 	if( it ) {
@@ -91,7 +207,9 @@ HL_PRIM void hl_buffer_str( hl_buffer *b, const uchar *s ) {
 }
 
 HL_PRIM void hl_buffer_cstr( hl_buffer *b, const char *s ) {
-	if( s ) {
+	if( s && b->bytes ) {
+		hl_buffer_utf8(b,s,(int)strlen(s));
+	} else if( s ) {
 		int len = (int)hl_utf8_length((vbyte*)s,0);
 		uchar *out = (uchar*)malloc(sizeof(uchar)*(len+1));
 		hl_from_utf8(out,len,s);
@@ -102,6 +220,17 @@ HL_PRIM void hl_buffer_cstr( hl_buffer *b, const char *s ) {
 
 HL_PRIM void hl_buffer_char( hl_buffer *b, uchar c ) {
 	stringitem it;
+	if( b->bytes ) {
+		if( !(b->flags & HL_BUFFER_UTF8) ) {
+			*(uchar*)buffer_reserve(b,2) = c;
+			b->pos += 2;
+		} else if( c < 0x80 && !b->pending ) {
+			*buffer_reserve(b,1) = (vbyte)c;
+			b->pos++;
+		} else
+			hl_buffer_str_sub(b,&c,1);
+		return;
+	}
 	b->totlen++;
 	it = b->data;
 	if( it && it->len != it->size ) {
@@ -111,10 +240,51 @@ HL_PRIM void hl_buffer_char( hl_buffer *b, uchar c ) {
 	buffer_append_new(b,(uchar*)&c,1);
 }
 
+HL_PRIM void hl_buffer_utf8( hl_buffer *b, const char *s, int len ) {
+	int n;
+	if( s == NULL || len <= 0 )
+		return;
+	if( b->bytes && (b->flags & HL_BUFFER_UTF8) ) {
+		if( b->pending ) buffer_flush_pending(b,0);
+		memcpy(buffer_reserve(b,len),s,len);
+		b->pos += len;
+		return;
+	}
+	n = buffer_utf8_chars((vbyte*)s,len);
+	if( b->bytes ) {
+		n = hl_from_utf8((uchar*)buffer_reserve(b,(n + 1) << 1),n,s);
+		b->pos += n << 1;
+	} else {
+		uchar *out = (uchar*)malloc(sizeof(uchar)*(n+1));
+		n = hl_from_utf8(out,n,s);
+		hl_buffer_str_sub(b,out,n);
+		free(out);
+	}
+}
+
 HL_PRIM uchar *hl_buffer_content( hl_buffer *b, int *len ) {
-	uchar *buf = (uchar*)hl_gc_alloc_noptr((b->totlen+1)<<1);
-	stringitem it = b->data;
-	uchar *s = ((uchar*)buf) + b->totlen;
+	uchar *buf;
+	stringitem it;
+	uchar *s;
+	if( b->bytes ) {
+		int n;
+		if( b->pending ) buffer_flush_pending(b,0);
+		if( b->flags & HL_BUFFER_UTF8 ) {
+			n = buffer_utf8_chars(b->bytes,b->pos);
+			buf = (uchar*)hl_gc_alloc_noptr((n+1)<<1);
+			n = hl_from_utf8(buf,n,(char*)b->bytes);
+		} else {
+			n = b->pos >> 1;
+			buf = (uchar*)hl_gc_alloc_noptr((n+1)<<1);
+			memcpy(buf,b->bytes,b->pos);
+			buf[n] = 0;
+		}
+		if( len ) *len = n;
+		return buf;
+	}
+	buf = (uchar*)hl_gc_alloc_noptr((b->totlen+1)<<1);
+	it = b->data;
+	s = ((uchar*)buf) + b->totlen;
 	*s = 0;
 	while( it != NULL ) {
 		stringitem tmp;
@@ -127,7 +297,32 @@ HL_PRIM uchar *hl_buffer_content( hl_buffer *b, int *len ) {
 	return buf;
 }
 
+// zero-copy view of a flat buffer content, NUL terminated and valid until the next write
+HL_PRIM vbyte *hl_buffer_bytes( hl_buffer *b, int *size ) {
+	int len;
+	vbyte *out;
+	if( b->bytes ) {
+		if( b->pending ) buffer_flush_pending(b,0);
+		memset(buffer_reserve(b,2),0,2);
+		if( size ) *size = b->pos;
+		return b->bytes;
+	}
+	out = (vbyte*)hl_buffer_content(b,&len);
+	if( size ) *size = len << 1;
+	return out;
+}
+
+HL_PRIM void hl_buffer_reset( hl_buffer *b ) {
+	b->totlen = 0;
+	b->blen = 16;
+	b->data = NULL;
+	b->pos = 0;
+	b->pending = 0;
+}
+
 int hl_buffer_length( hl_buffer *b ) {
+	if( b->bytes )
+		return (b->flags & HL_BUFFER_UTF8) ? b->pos + (b->pending ? 3 : 0) : b->pos >> 1;
 	return b->totlen;
 }
 
@@ -411,8 +606,19 @@ HL_PRIM uchar *hl_to_string( vdynamic *v ) {
 		return USTR("null");
 	if( v->t->kind == HBOOL )
 		return v->v.b ? USTR("true") : USTR("false");
-	hl_buffer *b = hl_alloc_buffer();
+	hl_buffer *b = hl_alloc_buffer_flat(64,0);
 	hl_buffer_val(b,v);
-	hl_buffer_char(b,0);
+	// copy to an exact size block : the buffer one has up to twice the needed size
 	return hl_buffer_content(b,NULL);
 }
+
+#define _BUF _ABSTRACT(hl_buffer)
+DEFINE_PRIM(_BUF, alloc_buffer_flat, _I32 _I32);
+DEFINE_PRIM(_VOID, buffer_str_sub, _BUF _BYTES _I32);
+DEFINE_PRIM(_VOID, buffer_char, _BUF _I32);
+DEFINE_PRIM(_VOID, buffer_val, _BUF _DYN);
+DEFINE_PRIM(_VOID, buffer_utf8, _BUF _BYTES _I32);
+DEFINE_PRIM(_I32, buffer_length, _BUF);
+DEFINE_PRIM(_BYTES, buffer_content, _BUF _REF(_I32));
+DEFINE_PRIM(_BYTES, buffer_bytes, _BUF _REF(_I32));
+DEFINE_PRIM(_VOID, buffer_reset, _BUF);
@@ -20,6 +20,88 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <hl.h>
+#include <float.h>
+
+/*
+	SIMD filters used by the search and compare functions : they return a mask
+	with one bit per matching byte (or char) lane, MASK8_SHIFT/MASK16_SHIFT give the
+	lane index from the bit position.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BYTES_SIMD
+#elif defined(__aarch64__)
+#	include <arm_neon.h>
+#	define BYTES_SIMD
+#endif
+
+#ifdef BYTES_SIMD
+
+#ifdef __aarch64__
+
+typedef uint64_t bytes_mask;
+#define MASK8_SHIFT		2
+#define MASK16_SHIFT	3
+#define mask_first(m)	__builtin_ctzll(m)
+#define mask_last(m)	(63 - __builtin_clzll(m))
+
+static inline bytes_mask find_mask8( const vbyte *a, const vbyte *b, int fa, int fb ) {
+	uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(a),vdupq_n_u8((uint8_t)fa)),vceqq_u8(vld1q_u8(b),vdupq_n_u8((uint8_t)fb)));
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq),4)),0) & 0x1111111111111111ULL;
+}
+
+static inline bytes_mask find_mask16( const uchar *a, const uchar *b, int fa, int fb ) {
+	uint16x8_t eq = vandq_u16(vceqq_u16(vld1q_u16(a),vdupq_n_u16((uint16_t)fa)),vceqq_u16(vld1q_u16(b),vdupq_n_u16((uint16_t)fb)));
+	return vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(eq)),0) & 0x0101010101010101ULL;
+}
+
+static inline bytes_mask diff_mask16( const unsigned short *a, const unsigned short *b ) {
+	return ~vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(vceqq_u16(vld1q_u16(a),vld1q_u16(b)))),0) & 0x0101010101010101ULL;
+}
+
+#else
+
+typedef unsigned int bytes_mask;
+#define MASK8_SHIFT		0
+#define MASK16_SHIFT	1
+
+#ifdef HL_WIN
+#	include <intrin.h>
+static int __inline mask_first( bytes_mask m ) {
+	DWORD b = 0;
+	_BitScanForward(&b, m);
+	return (int)b;
+}
+static int __inline mask_last( bytes_mask m ) {
+	DWORD b = 0;
+	_BitScanReverse(&b, m);
+	return (int)b;
+}
+#else
+#	define mask_first(m)	__builtin_ctz(m)
+#	define mask_last(m)		(31 - __builtin_clz(m))
+#endif
+
+static inline bytes_mask find_mask8( const vbyte *a, const vbyte *b, int fa, int fb ) {
+	__m128i ea = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)a),_mm_set1_epi8((char)fa));
+	__m128i eb = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)b),_mm_set1_epi8((char)fb));
+	return (bytes_mask)_mm_movemask_epi8(_mm_and_si128(ea,eb));
+}
+
+static inline bytes_mask find_mask16( const uchar *a, const uchar *b, int fa, int fb ) {
+	__m128i ea = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)a),_mm_set1_epi16((short)fa));
+	__m128i eb = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)b),_mm_set1_epi16((short)fb));
+	return (bytes_mask)_mm_movemask_epi8(_mm_and_si128(ea,eb)) & 0x5555;
+}
+
+static inline bytes_mask diff_mask16( const unsigned short *a, const unsigned short *b ) {
+	__m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128((__m128i*)a),_mm_loadu_si128((__m128i*)b));
+	return ~(bytes_mask)_mm_movemask_epi8(eq) & 0x5555;
+}
+
+#endif
+
+#endif
 
 HL_PRIM vbyte *hl_alloc_bytes( int size ) {
 	return (vbyte*)hl_gc_alloc_noptr(size);
@@ -42,98 +124,155 @@ HL_PRIM int hl_bytes_compare( vbyte *a, int apos, vbyte *b, int bpos, int len )
 HL_PRIM int hl_bytes_compare16( vbyte *a, vbyte *b, int len ) {
 	unsigned short *s1 = (unsigned short *)a;
 	unsigned short *s2 = (unsigned short *)b;
-	int i;
-	for(i=0;i<len;i++)
+	int i = 0;
+#	ifdef BYTES_SIMD
+	for(;i+8<=len;i+=8) {
+		bytes_mask m = diff_mask16(s1 + i, s2 + i);
+		if( m ) {
+			i += mask_first(m) >> MASK16_SHIFT;
+			return ((int)s1[i]) - ((int)s2[i]);
+		}
+	}
+#	endif
+	for(;i<len;i++)
 		if( s1[i] != s2[i] )
 			return ((int)s1[i]) - ((int)s2[i]);
 	return 0;
 }
 
-typedef unsigned char byte;
-static void *
-memfind_rb (const void  *in_block,      /*  Block containing data            */
-            size_t       block_size,    /*  Size of block in bytes           */
-            const void  *in_pattern,    /*  Pattern to search for            */
-            size_t       pattern_size,  /*  Size of pattern block            */
-            size_t      *shift,         /*  Shift table (search buffer)      */
-            bool        *repeat_find)   /*  TRUE: search buffer already init */
-{
-    size_t
-        byte_nbr,                       /*  Distance through block           */
-        match_size;                     /*  Size of matched part             */
-    const byte
-        *match_base = NULL,             /*  Base of match of pattern         */
-        *match_ptr  = NULL,             /*  Point within current match       */
-        *limit      = NULL;             /*  Last potiental match point       */
-    const byte
-        *block   = (byte *) in_block,   /*  Concrete pointer to block data   */
-        *pattern = (byte *) in_pattern; /*  Concrete pointer to search value */
-
-    if (block == NULL || pattern == NULL || shift == NULL)
-        return (NULL);
-
-    /*  Pattern must be smaller or equal in size to string                   */
-    if (block_size < pattern_size)
-        return (NULL);                  /*  Otherwise it's not found         */
-
-    if (pattern_size == 0)              /*  Empty patterns match at start    */
-        return ((void *)block);
-
-    /*  Build the shift table unless we're continuing a previous search      */
-
-    /*  The shift table determines how far to shift before trying to match   */
-    /*  again, if a match at this point fails.  If the byte after where the  */
-    /*  end of our pattern falls is not in our pattern, then we start to     */
-    /*  match again after that byte; otherwise we line up the last occurence */
-    /*  of that byte in our pattern under that byte, and try match again.    */
-
-    if (!repeat_find || !*repeat_find)
-      {
-        for (byte_nbr = 0; byte_nbr < 256; byte_nbr++)
-            shift [byte_nbr] = pattern_size + 1;
-        for (byte_nbr = 0; byte_nbr < pattern_size; byte_nbr++)
-            shift [(byte) pattern [byte_nbr]] = pattern_size - byte_nbr;
-
-        if (repeat_find)
-            *repeat_find = true;
-      }
-
-    /*  Search for the block, each time jumping up by the amount             */
-    /*  computed in the shift table                                          */
-
-    limit = block + (block_size - pattern_size + 1);
-
-    for (match_base = block;
-         match_base < limit;
-         match_base += shift [*(match_base + pattern_size)])
-      {
-        match_ptr  = match_base;
-        match_size = 0;
-
-        /*  Compare pattern until it all matches, or we find a difference    */
-        while (*match_ptr++ == pattern [match_size++])
-          {
-            /*  If we found a match, return the start address                */
-            if (match_size >= pattern_size)
-              return ((void*)(match_base));
-
-          }
-      }
-    return NULL;
+// needles longer than this switch to the two-way search when SIMD filtering gets too many false candidates
+#define FIND_SHORT_MAX	32
+
+static inline unsigned int unit_at( const vbyte *p, int i, int usize ) {
+	return usize == 1 ? p[i] : ((const unsigned short*)p)[i];
+}
+
+static int max_suffix( const vbyte *x, int m, int usize, bool rev, int *period ) {
+	int ms = -1, j = 0, k = 1, p = 1;
+	while( j + k < m ) {
+		unsigned int a = unit_at(x,j + k,usize);
+		unsigned int b = unit_at(x,ms + k,usize);
+		if( rev ? a > b : a < b ) {
+			j += k;
+			k = 1;
+			p = j - ms;
+		} else if( a == b ) {
+			if( k != p )
+				k++;
+			else {
+				j += p;
+				k = 1;
+			}
+		} else {
+			ms = j++;
+			k = p = 1;
+		}
+	}
+	*period = p;
+	return ms;
+}
+
+/*
+	Crochemore-Perrin two-way search : linear time and constant space, so long
+	needles never degrade into quadratic behavior. Lengths are in units of usize bytes.
+*/
+static int find_two_way( const vbyte *y, int n, const vbyte *x, int m, int usize ) {
+	int i, j, p, q, ell, per, memory;
+	int s1 = max_suffix(x,m,usize,false,&p);
+	int s2 = max_suffix(x,m,usize,true,&q);
+	if( s1 > s2 ) {
+		ell = s1;
+		per = p;
+	} else {
+		ell = s2;
+		per = q;
+	}
+	if( memcmp(x,x + per * usize,(ell + 1) * usize) == 0 ) {
+		// periodic needle : remember how much of the prefix already matched
+		memory = -1;
+		j = 0;
+		while( j <= n - m ) {
+			i = (ell > memory ? ell : memory) + 1;
+			while( i < m && unit_at(x,i,usize) == unit_at(y,i + j,usize) ) i++;
+			if( i >= m ) {
+				i = ell;
+				while( i > memory && unit_at(x,i,usize) == unit_at(y,i + j,usize) ) i--;
+				if( i <= memory ) return j;
+				j += per;
+				memory = m - per - 1;
+			} else {
+				j += i - ell;
+				memory = -1;
+			}
+		}
+	} else {
+		per = (ell + 1 > m - ell - 1 ? ell + 1 : m - ell - 1) + 1;
+		j = 0;
+		while( j <= n - m ) {
+			i = ell + 1;
+			while( i < m && unit_at(x,i,usize) == unit_at(y,i + j,usize) ) i++;
+			if( i >= m ) {
+				i = ell;
+				while( i >= 0 && unit_at(x,i,usize) == unit_at(y,i + j,usize) ) i--;
+				if( i < 0 ) return j;
+				j += per;
+			} else
+				j += i - ell;
+		}
+	}
+	return -1;
 }
 
 HL_PRIM int hl_bytes_find( vbyte *where, int pos, int len, vbyte *which, int wpos, int wlen ) {
-	size_t searchbuf [256];
-	bool repeat_find = false;
-	vbyte *found = (vbyte*)memfind_rb(where + pos,len,which+wpos,wlen,searchbuf,&repeat_find);
-	if( found == NULL ) return -1;
-	return (int)(size_t)(found - where);
+	vbyte *s = where + pos;
+	vbyte *w = which + wpos;
+	int i = 0;
+	if( wlen > len ) return -1;
+	if( wlen == 0 ) return pos;
+	if( wlen == 1 ) {
+		vbyte *f = (vbyte*)memchr(s,*w,len);
+		return f ? (int)(f - where) : -1;
+	}
+#	ifdef BYTES_SIMD
+	// only check full matches where both the first and last bytes match
+	int checks = 0;
+	for(;i+wlen+15<=len;i+=16) {
+		bytes_mask m = find_mask8(s + i,s + i + wlen - 1,w[0],w[wlen-1]);
+		while( m ) {
+			int k = i + (mask_first(m) >> MASK8_SHIFT);
+			if( memcmp(s + k + 1,w + 1,wlen - 2) == 0 ) return pos + k;
+			m &= m - 1;
+			checks++;
+		}
+		if( wlen > FIND_SHORT_MAX && checks > (i >> 4) + 32 ) break;
+	}
+#	endif
+	if( wlen > FIND_SHORT_MAX ) {
+		int k = find_two_way(s + i,len - i,w,wlen,1);
+		return k < 0 ? -1 : pos + i + k;
+	}
+	for(;i<=len-wlen;i++)
+		if( s[i] == w[0] && memcmp(s + i + 1,w + 1,wlen - 1) == 0 )
+			return pos + i;
+	return -1;
 }
 
 HL_PRIM int hl_bytes_rfind( vbyte *where, int len, vbyte *which, int wlen ) {
 	if( wlen > len ) return -1;
 	if( wlen == 0 ) return len; // at end
 	int pos = len - wlen;
+#	ifdef BYTES_SIMD
+	for(;pos>=15;pos-=16) {
+		vbyte *s = where + pos - 15;
+		bytes_mask m = find_mask8(s,s + wlen - 1,which[0],which[wlen-1]);
+		while( m ) {
+			int b = mask_last(m);
+			int k = pos - 15 + (b >> MASK8_SHIFT);
+			if( wlen < 3 || memcmp(where + k + 1,which + 1,wlen - 2) == 0 ) return k;
+			m &= ~(((bytes_mask)1) << b);
+		}
+	}
+#	endif
 	while( pos >= 0 ) {
 		if( memcmp(where+pos,which,wlen) == 0 )
 			return pos;
@@ -142,6 +281,61 @@ HL_PRIM int hl_bytes_rfind( vbyte *where, int len, vbyte *which, int wlen ) {
 	return -1;
 }
 
+// UTF-16 variants : positions and lengths are in chars, matches are always char aligned
+
+HL_PRIM int hl_bytes_find16( vbyte *where, int pos, int len, vbyte *which, int wpos, int wlen ) {
+	uchar *s = (uchar*)where + pos;
+	uchar *w = (uchar*)which + wpos;
+	int i = 0;
+	if( wlen > len ) return -1;
+	if( wlen == 0 ) return pos;
+#	ifdef BYTES_SIMD
+	int checks = 0;
+	for(;i+wlen+7<=len;i+=8) {
+		bytes_mask m = find_mask16(s + i,s + i + wlen - 1,w[0],w[wlen-1]);
+		while( m ) {
+			int k = i + (mask_first(m) >> MASK16_SHIFT);
+			if( wlen < 3 || memcmp(s + k + 1,w + 1,(wlen - 2) * sizeof(uchar)) == 0 ) return pos + k;
+			m &= m - 1;
+			checks++;
+		}
+		if( wlen > FIND_SHORT_MAX && checks > (i >> 3) + 32 ) break;
+	}
+#	endif
+	if( wlen > FIND_SHORT_MAX ) {
+		int k = find_two_way((vbyte*)(s + i),len - i,(vbyte*)w,wlen,2);
+		return k < 0 ? -1 : pos + i + k;
+	}
+	for(;i<=len-wlen;i++)
+		if( s[i] == w[0] && memcmp(s + i + 1,w + 1,(wlen - 1) * sizeof(uchar)) == 0 )
+			return pos + i;
+	return -1;
+}
+
+HL_PRIM int hl_bytes_rfind16( vbyte *where, int len, vbyte *which, int wlen ) {
+	uchar *s = (uchar*)where;
+	uchar *w = (uchar*)which;
+	int pos;
+	if( wlen > len ) return -1;
+	if( wlen == 0 ) return len;
+	pos = len - wlen;
+#	ifdef BYTES_SIMD
+	for(;pos>=7;pos-=8) {
+		bytes_mask m = find_mask16(s + pos - 7,s + pos - 7 + wlen - 1,w[0],w[wlen-1]);
+		while( m ) {
+			int b = mask_last(m);
+			int k = pos - 7 + (b >> MASK16_SHIFT);
+			if( wlen < 3 || memcmp(s + k + 1,w + 1,(wlen - 2) * sizeof(uchar)) == 0 ) return k;
+			m &= ~(((bytes_mask)1) << b);
+		}
+	}
+#	endif
+	for(;pos>=0;pos--)
+		if( memcmp(s + pos,w,wlen * sizeof(uchar)) == 0 )
+			return pos;
+	return -1;
+}
+
 HL_PRIM void hl_bytes_fill( vbyte *bytes, int pos, int len, int value ) {
 	memset(bytes+pos,value,len);
 }
@@ -186,20 +380,395 @@ HL_PRIM void hl_bsort_i64(vbyte* bytes, int pos, int len, vclosure* cmp) {
 	merge_sort_rec_i64(&m, 0, len);
 }
 
+/*
+	Native sorts : numeric values are mapped to unsigned keys with the same order
+	(descending order complements the keys) then radix sorted, without calling any closure.
+	Large arrays are sorted with several threads.
+*/
+#define RADIX_BITS			11
+#define RADIX_SIZE			(1 << RADIX_BITS)
+#define RADIX_MASK			(RADIX_SIZE - 1)
+#define RADIX_MAX_PASSES	6
+#define RADIX_SMALL			64
+#define RADIX_MAX_THREADS	8
+#define RADIX_PARALLEL_MIN	(1 << 20)
+
+#ifdef HL_THREADS
+static int radix_threads( int n ) {
+	int ncpu;
+	if( n < RADIX_PARALLEL_MIN ) return 1;
+	ncpu = hl_cpu_count();
+	return ncpu < RADIX_MAX_THREADS ? ncpu : RADIX_MAX_THREADS;
+}
+#endif
+
+#define TRADIX unsigned int
+#define TKEY unsigned int
+#define RKEY(e) (e)
+#define RID(t) t##_u32
+#define RADIX_PARALLEL
+#include "radix.h"
+#define TRADIX uint64
+#define TKEY uint64
+#define RKEY(e) (e)
+#define RID(t) t##_u64
+#define RADIX_PARALLEL
+#include "radix.h"
+
+typedef struct {
+	unsigned int key;
+	int index;
+} radix_key32;
+
+typedef struct {
+	uint64 key;
+	int index;
+} radix_key64;
+
+#define TRADIX radix_key32
+#define TKEY unsigned int
+#define RKEY(e) ((e).key)
+#define RID(t) t##_k32
+#include "radix.h"
+#define TRADIX radix_key64
+#define TKEY uint64
+#define RKEY(e) ((e).key)
+#define RID(t) t##_k64
+#include "radix.h"
+
+#define RADIX_SORT_KEYS(id,T) \
+	static void radix_sort_keys_##id( T *a, int n ) { \
+		T *tmp; \
+		if( n < RADIX_SMALL ) { \
+			rs_insert_##id(a, n); \
+			return; \
+		} \
+		tmp = (T*)malloc(sizeof(T) * n); \
+		if( tmp == NULL ) hl_error("Out of memory"); \
+		RADIX_SORT_CALL(id) \
+		free(tmp); \
+	}
+
+#ifdef HL_THREADS
+#	define RADIX_SORT_CALL(id) \
+		{ \
+			int nthreads = radix_threads(n); \
+			if( nthreads > 1 ) radix_sort_parallel_##id(a, tmp, n, nthreads); else radix_sort_##id(a, tmp, n); \
+		}
+#else
+#	define RADIX_SORT_CALL(id)	radix_sort_##id(a, tmp, n);
+#endif
+
+RADIX_SORT_KEYS(u32,unsigned int)
+RADIX_SORT_KEYS(u64,uint64)
+
+#define F64_SIGN	0x8000000000000000ULL
+
+static inline uint64 f64_key( uint64 b ) {
+	return (b & F64_SIGN) ? ~b : b | F64_SIGN;
+}
+
+static inline uint64 f64_unkey( uint64 k ) {
+	return (k & F64_SIGN) ? k & ~F64_SIGN : ~k;
+}
+
+HL_PRIM void hl_bytes_sort_i32( vbyte *bytes, int pos, int len, bool desc ) {
+	unsigned int *a = (unsigned int*)(bytes + pos);
+	unsigned int x = desc ? 0x7FFFFFFF : 0x80000000;
+	int i;
+	for(i=0;i<len;i++) a[i] ^= x;
+	radix_sort_keys_u32(a, len);
+	for(i=0;i<len;i++) a[i] ^= x;
+}
+
+HL_PRIM void hl_bytes_sort_i64( vbyte *bytes, int pos, int len, bool desc ) {
+	uint64 *a = (uint64*)(bytes + pos);
+	uint64 x = desc ? ~F64_SIGN : F64_SIGN;
+	int i;
+	for(i=0;i<len;i++) a[i] ^= x;
+	radix_sort_keys_u64(a, len);
+	for(i=0;i<len;i++) a[i] ^= x;
+}
+
+// NaNs are always moved at the end in their original order, -0 is sorted before +0
+HL_PRIM void hl_bytes_sort_f64( vbyte *bytes, int pos, int len, bool desc ) {
+	uint64 *a = (uint64*)(bytes + pos);
+	uint64 x = desc ? ~(uint64)0 : 0;
+	int i, n = 0, nans = 0;
+	for(i=0;i<len;i++)
+		if( (a[i] & ~F64_SIGN) > 0x7FF0000000000000ULL ) nans++;
+	if( nans ) {
+		uint64 *tmp = (uint64*)malloc(sizeof(uint64) * nans);
+		if( tmp == NULL ) hl_error("Out of memory");
+		nans = 0;
+		for(i=0;i<len;i++) {
+			uint64 b = a[i];
+			if( (b & ~F64_SIGN) > 0x7FF0000000000000ULL )
+				tmp[nans++] = b;
+			else
+				a[n++] = b;
+		}
+		memcpy(a + n, tmp, sizeof(uint64) * nans);
+		free(tmp);
+	} else
+		n = len;
+	for(i=0;i<n;i++) a[i] = f64_key(a[i]) ^ x;
+	radix_sort_keys_u64(a, n);
+	for(i=0;i<n;i++) a[i] = f64_unkey(a[i] ^ x);
+}
+
+/*
+	Sorts an array of objects by a key : the key function is called once per element,
+	the sort is stable. The permutation is done in a no-pointer block since no GC can
+	happen at this point.
+*/
+static void radix_permute( void **arr, int *index, int stride, void **out, int len ) {
+	int i;
+	for(i=0;i<len;i++)
+		out[i] = arr[index[i * stride]];
+	memcpy(arr, out, sizeof(void*) * len);
+}
+
+HL_PRIM void hl_bytes_sort_key_i32( vbyte *bytes, int pos, int len, vclosure *key, bool desc ) {
+	vdynamic **arr = (vdynamic**)(bytes + pos);
+	radix_key32 *keys, *tmp;
+	unsigned int x = desc ? 0x7FFFFFFF : 0x80000000;
+	int i;
+	if( len <= 1 ) return;
+	keys = (radix_key32*)hl_gc_alloc_noptr(sizeof(radix_key32) * len * 2);
+	tmp = keys + len;
+	for(i=0;i<len;i++) {
+		keys[i].key = ((unsigned int)hl_call1(int,key,vdynamic*,arr[i])) ^ x;
+		keys[i].index = i;
+	}
+	radix_sort_k32(keys, tmp, len);
+	radix_permute((void**)arr, &keys[0].index, sizeof(radix_key32) / sizeof(int), (void**)tmp, len);
+}
+
+HL_PRIM void hl_bytes_sort_key_f64( vbyte *bytes, int pos, int len, vclosure *key, bool desc ) {
+	vdynamic **arr = (vdynamic**)(bytes + pos);
+	radix_key64 *keys, *tmp;
+	uint64 x = desc ? ~(uint64)0 : 0;
+	int i, n = 0, nans = 0;
+	if( len <= 1 ) return;
+	keys = (radix_key64*)hl_gc_alloc_noptr(sizeof(radix_key64) * len * 2);
+	tmp = keys + len;
+	for(i=0;i<len;i++) {
+		union { double d; uint64 b; } v;
+		v.d = hl_call1(double,key,vdynamic*,arr[i]);
+		if( (v.b & ~F64_SIGN) > 0x7FF0000000000000ULL ) {
+			// NaN keys go at the end in their original order
+			tmp[nans].index = i;
+			nans++;
+		} else {
+			keys[n].key = f64_key(v.b) ^ x;
+			keys[n].index = i;
+			n++;
+		}
+	}
+	memcpy(keys + n, tmp, sizeof(radix_key64) * nans);
+	radix_sort_k64(keys, tmp, n);
+	radix_permute((void**)arr, &keys[0].index, sizeof(radix_key64) / sizeof(int), (void**)tmp, len);
+}
+
 static inline bool is_space_char(uchar c) {
 	return c == 32 || (c > 8 && c < 14);
 }
 
+#include "pow5.h"
+#ifdef HL_VCC
+#	include <intrin.h>
+#endif
+
+static inline uint64 mul128( uint64 a, uint64 b, uint64 *hi ) {
+#	if defined(__SIZEOF_INT128__)
+	unsigned __int128 r = (unsigned __int128)a * b;
+	*hi = (uint64)(r >> 64);
+	return (uint64)r;
+#	elif defined(_M_X64)
+	return _umul128(a,b,hi);
+#	else
+	uint64 al = a & 0xFFFFFFFF, ah = a >> 32, bl = b & 0xFFFFFFFF, bh = b >> 32;
+	uint64 ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64 mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (ll & 0xFFFFFFFF);
+#	endif
+}
+
+static inline int clz64( uint64 v ) {
+#	ifdef HL_VCC
+	unsigned long r = 0;
+#		ifdef _M_X64
+	_BitScanReverse64(&r,v);
+#		else
+	if( v >> 32 ) _BitScanReverse(&r,(unsigned long)(v >> 32)); else { _BitScanReverse(&r,(unsigned long)v); r -= 32; }
+	r += 32;
+#		endif
+	return 63 - (int)r;
+#	else
+	return __builtin_clzll(v);
+#	endif
+}
+
+/*
+	Eisel-Lemire : correctly rounded w * 10^q for an exact w of up to 19 digits.
+	Returns false for subnormal or overflowing results, which are left to strtod.
+*/
+static bool eisel_lemire( uint64 w, int q, double *out ) {
+	uint64 lo, hi, lo2, hi2, mantissa, bits;
+	int lz, upper, shift, power2;
+	const uint64 *t;
+	if( q < POW5_MIN || q > POW5_MAX ) return false;
+	t = pow5_128 + ((q - POW5_MIN) << 1);
+	lz = clz64(w);
+	w <<= lz;
+	lo = mul128(w,t[0],&hi);
+	if( (hi & 0x1FF) == 0x1FF ) {
+		mul128(w,t[1],&hi2);
+		lo2 = lo + hi2;
+		if( lo2 < lo ) hi++;
+		lo = lo2;
+	}
+	upper = (int)(hi >> 63);
+	shift = upper + 9;
+	mantissa = hi >> shift;
+	power2 = (int)((((152170 + 65536) * (int64)q) >> 16) + 63) + upper - lz + 1023;
+	if( power2 <= 0 ) return false;
+	// exactly halfway : round to even
+	if( lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi )
+		mantissa &= ~(uint64)1;
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if( mantissa >= ((uint64)2 << 52) ) {
+		mantissa = (uint64)1 << 52;
+		power2++;
+	}
+	mantissa &= ~((uint64)1 << 52);
+	if( power2 >= 0x7FF ) return false;
+	bits = mantissa | ((uint64)power2 << 52);
+	memcpy(out,&bits,sizeof(double));
+	return true;
+}
+
+static const double exact_pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/*
+	Parses [+-]digits[.digits][(e|E)[+-]digits] in place, for UTF-16 (usize=2) or
+	UTF-8 (usize=1) text. Returns false when the number needs the strtod path
+	(no digits, more than 19 significant digits, out of range) so results stay
+	identical to utod.
+*/
+static inline int float_char( const vbyte *s, int len, int usize, int i ) {
+	return i < len ? (int)unit_at(s,i,usize) : 0;
+}
+
+static bool parse_float_fast( const vbyte *s, int len, int usize, double *out ) {
+	uint64 w = 0;
+	int i = 0, ndigits = 0, exp10 = 0, c;
+	bool neg = false, any = false;
+	double d;
+	c = float_char(s,len,usize,0);
+	if( c == '-' || c == '+' ) {
+		neg = c == '-';
+		c = float_char(s,len,usize,++i);
+	}
+	while( c >= '0' && c <= '9' ) {
+		any = true;
+		if( w || c != '0' ) {
+			if( ndigits == 19 ) return false;
+			w = w * 10 + (c - '0');
+			ndigits++;
+		}
+		c = float_char(s,len,usize,++i);
+	}
+	if( c == '.' ) {
+		c = float_char(s,len,usize,++i);
+		while( c >= '0' && c <= '9' ) {
+			any = true;
+			if( w || c != '0' ) {
+				if( ndigits == 19 ) return false;
+				w = w * 10 + (c - '0');
+				ndigits++;
+			}
+			exp10--;
+			c = float_char(s,len,usize,++i);
+		}
+	}
+	if( !any ) return false;
+	if( c == 'e' || c == 'E' ) {
+		int j = i + 1, e = 0;
+		bool eneg = false;
+		c = float_char(s,len,usize,j);
+		if( c == '-' || c == '+' ) {
+			eneg = c == '-';
+			c = float_char(s,len,usize,++j);
+		}
+		if( c >= '0' && c <= '9' ) {
+			while( c >= '0' && c <= '9' ) {
+				if( e < 100000 ) e = e * 10 + (c - '0');
+				c = float_char(s,len,usize,++j);
+			}
+			exp10 += eneg ? -e : e;
+			i = j;
+		}
+	}
+	// utod only reads up to 30 chars
+	if( i >= 30 ) return false;
+	if( w == 0 )
+		d = 0.;
+#	if FLT_EVAL_METHOD == 0
+	else if( exp10 >= -22 && exp10 <= 22 && w <= ((uint64)1 << 53) ) {
+		// both w and the power of ten are exact doubles : a single rounding
+		d = (double)(int64)w;
+		if( exp10 < 0 ) d /= exact_pow10[-exp10]; else d *= exact_pow10[exp10];
+	}
+#	endif
+	else if( !eisel_lemire(w,exp10,&d) )
+		return false;
+	*out = neg ? -d : d;
+	return true;
+}
+
 HL_PRIM double hl_parse_float( vbyte *bytes, int pos, int len ) {
 	const uchar *str = (uchar*)(bytes+pos);
 	uchar *end = NULL;
 	while( is_space_char(*str) ) str++;
-	double d = utod(str,&end);
+	double d;
+	if( parse_float_fast((vbyte*)str,0x7FFFFFFF,2,&d) )
+		return d;
+	d = utod(str,&end);
 	if( end == str )
 		return hl_nan();
 	return d;
 }
 
+HL_PRIM double hl_parse_float_utf8( vbyte *bytes, int pos, int len ) {
+	char buf[31];
+	char *end;
+	double d;
+	int i = 0;
+	bytes += pos;
+	while( len > 0 && is_space_char(*bytes) ) {
+		bytes++;
+		len--;
+	}
+	if( parse_float_fast(bytes,len,1,&d) )
+		return d;
+	// same as utod
+	while( i < 30 && i < len ) {
+		int c = bytes[i];
+		if( (c < '0' || c > '9') && c != '.' && c != 'e' && c != 'E' && c != '-' && c != '+' )
+			break;
+		buf[i++] = (char)c;
+	}
+	buf[i] = 0;
+	d = strtod(buf,&end);
+	if( end == buf )
+		return hl_nan();
+	return d;
+}
+
 static inline bool has_hex_prefix( const uchar *c, int len, bool is_signed ) {
 	if (is_signed)
 		return len >= 3 && c[1] == '0' && (c[2] == 'x' || c[2] == 'X');
@@ -291,12 +860,20 @@ DEFINE_PRIM(_I32,bytes_compare16,_BYTES _BYTES _I32);
 DEFINE_PRIM(_I32,string_compare,_BYTES _BYTES _I32);
 DEFINE_PRIM(_I32,bytes_find,_BYTES _I32 _I32 _BYTES _I32 _I32);
 DEFINE_PRIM(_I32,bytes_rfind,_BYTES _I32 _BYTES _I32);
+DEFINE_PRIM(_I32,bytes_find16,_BYTES _I32 _I32 _BYTES _I32 _I32);
+DEFINE_PRIM(_I32,bytes_rfind16,_BYTES _I32 _BYTES _I32);
 DEFINE_PRIM(_VOID,bytes_fill,_BYTES _I32 _I32 _I32);
 DEFINE_PRIM(_F64, parse_float,_BYTES _I32 _I32);
+DEFINE_PRIM(_F64, parse_float_utf8,_BYTES _I32 _I32);
 DEFINE_PRIM(_NULL(_I32), parse_int, _BYTES _I32 _I32);
 DEFINE_PRIM(_VOID,bsort_i32,_BYTES _I32 _I32 _FUN(_I32,_I32 _I32));
 DEFINE_PRIM(_VOID,bsort_f64,_BYTES _I32 _I32 _FUN(_I32,_F64 _F64));
 DEFINE_PRIM(_VOID, bsort_i64, _BYTES _I32 _I32 _FUN(_I32, _I64 _I64));
+DEFINE_PRIM(_VOID,bytes_sort_i32,_BYTES _I32 _I32 _BOOL);
+DEFINE_PRIM(_VOID,bytes_sort_i64,_BYTES _I32 _I32 _BOOL);
+DEFINE_PRIM(_VOID,bytes_sort_f64,_BYTES _I32 _I32 _BOOL);
+DEFINE_PRIM(_VOID,bytes_sort_key_i32,_BYTES _I32 _I32 _FUN(_I32,_DYN) _BOOL);
+DEFINE_PRIM(_VOID,bytes_sort_key_f64,_BYTES _I32 _I32 _FUN(_F64,_DYN) _BOOL);
 DEFINE_PRIM(_BYTES,bytes_offset, _BYTES _I32);
 DEFINE_PRIM(_I32,bytes_subtract, _BYTES _BYTES);
 DEFINE_PRIM(_I32,bytes_address, _BYTES _REF(_I32));
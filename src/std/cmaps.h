@@ -0,0 +1,132 @@
+#undef t_cmap
+#define t_cmap _CNAME(_cmap)
+#define t_imap _INAME(_map)
+
+typedef struct _CNAME(_cmap) t_cmap;
+struct _CNAME(_cmap) {
+	void (*free)( t_cmap * );
+	t_imap **maps;
+	cmap_lock locks[HL_CMAP_STRIPES];
+};
+
+static void _CNAME(free)( t_cmap *m ) {
+	int i;
+	hl_remove_root(&m->maps);
+	for(i=0;i<HL_CMAP_STRIPES;i++)
+		CMAP_LOCK_FREE(m->locks[i]);
+}
+
+static int _CNAME(stripe)( _MKEY_TYPE key ) {
+	return (int)((_INAME(hash)(_INAME(filter)(key)) * 0x9E3779B1u) >> (32 - HL_CMAP_STRIPE_BITS));
+}
+
+HL_PRIM t_cmap *_CNAME(alloc)() {
+	int i;
+	t_cmap *m = (t_cmap*)hl_gc_alloc_finalizer(sizeof(t_cmap));
+	m->free = _CNAME(free);
+	m->maps = (t_imap**)hl_gc_alloc_raw(sizeof(t_imap*) * HL_CMAP_STRIPES);
+	memset(m->maps,0,sizeof(t_imap*) * HL_CMAP_STRIPES);
+	// finalizer blocks are not scanned : root the stripes before allocating them
+	hl_add_root(&m->maps);
+	for(i=0;i<HL_CMAP_STRIPES;i++) {
+		m->maps[i] = _INAME(alloc)();
+		CMAP_LOCK_INIT(m->locks[i]);
+	}
+	return m;
+}
+
+HL_PRIM void _CNAME(set)( t_cmap *m, _MKEY_TYPE key, vdynamic *value ) {
+	int s = _CNAME(stripe)(key);
+	cmap_write_lock(&m->locks[s]);
+	_INAME(set)(m->maps[s],key,value);
+	CMAP_WRITE_UNLOCK(m->locks[s]);
+}
+
+HL_PRIM vdynamic *_CNAME(set_if_absent)( t_cmap *m, _MKEY_TYPE key, vdynamic *value ) {
+	vdynamic *prev;
+	int s = _CNAME(stripe)(key);
+	cmap_write_lock(&m->locks[s]);
+	prev = _INAME(get)(m->maps[s],key);
+	if( prev == NULL ) _INAME(set)(m->maps[s],key,value);
+	CMAP_WRITE_UNLOCK(m->locks[s]);
+	return prev;
+}
+
+HL_PRIM vdynamic *_CNAME(get)( t_cmap *m, _MKEY_TYPE key ) {
+	vdynamic *v;
+	int s = _CNAME(stripe)(key);
+	cmap_read_lock(&m->locks[s]);
+	v = _INAME(get)(m->maps[s],key);
+	CMAP_READ_UNLOCK(m->locks[s]);
+	return v;
+}
+
+HL_PRIM bool _CNAME(exists)( t_cmap *m, _MKEY_TYPE key ) {
+	bool b;
+	int s = _CNAME(stripe)(key);
+	cmap_read_lock(&m->locks[s]);
+	b = _INAME(exists)(m->maps[s],key);
+	CMAP_READ_UNLOCK(m->locks[s]);
+	return b;
+}
+
+HL_PRIM bool _CNAME(remove)( t_cmap *m, _MKEY_TYPE key ) {
+	bool b;
+	int s = _CNAME(stripe)(key);
+	cmap_write_lock(&m->locks[s]);
+	b = _INAME(remove)(m->maps[s],key);
+	CMAP_WRITE_UNLOCK(m->locks[s]);
+	return b;
+}
+
+static varray *_CNAME(collect)( t_cmap *m, hl_type *t, bool keys ) {
+	varray *parts[HL_CMAP_STRIPES];
+	varray *a;
+	int i, size = 0, esize = hl_type_size(t);
+	for(i=0;i<HL_CMAP_STRIPES;i++) {
+		cmap_read_lock(&m->locks[i]);
+		parts[i] = keys ? _INAME(keys)(m->maps[i]) : _INAME(values)(m->maps[i]);
+		CMAP_READ_UNLOCK(m->locks[i]);
+		size += parts[i]->size;
+	}
+	a = hl_alloc_array(t,size);
+	size = 0;
+	for(i=0;i<HL_CMAP_STRIPES;i++) {
+		memcpy(hl_aptr(a,char) + size * esize, hl_aptr(parts[i],char), parts[i]->size * esize);
+		size += parts[i]->size;
+	}
+	return a;
+}
+
+HL_PRIM varray *_CNAME(keys)( t_cmap *m ) {
+	return _CNAME(collect)(m,&hlt_key,true);
+}
+
+HL_PRIM varray *_CNAME(values)( t_cmap *m ) {
+	return _CNAME(collect)(m,&hlt_dyn,false);
+}
+
+HL_PRIM void _CNAME(clear)( t_cmap *m ) {
+	int i;
+	for(i=0;i<HL_CMAP_STRIPES;i++) {
+		cmap_write_lock(&m->locks[i]);
+		_INAME(clear)(m->maps[i]);
+		CMAP_WRITE_UNLOCK(m->locks[i]);
+	}
+}
+
+HL_PRIM int _CNAME(size)( t_cmap *m ) {
+	int i, size = 0;
+	for(i=0;i<HL_CMAP_STRIPES;i++) {
+		cmap_read_lock(&m->locks[i]);
+		size += _INAME(size)(m->maps[i]);
+		CMAP_READ_UNLOCK(m->locks[i]);
+	}
+	return size;
+}
+
+#undef hlt_key
+#undef _MKEY_TYPE
+#undef _CNAME
+#undef _INAME
+#undef t_imap
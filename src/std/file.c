@@ -249,6 +249,468 @@ HL_PRIM vbyte *hl_file_contents( vbyte *name, int *size ) {
 	return content;
 }
 
+// ----------------- MEMORY MAPPED FILES
+
+/*
+	The mapping lives outside of the GC heap, so the GC ignores pointers into it.
+	Bytes obtained from file_map_bytes must not be used after file_unmap.
+*/
+
+#if defined(HL_WIN_DESKTOP) || (!defined(HL_WIN) && !defined(HL_CONSOLE))
+#	define HL_FILE_MAP
+#	ifndef HL_WIN
+#		include <sys/mman.h>
+#		include <sys/stat.h>
+#		include <fcntl.h>
+#		include <unistd.h>
+#	endif
+#endif
+
+#define MAP_READ_ONLY		0
+#define MAP_COPY_ON_WRITE	1
+
+typedef struct _hl_fmap hl_fmap;
+struct _hl_fmap {
+	void (*finalize)( hl_fmap * );
+	vbyte *data;
+	int64 size;
+};
+
+static void fmap_finalize( hl_fmap *m ) {
+#	ifdef HL_FILE_MAP
+	if( m->data && m->size ) {
+#		ifdef HL_WIN
+		UnmapViewOfFile(m->data);
+#		else
+		munmap(m->data, (size_t)m->size);
+#		endif
+	}
+#	endif
+	m->data = NULL;
+}
+
+HL_PRIM hl_fmap *hl_file_map( vbyte *name, int mode ) {
+#	ifndef HL_FILE_MAP
+	return NULL;
+#	else
+	hl_fmap *m;
+	vbyte *data;
+	int64 size;
+#	ifdef HL_WIN
+	LARGE_INTEGER fsize;
+	HANDLE h, hmap;
+	hl_blocking(true);
+	h = CreateFileW((uchar*)name,GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_WRITE,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if( h == INVALID_HANDLE_VALUE || !GetFileSizeEx(h,&fsize) ) {
+		if( h != INVALID_HANDLE_VALUE ) CloseHandle(h);
+		hl_blocking(false);
+		return NULL;
+	}
+	size = fsize.QuadPart;
+	data = (vbyte*)"";
+	if( size ) {
+		hmap = CreateFileMappingW(h,NULL,mode == MAP_COPY_ON_WRITE ? PAGE_WRITECOPY : PAGE_READONLY,0,0,NULL);
+		data = hmap ? (vbyte*)MapViewOfFile(hmap,mode == MAP_COPY_ON_WRITE ? FILE_MAP_COPY : FILE_MAP_READ,0,0,0) : NULL;
+		if( hmap ) CloseHandle(hmap);
+	}
+	CloseHandle(h);
+	hl_blocking(false);
+	if( data == NULL ) return NULL;
+#	else
+	struct stat st;
+	int fd;
+	hl_blocking(true);
+	fd = open((char*)name,O_RDONLY|O_CLOEXEC);
+	if( fd < 0 || fstat(fd,&st) != 0 ) {
+		if( fd >= 0 ) close(fd);
+		hl_blocking(false);
+		return NULL;
+	}
+	size = st.st_size;
+	data = (vbyte*)"";
+	if( size ) {
+		data = (vbyte*)mmap(NULL,(size_t)size,mode == MAP_COPY_ON_WRITE ? PROT_READ|PROT_WRITE : PROT_READ,MAP_PRIVATE,fd,0);
+		if( data == (vbyte*)MAP_FAILED ) data = NULL;
+	}
+	close(fd);
+	hl_blocking(false);
+	if( data == NULL ) return NULL;
+#	endif
+	m = (hl_fmap*)hl_gc_alloc_finalizer(sizeof(hl_fmap));
+	m->finalize = fmap_finalize;
+	m->data = data;
+	m->size = size;
+	return m;
+#	endif
+}
+
+HL_PRIM vbyte *hl_file_map_bytes( hl_fmap *m ) {
+	return m ? m->data : NULL;
+}
+
+HL_PRIM int64 hl_file_map_size( hl_fmap *m ) {
+	return m && m->data ? m->size : 0;
+}
+
+// kind : 0 = normal, 1 = sequential, 2 = random, 3 = will need, 4 = don't need
+HL_PRIM bool hl_file_map_advise( hl_fmap *m, int kind, int64 p, int64 l ) {
+	if( !m || !m->data || p < 0 || l < 0 || p + l > m->size ) return false;
+	if( !m->size ) return true;
+	if( l == 0 ) l = m->size - p;
+#	if defined(HL_FILE_MAP) && !defined(HL_WIN)
+	{
+		static const int ADVICE[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED };
+		// madvise requires a page aligned address
+		int64 page = sysconf(_SC_PAGESIZE);
+		int64 start = p & ~(page - 1);
+		if( kind < 0 || kind > 4 ) return false;
+		return madvise(m->data + start, (size_t)(p + l - start), ADVICE[kind]) == 0;
+	}
+#	elif defined(HL_FILE_MAP)
+	if( kind == 3 ) {
+		WIN32_MEMORY_RANGE_ENTRY r;
+		r.VirtualAddress = m->data + p;
+		r.NumberOfBytes = (SIZE_T)l;
+		return PrefetchVirtualMemory(GetCurrentProcess(),1,&r,0) != 0;
+	}
+	return kind >= 0 && kind <= 4;
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM void hl_file_unmap( hl_fmap *m ) {
+	if( !m ) return;
+	fmap_finalize(m);
+	m->finalize = NULL;
+}
+
+// ----------------- RAW FILES
+
+/*
+	Unbuffered file handles on top of the OS descriptor : positional reads and
+	writes at 64-bit offsets don't share a file position, so several threads
+	can use the same handle concurrently. With RAW_DIRECT, buffers, offsets and
+	lengths must be aligned on the device block size (see file_raw_align_offset).
+*/
+
+#define RAW_DIRECT	1
+#define RAW_DSYNC	2
+
+#ifndef HL_CONSOLE
+#	define HL_FILE_RAW
+#	ifndef HL_WIN
+#		include <sys/uio.h>
+#		include <sys/stat.h>
+#		include <fcntl.h>
+#		include <unistd.h>
+#		include <limits.h>
+#		ifndef IOV_MAX
+#			define IOV_MAX	1024
+#		endif
+#	endif
+#endif
+
+typedef struct _hl_fraw hl_fraw;
+struct _hl_fraw {
+	void (*finalize)( hl_fraw * );
+#	ifdef HL_WIN
+	HANDLE h;
+#	else
+	int fd;
+#	endif
+};
+
+#ifdef HL_FILE_RAW
+
+static void fraw_finalize( hl_fraw *f ) {
+#	ifdef HL_WIN
+	if( f->h != INVALID_HANDLE_VALUE ) CloseHandle(f->h);
+	f->h = INVALID_HANDLE_VALUE;
+#	else
+	if( f->fd >= 0 ) close(f->fd);
+	f->fd = -1;
+#	endif
+}
+
+#ifdef HL_WIN
+static int fraw_transfer( hl_fraw *f, vbyte *buf, int len, int64 offset, bool write ) {
+	DWORD n = 0;
+	OVERLAPPED o;
+	BOOL ok;
+	memset(&o,0,sizeof(o));
+	o.Offset = (DWORD)offset;
+	o.OffsetHigh = (DWORD)(offset >> 32);
+	ok = write ? WriteFile(f->h,buf,len,&n,offset < 0 ? NULL : &o) : ReadFile(f->h,buf,len,&n,offset < 0 ? NULL : &o);
+	if( !ok ) return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+	return (int)n;
+}
+#endif
+
+#endif
+
+// mode : 0 = read, 1 = write (create/truncate), 2 = append, 3 = read/write, 4 = read/write (create)
+HL_PRIM hl_fraw *hl_file_raw_open( vbyte *name, int mode, int flags ) {
+#	ifndef HL_FILE_RAW
+	return NULL;
+#	else
+	hl_fraw *f;
+#	ifdef HL_WIN
+	static const DWORD ACCESS[] = { GENERIC_READ, GENERIC_WRITE, FILE_APPEND_DATA, GENERIC_READ|GENERIC_WRITE, GENERIC_READ|GENERIC_WRITE };
+	static const DWORD DISPOSITION[] = { OPEN_EXISTING, CREATE_ALWAYS, OPEN_ALWAYS, OPEN_EXISTING, OPEN_ALWAYS };
+	DWORD attr = FILE_ATTRIBUTE_NORMAL;
+	HANDLE h;
+	if( mode < 0 || mode > 4 ) return NULL;
+	if( flags & RAW_DIRECT ) attr |= FILE_FLAG_NO_BUFFERING;
+	if( flags & RAW_DSYNC ) attr |= FILE_FLAG_WRITE_THROUGH;
+	hl_blocking(true);
+	h = CreateFileW((uchar*)name,ACCESS[mode],FILE_SHARE_READ|FILE_SHARE_WRITE,NULL,DISPOSITION[mode],attr,NULL);
+	hl_blocking(false);
+	if( h == INVALID_HANDLE_VALUE ) return NULL;
+#	else
+	static const int MODES[] = { O_RDONLY, O_WRONLY|O_CREAT|O_TRUNC, O_WRONLY|O_CREAT|O_APPEND, O_RDWR, O_RDWR|O_CREAT };
+	int fd, oflags;
+	if( mode < 0 || mode > 4 ) return NULL;
+	oflags = MODES[mode] | O_CLOEXEC;
+#	ifdef O_DIRECT
+	if( flags & RAW_DIRECT ) oflags |= O_DIRECT;
+#	endif
+#	ifdef O_DSYNC
+	if( flags & RAW_DSYNC ) oflags |= O_DSYNC;
+#	endif
+	hl_blocking(true);
+	fd = open((char*)name,oflags,0666);
+#	ifdef F_NOCACHE
+	// macOS has no O_DIRECT
+	if( fd >= 0 && (flags & RAW_DIRECT) ) fcntl(fd,F_NOCACHE,1);
+#	endif
+	hl_blocking(false);
+	if( fd < 0 ) return NULL;
+#	endif
+	f = (hl_fraw*)hl_gc_alloc_finalizer(sizeof(hl_fraw));
+	f->finalize = fraw_finalize;
+#	ifdef HL_WIN
+	f->h = h;
+#	else
+	f->fd = fd;
+#	endif
+	return f;
+#	endif
+}
+
+HL_PRIM void hl_file_raw_close( hl_fraw *f ) {
+#	ifdef HL_FILE_RAW
+	if( !f || !f->finalize ) return;
+	fraw_finalize(f);
+	f->finalize = NULL;
+#	endif
+}
+
+// native descriptor, usable with the aio ring
+HL_PRIM int hl_file_raw_fd( hl_fraw *f ) {
+#	if defined(HL_FILE_RAW) && !defined(HL_WIN)
+	return f && f->finalize ? f->fd : -1;
+#	else
+	return -1;
+#	endif
+}
+
+HL_PRIM int hl_file_raw_pread( hl_fraw *f, vbyte *buf, int pos, int len, int64 offset ) {
+#	ifdef HL_FILE_RAW
+	int r;
+	if( !f || !f->finalize ) return -1;
+	hl_blocking(true);
+#	ifdef HL_WIN
+	r = fraw_transfer(f,buf + pos,len,offset,false);
+#	else
+	do {
+		r = (int)(offset < 0 ? read(f->fd,buf + pos,len) : pread(f->fd,buf + pos,len,(off_t)offset));
+	} while( r < 0 && errno == EINTR );
+#	endif
+	hl_blocking(false);
+	return r;
+#	else
+	return -1;
+#	endif
+}
+
+HL_PRIM int hl_file_raw_pwrite( hl_fraw *f, vbyte *buf, int pos, int len, int64 offset ) {
+#	ifdef HL_FILE_RAW
+	int r;
+	if( !f || !f->finalize ) return -1;
+	hl_blocking(true);
+#	ifdef HL_WIN
+	r = fraw_transfer(f,buf + pos,len,offset,true);
+#	else
+	do {
+		r = (int)(offset < 0 ? write(f->fd,buf + pos,len) : pwrite(f->fd,buf + pos,len,(off_t)offset));
+	} while( r < 0 && errno == EINTR );
+#	endif
+	hl_blocking(false);
+	return r;
+#	else
+	return -1;
+#	endif
+}
+
+#ifdef HL_FILE_RAW
+// slices holds a (pos,len) pair for each bytes of bufs
+static int fraw_vectored( hl_fraw *f, varray *bufs, int *slices, int64 offset, bool write ) {
+	int i, total = 0;
+#	ifdef HL_WIN
+	hl_blocking(true);
+	for(i=0;i<bufs->size;i++) {
+		int len = slices[i*2+1];
+		int r = fraw_transfer(f,hl_aptr(bufs,vbyte*)[i] + slices[i*2],len,offset < 0 ? offset : offset + total,write);
+		if( r < 0 ) {
+			hl_blocking(false);
+			return total ? total : -1;
+		}
+		total += r;
+		if( r < len ) break;
+	}
+	hl_blocking(false);
+#	else
+	struct iovec iov[64];
+	int start = 0;
+	hl_blocking(true);
+	while( start < bufs->size ) {
+		int n = bufs->size - start, r, want = 0;
+		if( n > 64 ) n = 64;
+		if( n > IOV_MAX ) n = IOV_MAX;
+		for(i=0;i<n;i++) {
+			iov[i].iov_base = hl_aptr(bufs,vbyte*)[start + i] + slices[(start + i) * 2];
+			iov[i].iov_len = slices[(start + i) * 2 + 1];
+			want += (int)iov[i].iov_len;
+		}
+		do {
+			if( offset < 0 )
+				r = (int)(write ? writev(f->fd,iov,n) : readv(f->fd,iov,n));
+			else
+				r = (int)(write ? pwritev(f->fd,iov,n,(off_t)(offset + total)) : preadv(f->fd,iov,n,(off_t)(offset + total)));
+		} while( r < 0 && errno == EINTR );
+		if( r < 0 ) {
+			hl_blocking(false);
+			return total ? total : -1;
+		}
+		total += r;
+		if( r < want ) break;
+		start += n;
+	}
+	hl_blocking(false);
+#	endif
+	return total;
+}
+#endif
+
+// scatter read into bufs, at offset or at the current position if offset < 0
+HL_PRIM int hl_file_raw_readv( hl_fraw *f, varray *bufs, int *slices, int64 offset ) {
+#	ifdef HL_FILE_RAW
+	if( !f || !f->finalize ) return -1;
+	return fraw_vectored(f,bufs,slices,offset,false);
+#	else
+	return -1;
+#	endif
+}
+
+HL_PRIM int hl_file_raw_writev( hl_fraw *f, varray *bufs, int *slices, int64 offset ) {
+#	ifdef HL_FILE_RAW
+	if( !f || !f->finalize ) return -1;
+	return fraw_vectored(f,bufs,slices,offset,true);
+#	else
+	return -1;
+#	endif
+}
+
+HL_PRIM int64 hl_file_raw_size( hl_fraw *f ) {
+#	if !defined(HL_FILE_RAW)
+	return -1;
+#	elif defined(HL_WIN)
+	LARGE_INTEGER size;
+	if( !f || !f->finalize || !GetFileSizeEx(f->h,&size) ) return -1;
+	return size.QuadPart;
+#	else
+	struct stat st;
+	if( !f || !f->finalize || fstat(f->fd,&st) != 0 ) return -1;
+	return st.st_size;
+#	endif
+}
+
+HL_PRIM bool hl_file_raw_truncate( hl_fraw *f, int64 size ) {
+#	if !defined(HL_FILE_RAW)
+	return false;
+#	elif defined(HL_WIN)
+	FILE_END_OF_FILE_INFO info;
+	if( !f || !f->finalize ) return false;
+	info.EndOfFile.QuadPart = size;
+	return SetFileInformationByHandle(f->h,FileEndOfFileInfo,&info,sizeof(info)) != 0;
+#	else
+	if( !f || !f->finalize ) return false;
+	return ftruncate(f->fd,(off_t)size) == 0;
+#	endif
+}
+
+HL_PRIM bool hl_file_raw_sync( hl_fraw *f, bool data_only ) {
+#	if !defined(HL_FILE_RAW)
+	return false;
+#	else
+	bool ok;
+	if( !f || !f->finalize ) return false;
+	hl_blocking(true);
+#	if defined(HL_WIN)
+	ok = FlushFileBuffers(f->h) != 0;
+#	elif defined(HL_LINUX)
+	ok = (data_only ? fdatasync(f->fd) : fsync(f->fd)) == 0;
+#	else
+	ok = fsync(f->fd) == 0;
+#	endif
+	hl_blocking(false);
+	return ok;
+#	endif
+}
+
+// reserve disk space for [offset, offset+len) without changing the file data
+HL_PRIM bool hl_file_raw_allocate( hl_fraw *f, int64 offset, int64 len ) {
+#	if !defined(HL_FILE_RAW) || defined(HL_WIN) || defined(HL_MAC) || defined(HL_IOS) || defined(HL_TVOS)
+	return false;
+#	else
+	bool ok;
+	if( !f || !f->finalize ) return false;
+	hl_blocking(true);
+#	ifdef HL_LINUX
+	ok = fallocate(f->fd,0,(off_t)offset,(off_t)len) == 0 || (errno == EOPNOTSUPP && posix_fallocate(f->fd,(off_t)offset,(off_t)len) == 0);
+#	else
+	ok = posix_fallocate(f->fd,(off_t)offset,(off_t)len) == 0;
+#	endif
+	hl_blocking(false);
+	return ok;
+#	endif
+}
+
+// kind : 0 = normal, 1 = sequential, 2 = random, 3 = will need, 4 = don't need, 5 = no reuse
+HL_PRIM bool hl_file_raw_advise( hl_fraw *f, int64 offset, int64 len, int kind ) {
+#	if !defined(HL_FILE_RAW) || defined(HL_WIN)
+	return false;
+#	elif defined(POSIX_FADV_NORMAL)
+	static const int ADVICE[] = { POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED, POSIX_FADV_NOREUSE };
+	if( !f || !f->finalize || kind < 0 || kind > 5 ) return false;
+	return posix_fadvise(f->fd,(off_t)offset,(off_t)len,ADVICE[kind]) == 0;
+#	elif defined(F_RDADVISE)
+	struct radvisory r;
+	if( !f || !f->finalize || kind != 3 ) return false;
+	r.ra_offset = (off_t)offset;
+	r.ra_count = (int)len;
+	return fcntl(f->fd,F_RDADVISE,&r) == 0;
+#	else
+	return false;
+#	endif
+}
+
+// offset to add to buf so that it is aligned on align bytes (a power of two)
+HL_PRIM int hl_file_raw_align_offset( vbyte *buf, int align ) {
+	return (int)((align - ((int_val)buf & (align - 1))) & (align - 1));
+}
+
 #define _FILE _ABSTRACT(hl_fdesc)
 DEFINE_PRIM(_FILE, file_open, _BYTES _I32 _BOOL);
 DEFINE_PRIM(_VOID, file_close, _FILE);
@@ -269,3 +731,25 @@ DEFINE_PRIM(_BYTES, file_contents, _BYTES _REF(_I32));
 DEFINE_PRIM(_BOOL, file_is_locked, _BYTES);
 DEFINE_PRIM(_I32, file_error_code, _NO_ARG);
 
+
+#define _FMAP _ABSTRACT(hl_fmap)
+DEFINE_PRIM(_FMAP, file_map, _BYTES _I32);
+DEFINE_PRIM(_BYTES, file_map_bytes, _FMAP);
+DEFINE_PRIM(_I64, file_map_size, _FMAP);
+DEFINE_PRIM(_BOOL, file_map_advise, _FMAP _I32 _I64 _I64);
+DEFINE_PRIM(_VOID, file_unmap, _FMAP);
+
+#define _FRAW _ABSTRACT(hl_fraw)
+DEFINE_PRIM(_FRAW, file_raw_open, _BYTES _I32 _I32);
+DEFINE_PRIM(_VOID, file_raw_close, _FRAW);
+DEFINE_PRIM(_I32, file_raw_fd, _FRAW);
+DEFINE_PRIM(_I32, file_raw_pread, _FRAW _BYTES _I32 _I32 _I64);
+DEFINE_PRIM(_I32, file_raw_pwrite, _FRAW _BYTES _I32 _I32 _I64);
+DEFINE_PRIM(_I32, file_raw_readv, _FRAW _ARR _BYTES _I64);
+DEFINE_PRIM(_I32, file_raw_writev, _FRAW _ARR _BYTES _I64);
+DEFINE_PRIM(_I64, file_raw_size, _FRAW);
+DEFINE_PRIM(_BOOL, file_raw_truncate, _FRAW _I64);
+DEFINE_PRIM(_BOOL, file_raw_sync, _FRAW _BOOL);
+DEFINE_PRIM(_BOOL, file_raw_allocate, _FRAW _I64 _I64);
+DEFINE_PRIM(_BOOL, file_raw_advise, _FRAW _I64 _I64 _I32);
+DEFINE_PRIM(_I32, file_raw_align_offset, _BYTES _I32);
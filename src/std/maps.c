@@ -19,7 +19,7 @@
  * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
  * DEALINGS IN THE SOFTWARE.
  */
-#include <hl.h>
+#include "hlsystem.h"
 #ifdef HL_VCC
 #	pragma warning(disable:4034) // sizeof(void) == 0
 #endif
@@ -271,6 +271,100 @@ typedef struct {
 
 #include "maps.h"
 
+// ----- CONCURRENT MAPS ---------------------------------
+
+/*
+	Concurrent maps shard their entries over a fixed number of stripes, each stripe
+	being a regular map protected by its own reader/writer lock. Stripes are selected
+	with the same hash as the underlying map, so that resizes only lock one stripe.
+*/
+
+#define HL_CMAP_STRIPE_BITS	5
+#define HL_CMAP_STRIPES		(1 << HL_CMAP_STRIPE_BITS)
+
+#if !defined(HL_THREADS)
+typedef int cmap_lock;
+#	define CMAP_LOCK_INIT(l)
+#	define CMAP_LOCK_FREE(l)
+#	define CMAP_TRY_READ_LOCK(l)	true
+#	define CMAP_TRY_WRITE_LOCK(l)	true
+#	define CMAP_READ_LOCK(l)
+#	define CMAP_WRITE_LOCK(l)
+#	define CMAP_READ_UNLOCK(l)
+#	define CMAP_WRITE_UNLOCK(l)
+#elif defined(HL_WIN)
+typedef SRWLOCK cmap_lock;
+#	define CMAP_LOCK_INIT(l)		InitializeSRWLock(&(l))
+#	define CMAP_LOCK_FREE(l)
+#	define CMAP_TRY_READ_LOCK(l)	TryAcquireSRWLockShared(&(l))
+#	define CMAP_TRY_WRITE_LOCK(l)	TryAcquireSRWLockExclusive(&(l))
+#	define CMAP_READ_LOCK(l)		AcquireSRWLockShared(&(l))
+#	define CMAP_WRITE_LOCK(l)		AcquireSRWLockExclusive(&(l))
+#	define CMAP_READ_UNLOCK(l)		ReleaseSRWLockShared(&(l))
+#	define CMAP_WRITE_UNLOCK(l)		ReleaseSRWLockExclusive(&(l))
+#else
+#	include <pthread.h>
+typedef pthread_rwlock_t cmap_lock;
+#	define CMAP_LOCK_INIT(l)		cmap_lock_init(&(l))
+#	define CMAP_LOCK_FREE(l)		pthread_rwlock_destroy(&(l))
+#	define CMAP_TRY_READ_LOCK(l)	(pthread_rwlock_tryrdlock(&(l)) == 0)
+#	define CMAP_TRY_WRITE_LOCK(l)	(pthread_rwlock_trywrlock(&(l)) == 0)
+#	define CMAP_READ_LOCK(l)		pthread_rwlock_rdlock(&(l))
+#	define CMAP_WRITE_LOCK(l)		pthread_rwlock_wrlock(&(l))
+#	define CMAP_READ_UNLOCK(l)		pthread_rwlock_unlock(&(l))
+#	define CMAP_WRITE_UNLOCK(l)		pthread_rwlock_unlock(&(l))
+
+static void cmap_lock_init( cmap_lock *l ) {
+	pthread_rwlockattr_t a;
+	pthread_rwlockattr_init(&a);
+#	if defined(HL_LINUX) && !defined(HL_ANDROID)
+	// glibc defaults to readers preference, which can starve writers of a hot cache
+	pthread_rwlockattr_setkind_np(&a,PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#	endif
+	pthread_rwlock_init(l,&a);
+	pthread_rwlockattr_destroy(&a);
+}
+#endif
+
+// only enter blocking mode when we need to wait, so a waiting thread never delays a GC
+static void cmap_read_lock( cmap_lock *l ) {
+	if( CMAP_TRY_READ_LOCK(*l) ) return;
+	hl_blocking(true);
+	CMAP_READ_LOCK(*l);
+	hl_blocking(false);
+}
+
+static void cmap_write_lock( cmap_lock *l ) {
+	if( CMAP_TRY_WRITE_LOCK(*l) ) return;
+	hl_blocking(true);
+	CMAP_WRITE_LOCK(*l);
+	hl_blocking(false);
+}
+
+#define hlt_key		hlt_i32
+#define _MKEY_TYPE	int
+#define _CNAME(n)	hl_chi##n
+#define _INAME(n)	hl_hi##n
+#include "cmaps.h"
+
+#define hlt_key		hlt_i64
+#define _MKEY_TYPE	int64
+#define _CNAME(n)	hl_chi64##n
+#define _INAME(n)	hl_hi64##n
+#include "cmaps.h"
+
+#define hlt_key		hlt_bytes
+#define _MKEY_TYPE	uchar*
+#define _CNAME(n)	hl_chb##n
+#define _INAME(n)	hl_hb##n
+#include "cmaps.h"
+
+#define hlt_key		hlt_dyn
+#define _MKEY_TYPE	vdynamic*
+#define _CNAME(n)	hl_cho##n
+#define _INAME(n)	hl_ho##n
+#include "cmaps.h"
+
 /// ----------------------------------------------
 
 #define _IMAP _ABSTRACT(hl_int_map)
@@ -316,3 +410,51 @@ DEFINE_PRIM( _ARR, hokeys, _OMAP );
 DEFINE_PRIM( _ARR, hovalues, _OMAP );
 DEFINE_PRIM( _VOID, hoclear, _OMAP );
 DEFINE_PRIM( _I32, hosize, _OMAP );
+
+#define _CIMAP _ABSTRACT(hl_int_cmap)
+DEFINE_PRIM( _CIMAP, chialloc, _NO_ARG );
+DEFINE_PRIM( _VOID, chiset, _CIMAP _I32 _DYN );
+DEFINE_PRIM( _DYN, chiset_if_absent, _CIMAP _I32 _DYN );
+DEFINE_PRIM( _BOOL, chiexists, _CIMAP _I32 );
+DEFINE_PRIM( _DYN, chiget, _CIMAP _I32 );
+DEFINE_PRIM( _BOOL, chiremove, _CIMAP _I32 );
+DEFINE_PRIM( _ARR, chikeys, _CIMAP );
+DEFINE_PRIM( _ARR, chivalues, _CIMAP );
+DEFINE_PRIM( _VOID, chiclear, _CIMAP );
+DEFINE_PRIM( _I32, chisize, _CIMAP );
+
+#define _CI64MAP _ABSTRACT(hl_int64_cmap)
+DEFINE_PRIM( _CI64MAP, chi64alloc, _NO_ARG );
+DEFINE_PRIM( _VOID, chi64set, _CI64MAP _I64 _DYN );
+DEFINE_PRIM( _DYN, chi64set_if_absent, _CI64MAP _I64 _DYN );
+DEFINE_PRIM( _BOOL, chi64exists, _CI64MAP _I64 );
+DEFINE_PRIM( _DYN, chi64get, _CI64MAP _I64 );
+DEFINE_PRIM( _BOOL, chi64remove, _CI64MAP _I64 );
+DEFINE_PRIM( _ARR, chi64keys, _CI64MAP );
+DEFINE_PRIM( _ARR, chi64values, _CI64MAP );
+DEFINE_PRIM( _VOID, chi64clear, _CI64MAP );
+DEFINE_PRIM( _I32, chi64size, _CI64MAP );
+
+#define _CBMAP _ABSTRACT(hl_bytes_cmap)
+DEFINE_PRIM( _CBMAP, chballoc, _NO_ARG );
+DEFINE_PRIM( _VOID, chbset, _CBMAP _BYTES _DYN );
+DEFINE_PRIM( _DYN, chbset_if_absent, _CBMAP _BYTES _DYN );
+DEFINE_PRIM( _BOOL, chbexists, _CBMAP _BYTES );
+DEFINE_PRIM( _DYN, chbget, _CBMAP _BYTES );
+DEFINE_PRIM( _BOOL, chbremove, _CBMAP _BYTES );
+DEFINE_PRIM( _ARR, chbkeys, _CBMAP );
+DEFINE_PRIM( _ARR, chbvalues, _CBMAP );
+DEFINE_PRIM( _VOID, chbclear, _CBMAP );
+DEFINE_PRIM( _I32, chbsize, _CBMAP );
+
+#define _COMAP _ABSTRACT(hl_obj_cmap)
+DEFINE_PRIM( _COMAP, choalloc, _NO_ARG );
+DEFINE_PRIM( _VOID, choset, _COMAP _DYN _DYN );
+DEFINE_PRIM( _DYN, choset_if_absent, _COMAP _DYN _DYN );
+DEFINE_PRIM( _BOOL, choexists, _COMAP _DYN );
+DEFINE_PRIM( _DYN, choget, _COMAP _DYN );
+DEFINE_PRIM( _BOOL, choremove, _COMAP _DYN );
+DEFINE_PRIM( _ARR, chokeys, _COMAP );
+DEFINE_PRIM( _ARR, chovalues, _COMAP );
+DEFINE_PRIM( _VOID, choclear, _COMAP );
+DEFINE_PRIM( _I32, chosize, _COMAP );
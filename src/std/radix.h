@@ -0,0 +1,214 @@
+/*
+	Stable LSD radix sort, included by bytes.c with :
+		TRADIX : the element type
+		TKEY : the unsigned key type (ascending order)
+		RKEY(e) : the key of an element
+		RID(t) : names the generated functions
+		RADIX_PARALLEL : also generates radix_sort_parallel
+	The common definitions (RADIX_*, radix_threads) are in bytes.c
+*/
+#define rs_insert RID(rs_insert)
+#define rs_lsd RID(rs_lsd)
+#define radix_sort RID(radix_sort)
+#define rs_par RID(rs_par)
+#define rs_par_phase RID(rs_par_phase)
+#define radix_sort_parallel RID(radix_sort_parallel)
+
+static void rs_insert( TRADIX *a, int n ) {
+	int i;
+	for(i=1;i<n;i++) {
+		TRADIX v = a[i];
+		TKEY k = RKEY(v);
+		int j = i;
+		while( j > 0 && RKEY(a[j-1]) > k ) {
+			a[j] = a[j-1];
+			j--;
+		}
+		a[j] = v;
+	}
+}
+
+// sorts on the low 'bits' of the keys (upper bits must be equal), returns either a or tmp depending on where the result is
+static TRADIX *rs_lsd( TRADIX *a, TRADIX *tmp, int n, int bits ) {
+	int counts[RADIX_MAX_PASSES][RADIX_SIZE];
+	int npass = (bits + RADIX_BITS - 1) / RADIX_BITS;
+	int i, p;
+	if( n < RADIX_SMALL ) {
+		rs_insert(a, n);
+		return a;
+	}
+	memset(counts, 0, sizeof(counts[0]) * npass);
+	for(i=0;i<n;i++) {
+		TKEY k = RKEY(a[i]);
+		for(p=0;p<npass;p++)
+			counts[p][(k >> (p * RADIX_BITS)) & RADIX_MASK]++;
+	}
+	for(p=0;p<npass;p++) {
+		int *c = counts[p];
+		int shift = p * RADIX_BITS;
+		int sum = 0;
+		TRADIX *t;
+		// skip the pass if all keys share this digit
+		if( c[(RKEY(a[0]) >> shift) & RADIX_MASK] == n )
+			continue;
+		for(i=0;i<RADIX_SIZE;i++) {
+			int v = c[i];
+			c[i] = sum;
+			sum += v;
+		}
+		for(i=0;i<n;i++) {
+			TRADIX v = a[i];
+			tmp[c[(RKEY(v) >> shift) & RADIX_MASK]++] = v;
+		}
+		t = a;
+		a = tmp;
+		tmp = t;
+	}
+	return a;
+}
+
+static void radix_sort( TRADIX *a, TRADIX *tmp, int n ) {
+	TRADIX *r = rs_lsd(a, tmp, n, sizeof(TKEY) * 8);
+	if( r != a ) memcpy(a, r, sizeof(TRADIX) * n);
+}
+
+#if defined(HL_THREADS) && defined(RADIX_PARALLEL)
+
+/*
+	Parallel version : a first MSD pass on the 8 bits following the common prefix of all keys
+	(parallel histograms then a stable scatter into tmp), then each thread sorts a
+	contiguous range of buckets on the remaining low bits.
+*/
+typedef struct {
+	TRADIX *a;
+	TRADIX *tmp;
+	int n;
+	int nthreads;
+	int phase;
+	int shift;
+	TKEY kmin[RADIX_MAX_THREADS];
+	TKEY kmax[RADIX_MAX_THREADS];
+	int counts[RADIX_MAX_THREADS][256];
+	int buckets[257];
+	int ranges[RADIX_MAX_THREADS + 1];
+} rs_par;
+
+static void rs_par_phase( rs_par *p, int t ) {
+	int from = (int)((int64)p->n * t / p->nthreads);
+	int to = (int)((int64)p->n * (t + 1) / p->nthreads);
+	int i;
+	switch( p->phase ) {
+	case 0:
+		{
+			TKEY kmin = RKEY(p->a[from]), kmax = kmin;
+			for(i=from+1;i<to;i++) {
+				TKEY k = RKEY(p->a[i]);
+				if( k < kmin ) kmin = k;
+				if( k > kmax ) kmax = k;
+			}
+			p->kmin[t] = kmin;
+			p->kmax[t] = kmax;
+		}
+		break;
+	case 1:
+		{
+			int *c = p->counts[t];
+			memset(c, 0, sizeof(p->counts[t]));
+			for(i=from;i<to;i++)
+				c[(RKEY(p->a[i]) >> p->shift) & 255]++;
+		}
+		break;
+	case 2:
+		{
+			int *c = p->counts[t];
+			for(i=from;i<to;i++) {
+				TRADIX v = p->a[i];
+				p->tmp[c[(RKEY(v) >> p->shift) & 255]++] = v;
+			}
+		}
+		break;
+	case 3:
+		for(i=p->ranges[t];i<p->ranges[t+1];i++) {
+			int start = p->buckets[i];
+			int n = p->buckets[i+1] - start;
+			TRADIX *r = rs_lsd(p->tmp + start, p->a + start, n, p->shift);
+			if( r != p->a + start ) memcpy(p->a + start, r, sizeof(TRADIX) * n);
+		}
+		break;
+	}
+}
+
+static void radix_sort_parallel( TRADIX *a, TRADIX *tmp, int n, int nthreads ) {
+	rs_par *p = (rs_par*)malloc(sizeof(rs_par));
+	TKEY kmin, kmax, diff;
+	int i, t, sum, bits;
+	if( p == NULL ) {
+		radix_sort(a, tmp, n);
+		return;
+	}
+	p->a = a;
+	p->tmp = tmp;
+	p->n = n;
+	p->nthreads = nthreads;
+	p->phase = 0;
+	hl_parallel_for(nthreads, (void(*)(void*,int))rs_par_phase, p);
+	kmin = p->kmin[0];
+	kmax = p->kmax[0];
+	for(t=1;t<nthreads;t++) {
+		if( p->kmin[t] < kmin ) kmin = p->kmin[t];
+		if( p->kmax[t] > kmax ) kmax = p->kmax[t];
+	}
+	if( kmin == kmax ) {
+		free(p);
+		return;
+	}
+	// the bits above the highest differing bit are the same for all keys
+	diff = kmin ^ kmax;
+	bits = 0;
+	while( diff ) {
+		diff >>= 1;
+		bits++;
+	}
+	p->shift = bits > 8 ? bits - 8 : 0;
+	p->phase = 1;
+	hl_parallel_for(nthreads, (void(*)(void*,int))rs_par_phase, p);
+	// stable offsets : by bucket, then by thread
+	sum = 0;
+	for(i=0;i<256;i++) {
+		p->buckets[i] = sum;
+		for(t=0;t<nthreads;t++) {
+			int v = p->counts[t][i];
+			p->counts[t][i] = sum;
+			sum += v;
+		}
+	}
+	p->buckets[256] = sum;
+	p->phase = 2;
+	hl_parallel_for(nthreads, (void(*)(void*,int))rs_par_phase, p);
+	// split the buckets into ranges of about the same size
+	p->ranges[0] = 0;
+	i = 0;
+	for(t=1;t<nthreads;t++) {
+		int limit = (int)((int64)n * t / nthreads);
+		while( i < 256 && p->buckets[i+1] <= limit ) i++;
+		p->ranges[t] = i;
+	}
+	p->ranges[nthreads] = 256;
+	p->phase = 3;
+	hl_parallel_for(nthreads, (void(*)(void*,int))rs_par_phase, p);
+	free(p);
+}
+
+#endif
+
+#undef rs_insert
+#undef rs_lsd
+#undef radix_sort
+#undef rs_par
+#undef rs_par_phase
+#undef radix_sort_parallel
+#undef TRADIX
+#undef TKEY
+#undef RKEY
+#undef RID
+#undef RADIX_PARALLEL
@@ -24,22 +24,172 @@
 #include <pcre2.h>
 
 typedef struct _ereg ereg;
+typedef struct _regexp_code regexp_code;
+
+/*
+	A compiled pattern, shared by all the ereg (and threads) using the same source and
+	options. It is refcounted : the cache holds one reference and each ereg another one.
+*/
+struct _regexp_code {
+	pcre2_code_16 *code;
+	uchar *source;
+	int options;
+	int hash;
+	int refs;
+	int n_groups;
+	int last_use;
+	bool jit;
+};
 
 struct _ereg {
 	void (*finalize)( ereg * );
-	/* The compiled regex code */
-	pcre2_code_16 *regex;
-	/* Pointer to the allocated memory for match data */
-	pcre2_match_data_16 *match_data;
+	/* The shared compiled regex code */
+	regexp_code *rc;
 	/* Number of capture groups */
 	int n_groups;
 	/* Whether the last string was matched successfully */
 	bool matched;
+	/* Offsets of the last match, copied from the thread match data */
+	int matches[1];
 };
 
+/*
+	Per thread matching state : the match data is sized for the largest pattern
+	used by the thread, the JIT stack grows up to REGEXP_JIT_STACK_MAX. It is released
+	when the thread exits.
+*/
+typedef struct {
+	pcre2_match_data_16 *match_data;
+	pcre2_match_context_16 *context;
+	pcre2_jit_stack_16 *jit_stack;
+	int n_groups;
+} regexp_thread;
+
+#define REGEXP_CACHE_SIZE		64
+#define REGEXP_JIT_STACK_MIN	(32 << 10)
+#define REGEXP_JIT_STACK_MAX	(1 << 20)
+
+static regexp_code *regexp_cache[REGEXP_CACHE_SIZE] = {NULL};
+static hl_mutex *regexp_cache_lock = NULL;
+static int regexp_cache_time = 0;
+static hl_tls *regexp_tls = NULL;
+
+static void regexp_code_release( regexp_code *rc ) {
+	if( hl_atomic_add32(&rc->refs, -1) != 1 )
+		return;
+	pcre2_code_free_16(rc->code);
+	free(rc->source);
+	free(rc);
+}
+
+// the lock is only held for a few operations that never allocate GC memory,
+// waiting for it does not need to be a blocking section
+static void regexp_cache_acquire() {
+	if( regexp_cache_lock == NULL ) {
+		hl_mutex *m = hl_mutex_alloc(false);
+		if( hl_atomic_compare_exchange_ptr((void**)&regexp_cache_lock, NULL, m) == NULL )
+			hl_add_root(&regexp_cache_lock);
+	}
+	hl_mutex_acquire(regexp_cache_lock);
+}
+
+static void regexp_cache_release() {
+	hl_mutex_release(regexp_cache_lock);
+}
+
+static int regexp_hash( const uchar *str, int options ) {
+	int h = options;
+	while( *str )
+		h = 223 * h + *str++;
+	return h;
+}
+
+static regexp_code *regexp_cache_find( const uchar *str, int options, int hash ) {
+	int i;
+	regexp_code *rc = NULL;
+	regexp_cache_acquire();
+	for(i=0;i<REGEXP_CACHE_SIZE;i++) {
+		regexp_code *c = regexp_cache[i];
+		if( c && c->hash == hash && c->options == options && ucmp(c->source, str) == 0 ) {
+			c->last_use = ++regexp_cache_time;
+			hl_atomic_add32(&c->refs, 1);
+			rc = c;
+			break;
+		}
+	}
+	regexp_cache_release();
+	return rc;
+}
+
+// adds a newly compiled code to the cache, or returns the one another thread added in the meantime
+static regexp_code *regexp_cache_add( regexp_code *rc ) {
+	int i, slot = 0;
+	regexp_code *old = NULL;
+	regexp_cache_acquire();
+	for(i=0;i<REGEXP_CACHE_SIZE;i++) {
+		regexp_code *c = regexp_cache[i];
+		if( c == NULL ) {
+			slot = i;
+			break;
+		}
+		if( c->hash == rc->hash && c->options == rc->options && ucmp(c->source, rc->source) == 0 ) {
+			c->last_use = ++regexp_cache_time;
+			hl_atomic_add32(&c->refs, 1);
+			regexp_cache_release();
+			regexp_code_release(rc);
+			return c;
+		}
+		if( c->last_use < regexp_cache[slot]->last_use )
+			slot = i;
+	}
+	old = regexp_cache[slot];
+	rc->last_use = ++regexp_cache_time;
+	rc->refs++;
+	regexp_cache[slot] = rc;
+	regexp_cache_release();
+	if( old ) regexp_code_release(old);
+	return rc;
+}
+
+static void regexp_thread_free( void *v ) {
+	regexp_thread *t = (regexp_thread*)v;
+	if( t->match_data ) pcre2_match_data_free_16(t->match_data);
+	if( t->jit_stack ) pcre2_jit_stack_free_16(t->jit_stack);
+	pcre2_match_context_free_16(t->context);
+	free(t);
+}
+
+static regexp_thread *regexp_get_thread( int n_groups ) {
+	regexp_thread *t;
+	if( regexp_tls == NULL ) {
+		hl_tls *tls = hl_tls_alloc_destructor(regexp_thread_free);
+		if( hl_atomic_compare_exchange_ptr((void**)&regexp_tls, NULL, tls) == NULL )
+			hl_add_root(&regexp_tls);
+		else
+			hl_tls_free(tls);
+	}
+	t = (regexp_thread*)hl_tls_get(regexp_tls);
+	if( t == NULL ) {
+		t = (regexp_thread*)malloc(sizeof(regexp_thread));
+		t->match_data = NULL;
+		t->n_groups = 0;
+		t->context = pcre2_match_context_create_16(NULL);
+		t->jit_stack = pcre2_jit_stack_create_16(REGEXP_JIT_STACK_MIN, REGEXP_JIT_STACK_MAX, NULL);
+		if( t->jit_stack ) pcre2_jit_stack_assign_16(t->context, NULL, t->jit_stack);
+		hl_tls_set(regexp_tls, t);
+	}
+	if( t->n_groups < n_groups ) {
+		int size = t->n_groups ? t->n_groups : 16;
+		while( size < n_groups ) size <<= 1;
+		if( t->match_data ) pcre2_match_data_free_16(t->match_data);
+		t->match_data = pcre2_match_data_create_16(size, NULL);
+		t->n_groups = size;
+	}
+	return t;
+}
+
 static void regexp_finalize( ereg *e ) {
-	pcre2_code_free_16(e->regex);
-	pcre2_match_data_free_16(e->match_data);
+	regexp_code_release(e->rc);
 }
 
 HL_PRIM ereg *hl_regexp_new_options( vbyte *str, vbyte *opts ) {
@@ -47,8 +197,10 @@ HL_PRIM ereg *hl_regexp_new_options( vbyte *str, vbyte *opts ) {
 	int error_code;
 	size_t error_offset;
 	pcre2_code_16 *p;
+	regexp_code *rc;
 	uchar *o = (uchar*)opts;
 	int options = PCRE2_UCP | PCRE2_UTF | PCRE2_ALT_BSUX | PCRE2_ALLOW_EMPTY_CLASS | PCRE2_MATCH_UNSET_BACKREF;
+	int hash;
 	while( *o ) {
 		switch( *o++ ) {
 		case 'i':
@@ -69,40 +221,51 @@ HL_PRIM ereg *hl_regexp_new_options( vbyte *str, vbyte *opts ) {
 			return NULL;
 		}
 	}
-	p = pcre2_compile_16((PCRE2_SPTR16)str,PCRE2_ZERO_TERMINATED,options,&error_code,&error_offset,NULL);
-	if( p == NULL ) {
-		hl_buffer *b = hl_alloc_buffer();
-		vdynamic *d = hl_alloc_dynamic(&hlt_bytes);
-		PCRE2_UCHAR16 error_buffer[256];
-		pcre2_get_error_message_16(error_code,error_buffer,sizeof(error_buffer));
-		hl_buffer_str(b,USTR("Regexp compilation error : "));
-		hl_buffer_str(b,error_buffer);
-		hl_buffer_str(b,USTR(" in "));
-		hl_buffer_str(b,(uchar*)str);
-		d->v.bytes = (vbyte*)hl_buffer_content(b,NULL);
-		hl_throw(d);
+	hash = regexp_hash((uchar*)str, options);
+	rc = regexp_cache_find((uchar*)str, options, hash);
+	if( rc == NULL ) {
+		p = pcre2_compile_16((PCRE2_SPTR16)str,PCRE2_ZERO_TERMINATED,options,&error_code,&error_offset,NULL);
+		if( p == NULL ) {
+			hl_buffer *b = hl_alloc_buffer();
+			vdynamic *d = hl_alloc_dynamic(&hlt_bytes);
+			PCRE2_UCHAR16 error_buffer[256];
+			pcre2_get_error_message_16(error_code,error_buffer,sizeof(error_buffer));
+			hl_buffer_str(b,USTR("Regexp compilation error : "));
+			hl_buffer_str(b,error_buffer);
+			hl_buffer_str(b,USTR(" in "));
+			hl_buffer_str(b,(uchar*)str);
+			d->v.bytes = (vbyte*)hl_buffer_content(b,NULL);
+			hl_throw(d);
+		}
+		rc = (regexp_code*)malloc(sizeof(regexp_code));
+		rc->code = p;
+		rc->source = ustrdup((uchar*)str);
+		rc->options = options;
+		rc->hash = hash;
+		rc->refs = 1;
+		rc->n_groups = 0;
+		pcre2_pattern_info_16(p,PCRE2_INFO_CAPTURECOUNT,&rc->n_groups);
+		rc->n_groups++;
+		// fails if PCRE2 was built without JIT support : we then use the interpreter
+		rc->jit = pcre2_jit_compile_16(p,PCRE2_JIT_COMPLETE) == 0;
+		rc = regexp_cache_add(rc);
 	}
-	r = (ereg*)hl_gc_alloc_finalizer(sizeof(ereg));
+	r = (ereg*)hl_gc_alloc_finalizer(sizeof(ereg) + sizeof(int) * (rc->n_groups * 2 - 1));
 	r->finalize = regexp_finalize;
-	r->regex = p;
+	r->rc = rc;
 	r->matched = 0;
-	r->n_groups = 0;
-	pcre2_pattern_info_16(p,PCRE2_INFO_CAPTURECOUNT,&r->n_groups);
-	r->n_groups++;
-	r->match_data = pcre2_match_data_create_from_pattern_16(r->regex,NULL);
-
+	r->n_groups = rc->n_groups;
 	return r;
 }
 
 HL_PRIM int hl_regexp_matched_pos( ereg *e, int m, int *len ) {
 	int start;
-	size_t *matches = pcre2_get_ovector_pointer_16(e->match_data);
 	if( !e->matched )
 		hl_error("Calling regexp_matched_pos() on an unmatched regexp");
 	if( m < 0 || m >= e->n_groups )
 		hl_error("Matched index %d outside bounds",m);
-	start = (int)matches[m*2];
-	if( len ) *len = (int)matches[m*2+1] - start;
+	start = e->matches[m*2];
+	if( len ) *len = e->matches[m*2+1] - start;
 	return start;
 }
 
@@ -114,10 +277,21 @@ HL_PRIM int hl_regexp_matched_num( ereg *e ) {
 }
 
 HL_PRIM bool hl_regexp_match( ereg *e, vbyte *s, int pos, int len ) {
-	int res = pcre2_match_16(e->regex,(PCRE2_SPTR16)s,pos+len,pos,PCRE2_NO_UTF_CHECK,e->match_data,NULL);
+	regexp_code *rc = e->rc;
+	regexp_thread *t = regexp_get_thread(e->n_groups);
+	int res;
+	if( rc->jit )
+		res = pcre2_jit_match_16(rc->code,(PCRE2_SPTR16)s,pos+len,pos,0,t->match_data,t->context);
+	else
+		res = pcre2_match_16(rc->code,(PCRE2_SPTR16)s,pos+len,pos,PCRE2_NO_UTF_CHECK,t->match_data,t->context);
 	e->matched = res >= 0;
-	if( res >= 0 )
+	if( res >= 0 ) {
+		int i;
+		size_t *matches = pcre2_get_ovector_pointer_16(t->match_data);
+		for(i=0;i<e->n_groups*2;i++)
+			e->matches[i] = (int)matches[i];
 		return true;
+	}
 	if( res != PCRE2_ERROR_NOMATCH )
 		hl_error("An error occurred while running pcre2_match()");
 	return false;
@@ -65,6 +65,8 @@
 	typedef unsigned int _sockaddr;
 #endif
 
+#include <hl.h>
+
 #ifdef HL_LINUX
 #	include <linux/version.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,5,44)
@@ -78,8 +80,6 @@
 #	define EPOLLOUT 0x004
 #endif
 
-#include <hl.h>
-
 #if defined(HL_WIN) || defined(HL_MAC) || defined(HL_IOS) || defined(HL_TVOS)
 #	define MSG_NOSIGNAL 0
 #endif
@@ -304,6 +304,19 @@ HL_PRIM hl_socket *hl_socket_accept( hl_socket *s ) {
 	return hs;
 }
 
+// native descriptor, used to hand sockets over to the aio ring
+HL_PRIM int hl_socket_fd( hl_socket *s ) {
+	return s ? (int)s->sock : -1;
+}
+
+HL_PRIM hl_socket *hl_socket_from_fd( int fd ) {
+	hl_socket *hs;
+	if( fd < 0 ) return NULL;
+	hs = (hl_socket*)hl_gc_alloc_noptr(sizeof(hl_socket));
+	hs->sock = (SOCKET)fd;
+	return hs;
+}
+
 HL_PRIM bool hl_socket_peer( hl_socket *s, int *host, int *port ) {
 	struct sockaddr_in addr;
 	_sockaddr addrlen = sizeof(addr);
@@ -487,6 +500,461 @@ HL_PRIM bool hl_socket_select( varray *ra, varray *wa, varray *ea, char *tmp, in
 	return true;
 }
 
+// ----------------- SEND FILE
+
+#if defined(HL_LINUX)
+#	include <sys/sendfile.h>
+#elif defined(HL_MAC) || defined(HL_IOS) || defined(HL_TVOS) || defined(HL_BSD)
+#	include <sys/uio.h>
+#elif defined(HL_WIN)
+#	include <io.h>
+#endif
+
+/*
+	Send len bytes of the file descriptor fd starting at offset without copying
+	them through user space. Returns the number of bytes sent, which can be less
+	than len on non-blocking sockets, -1 if the call would block or -2 on error.
+*/
+HL_PRIM int hl_socket_send_file( hl_socket *s, int fd, int64 offset, int len ) {
+	int r;
+	if( !s || fd < 0 || len < 0 ) return -2;
+	if( len == 0 ) return 0;
+#	if defined(HL_LINUX)
+	{
+		off_t off = (off_t)offset;
+		hl_blocking(true);
+		r = (int)sendfile(s->sock, fd, &off, len);
+		hl_blocking(false);
+	}
+#	elif defined(HL_MAC) || defined(HL_IOS) || defined(HL_TVOS)
+	{
+		off_t sent = len;
+		hl_blocking(true);
+		r = sendfile(fd, s->sock, (off_t)offset, &sent, NULL, 0);
+		hl_blocking(false);
+		// partial sends report an error but still update sent
+		if( sent > 0 ) r = (int)sent;
+	}
+#	elif defined(HL_BSD)
+	{
+		off_t sent = 0;
+		hl_blocking(true);
+		r = sendfile(fd, s->sock, (off_t)offset, len, NULL, &sent, 0);
+		hl_blocking(false);
+		if( sent > 0 ) r = (int)sent;
+	}
+#	else
+	{
+		// no zero-copy transfer available : go through a buffer
+		char buf[16384];
+		int n = len > (int)sizeof(buf) ? (int)sizeof(buf) : len;
+		hl_blocking(true);
+#		ifdef HL_WIN
+		n = _lseeki64(fd, offset, SEEK_SET) < 0 ? -1 : _read(fd, buf, n);
+#		else
+		n = (int)pread(fd, buf, n, (off_t)offset);
+#		endif
+		hl_blocking(false);
+		if( n <= 0 ) return n == 0 ? 0 : -2;
+		r = send(s->sock, buf, n, MSG_NOSIGNAL);
+	}
+#	endif
+	if( r == SOCKET_ERROR )
+		return block_error();
+	return r;
+}
+
+// ----------------- BATCHED UDP
+
+/*
+	Batched datagram I/O : entries is an array of BATCH_STRIDE ints per datagram
+	{ pos, len, host, port, segment } describing slices of a shared data buffer.
+	On Linux a single sendmmsg/recvmmsg moves the whole batch ; segment enables
+	UDP GSO on send (payload split by the kernel every segment bytes) and reports
+	the GRO segment size on receive once enabled with socket_set_udp_gro.
+*/
+
+#define BATCH_STRIDE	5
+#define BATCH_MAX		64
+
+#ifdef HL_LINUX
+#	define HAS_MMSG
+#	include <netinet/udp.h>
+#	ifndef UDP_SEGMENT
+#		define UDP_SEGMENT	103
+#	endif
+#	ifndef UDP_GRO
+#		define UDP_GRO		104
+#	endif
+#endif
+
+HL_PRIM bool hl_socket_set_udp_gro( hl_socket *s, bool b ) {
+#	ifdef HAS_MMSG
+	int v = b;
+	if( !s ) return false;
+	return setsockopt(s->sock,IPPROTO_UDP,UDP_GRO,(char*)&v,sizeof(v)) == 0;
+#	else
+	return false;
+#	endif
+}
+
+HL_PRIM int hl_socket_send_batch( hl_socket *s, vbyte *data, int *entries, int count ) {
+	int done = 0;
+	if( !s ) return -2;
+#	ifdef HAS_MMSG
+	while( done < count ) {
+		struct mmsghdr msgs[BATCH_MAX];
+		struct iovec iovs[BATCH_MAX];
+		struct sockaddr_in addrs[BATCH_MAX];
+		char ctrl[BATCH_MAX][CMSG_SPACE(sizeof(unsigned short))];
+		int i, n = count - done, r;
+		if( n > BATCH_MAX ) n = BATCH_MAX;
+		memset(msgs,0,sizeof(struct mmsghdr) * n);
+		memset(addrs,0,sizeof(struct sockaddr_in) * n);
+		for(i=0;i<n;i++) {
+			int *e = entries + (done + i) * BATCH_STRIDE;
+			struct msghdr *h = &msgs[i].msg_hdr;
+			iovs[i].iov_base = data + e[0];
+			iovs[i].iov_len = e[1];
+			addrs[i].sin_family = AF_INET;
+			addrs[i].sin_port = htons((unsigned short)e[3]);
+			*(int*)&addrs[i].sin_addr.s_addr = e[2];
+			h->msg_name = &addrs[i];
+			h->msg_namelen = sizeof(struct sockaddr_in);
+			h->msg_iov = &iovs[i];
+			h->msg_iovlen = 1;
+			if( e[4] > 0 ) {
+				struct cmsghdr *c;
+				h->msg_control = ctrl[i];
+				h->msg_controllen = sizeof(ctrl[i]);
+				c = CMSG_FIRSTHDR(h);
+				c->cmsg_level = IPPROTO_UDP;
+				c->cmsg_type = UDP_SEGMENT;
+				c->cmsg_len = CMSG_LEN(sizeof(unsigned short));
+				*(unsigned short*)CMSG_DATA(c) = (unsigned short)e[4];
+			}
+		}
+		r = sendmmsg(s->sock, msgs, n, MSG_NOSIGNAL);
+		if( r < 0 ) {
+			if( done > 0 ) break;
+			return block_error();
+		}
+		for(i=0;i<r;i++)
+			entries[(done + i) * BATCH_STRIDE + 1] = msgs[i].msg_len;
+		done += r;
+		if( r < n ) break;
+	}
+#	else
+	for(done=0;done<count;done++) {
+		int *e = entries + done * BATCH_STRIDE;
+		int r = hl_socket_send_to(s, (char*)data + e[0], e[1], e[2], e[3]);
+		if( r < 0 ) return done > 0 ? done : r;
+		e[1] = r;
+	}
+#	endif
+	return done;
+}
+
+// entries len is the capacity of each slot on input and the datagram size on output
+HL_PRIM int hl_socket_recv_batch( hl_socket *s, vbyte *data, int *entries, int count ) {
+	int r;
+	if( !s ) return -2;
+	if( count > BATCH_MAX ) count = BATCH_MAX;
+	if( count <= 0 ) return 0;
+#	ifdef HAS_MMSG
+	{
+		struct mmsghdr msgs[BATCH_MAX];
+		struct iovec iovs[BATCH_MAX];
+		struct sockaddr_in addrs[BATCH_MAX];
+		char ctrl[BATCH_MAX][CMSG_SPACE(sizeof(int))];
+		int i;
+		memset(msgs,0,sizeof(struct mmsghdr) * count);
+		for(i=0;i<count;i++) {
+			int *e = entries + i * BATCH_STRIDE;
+			struct msghdr *h = &msgs[i].msg_hdr;
+			iovs[i].iov_base = data + e[0];
+			iovs[i].iov_len = e[1];
+			h->msg_name = &addrs[i];
+			h->msg_namelen = sizeof(struct sockaddr_in);
+			h->msg_iov = &iovs[i];
+			h->msg_iovlen = 1;
+			h->msg_control = ctrl[i];
+			h->msg_controllen = sizeof(ctrl[i]);
+		}
+		hl_blocking(true);
+		r = recvmmsg(s->sock, msgs, count, MSG_WAITFORONE, NULL);
+		hl_blocking(false);
+		if( r < 0 ) return block_error();
+		for(i=0;i<r;i++) {
+			int *e = entries + i * BATCH_STRIDE;
+			struct msghdr *h = &msgs[i].msg_hdr;
+			struct cmsghdr *c;
+			e[1] = msgs[i].msg_len;
+			e[2] = *(int*)&addrs[i].sin_addr;
+			e[3] = ntohs(addrs[i].sin_port);
+			e[4] = 0;
+			for(c=CMSG_FIRSTHDR(h);c;c=CMSG_NXTHDR(h,c))
+				if( c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO )
+					e[4] = *(int*)CMSG_DATA(c);
+		}
+	}
+#	else
+	for(r=0;r<count;r++) {
+		int *e = entries + r * BATCH_STRIDE;
+		struct sockaddr_in saddr;
+		socklen_t slen = sizeof(saddr);
+		int len, flags = MSG_NOSIGNAL;
+		if( r == 0 ) hl_blocking(true);
+#		ifdef MSG_DONTWAIT
+		// only wait for the first datagram
+		else flags |= MSG_DONTWAIT;
+#		else
+		else break;
+#		endif
+		len = recvfrom(s->sock, (char*)data + e[0], e[1], flags, (struct sockaddr*)&saddr, &slen);
+		if( r == 0 ) hl_blocking(false);
+		if( len == SOCKET_ERROR ) {
+			if( r > 0 ) break;
+			return block_error();
+		}
+		e[1] = len;
+		e[2] = *(int*)&saddr.sin_addr;
+		e[3] = ntohs(saddr.sin_port);
+		e[4] = 0;
+	}
+#	endif
+	return r;
+}
+
+// ----------------- POLLER
+
+/*
+	Persistent socket poller : sockets are registered once with their read/write
+	interest and wait only reports the ready ones, using epoll on Linux and
+	poll() elsewhere. Edge-triggered mode is only honored by epoll.
+	Registered sockets are kept alive by the poller until they are removed.
+*/
+
+#define POLL_READ	1
+#define POLL_WRITE	2
+#define POLL_EDGE	4
+#define POLL_ERROR	8
+
+#ifdef HL_WIN
+#	define poll WSAPoll
+#endif
+
+typedef struct _hl_poll hl_poll;
+struct _hl_poll {
+	void (*free)( hl_poll * );
+	hl_socket **socks;
+	int count;
+	int max;
+#	ifndef HL_WIN
+	// socket slot + 1 indexed by fd
+	int *slots;
+	int nslots;
+#	endif
+#	ifdef HAS_EPOLL
+	int epfd;
+	struct epoll_event *events;
+	int nevents;
+#	else
+	struct pollfd *fds;
+#	endif
+};
+
+static void poll_free( hl_poll *p ) {
+	hl_remove_root(&p->socks);
+#	ifndef HL_WIN
+	free(p->slots);
+#	endif
+#	ifdef HAS_EPOLL
+	close(p->epfd);
+	free(p->events);
+#	else
+	free(p->fds);
+#	endif
+}
+
+HL_PRIM hl_poll *hl_poll_alloc() {
+	hl_poll *p;
+#	ifdef HAS_EPOLL
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	if( epfd < 0 ) return NULL;
+#	endif
+	p = (hl_poll*)hl_gc_alloc_finalizer(sizeof(hl_poll));
+	memset(p,0,sizeof(hl_poll));
+	p->free = poll_free;
+#	ifdef HAS_EPOLL
+	p->epfd = epfd;
+#	endif
+	hl_add_root(&p->socks);
+	return p;
+}
+
+static int poll_find( hl_poll *p, hl_socket *s ) {
+#	ifdef HL_WIN
+	int i;
+	for(i=0;i<p->count;i++)
+		if( p->socks[i]->sock == s->sock )
+			return i;
+	return -1;
+#	else
+	int fd = (int)s->sock;
+	if( fd < 0 || fd >= p->nslots ) return -1;
+	return p->slots[fd] - 1;
+#	endif
+}
+
+#ifdef HAS_EPOLL
+static bool poll_ctl( hl_poll *p, int op, hl_socket *s, int flags ) {
+	struct epoll_event ev;
+	ev.events = (flags & POLL_READ ? EPOLLIN | EPOLLRDHUP : 0) | (flags & POLL_WRITE ? EPOLLOUT : 0) | (flags & POLL_EDGE ? EPOLLET : 0);
+	ev.data.u64 = 0;
+	ev.data.fd = (int)s->sock;
+	return epoll_ctl(p->epfd, op, (int)s->sock, &ev) == 0;
+}
+#else
+static short poll_events( int flags ) {
+	return (short)((flags & POLL_READ ? POLLIN : 0) | (flags & POLL_WRITE ? POLLOUT : 0));
+}
+#endif
+
+HL_PRIM bool hl_poll_modify( hl_poll *p, hl_socket *s, int flags );
+
+HL_PRIM bool hl_poll_add( hl_poll *p, hl_socket *s, int flags ) {
+	int slot;
+	if( !p || !s || s->sock == INVALID_SOCKET ) return false;
+	slot = poll_find(p,s);
+	if( slot >= 0 ) {
+		// fd was reused by another socket without being removed
+		p->socks[slot] = s;
+#		ifdef HAS_EPOLL
+		// closing the old socket removed the fd from the epoll set, unless it was duplicated
+		return poll_ctl(p,EPOLL_CTL_ADD,s,flags) || (errno == EEXIST && poll_ctl(p,EPOLL_CTL_MOD,s,flags));
+#		else
+		return hl_poll_modify(p,s,flags);
+#		endif
+	}
+#	ifdef HAS_EPOLL
+	if( !poll_ctl(p,EPOLL_CTL_ADD,s,flags) ) return false;
+#	endif
+	if( p->count == p->max ) {
+		int nmax = p->max ? p->max << 1 : 16;
+		hl_socket **socks = (hl_socket**)hl_gc_alloc_raw(sizeof(hl_socket*) * nmax);
+		memcpy(socks,p->socks,sizeof(hl_socket*) * p->count);
+		p->socks = socks;
+#		ifndef HAS_EPOLL
+		p->fds = (struct pollfd*)realloc(p->fds,sizeof(struct pollfd) * nmax);
+#		endif
+		p->max = nmax;
+	}
+#	ifndef HL_WIN
+	if( (int)s->sock >= p->nslots ) {
+		int nslots = p->nslots ? p->nslots : 64;
+		while( nslots <= (int)s->sock ) nslots <<= 1;
+		p->slots = (int*)realloc(p->slots,sizeof(int) * nslots);
+		memset(p->slots + p->nslots, 0, sizeof(int) * (nslots - p->nslots));
+		p->nslots = nslots;
+	}
+	p->slots[s->sock] = p->count + 1;
+#	endif
+#	ifndef HAS_EPOLL
+	p->fds[p->count].fd = s->sock;
+	p->fds[p->count].events = poll_events(flags);
+	p->fds[p->count].revents = 0;
+#	endif
+	p->socks[p->count++] = s;
+	return true;
+}
+
+HL_PRIM bool hl_poll_modify( hl_poll *p, hl_socket *s, int flags ) {
+	int slot;
+	if( !p || !s ) return false;
+	slot = poll_find(p,s);
+	if( slot < 0 ) return false;
+#	ifdef HAS_EPOLL
+	return poll_ctl(p,EPOLL_CTL_MOD,s,flags);
+#	else
+	p->fds[slot].events = poll_events(flags);
+	return true;
+#	endif
+}
+
+HL_PRIM bool hl_poll_remove( hl_poll *p, hl_socket *s ) {
+	int slot, last;
+	if( !p || !s ) return false;
+	slot = poll_find(p,s);
+	if( slot < 0 ) return false;
+#	ifdef HAS_EPOLL
+	// the fd might already be closed, which removes it from the epoll set
+	epoll_ctl(p->epfd, EPOLL_CTL_DEL, (int)s->sock, NULL);
+#	endif
+	last = --p->count;
+#	ifndef HL_WIN
+	p->slots[s->sock] = 0;
+	if( slot != last ) p->slots[p->socks[last]->sock] = slot + 1;
+#	endif
+#	ifndef HAS_EPOLL
+	p->fds[slot] = p->fds[last];
+#	endif
+	p->socks[slot] = p->socks[last];
+	p->socks[last] = NULL;
+	return true;
+}
+
+HL_PRIM int hl_poll_count( hl_poll *p ) {
+	return p ? p->count : 0;
+}
+
+// store up to out->size ready sockets in out and their POLL_* flags in events, returns -1 on error
+HL_PRIM int hl_poll_wait( hl_poll *p, varray *out, int *events, double timeout ) {
+	int i, n, count = 0;
+	int ms = timeout < 0 ? -1 : (int)(timeout * 1000. + 0.999);
+	hl_socket **aout = hl_aptr(out,hl_socket*);
+	if( !p ) return -1;
+	if( out->size == 0 ) return 0;
+#	ifdef HAS_EPOLL
+	if( p->nevents < out->size ) {
+		free(p->events);
+		p->events = (struct epoll_event*)malloc(sizeof(struct epoll_event) * out->size);
+		p->nevents = out->size;
+	}
+	hl_blocking(true);
+	n = epoll_wait(p->epfd, p->events, out->size, ms);
+	hl_blocking(false);
+	if( n < 0 ) return errno == EINTR ? 0 : -1;
+	for(i=0;i<n;i++) {
+		struct epoll_event *e = p->events + i;
+		int fd = e->data.fd;
+		int slot = fd < p->nslots ? p->slots[fd] - 1 : -1;
+		if( slot < 0 ) continue;
+		aout[count] = p->socks[slot];
+		events[count++] = (e->events & (EPOLLIN | EPOLLRDHUP) ? POLL_READ : 0) | (e->events & EPOLLOUT ? POLL_WRITE : 0) | (e->events & (EPOLLERR | EPOLLHUP) ? POLL_ERROR : 0);
+	}
+#	else
+	hl_blocking(true);
+	n = poll(p->fds, p->count, ms);
+	hl_blocking(false);
+	if( n == SOCKET_ERROR ) {
+#		ifndef HL_WIN
+		if( errno == EINTR ) return 0;
+#		endif
+		return -1;
+	}
+	for(i=0;i<p->count && n > 0 && count < out->size;i++) {
+		int r = p->fds[i].revents;
+		if( r == 0 ) continue;
+		n--;
+		aout[count] = p->socks[i];
+		events[count++] = (r & (POLLIN | POLLHUP) ? POLL_READ : 0) | (r & POLLOUT ? POLL_WRITE : 0) | (r & (POLLERR | POLLHUP | POLLNVAL) ? POLL_ERROR : 0);
+	}
+#	endif
+	if( count < out->size ) aout[count] = NULL;
+	return count;
+}
+
 #define _SOCK	_ABSTRACT(hl_socket)
 DEFINE_PRIM(_VOID,socket_init,_NO_ARG);
 DEFINE_PRIM(_SOCK,socket_new,_BOOL);
@@ -504,6 +972,8 @@ DEFINE_PRIM(_BOOL,socket_connect,_SOCK _I32 _I32);
 DEFINE_PRIM(_BOOL,socket_listen,_SOCK _I32);
 DEFINE_PRIM(_BOOL,socket_bind,_SOCK _I32 _I32);
 DEFINE_PRIM(_SOCK,socket_accept,_SOCK);
+DEFINE_PRIM(_I32,socket_fd,_SOCK);
+DEFINE_PRIM(_SOCK,socket_from_fd,_I32);
 DEFINE_PRIM(_BOOL,socket_peer,_SOCK _REF(_I32) _REF(_I32));
 DEFINE_PRIM(_BOOL,socket_host,_SOCK _REF(_I32) _REF(_I32));
 DEFINE_PRIM(_BOOL,socket_set_timeout,_SOCK _F64);
@@ -514,4 +984,16 @@ DEFINE_PRIM(_BOOL,socket_set_fast_send,_SOCK _BOOL);
 DEFINE_PRIM(_I32, socket_send_to, _SOCK _BYTES _I32 _I32 _I32);
 DEFINE_PRIM(_I32, socket_recv_from, _SOCK _BYTES _I32 _REF(_I32) _REF(_I32));
 DEFINE_PRIM(_I32, socket_fd_size, _I32 );
+DEFINE_PRIM(_I32, socket_send_file, _SOCK _I32 _I64 _I32);
+DEFINE_PRIM(_I32, socket_send_batch, _SOCK _BYTES _BYTES _I32);
+DEFINE_PRIM(_I32, socket_recv_batch, _SOCK _BYTES _BYTES _I32);
+DEFINE_PRIM(_BOOL, socket_set_udp_gro, _SOCK _BOOL);
 DEFINE_PRIM(_BOOL, socket_select, _ARR _ARR _ARR _BYTES _I32 _F64);
+
+#define _POLL _ABSTRACT(hl_poll)
+DEFINE_PRIM(_POLL, poll_alloc, _NO_ARG);
+DEFINE_PRIM(_BOOL, poll_add, _POLL _SOCK _I32);
+DEFINE_PRIM(_BOOL, poll_modify, _POLL _SOCK _I32);
+DEFINE_PRIM(_BOOL, poll_remove, _POLL _SOCK);
+DEFINE_PRIM(_I32, poll_count, _POLL);
+DEFINE_PRIM(_I32, poll_wait, _POLL _ARR _BYTES _F64);
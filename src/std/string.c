@@ -20,6 +20,88 @@
  * DEALINGS IN THE SOFTWARE.
  */
 #include <hl.h>
+#include <float.h>
+
+/*
+	ASCII fast paths for UTF-8/UTF-16 conversions : 16 bytes (or 8 UTF-16 units)
+	are checked and widened/narrowed at once, anything else goes through the
+	scalar code so invalid sequences keep the same behavior. NUL terminated
+	inputs are only read ahead when the load stays within the same page.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define UTF_SIMD
+#elif defined(__aarch64__)
+#	include <arm_neon.h>
+#	define UTF_SIMD
+#endif
+
+#ifdef UTF_SIMD
+
+#define UTF_CAN_LOAD(p)	((((int_val)(p)) & 4095) <= 4096 - 16)
+
+#ifdef HL_WIN
+#	include <intrin.h>
+static int __inline utf_ctz( unsigned int x ) {
+	DWORD b = 0;
+	_BitScanForward(&b, x);
+	return (int)b;
+}
+#else
+#	define utf_ctz(x) __builtin_ctz(x)
+#endif
+
+// number of leading bytes in 0x01-0x7F (0-16)
+static inline int utf_ascii16( const vbyte *s ) {
+#	ifdef __aarch64__
+	uint8x16_t v = vld1q_u8(s);
+	uint8x16_t bad = vorrq_u8(vcgeq_u8(v,vdupq_n_u8(0x80)),vceqq_u8(v,vdupq_n_u8(0)));
+	uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(bad),4)),0);
+	return m ? __builtin_ctzll(m) >> 2 : 16;
+#	else
+	__m128i v = _mm_loadu_si128((__m128i*)s);
+	int m = _mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_setzero_si128()));
+	return m ? utf_ctz(m) : 16;
+#	endif
+}
+
+static inline void utf_widen16( uchar *out, const vbyte *s ) {
+#	ifdef __aarch64__
+	uint8x16_t v = vld1q_u8(s);
+	vst1q_u16(out, vmovl_u8(vget_low_u8(v)));
+	vst1q_u16(out + 8, vmovl_u8(vget_high_u8(v)));
+#	else
+	__m128i v = _mm_loadu_si128((__m128i*)s);
+	_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(v,_mm_setzero_si128()));
+	_mm_storeu_si128((__m128i*)(out + 8), _mm_unpackhi_epi8(v,_mm_setzero_si128()));
+#	endif
+}
+
+// number of leading UTF-16 units in 0x01-0x7F (0-8)
+static inline int utf_ascii8( const uchar *c ) {
+#	ifdef __aarch64__
+	uint16x8_t v = vld1q_u16(c);
+	uint16x8_t bad = vorrq_u16(vcgeq_u16(v,vdupq_n_u16(0x80)),vceqq_u16(v,vdupq_n_u16(0)));
+	uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(bad)),0);
+	return m ? __builtin_ctzll(m) >> 3 : 8;
+#	else
+	__m128i v = _mm_loadu_si128((__m128i*)c);
+	__m128i ok = _mm_cmpeq_epi16(_mm_and_si128(v,_mm_set1_epi16((short)0xFF80)),_mm_setzero_si128());
+	int m = ~(_mm_movemask_epi8(ok) & ~_mm_movemask_epi8(_mm_cmpeq_epi16(v,_mm_setzero_si128()))) & 0xFFFF;
+	return m ? utf_ctz(m) >> 1 : 8;
+#	endif
+}
+
+static inline void utf_narrow8( vbyte *out, const uchar *c ) {
+#	ifdef __aarch64__
+	vst1_u8(out, vmovn_u16(vld1q_u16(c)));
+#	else
+	__m128i v = _mm_loadu_si128((__m128i*)c);
+	_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(v,v));
+#	endif
+}
+
+#endif
 
 HL_PRIM vbyte *hl_itos( int i, int *len ) {
 	uchar tmp[24];
@@ -29,6 +111,293 @@ HL_PRIM vbyte *hl_itos( int i, int *len ) {
 	return hl_copy_bytes((vbyte*)tmp,(k + 1)<<1);
 }
 
+/*
+	Grisu2 : generates digits that round-trip to the same double. When it needs no
+	more than 15 digits, these are exactly the ones printf %.15g produces (any
+	15 digits decimal is uniquely identified by its double), so we can format
+	them ourselves and only use printf for the remaining cases.
+*/
+typedef struct {
+	uint64 f;
+	int e;
+} diy_fp;
+
+// 10^k for k = -348 ... 340 by steps of 8
+static const diy_fp grisu_powers[] = {
+	{ 0xfa8fd5a0081c0288ULL, -1220 },
+	{ 0xbaaee17fa23ebf76ULL, -1193 },
+	{ 0x8b16fb203055ac76ULL, -1166 },
+	{ 0xcf42894a5dce35eaULL, -1140 },
+	{ 0x9a6bb0aa55653b2dULL, -1113 },
+	{ 0xe61acf033d1a45dfULL, -1087 },
+	{ 0xab70fe17c79ac6caULL, -1060 },
+	{ 0xff77b1fcbebcdc4fULL, -1034 },
+	{ 0xbe5691ef416bd60cULL, -1007 },
+	{ 0x8dd01fad907ffc3cULL, -980 },
+	{ 0xd3515c2831559a83ULL, -954 },
+	{ 0x9d71ac8fada6c9b5ULL, -927 },
+	{ 0xea9c227723ee8bcbULL, -901 },
+	{ 0xaecc49914078536dULL, -874 },
+	{ 0x823c12795db6ce57ULL, -847 },
+	{ 0xc21094364dfb5637ULL, -821 },
+	{ 0x9096ea6f3848984fULL, -794 },
+	{ 0xd77485cb25823ac7ULL, -768 },
+	{ 0xa086cfcd97bf97f4ULL, -741 },
+	{ 0xef340a98172aace5ULL, -715 },
+	{ 0xb23867fb2a35b28eULL, -688 },
+	{ 0x84c8d4dfd2c63f3bULL, -661 },
+	{ 0xc5dd44271ad3cdbaULL, -635 },
+	{ 0x936b9fcebb25c996ULL, -608 },
+	{ 0xdbac6c247d62a584ULL, -582 },
+	{ 0xa3ab66580d5fdaf6ULL, -555 },
+	{ 0xf3e2f893dec3f126ULL, -529 },
+	{ 0xb5b5ada8aaff80b8ULL, -502 },
+	{ 0x87625f056c7c4a8bULL, -475 },
+	{ 0xc9bcff6034c13053ULL, -449 },
+	{ 0x964e858c91ba2655ULL, -422 },
+	{ 0xdff9772470297ebdULL, -396 },
+	{ 0xa6dfbd9fb8e5b88fULL, -369 },
+	{ 0xf8a95fcf88747d94ULL, -343 },
+	{ 0xb94470938fa89bcfULL, -316 },
+	{ 0x8a08f0f8bf0f156bULL, -289 },
+	{ 0xcdb02555653131b6ULL, -263 },
+	{ 0x993fe2c6d07b7facULL, -236 },
+	{ 0xe45c10c42a2b3b06ULL, -210 },
+	{ 0xaa242499697392d3ULL, -183 },
+	{ 0xfd87b5f28300ca0eULL, -157 },
+	{ 0xbce5086492111aebULL, -130 },
+	{ 0x8cbccc096f5088ccULL, -103 },
+	{ 0xd1b71758e219652cULL, -77 },
+	{ 0x9c40000000000000ULL, -50 },
+	{ 0xe8d4a51000000000ULL, -24 },
+	{ 0xad78ebc5ac620000ULL, 3 },
+	{ 0x813f3978f8940984ULL, 30 },
+	{ 0xc097ce7bc90715b3ULL, 56 },
+	{ 0x8f7e32ce7bea5c70ULL, 83 },
+	{ 0xd5d238a4abe98068ULL, 109 },
+	{ 0x9f4f2726179a2245ULL, 136 },
+	{ 0xed63a231d4c4fb27ULL, 162 },
+	{ 0xb0de65388cc8ada8ULL, 189 },
+	{ 0x83c7088e1aab65dbULL, 216 },
+	{ 0xc45d1df942711d9aULL, 242 },
+	{ 0x924d692ca61be758ULL, 269 },
+	{ 0xda01ee641a708deaULL, 295 },
+	{ 0xa26da3999aef774aULL, 322 },
+	{ 0xf209787bb47d6b85ULL, 348 },
+	{ 0xb454e4a179dd1877ULL, 375 },
+	{ 0x865b86925b9bc5c2ULL, 402 },
+	{ 0xc83553c5c8965d3dULL, 428 },
+	{ 0x952ab45cfa97a0b3ULL, 455 },
+	{ 0xde469fbd99a05fe3ULL, 481 },
+	{ 0xa59bc234db398c25ULL, 508 },
+	{ 0xf6c69a72a3989f5cULL, 534 },
+	{ 0xb7dcbf5354e9beceULL, 561 },
+	{ 0x88fcf317f22241e2ULL, 588 },
+	{ 0xcc20ce9bd35c78a5ULL, 614 },
+	{ 0x98165af37b2153dfULL, 641 },
+	{ 0xe2a0b5dc971f303aULL, 667 },
+	{ 0xa8d9d1535ce3b396ULL, 694 },
+	{ 0xfb9b7cd9a4a7443cULL, 720 },
+	{ 0xbb764c4ca7a44410ULL, 747 },
+	{ 0x8bab8eefb6409c1aULL, 774 },
+	{ 0xd01fef10a657842cULL, 800 },
+	{ 0x9b10a4e5e9913129ULL, 827 },
+	{ 0xe7109bfba19c0c9dULL, 853 },
+	{ 0xac2820d9623bf429ULL, 880 },
+	{ 0x80444b5e7aa7cf85ULL, 907 },
+	{ 0xbf21e44003acdd2dULL, 933 },
+	{ 0x8e679c2f5e44ff8fULL, 960 },
+	{ 0xd433179d9c8cb841ULL, 986 },
+	{ 0x9e19db92b4e31ba9ULL, 1013 },
+	{ 0xeb96bf6ebadf77d9ULL, 1039 },
+	{ 0xaf87023b9bf0ee6bULL, 1066 },
+};
+
+static const unsigned int grisu_pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+static diy_fp diy_mul( diy_fp a, diy_fp b ) {
+	uint64 m32 = 0xFFFFFFFF;
+	uint64 ah = a.f >> 32, al = a.f & m32, bh = b.f >> 32, bl = b.f & m32;
+	uint64 hh = ah * bh, lh = al * bh, hl = ah * bl, ll = al * bl;
+	uint64 tmp = (ll >> 32) + (hl & m32) + (lh & m32) + (1U << 31);
+	diy_fp r;
+	r.f = hh + (hl >> 32) + (lh >> 32) + (tmp >> 32);
+	r.e = a.e + b.e + 64;
+	return r;
+}
+
+static diy_fp diy_normalize( diy_fp v ) {
+	while( !(v.f & ((uint64)1 << 63)) ) {
+		v.f <<= 1;
+		v.e--;
+	}
+	return v;
+}
+
+static void grisu_round( char *buf, int len, uint64 delta, uint64 rest, uint64 ten_kappa, uint64 wp_w ) {
+	while( rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w) ) {
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+// d must be finite and > 0, writes up to 17 digits and returns their count, the value being digits * 10^K
+static int grisu2( double d, char *buf, int *K ) {
+	uint64 bits, delta, p2;
+	unsigned int p1;
+	diy_fp v, wp, wm, c, w, one;
+	int len = 0, kappa, k, index;
+	double dk;
+	memcpy(&bits,&d,sizeof(double));
+	v.f = bits & (((uint64)1 << 52) - 1);
+	v.e = (int)((bits >> 52) & 0x7FF);
+	if( v.e ) {
+		v.f += (uint64)1 << 52;
+		v.e -= 1075;
+	} else
+		v.e = -1074;
+	// boundaries
+	wp.f = (v.f << 1) + 1;
+	wp.e = v.e - 1;
+	while( !(wp.f & ((uint64)1 << 53)) ) {
+		wp.f <<= 1;
+		wp.e--;
+	}
+	wp.f <<= 10;
+	wp.e -= 10;
+	if( v.f == ((uint64)1 << 52) ) {
+		wm.f = (v.f << 2) - 1;
+		wm.e = v.e - 2;
+	} else {
+		wm.f = (v.f << 1) - 1;
+		wm.e = v.e - 1;
+	}
+	wm.f <<= wm.e - wp.e;
+	wm.e = wp.e;
+	// cached power
+	dk = (-61 - wp.e) * 0.30102999566398114 + 347;
+	k = (int)dk;
+	if( dk - k > 0.0 ) k++;
+	index = (k >> 3) + 1;
+	*K = -(-348 + index * 8);
+	c = grisu_powers[index];
+	w = diy_mul(diy_normalize(v),c);
+	wp = diy_mul(wp,c);
+	wm = diy_mul(wm,c);
+	wm.f++;
+	wp.f--;
+	// digits generation
+	delta = wp.f - wm.f;
+	one.e = wp.e;
+	one.f = (uint64)1 << -one.e;
+	p1 = (unsigned int)(wp.f >> -one.e);
+	p2 = wp.f & (one.f - 1);
+	kappa = 10;
+	while( kappa > 1 && p1 < grisu_pow10[kappa - 1] ) kappa--;
+	while( kappa > 0 ) {
+		unsigned int dg = p1 / grisu_pow10[kappa - 1];
+		uint64 tmp;
+		p1 %= grisu_pow10[kappa - 1];
+		if( dg || len ) buf[len++] = (char)('0' + dg);
+		kappa--;
+		tmp = ((uint64)p1 << -one.e) + p2;
+		if( tmp <= delta ) {
+			*K += kappa;
+			grisu_round(buf,len,delta,tmp,(uint64)grisu_pow10[kappa] << -one.e,wp.f - w.f);
+			return len;
+		}
+	}
+	while( true ) {
+		char dg;
+		p2 *= 10;
+		delta *= 10;
+		dg = (char)(p2 >> -one.e);
+		if( dg || len ) buf[len++] = (char)('0' + dg);
+		p2 &= one.f - 1;
+		kappa--;
+		if( p2 < delta ) {
+			*K += kappa;
+			grisu_round(buf,len,delta,p2,one.f,(wp.f - w.f) * (-kappa < 10 ? grisu_pow10[-kappa] : 0));
+			return len;
+		}
+	}
+}
+
+// same output as %.15g, returns 0 if printf is required
+static int ftos_fast( double d, uchar *out ) {
+	char digits[20];
+	int K, len, exp, i, p = 0;
+	// subnormals have less than 15 digits of precision
+	if( d - d != 0 || (d < DBL_MIN && d > -DBL_MIN) )
+		return 0;
+	if( d < 0 ) {
+		out[p++] = '-';
+		d = -d;
+	}
+	len = grisu2(d,digits,&K);
+	while( len > 1 && digits[len - 1] == '0' ) {
+		len--;
+		K++;
+	}
+	if( len > 15 ) {
+		/*
+			Round to 15 digits ourselves only when it can't differ from rounding the
+			exact value : it is within half an ulp (less than 12 units of the 17th
+			digit) from the generated digits, so they must not be close to the middle.
+		*/
+		int tail = (digits[15] - '0') * 10 + (len > 16 ? digits[16] - '0' : 0);
+		if( tail > 38 && tail < 62 )
+			return 0;
+		K += len - 15;
+		len = 15;
+		if( tail >= 62 ) {
+			i = 14;
+			while( i >= 0 && digits[i] == '9' )
+				digits[i--] = '0';
+			if( i < 0 ) {
+				digits[0] = '1';
+				K += 15;
+				len = 1;
+			} else
+				digits[i]++;
+		}
+		while( len > 1 && digits[len - 1] == '0' ) {
+			len--;
+			K++;
+		}
+	}
+	exp = len + K - 1;
+	if( exp < -4 || exp >= 15 ) {
+		out[p++] = digits[0];
+		if( len > 1 ) {
+			out[p++] = '.';
+			for(i=1;i<len;i++) out[p++] = digits[i];
+		}
+		out[p++] = 'e';
+		out[p++] = exp < 0 ? '-' : '+';
+		if( exp < 0 ) exp = -exp;
+		if( exp >= 100 ) {
+			out[p++] = (uchar)('0' + exp / 100);
+			exp %= 100;
+		}
+		out[p++] = (uchar)('0' + exp / 10);
+		out[p++] = (uchar)('0' + exp % 10);
+	} else if( exp < 0 ) {
+		out[p++] = '0';
+		out[p++] = '.';
+		for(i=-1;i>exp;i--) out[p++] = '0';
+		for(i=0;i<len;i++) out[p++] = digits[i];
+	} else {
+		for(i=0;i<=exp;i++) out[p++] = i < len ? digits[i] : '0';
+		if( len > exp + 1 ) {
+			out[p++] = '.';
+			for(i=exp+1;i<len;i++) out[p++] = digits[i];
+		}
+	}
+	out[p] = 0;
+	return p;
+}
+
 HL_PRIM vbyte *hl_ftos( double d, int *len ) {
 	uchar tmp[24];
 	int k;
@@ -37,6 +406,11 @@ HL_PRIM vbyte *hl_ftos( double d, int *len ) {
 		*len = 3;
 		return hl_copy_bytes((vbyte*)USTR("NaN"),8);
 	}
+	k = ftos_fast(d,tmp);
+	if( k ) {
+		*len = k;
+		return hl_copy_bytes((vbyte*)tmp,(k + 1) << 1);
+	}
 	// don't use the last digit (eg 5.1 = 5.09999..996)
 	// also cut one more digit for some numbers (eg 86.57 and 85.18) <- to fix since we lose one PI digit
 	k = (int)usprintf(tmp,24,USTR("%.15g"),d);
@@ -86,7 +460,18 @@ HL_PRIM int hl_utf8_length( const vbyte *s, int pos ) {
 	int len = 0;
 	s += pos;
 	while( true ) {
-		unsigned char c = (unsigned)*s;
+		unsigned char c;
+#		ifdef UTF_SIMD
+		if( *s < 0x80 ) {
+			int n;
+			while( UTF_CAN_LOAD(s) && (n = utf_ascii16(s)) > 0 ) {
+				s += n;
+				len += n;
+				if( n < 16 ) break;
+			}
+		}
+#		endif
+		c = (unsigned)*s;
 		len++;
 		if( c < 0x80 ) {
 			if( c == 0 ) {
@@ -116,6 +501,19 @@ HL_PRIM int hl_from_utf8( uchar *out, int outLen, const char *str ) {
 	int p = 0;
 	unsigned int c, c2, c3;
 	while( p++ < outLen ) {
+#		ifdef UTF_SIMD
+		if( (unsigned char)*str < 0x80 ) {
+			int n;
+			while( outLen - p >= 16 && UTF_CAN_LOAD(str) && (n = utf_ascii16((vbyte*)str)) > 0 ) {
+				// out has room for 16 more chars, extra ones will be overwritten
+				utf_widen16(out,(vbyte*)str);
+				out += n;
+				str += n;
+				p += n;
+				if( n < 16 ) break;
+			}
+		}
+#		endif
 		c = *(unsigned char *)str++;
 		if( c < 0x80 ) {
 			if( c == 0 ) break;
@@ -203,7 +601,19 @@ HL_PRIM vbyte *hl_utf16_to_utf8( vbyte *str, int len, int *size ) {
 	int utf8bytes = 0;
 	int p = 0;
 	while( c != end ) {
-		unsigned int v = (unsigned int)*c;
+		unsigned int v;
+#		ifdef UTF_SIMD
+		if( *c < 0x80 ) {
+			int n;
+			while( (end ? end - c >= 8 : UTF_CAN_LOAD(c)) && (n = utf_ascii8(c)) > 0 ) {
+				c += n;
+				utf8bytes += n;
+				if( n < 8 ) break;
+			}
+			if( c == end ) break;
+		}
+#		endif
+		v = (unsigned int)*c;
 		if( v == 0 && end == NULL ) break;
 		if( v < 0x80 )
 			utf8bytes++;
@@ -219,7 +629,25 @@ HL_PRIM vbyte *hl_utf16_to_utf8( vbyte *str, int len, int *size ) {
 	out = hl_gc_alloc_noptr(utf8bytes + 1);
 	c = (uchar*)str;
 	while( c != end ) {
-		unsigned int v = (unsigned int)*c;
+		unsigned int v;
+#		ifdef UTF_SIMD
+		if( *c < 0x80 ) {
+			int n;
+			while( (end ? end - c >= 8 : UTF_CAN_LOAD(c)) && (n = utf_ascii8(c)) > 0 ) {
+				if( n == 8 )
+					utf_narrow8(out + p,c);
+				else {
+					int i;
+					for(i=0;i<n;i++) out[p+i] = (vbyte)c[i];
+				}
+				c += n;
+				p += n;
+				if( n < 8 ) break;
+			}
+			if( c == end ) break;
+		}
+#		endif
+		v = (unsigned int)*c;
 		if( v < 0x80 ) {
 			out[p++] = (vbyte)v;
 			if( v == 0 && end == NULL ) break;
@@ -69,8 +69,14 @@ struct _hl_tls {
 	void (*free)( hl_tls * );
 	DWORD tid;
 	bool gc;
+	void (*destructor)( void * ); // tid is a FLS index when set
 };
 
+typedef struct {
+	void (*destructor)( void * );
+	void *value;
+} tls_fls_store;
+
 #else
 
 #	include <pthread.h>
@@ -194,25 +200,27 @@ DEFINE_PRIM(_VOID, mutex_free, _MUTEX);
 
 // ------------------ SEMAPHORE
 
+#ifdef HL_THREADS
+static void semaphore_init( hl_semaphore *sem, int value ) {
+	sem->free = hl_semaphore_free;
+#	if defined(HL_WIN)
+	sem->sem = CreateSemaphoreW(NULL, value, 0x7FFFFFFF, NULL);
+#	elif defined(__APPLE__)
+	sem->sem = dispatch_semaphore_create(value);
+#	else
+	sem_init(&sem->sem, false, value);
+#	endif
+}
+#endif
+
 HL_PRIM hl_semaphore *hl_semaphore_alloc(int value) {
 #	if !defined(HL_THREADS)
 	static struct _hl_semaphore null_semaphore = {0};
 	return (hl_semaphore *)&null_semaphore;
-#	elif defined(HL_WIN)
-	hl_semaphore *sem =
-	    (hl_semaphore *)hl_gc_alloc_finalizer(sizeof(hl_semaphore));
-	sem->free = hl_semaphore_free;
-	sem->sem = CreateSemaphoreW(NULL, value, 0x7FFFFFFF, NULL);
-	return sem;
 #	else
 	hl_semaphore *sem =
 	    (hl_semaphore *)hl_gc_alloc_finalizer(sizeof(hl_semaphore));
-	sem->free = hl_semaphore_free;
-#	ifdef __APPLE__
-	sem->sem = dispatch_semaphore_create(value);
-#	else
-	sem_init(&sem->sem, false, value);
-#	endif
+	semaphore_init(sem, value);
 	return sem;
 #	endif
 }
@@ -491,6 +499,7 @@ HL_PRIM hl_tls *hl_tls_alloc( bool gc_value ) {
 	l->free = hl_tls_free;
 	l->tid = TlsAlloc();
 	l->gc = gc_value;
+	l->destructor = NULL;
 	TlsSetValue(l->tid,NULL);
 	return l;
 #	else
@@ -502,12 +511,45 @@ HL_PRIM hl_tls *hl_tls_alloc( bool gc_value ) {
 #	endif
 }
 
+#if defined(HL_THREADS) && defined(HL_WIN)
+static void NTAPI tls_fls_exit( void *v ) {
+	tls_fls_store *s = (tls_fls_store*)v;
+	if( !s ) return;
+	s->destructor(s->value);
+	free(s);
+}
+#endif
+
+/*
+	Allocates a thread local for native values : when a thread exits, destructor is
+	called with its value unless it is NULL. The values of the threads still running
+	when the thread local is freed are not released on all platforms.
+*/
+HL_PRIM hl_tls *hl_tls_alloc_destructor( void (*destructor)( void * ) ) {
+#	if !defined(HL_THREADS)
+	return hl_tls_alloc(false);
+#	elif defined(HL_WIN)
+	hl_tls *l = (hl_tls*)hl_gc_alloc_finalizer(sizeof(hl_tls));
+	l->free = hl_tls_free;
+	l->tid = FlsAlloc(tls_fls_exit);
+	l->gc = false;
+	l->destructor = destructor;
+	return l;
+#	else
+	hl_tls *l = (hl_tls*)hl_gc_alloc_finalizer(sizeof(hl_tls));
+	l->free = hl_tls_free;
+	l->gc = false;
+	pthread_key_create(&l->key,destructor);
+	return l;
+#	endif
+}
+
 HL_PRIM void hl_tls_free( hl_tls *l ) {
 #	if !defined(HL_THREADS)
 	free(l);
 #	elif defined(HL_WIN)
 	if( l->free ) {
-		TlsFree(l->tid);
+		if( l->destructor ) FlsFree(l->tid); else TlsFree(l->tid);
 		l->free = NULL;
 	}
 #	else
@@ -522,6 +564,23 @@ HL_PRIM void hl_tls_set( hl_tls *l, void *v ) {
 #	if !defined(HL_THREADS)
 	l->value = v;
 #	else
+#	ifdef HL_WIN
+	if( l->destructor ) {
+		tls_fls_store *s = (tls_fls_store*)FlsGetValue(l->tid);
+		if( !s ) {
+			if( !v ) return;
+			s = (tls_fls_store*)malloc(sizeof(tls_fls_store));
+			s->destructor = l->destructor;
+			FlsSetValue(l->tid, s);
+		} else if( !v ) {
+			FlsSetValue(l->tid, NULL);
+			free(s);
+			return;
+		}
+		s->value = v;
+		return;
+	}
+#	endif
 	if( l->gc ) {
 		void **store = _tls_get(l);
 		if( !store) {
@@ -548,7 +607,14 @@ HL_PRIM void *hl_tls_get( hl_tls *l ) {
 #	if !defined(HL_THREADS)
 	return l->value;
 #	else
-	void **store = _tls_get(l);
+	void **store;
+#	ifdef HL_WIN
+	if( l->destructor ) {
+		tls_fls_store *s = (tls_fls_store*)FlsGetValue(l->tid);
+		return s ? s->value : NULL;
+	}
+#	endif
+	store = _tls_get(l);
 	if( !l->gc ) return store;
 	return store ? *store : NULL;
 #	endif
@@ -1174,3 +1240,889 @@ DEFINE_PRIM(_I32, atomic_load32, _REF(_I32))
 DEFINE_PRIM(_DYN, atomic_load_ptr, _REF(_DYN))
 DEFINE_PRIM(_I32, atomic_store32, _REF(_I32) _I32)
 DEFINE_PRIM(_DYN, atomic_store_ptr, _REF(_DYN) _DYN)
+
+// ----------------- RING
+
+// internal atomics used by the ring and pool, sized to int_val
+
+#if defined(HL_GCC_ATOMICS)
+#	define ATOMIC_LOAD(p)			__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#	define ATOMIC_STORE(p,v)		__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#	define ATOMIC_ADD(p,v)			__atomic_add_fetch(p, v, __ATOMIC_SEQ_CST)
+#	define ATOMIC_FENCE()			__atomic_thread_fence(__ATOMIC_SEQ_CST)
+static bool atomic_cas_val( int_val *a, int_val expected, int_val v ) {
+	return __atomic_compare_exchange_n(a, &expected, v, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+#elif defined(HL_VCC_ATOMICS)
+#	define ATOMIC_LOAD(p)			(*(volatile int_val*)(p))
+#	define ATOMIC_STORE(p,v)		(_ReadWriteBarrier(), *(volatile int_val*)(p) = (v))
+#	ifdef HL_64
+#		define ATOMIC_ADD(p,v)		(_InterlockedExchangeAdd64((__int64 volatile*)(p),v) + (v))
+#	else
+#		define ATOMIC_ADD(p,v)		(_InterlockedExchangeAdd((long volatile*)(p),v) + (v))
+#	endif
+#	define ATOMIC_FENCE()			MemoryBarrier()
+static bool atomic_cas_val( int_val *a, int_val expected, int_val v ) {
+#	ifdef HL_64
+	return _InterlockedCompareExchange64((__int64 volatile*)a, v, expected) == expected;
+#	else
+	return _InterlockedCompareExchange((long volatile*)a, v, expected) == expected;
+#	endif
+}
+#endif
+
+/*
+	Bounded multi-producer multi-consumer queue (D. Vyukov's sequenced ring).
+	Producers and consumers only contend on a single CAS, messages are stored
+	in preallocated cells so no allocation is done per message. The condition
+	is only used to park consumers doing a blocking pop on an empty ring.
+*/
+
+typedef struct {
+	int_val seq;
+	vdynamic *msg;
+} ring_cell;
+
+typedef struct _hl_ring hl_ring;
+struct _hl_ring {
+	void (*free)( hl_ring * );
+	ring_cell *cells;
+	int_val mask;
+	int_val waiters;
+	char __pad0[64];
+	int_val head;
+	char __pad1[64];
+	int_val tail;
+	char __pad2[64];
+#ifdef HL_THREADS
+#	ifdef HL_WIN
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE wait;
+#	else
+	pthread_mutex_t lock;
+	pthread_cond_t wait;
+#	endif
+#endif
+};
+
+static void hl_ring_free( hl_ring *r ) {
+	hl_remove_root(&r->cells);
+#	if !defined(HL_THREADS)
+#	elif defined(HL_WIN)
+	DeleteCriticalSection(&r->lock);
+#	else
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->wait);
+#	endif
+}
+
+HL_PRIM hl_ring *hl_ring_alloc( int size ) {
+	hl_ring *r;
+	int_val i, count = 2;
+	if( size <= 0 || size > (1 << 28) ) hl_error("Invalid ring size");
+	while( count < size ) count <<= 1;
+	r = (hl_ring*)hl_gc_alloc_finalizer(sizeof(hl_ring));
+	memset(r,0,sizeof(hl_ring));
+	r->free = hl_ring_free;
+	r->mask = count - 1;
+	r->cells = (ring_cell*)hl_gc_alloc_raw((int)(sizeof(ring_cell) * count));
+	for(i=0;i<count;i++) {
+		r->cells[i].seq = i;
+		r->cells[i].msg = NULL;
+	}
+	hl_add_root(&r->cells);
+#	if !defined(HL_THREADS)
+#	elif defined(HL_WIN)
+	InitializeCriticalSection(&r->lock);
+	InitializeConditionVariable(&r->wait);
+#	else
+	pthread_mutex_init(&r->lock,NULL);
+	pthread_cond_init(&r->wait,NULL);
+#	endif
+	return r;
+}
+
+static bool ring_try_push( hl_ring *r, vdynamic *msg ) {
+	ring_cell *c;
+	int_val pos = ATOMIC_LOAD(&r->head);
+	while( true ) {
+		c = &r->cells[pos & r->mask];
+		int_val dif = ATOMIC_LOAD(&c->seq) - pos;
+		if( dif == 0 ) {
+			if( atomic_cas_val(&r->head, pos, pos + 1) )
+				break;
+		} else if( dif < 0 )
+			return false; // full
+		pos = ATOMIC_LOAD(&r->head);
+	}
+	c->msg = msg;
+	ATOMIC_STORE(&c->seq, pos + 1);
+	return true;
+}
+
+static vdynamic *ring_try_pop( hl_ring *r ) {
+	ring_cell *c;
+	vdynamic *msg;
+	int_val pos = ATOMIC_LOAD(&r->tail);
+	while( true ) {
+		c = &r->cells[pos & r->mask];
+		int_val dif = ATOMIC_LOAD(&c->seq) - (pos + 1);
+		if( dif == 0 ) {
+			if( atomic_cas_val(&r->tail, pos, pos + 1) )
+				break;
+		} else if( dif < 0 )
+			return NULL; // empty
+		pos = ATOMIC_LOAD(&r->tail);
+	}
+	msg = c->msg;
+	c->msg = NULL;
+	ATOMIC_STORE(&c->seq, pos + r->mask + 1);
+	return msg;
+}
+
+HL_PRIM bool hl_ring_push( hl_ring *r, vdynamic *msg ) {
+	if( msg == NULL ) hl_error("Null message");
+	if( !ring_try_push(r,msg) )
+		return false;
+#	ifdef HL_THREADS
+	ATOMIC_FENCE();
+	if( ATOMIC_LOAD(&r->waiters) > 0 ) {
+		LOCK(r->lock);
+#		ifdef HL_WIN
+		WakeConditionVariable(&r->wait);
+#		else
+		pthread_cond_signal(&r->wait);
+#		endif
+		UNLOCK(r->lock);
+	}
+#	endif
+	return true;
+}
+
+HL_PRIM vdynamic *hl_ring_pop( hl_ring *r, bool block ) {
+	vdynamic *msg = ring_try_pop(r);
+	if( msg || !block )
+		return msg;
+#	ifdef HL_THREADS
+	hl_blocking(true);
+	LOCK(r->lock);
+	ATOMIC_ADD(&r->waiters, 1);
+	while( (msg = ring_try_pop(r)) == NULL ) {
+#		ifdef HL_WIN
+		SleepConditionVariableCS(&r->wait, &r->lock, INFINITE);
+#		else
+		pthread_cond_wait(&r->wait, &r->lock);
+#		endif
+	}
+	ATOMIC_ADD(&r->waiters, -1);
+	UNLOCK(r->lock);
+	hl_blocking(false);
+#	endif
+	return msg;
+}
+
+HL_PRIM int hl_ring_size( hl_ring *r ) {
+	int_val size = ATOMIC_LOAD(&r->head) - ATOMIC_LOAD(&r->tail);
+	return size < 0 ? 0 : (int)size;
+}
+
+#define _RING _ABSTRACT(hl_ring)
+DEFINE_PRIM(_RING, ring_alloc, _I32);
+DEFINE_PRIM(_BOOL, ring_push, _RING _DYN);
+DEFINE_PRIM(_DYN, ring_pop, _RING _BOOL);
+DEFINE_PRIM(_I32, ring_size, _RING);
+
+// ----------------- POOL
+
+/*
+	Thread pool : each worker owns a ring of tasks, submissions are spread
+	round-robin over the workers and idle workers steal from the others rings.
+	Workers are started once and stay registered with the GC for the whole
+	process lifetime. A task is either a closure or a parallel-for job.
+*/
+
+#define POOL_MAX_WORKERS	256
+#define POOL_RING_SIZE		4096
+
+typedef struct _pool_job pool_job;
+struct _pool_job {
+	hl_type *t; // always NULL, tells apart jobs from closures
+	vclosure *fun;
+	int_val next;
+	int_val end;
+	int_val chunk;
+	int_val remaining;
+	vdynamic *exc;
+	hl_semaphore *done;
+};
+
+typedef struct _hl_pool hl_pool;
+struct _hl_pool {
+	void (*free)( hl_pool * );
+	hl_ring **rings;
+	int nworkers;
+	int_val submit_index;
+	int_val idle;
+	hl_semaphore *wake;
+};
+
+HL_API void hl_gc_safepoint( void );
+
+static void pool_job_run( pool_job *j ) {
+	hl_trap_ctx trap;
+	vdynamic *exc;
+	int_val start;
+	hl_trap(trap, exc, on_exception);
+	while( (start = ATOMIC_ADD(&j->next, j->chunk) - j->chunk) < j->end ) {
+		int_val end = start + j->chunk;
+		if( end > j->end ) end = j->end;
+		if( j->exc == NULL ) hl_call2(void, j->fun, int, (int)start, int, (int)end);
+		if( ATOMIC_ADD(&j->remaining, -1) == 0 ) hl_semaphore_release(j->done);
+	}
+	hl_endtrap(trap);
+	return;
+on_exception:
+	hl_endtrap(trap);
+	j->exc = exc;
+	// this chunk is finished (with an error), keep draining the others
+	if( ATOMIC_ADD(&j->remaining, -1) == 0 ) hl_semaphore_release(j->done);
+	pool_job_run(j);
+}
+
+static void pool_run_task( vdynamic *task ) {
+	if( task->t == NULL ) {
+		pool_job_run((pool_job*)task);
+		return;
+	}
+	bool isExc;
+	vdynamic *exc = hl_dyn_call_safe((vclosure*)task,NULL,0,&isExc);
+	if( isExc ) hl_print_uncaught_exception(exc);
+}
+
+static vdynamic *pool_find_task( hl_pool *p, int index ) {
+	int i;
+	vdynamic *task = ring_try_pop(p->rings[index]);
+	if( task ) return task;
+	for(i=1;i<p->nworkers;i++) {
+		task = ring_try_pop(p->rings[(index + i) % p->nworkers]);
+		if( task ) return task;
+	}
+	return NULL;
+}
+
+typedef struct {
+	hl_pool *p;
+	int index;
+} pool_worker;
+
+static void pool_worker_main( pool_worker *w ) {
+	hl_pool *p = w->p;
+	int index = w->index;
+	w = NULL;
+	while( true ) {
+		vdynamic *task = pool_find_task(p, index);
+		if( task == NULL ) {
+			ATOMIC_ADD(&p->idle, 1);
+			task = pool_find_task(p, index);
+			if( task == NULL ) hl_semaphore_acquire(p->wake);
+			ATOMIC_ADD(&p->idle, -1);
+			if( task == NULL ) continue;
+		}
+		pool_run_task(task);
+		hl_gc_safepoint();
+	}
+}
+
+static void pool_push( hl_pool *p, vdynamic *task ) {
+	while( true ) {
+		int i;
+		int_val start = ATOMIC_ADD(&p->submit_index, 1);
+		for(i=0;i<p->nworkers;i++)
+			if( ring_try_push(p->rings[(start + i) % p->nworkers], task) ) {
+				ATOMIC_FENCE();
+				if( ATOMIC_LOAD(&p->idle) > 0 ) hl_semaphore_release(p->wake);
+				return;
+			}
+		// all rings are full : help the workers
+		task = pool_find_task(p, (int)(start % p->nworkers));
+		if( task ) pool_run_task(task);
+	}
+}
+
+HL_PRIM hl_pool *hl_pool_alloc( int nworkers ) {
+	int i;
+	hl_pool *p;
+#	ifndef HL_THREADS
+	hl_error("Threads support is disabled");
+#	endif
+	if( nworkers <= 0 || nworkers > POOL_MAX_WORKERS ) hl_error("Invalid number of workers");
+	p = (hl_pool*)hl_gc_alloc_raw(sizeof(hl_pool));
+	memset(p,0,sizeof(hl_pool));
+	p->nworkers = nworkers;
+	p->rings = (hl_ring**)hl_gc_alloc_raw(sizeof(hl_ring*) * nworkers);
+	p->wake = hl_semaphore_alloc(0);
+	for(i=0;i<nworkers;i++)
+		p->rings[i] = hl_ring_alloc(POOL_RING_SIZE);
+	for(i=0;i<nworkers;i++) {
+		pool_worker *w = (pool_worker*)hl_gc_alloc_raw(sizeof(pool_worker));
+		w->p = p;
+		w->index = i;
+		if( hl_thread_start(pool_worker_main, w, true) == NULL )
+			hl_error("Failed to start pool worker");
+	}
+	return p;
+}
+
+HL_PRIM void hl_pool_submit( hl_pool *p, vclosure *c ) {
+	if( c == NULL ) hl_null_access();
+	pool_push(p, (vdynamic*)c);
+}
+
+HL_PRIM void hl_pool_parallel_for( hl_pool *p, int start, int end, int chunk, vclosure *c ) {
+	int i, njobs;
+	pool_job *j;
+	if( end <= start ) return;
+	if( chunk <= 0 ) {
+		// a few chunks per worker gives some room for stealing
+		chunk = (end - start) / (p->nworkers * 4 + 1);
+		if( chunk <= 0 ) chunk = 1;
+	}
+	j = (pool_job*)hl_gc_alloc_raw(sizeof(pool_job));
+	memset(j,0,sizeof(pool_job));
+	j->fun = c;
+	j->next = start;
+	j->end = end;
+	j->chunk = chunk;
+	j->remaining = ((int_val)end - start + chunk - 1) / chunk;
+	j->done = hl_semaphore_alloc(0);
+	njobs = (int)(j->remaining - 1);
+	if( njobs > p->nworkers ) njobs = p->nworkers;
+	for(i=0;i<njobs;i++)
+		pool_push(p, (vdynamic*)j);
+	// the caller participates, then waits for the chunks stolen by the workers
+	pool_job_run(j);
+	hl_semaphore_acquire(j->done);
+	if( j->exc ) hl_rethrow(j->exc);
+}
+
+HL_PRIM int hl_pool_workers( hl_pool *p ) {
+	return p->nworkers;
+}
+
+#define _POOL _ABSTRACT(hl_pool)
+DEFINE_PRIM(_POOL, pool_alloc, _I32);
+DEFINE_PRIM(_VOID, pool_submit, _POOL _FUN(_VOID,_NO_ARG));
+DEFINE_PRIM(_VOID, pool_parallel_for, _POOL _I32 _I32 _I32 _FUN(_VOID,_I32 _I32));
+DEFINE_PRIM(_I32, pool_workers, _POOL);
+
+// ----------------- NATIVE PARALLEL LOOPS
+
+HL_PRIM int hl_cpu_count() {
+	static int ncpu = 0;
+	if( ncpu == 0 ) {
+		int n = 1;
+#		if !defined(HL_THREADS)
+#		elif defined(HL_WIN_DESKTOP)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		n = (int)info.dwNumberOfProcessors;
+#		elif defined(_SC_NPROCESSORS_ONLN)
+		n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#		endif
+		ncpu = n <= 0 ? 1 : n;
+	}
+	return ncpu;
+}
+
+#ifdef HL_THREADS
+#define PARALLEL_LOCAL_WORKERS	16
+
+typedef struct {
+	void (*fn)( void *, int );
+	void *ctx;
+	int index;
+	hl_semaphore *done;
+} parallel_worker;
+
+static void parallel_worker_main( parallel_worker *w ) {
+	w->fn(w->ctx, w->index);
+	hl_semaphore_release(w->done);
+}
+#endif
+
+/*
+	Calls fn(ctx,0) ... fn(ctx,n-1) in parallel and returns once they are all done.
+	Index 0 runs on the calling thread, the others on short lived threads that are
+	not GC threads : fn must not allocate GC memory or raise exceptions. Nothing is
+	allocated in the GC either, so it can be called from a blocking section.
+*/
+HL_PRIM void hl_parallel_for( int n, void (*fn)( void *, int ), void *ctx ) {
+	int i;
+#	ifdef HL_THREADS
+	parallel_worker local[PARALLEL_LOCAL_WORKERS];
+	parallel_worker *w = NULL;
+	struct _hl_semaphore done;
+	int started = 0;
+	if( n > 1 )
+		w = n <= PARALLEL_LOCAL_WORKERS ? local : (parallel_worker*)malloc(sizeof(parallel_worker) * n);
+	if( w ) {
+		semaphore_init(&done, 0);
+		for(i=1;i<n;i++) {
+			w[i].fn = fn;
+			w[i].ctx = ctx;
+			w[i].index = i;
+			w[i].done = &done;
+			if( hl_thread_start(parallel_worker_main, &w[i], false) )
+				started++;
+			else
+				fn(ctx, i);
+		}
+		fn(ctx, 0);
+		while( started-- > 0 )
+			hl_semaphore_acquire(&done);
+		hl_semaphore_free(&done);
+#		ifdef __APPLE__
+		// back to its initial value : it can be released
+		dispatch_release(done.sem);
+#		endif
+		if( w != local ) free(w);
+		return;
+	}
+#	endif
+	for(i=0;i<n;i++)
+		fn(ctx, i);
+}
+
+// ----------------- FIBERS
+
+/*
+	Stackful fibers : each fiber runs on its own mmap'ed stack, switched in and
+	out of the OS thread that resumes it. While a fiber runs, the thread stack_top
+	points to the fiber stack and the stack of its resumer is registered as an
+	extra GC region ; while it is suspended the region covers the fiber stack
+	instead, and is only scanned while the fiber is reachable : an abandoned
+	fiber is collected and its stack released by its finalizer.
+
+	Blocking prims still block the OS thread running the fiber : yielding is
+	explicit, and a scheduler spreads runnable fibers over the threads calling
+	fiber_sched_run.
+*/
+
+#if !defined(HL_WIN) && !defined(HL_CONSOLE) && !defined(HL_EMSCRIPTEN)
+#	define HL_FIBERS
+#	include <sys/mman.h>
+#	if defined(__x86_64__) || defined(__aarch64__)
+#		define FIBER_ASM
+#	else
+#		include <ucontext.h>
+#	endif
+#endif
+
+#define FIBER_NEW		0
+#define FIBER_SUSPENDED	1
+#define FIBER_RUNNING	2
+#define FIBER_DONE		3
+#define FIBER_QUEUED	4
+
+#define FIBER_DEFAULT_STACK	(64 << 10)
+
+typedef struct _hl_fiber_sched hl_fiber_sched;
+typedef struct _hl_fiber hl_fiber;
+struct _hl_fiber {
+	void (*finalize)( hl_fiber * );
+	// finalizer memory is not scanned : these are kept by the refs region
+	vclosure *fun;
+	vdynamic *exc;
+	hl_fiber *parent;
+	hl_fiber_sched *sched;
+	unsigned char *stack;
+	int stack_size;
+	int_val state;
+	int_val woken;
+	bool requeue;
+	void *resumer_top;
+	hl_trap_ctx *trap;
+	// while running : resumer stack, while suspended : fiber stack
+	hl_stack_region region;
+	hl_stack_region refs;
+#	if defined(HL_FIBERS) && !defined(FIBER_ASM)
+	ucontext_t ctx;
+	ucontext_t resumer_ctx;
+#	endif
+};
+
+struct _hl_fiber_sched {
+	hl_ring *ready;
+	int_val active;
+	int_val runners;
+};
+
+HL_THREAD_STATIC_VAR hl_fiber *current_fiber;
+
+#ifdef FIBER_ASM
+
+#	ifdef __APPLE__
+#		define FIBER_SYM(name)	"_" #name
+#		define FIBER_SECTION	".text\n"
+#		define FIBER_END_SECTION
+#	else
+#		define FIBER_SYM(name)	#name
+#		define FIBER_SECTION	".pushsection .text\n"
+#		define FIBER_END_SECTION	".popsection\n"
+#	endif
+
+// save callee-saved registers on the current stack, store its pointer in *save_sp and restore from sp
+void fiber_switch( void **save_sp, void *sp ) __asm__(FIBER_SYM(hl_fiber_switch));
+void fiber_start( void ) __asm__(FIBER_SYM(hl_fiber_start));
+
+#	if defined(__x86_64__)
+__asm__(
+	FIBER_SECTION
+	".p2align 4\n"
+	FIBER_SYM(hl_fiber_switch) ":\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".p2align 4\n"
+	FIBER_SYM(hl_fiber_start) ":\n"
+	"	movq %r12, %rdi\n"
+	"	call *%r13\n"
+	"	ud2\n"
+	FIBER_END_SECTION
+);
+#		define FIBER_FRAME_SIZE	64
+static void fiber_init_frame( void **sp, hl_fiber *f, void *entry ) {
+	((int*)sp)[0] = 0x1F80; // mxcsr
+	((int*)sp)[1] = 0x037F; // x87 control word
+	sp[1] = NULL; // r15
+	sp[2] = NULL; // r14
+	sp[3] = entry; // r13
+	sp[4] = f; // r12
+	sp[5] = NULL; // rbx
+	sp[6] = NULL; // rbp
+	sp[7] = (void*)fiber_start;
+}
+#	else
+__asm__(
+	FIBER_SECTION
+	".p2align 4\n"
+	FIBER_SYM(hl_fiber_switch) ":\n"
+	"	sub sp, sp, #160\n"
+	"	stp x19, x20, [sp, #0]\n"
+	"	stp x21, x22, [sp, #16]\n"
+	"	stp x23, x24, [sp, #32]\n"
+	"	stp x25, x26, [sp, #48]\n"
+	"	stp x27, x28, [sp, #64]\n"
+	"	stp x29, x30, [sp, #80]\n"
+	"	stp d8, d9, [sp, #96]\n"
+	"	stp d10, d11, [sp, #112]\n"
+	"	stp d12, d13, [sp, #128]\n"
+	"	stp d14, d15, [sp, #144]\n"
+	"	mov x2, sp\n"
+	"	str x2, [x0]\n"
+	"	mov sp, x1\n"
+	"	ldp x19, x20, [sp, #0]\n"
+	"	ldp x21, x22, [sp, #16]\n"
+	"	ldp x23, x24, [sp, #32]\n"
+	"	ldp x25, x26, [sp, #48]\n"
+	"	ldp x27, x28, [sp, #64]\n"
+	"	ldp x29, x30, [sp, #80]\n"
+	"	ldp d8, d9, [sp, #96]\n"
+	"	ldp d10, d11, [sp, #112]\n"
+	"	ldp d12, d13, [sp, #128]\n"
+	"	ldp d14, d15, [sp, #144]\n"
+	"	add sp, sp, #160\n"
+	"	ret\n"
+	".p2align 4\n"
+	FIBER_SYM(hl_fiber_start) ":\n"
+	"	mov x0, x19\n"
+	"	blr x20\n"
+	"	brk #0\n"
+	FIBER_END_SECTION
+);
+#		define FIBER_FRAME_SIZE	160
+static void fiber_init_frame( void **sp, hl_fiber *f, void *entry ) {
+	memset(sp, 0, FIBER_FRAME_SIZE);
+	sp[0] = f; // x19
+	sp[1] = entry; // x20
+	sp[11] = (void*)fiber_start; // x30
+}
+#	endif
+
+#endif
+
+#ifdef HL_FIBERS
+
+static void fiber_leave( hl_fiber *f ) {
+	hl_thread_info *t = hl_get_thread();
+	hl_trap_ctx *trap = t->trap_current;
+	t->trap_current = f->trap;
+	f->trap = trap;
+	t->stack_top = f->resumer_top;
+	current_fiber = f->parent;
+	f->region.stack_top = f->stack + f->stack_size;
+	f->region.owner = f;
+#	ifdef FIBER_ASM
+	fiber_switch(&f->region.stack_cur, f->region.stack_cur);
+#	else
+	f->region.stack_cur = &t;
+	swapcontext(&f->ctx, &f->resumer_ctx);
+#	endif
+}
+
+static void fiber_main( hl_fiber *f ) {
+	// keep the fiber reachable from its own stack while it runs
+	hl_fiber *volatile self = f;
+	hl_trap_ctx trap;
+	hl_thread_info *t = hl_get_thread();
+	// not hl_trap : the fiber can be resumed by another thread, so the thread
+	// info must be read again once the trap is reached
+	trap.tcheck = NULL;
+	trap.prev = t->trap_current;
+	t->trap_current = &trap;
+	if( setjmp(trap.buf) )
+		self->exc = hl_get_thread()->exc_value;
+	else {
+		hl_dyn_call(self->fun, NULL, 0);
+		hl_get_thread()->trap_current = trap.prev;
+	}
+	self->state = FIBER_DONE;
+	fiber_leave(self);
+	hl_fatal("Dead fiber resumed");
+}
+
+#ifndef FIBER_ASM
+static void fiber_main_ctx( unsigned int lo, unsigned int hi ) {
+	fiber_main((hl_fiber*)(((uint64)hi << 32) | lo));
+}
+#endif
+
+static void fiber_alloc_stack( hl_fiber *f ) {
+	int page = (int)sysconf(_SC_PAGESIZE);
+	int size = (f->stack_size + page - 1) & ~(page - 1);
+	// one more page at the bottom is kept as guard
+	unsigned char *mem = (unsigned char*)mmap(NULL, size + page, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if( mem == (unsigned char*)MAP_FAILED ) hl_error("Failed to allocate fiber stack");
+	mprotect(mem, page, PROT_NONE);
+	f->stack = mem + page;
+	f->stack_size = size;
+#	ifdef FIBER_ASM
+	void **sp = (void**)(f->stack + size - FIBER_FRAME_SIZE);
+	fiber_init_frame(sp, f, (void*)fiber_main);
+	f->region.stack_cur = sp;
+#	else
+	getcontext(&f->ctx);
+	f->ctx.uc_stack.ss_sp = f->stack;
+	f->ctx.uc_stack.ss_size = size;
+	f->ctx.uc_link = NULL;
+	makecontext(&f->ctx, (void(*)())fiber_main_ctx, 2, (unsigned int)(uint64)(int_val)f, (unsigned int)((uint64)(int_val)f >> 32));
+	f->region.stack_cur = NULL;
+#	endif
+	f->region.stack_top = f->stack + size;
+	f->region.owner = f;
+	hl_gc_add_stack(&f->region);
+}
+
+static void fiber_free_stack( hl_fiber *f ) {
+	int page = (int)sysconf(_SC_PAGESIZE);
+	hl_gc_remove_stack(&f->region);
+	munmap(f->stack - page, f->stack_size + page);
+	f->stack = NULL;
+}
+
+static void fiber_finalize( hl_fiber *f ) {
+	if( f->stack ) fiber_free_stack(f);
+	hl_gc_remove_stack(&f->refs);
+}
+
+#endif
+
+HL_PRIM hl_fiber *hl_fiber_create( vclosure *c, int stack_size ) {
+#	ifndef HL_FIBERS
+	hl_error("Fibers are not supported on this platform");
+	return NULL;
+#	else
+	hl_fiber *f;
+	if( c == NULL ) hl_null_access();
+	f = (hl_fiber*)hl_gc_alloc_finalizer(sizeof(hl_fiber));
+	memset(f, 0, sizeof(hl_fiber));
+	f->finalize = fiber_finalize;
+	f->fun = c;
+	f->stack_size = stack_size > 0 ? stack_size : FIBER_DEFAULT_STACK;
+	f->state = FIBER_NEW;
+	f->refs.stack_cur = &f->fun;
+	f->refs.stack_top = &f->stack;
+	f->refs.owner = f;
+	hl_gc_add_stack(&f->refs);
+	return f;
+#	endif
+}
+
+// returns false once the fiber is done, and sets *exc if it ended with an exception
+static bool fiber_resume( hl_fiber *f, vdynamic **exc ) {
+#	ifdef HL_FIBERS
+	hl_thread_info *t = hl_get_thread();
+	hl_trap_ctx *trap;
+	int_val state = ATOMIC_LOAD(&f->state);
+	*exc = NULL;
+	if( state == FIBER_DONE ) return false;
+	if( state == FIBER_RUNNING || !atomic_cas_val(&f->state, state, FIBER_RUNNING) )
+		hl_error("Fiber is already running");
+	if( !t ) hl_fatal("Can't resume a fiber in unregistered thread");
+	if( f->stack == NULL ) fiber_alloc_stack(f);
+	f->requeue = false;
+	f->parent = current_fiber;
+	f->resumer_top = t->stack_top;
+	trap = t->trap_current;
+	t->trap_current = f->trap;
+	f->trap = trap;
+	t->stack_top = f->stack + f->stack_size;
+	current_fiber = f;
+	f->region.stack_top = f->resumer_top;
+	f->region.owner = NULL;
+#	ifdef FIBER_ASM
+	fiber_switch(&f->region.stack_cur, f->region.stack_cur);
+#	else
+	f->region.stack_cur = &trap;
+	swapcontext(&f->resumer_ctx, &f->ctx);
+#	endif
+	if( f->state == FIBER_DONE ) {
+		fiber_free_stack(f);
+		*exc = f->exc;
+		f->exc = NULL;
+		return false;
+	}
+	ATOMIC_STORE(&f->state, FIBER_SUSPENDED);
+	return true;
+#	else
+	hl_error("Fibers are not supported on this platform");
+	return false;
+#	endif
+}
+
+HL_PRIM bool hl_fiber_resume( hl_fiber *f ) {
+	vdynamic *exc;
+	bool alive;
+	if( f->sched ) hl_error("Fiber is run by a scheduler");
+	alive = fiber_resume(f, &exc);
+	if( exc ) hl_rethrow(exc);
+	return alive;
+}
+
+HL_PRIM void hl_fiber_yield() {
+#	ifdef HL_FIBERS
+	hl_fiber *f = current_fiber;
+	if( f == NULL ) hl_error("Not running in a fiber");
+	f->requeue = true;
+	fiber_leave(f);
+#	endif
+}
+
+HL_PRIM hl_fiber *hl_fiber_current() {
+	return current_fiber;
+}
+
+HL_PRIM bool hl_fiber_is_done( hl_fiber *f ) {
+	return ATOMIC_LOAD(&f->state) == FIBER_DONE;
+}
+
+static void fiber_sched_push( hl_fiber_sched *s, void *v ) {
+	while( !hl_ring_push(s->ready, (vdynamic*)v) )
+		hl_gc_safepoint();
+}
+
+// only the caller that moves the fiber out of the suspended state pushes it
+static void fiber_sched_queue( hl_fiber *f ) {
+	if( atomic_cas_val(&f->state, FIBER_SUSPENDED, FIBER_QUEUED) ) {
+		ATOMIC_STORE(&f->woken, 0);
+		fiber_sched_push(f->sched, f);
+	}
+}
+
+HL_PRIM hl_fiber_sched *hl_fiber_sched_alloc( int capacity ) {
+	hl_fiber_sched *s = (hl_fiber_sched*)hl_gc_alloc_raw(sizeof(hl_fiber_sched));
+	memset(s, 0, sizeof(hl_fiber_sched));
+	s->ready = hl_ring_alloc(capacity > 0 ? capacity : (1 << 16));
+	return s;
+}
+
+HL_PRIM hl_fiber *hl_fiber_spawn( hl_fiber_sched *s, vclosure *c, int stack_size ) {
+	hl_fiber *f = hl_fiber_create(c, stack_size);
+	f->sched = s;
+	f->state = FIBER_QUEUED;
+	ATOMIC_ADD(&s->active, 1);
+	fiber_sched_push(s, f);
+	return f;
+}
+
+// suspend the current fiber until fiber_wake is called on it
+HL_PRIM void hl_fiber_suspend() {
+#	ifdef HL_FIBERS
+	hl_fiber *f = current_fiber;
+	if( f == NULL || f->sched == NULL ) hl_error("Not running in a scheduled fiber");
+	fiber_leave(f);
+#	endif
+}
+
+HL_PRIM void hl_fiber_wake( hl_fiber *f ) {
+	if( f->sched == NULL ) hl_error("Fiber is not scheduled");
+	if( ATOMIC_LOAD(&f->state) == FIBER_QUEUED ) return;
+	ATOMIC_STORE(&f->woken, 1);
+	ATOMIC_FENCE();
+	// either we see it suspended, or its runner will see the wake flag
+	fiber_sched_queue(f);
+}
+
+HL_PRIM void hl_fiber_sched_run( hl_fiber_sched *s ) {
+	ATOMIC_ADD(&s->runners, 1);
+	while( ATOMIC_LOAD(&s->active) > 0 ) {
+		vdynamic *exc;
+		hl_fiber *f = (hl_fiber*)hl_ring_pop(s->ready, true);
+		if( f == (hl_fiber*)s ) continue; // stop token
+		if( !fiber_resume(f, &exc) ) {
+			if( exc ) hl_print_uncaught_exception(exc);
+			if( ATOMIC_ADD(&s->active, -1) == 0 ) {
+				// wake up the other runners so they can leave
+				int_val i, count = ATOMIC_LOAD(&s->runners) - 1;
+				for(i=0;i<count;i++)
+					fiber_sched_push(s, s);
+			}
+			continue;
+		}
+		ATOMIC_FENCE();
+		if( f->requeue || ATOMIC_LOAD(&f->woken) )
+			fiber_sched_queue(f);
+	}
+	ATOMIC_ADD(&s->runners, -1);
+}
+
+#define _FIBER _ABSTRACT(hl_fiber)
+#define _FSCHED _ABSTRACT(hl_fiber_sched)
+DEFINE_PRIM(_FIBER, fiber_create, _FUN(_VOID,_NO_ARG) _I32);
+DEFINE_PRIM(_BOOL, fiber_resume, _FIBER);
+DEFINE_PRIM(_VOID, fiber_yield, _NO_ARG);
+DEFINE_PRIM(_FIBER, fiber_current, _NO_ARG);
+DEFINE_PRIM(_BOOL, fiber_is_done, _FIBER);
+DEFINE_PRIM(_FSCHED, fiber_sched_alloc, _I32);
+DEFINE_PRIM(_FIBER, fiber_spawn, _FSCHED _FUN(_VOID,_NO_ARG) _I32);
+DEFINE_PRIM(_VOID, fiber_suspend, _NO_ARG);
+DEFINE_PRIM(_VOID, fiber_wake, _FIBER);
+DEFINE_PRIM(_VOID, fiber_sched_run, _FSCHED);